@@ -0,0 +1,330 @@
+/***********************************************************************
+      LIBRARY: IMAGE - Image Manipulation and Processing Routines
+
+      FILE:    BATCH.C
+
+      Contains routines responsible for running an image coder over a
+      whole list of files in one process.  A read-ahead thread loads
+      the next files while a fixed pool of worker threads codes and
+      writes the ones already loaded, so disk reads overlap with the
+      coding.  A file that fails is reported and skipped; the rest of
+      the batch carries on.
+
+      ROUTINES:
+#cat: read_batch_list - reads the file names of a batch from a list
+#cat:               file (one name per line) or from a directory.
+#cat: free_batch_list - deallocates a list of batch file names.
+#cat:
+#cat: run_batch - loads and processes a list of files with a pool of
+#cat:               worker threads and a read-ahead thread.
+#cat: print_batch_stats - prints the throughput of a finished batch.
+#cat:
+
+***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include <batch.h>
+
+typedef struct batch_pool {
+   pthread_mutex_t lock;
+   pthread_cond_t loaded;    /* signaled when an item has been loaded */
+   pthread_cond_t taken;     /* signaled when a worker takes an item */
+   BATCH_ITEM *items;
+   int nfiles;
+   int nloaded;              /* items read so far, in list order */
+   int ntaken;               /* items handed to workers */
+   int ahead;                /* most items loaded but not yet taken */
+   BATCH_RUN run;
+   void *arg;
+   BATCH_STATS *stats;
+} BATCH_POOL;
+
+typedef struct batch_worker {
+   BATCH_POOL *pool;
+   int id;
+   pthread_t thread;
+} BATCH_WORKER;
+
+/***********************************************************************/
+/* Appends a copy of a file name to a growing list.                    */
+/***********************************************************************/
+static int add_batch_file(char ***files, int *nfiles, int *alloc,
+                          const char *name)
+{
+   char **nlist;
+
+   if(*nfiles == *alloc){
+      *alloc = (*alloc == 0) ? 256 : *alloc * 2;
+      nlist = (char **)realloc(*files, *alloc * sizeof(char *));
+      if(nlist == (char **)NULL){
+         fprintf(stderr, "ERROR : add_batch_file : realloc : files\n");
+         return(-2);
+      }
+      *files = nlist;
+   }
+
+   (*files)[*nfiles] = strdup(name);
+   if((*files)[*nfiles] == (char *)NULL){
+      fprintf(stderr, "ERROR : add_batch_file : strdup : %s\n", name);
+      return(-3);
+   }
+   (*nfiles)++;
+
+   return(0);
+}
+
+static int cmp_batch_files(const void *a, const void *b)
+{
+   return(strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+/***********************************************************************/
+/* Reads the names of the files in a batch.  If "name" is a directory  */
+/* the regular files in it are taken in sorted order, skipping hidden  */
+/* files; otherwise "name" is a list file holding one path per line.   */
+/***********************************************************************/
+int read_batch_list(char ***ofiles, int *onfiles, char *name)
+{
+   char **files;
+   int nfiles, alloc, ret, len;
+   char path[MAXPATHLEN];
+   struct stat st;
+   DIR *dir;
+   struct dirent *ent;
+   FILE *fp;
+
+   files = (char **)NULL;
+   nfiles = 0;
+   alloc = 0;
+
+   if(stat(name, &st)){
+      fprintf(stderr, "ERROR : read_batch_list : stat : %s\n", name);
+      return(-4);
+   }
+
+   if(S_ISDIR(st.st_mode)){
+      if((dir = opendir(name)) == (DIR *)NULL){
+         fprintf(stderr, "ERROR : read_batch_list : opendir : %s\n", name);
+         return(-5);
+      }
+      while((ent = readdir(dir)) != (struct dirent *)NULL){
+         if(ent->d_name[0] == '.')
+            continue;
+         if(snprintf(path, MAXPATHLEN, "%s/%s", name, ent->d_name)
+            >= MAXPATHLEN)
+            continue;
+         if(stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+         ret = add_batch_file(&files, &nfiles, &alloc, path);
+         if(ret){
+            closedir(dir);
+            free_batch_list(files, nfiles);
+            return(ret);
+         }
+      }
+      closedir(dir);
+      qsort(files, nfiles, sizeof(char *), cmp_batch_files);
+   }
+   else{
+      if((fp = fopen(name, "r")) == (FILE *)NULL){
+         fprintf(stderr, "ERROR : read_batch_list : fopen : %s\n", name);
+         return(-6);
+      }
+      while(fgets(path, MAXPATHLEN, fp) != (char *)NULL){
+         len = strlen(path);
+         while(len > 0 && (path[len-1] == '\n' || path[len-1] == '\r' ||
+                           path[len-1] == ' ' || path[len-1] == '\t'))
+            path[--len] = '\0';
+         if(len == 0)
+            continue;
+         ret = add_batch_file(&files, &nfiles, &alloc, path);
+         if(ret){
+            fclose(fp);
+            free_batch_list(files, nfiles);
+            return(ret);
+         }
+      }
+      fclose(fp);
+   }
+
+   *ofiles = files;
+   *onfiles = nfiles;
+   return(0);
+}
+
+/***********************************************************************/
+void free_batch_list(char **files, const int nfiles)
+{
+   int i;
+
+   if(files == (char **)NULL)
+      return;
+   for(i = 0; i < nfiles; i++)
+      free(files[i]);
+   free(files);
+}
+
+/***********************************************************************/
+/* Runs one loaded item and adds it to the batch totals.               */
+/***********************************************************************/
+static void run_batch_item(BATCH_POOL *pool, BATCH_ITEM *item, const int id)
+{
+   int ret;
+
+   ret = item->ret;
+   if(ret == 0)
+      ret = (*pool->run)(item, id, pool->arg);
+
+   pthread_mutex_lock(&pool->lock);
+   pool->stats->ibytes += item->ilen;
+   if(ret){
+      pool->stats->nfailed++;
+      fprintf(stderr, "ERROR : run_batch : %s : error %d\n", item->ifile, ret);
+   }
+   else
+      pool->stats->obytes += item->olen;
+   pthread_mutex_unlock(&pool->lock);
+}
+
+/***********************************************************************/
+/* Takes loaded items in list order until all of them are taken.       */
+/***********************************************************************/
+static void *batch_worker(void *varg)
+{
+   BATCH_WORKER *worker = (BATCH_WORKER *)varg;
+   BATCH_POOL *pool = worker->pool;
+   int i;
+
+   while(1){
+      pthread_mutex_lock(&pool->lock);
+      while(pool->ntaken == pool->nloaded && pool->nloaded < pool->nfiles)
+         pthread_cond_wait(&pool->loaded, &pool->lock);
+      if(pool->ntaken == pool->nfiles){
+         pthread_mutex_unlock(&pool->lock);
+         break;
+      }
+      i = pool->ntaken++;
+      pthread_cond_signal(&pool->taken);
+      pthread_mutex_unlock(&pool->lock);
+
+      run_batch_item(pool, &pool->items[i], worker->id);
+   }
+
+   return((void *)NULL);
+}
+
+/***********************************************************************/
+/* Loads and processes every file in "files".  The calling thread      */
+/* reads ahead, keeping up to BATCH_READ_AHEAD loaded files queued     */
+/* for each of the "nworkers" workers, which run them in list order.   */
+/* Only errors that stop the whole batch are returned; failures of     */
+/* single files are counted in "stats".                                */
+/***********************************************************************/
+int run_batch(char **files, const int nfiles, const int nworkers,
+              BATCH_LOAD load, BATCH_RUN run, void *arg, BATCH_STATS *stats)
+{
+   BATCH_POOL pool;
+   BATCH_WORKER *workers;
+   BATCH_ITEM *items, *item;
+   struct timeval t0, t1;
+   int i, nstarted;
+
+   memset(stats, 0, sizeof(BATCH_STATS));
+   stats->nfiles = nfiles;
+   gettimeofday(&t0, NULL);
+
+   items = (BATCH_ITEM *)calloc(nfiles + 1, sizeof(BATCH_ITEM));
+   if(items == (BATCH_ITEM *)NULL){
+      fprintf(stderr, "ERROR : run_batch : calloc : items\n");
+      return(-2);
+   }
+   for(i = 0; i < nfiles; i++)
+      items[i].ifile = files[i];
+
+   workers = (BATCH_WORKER *)calloc((nworkers > 0) ? nworkers : 1,
+                                    sizeof(BATCH_WORKER));
+   if(workers == (BATCH_WORKER *)NULL){
+      free(items);
+      fprintf(stderr, "ERROR : run_batch : calloc : workers\n");
+      return(-3);
+   }
+
+   pool.items = items;
+   pool.nfiles = nfiles;
+   pool.nloaded = 0;
+   pool.ntaken = 0;
+   pool.ahead = BATCH_READ_AHEAD * ((nworkers > 0) ? nworkers : 1);
+   pool.run = run;
+   pool.arg = arg;
+   pool.stats = stats;
+   pthread_mutex_init(&pool.lock, NULL);
+   pthread_cond_init(&pool.loaded, NULL);
+   pthread_cond_init(&pool.taken, NULL);
+
+   for(nstarted = 0; nstarted < nworkers; nstarted++){
+      workers[nstarted].pool = &pool;
+      workers[nstarted].id = nstarted;
+      if(pthread_create(&workers[nstarted].thread, NULL, batch_worker,
+                        &workers[nstarted]))
+         break;
+   }
+
+   for(i = 0; i < nfiles; i++){
+      item = &items[i];
+      item->ret = (*load)(item, arg);
+
+      /* Without workers, process each file as soon as it is read. */
+      if(nstarted == 0){
+         pool.ntaken = pool.nloaded = i + 1;
+         run_batch_item(&pool, item, 0);
+         continue;
+      }
+
+      pthread_mutex_lock(&pool.lock);
+      pool.nloaded = i + 1;
+      pthread_cond_signal(&pool.loaded);
+      while(pool.nloaded - pool.ntaken >= pool.ahead)
+         pthread_cond_wait(&pool.taken, &pool.lock);
+      pthread_mutex_unlock(&pool.lock);
+   }
+
+   /* Wake any workers still waiting so they see the list is done. */
+   pthread_mutex_lock(&pool.lock);
+   pthread_cond_broadcast(&pool.loaded);
+   pthread_mutex_unlock(&pool.lock);
+
+   for(i = 0; i < nstarted; i++)
+      pthread_join(workers[i].thread, NULL);
+
+   pthread_cond_destroy(&pool.taken);
+   pthread_cond_destroy(&pool.loaded);
+   pthread_mutex_destroy(&pool.lock);
+   free(workers);
+   free(items);
+
+   gettimeofday(&t1, NULL);
+   stats->secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+
+   return(0);
+}
+
+/***********************************************************************/
+void print_batch_stats(FILE *fp, const BATCH_STATS *stats)
+{
+   double secs;
+
+   secs = (stats->secs > 0.0) ? stats->secs : 1e-6;
+   fprintf(fp, "%d files, %d failed, %.2f seconds\n",
+           stats->nfiles, stats->nfailed, stats->secs);
+   fprintf(fp, "%.1f images/s, %.2f MB/s in, %.2f MB/s out\n",
+           (stats->nfiles - stats->nfailed) / secs,
+           stats->ibytes / (1024.0 * 1024.0) / secs,
+           stats->obytes / (1024.0 * 1024.0) / secs);
+}
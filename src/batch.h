@@ -0,0 +1,39 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stdio.h>
+
+/* One file of a batch.  The load routine fills in "data" and "ilen"; */
+/* the run routine consumes "data" and sets "olen".                    */
+typedef struct batch_item {
+   char *ifile;       /* input file name */
+   void *data;        /* input read ahead by the load routine */
+   int ilen;          /* bytes read */
+   int olen;          /* bytes written */
+   int ret;           /* error from the load routine, or 0 */
+} BATCH_ITEM;
+
+typedef struct batch_stats {
+   int nfiles;
+   int nfailed;
+   double ibytes;     /* total bytes read */
+   double obytes;     /* total bytes written */
+   double secs;       /* elapsed wall clock time */
+} BATCH_STATS;
+
+/* Reads one file on the read-ahead thread, returning 0 or an error. */
+/* On error it must leave nothing behind in "data".                  */
+typedef int (*BATCH_LOAD)(BATCH_ITEM *, void *);
+/* Processes one loaded file on the given worker and frees "data".   */
+typedef int (*BATCH_RUN)(BATCH_ITEM *, const int, void *);
+
+/* Number of loaded files kept waiting for each worker. */
+#define BATCH_READ_AHEAD  2
+
+extern int read_batch_list(char ***, int *, char *);
+extern void free_batch_list(char **, const int);
+extern int run_batch(char **, const int, const int, BATCH_LOAD, BATCH_RUN,
+                     void *, BATCH_STATS *);
+extern void print_batch_stats(FILE *, const BATCH_STATS *);
+
+#endif /* !_BATCH_H */
@@ -0,0 +1,256 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     BENCHG4.C
+
+      DATE:     10/17/2026
+
+#cat: benchg4 - Times the Group 4 decoding of synthetic text and
+#cat:           fingerprint ridge pages, reporting pages/s on one thread
+#cat:           and on several, and checks that every page decodes to
+#cat:           the image it was coded from.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <wsq.h>
+#include <grp4comp.h>
+#include <grp4deco.h>
+
+/* Page contents timed. */
+#define PAGE_TEXT     0   /* rows of small glyph boxes */
+#define PAGE_RIDGES   1   /* curved fingerprint like ridges */
+#define NUM_PAGES     2
+
+static char *page_names[NUM_PAGES] = { "text", "ridges" };
+
+/* Pages decoded on their own threads, each thread taking every */
+/* "nthreads"-th page with its own context and output buffer.   */
+typedef struct g4_page_jobs {
+   unsigned char *cdata;     /* coded page */
+   int clen;
+   unsigned char *image;     /* page it was coded from */
+   int width, height;
+   int npages;
+   int nthreads;
+   int nbad;                 /* pages decoded wrongly */
+   pthread_mutex_t lock;
+} G4_PAGE_JOBS;
+
+void procargs(int, char **, int *, int *, int *, int *);
+void print_usage(char *);
+void gen_page(unsigned char *, const int, const int, const int);
+int time_pages(double *, G4_PAGE_JOBS *, const int);
+
+int debug = 0;
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, k, npages, nthreads, width, height, size, nfailed;
+   double t1, tn;
+   G4_PAGE_JOBS jobs;
+   G4_ENC_CTX *enc;
+
+   procargs(argc, argv, &npages, &nthreads, &width, &height);
+
+   size = (width / 8) * height;
+   jobs.image = (unsigned char *)malloc(size);
+   /* Pages that code poorly may grow past their raw size. */
+   jobs.cdata = (unsigned char *)malloc(2 * size);
+   if(jobs.image == (unsigned char *)NULL ||
+      jobs.cdata == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : main : malloc : pages\n");
+      exit(-2);
+   }
+   jobs.width = width;
+   jobs.height = height;
+   jobs.npages = npages;
+   pthread_mutex_init(&jobs.lock, NULL);
+   if((ret = alloc_G4_ENC_CTX(&enc)))
+      exit(ret);
+
+   nfailed = 0;
+   printf("%-8s %9s %10s %12s %12s\n", "page", "size", "coded KB",
+          "1 thr pg/s", "n thr pg/s");
+   for(k = 0; k < NUM_PAGES; k++){
+      gen_page(jobs.image, width, height, k);
+      if((ret = grp4comp_ctx(enc, jobs.image, size, width, height,
+                             jobs.cdata, 2 * size, &jobs.clen)))
+         exit(ret);
+
+      jobs.nbad = 0;
+      if((ret = time_pages(&t1, &jobs, 1)))
+         exit(ret);
+      if((ret = time_pages(&tn, &jobs, nthreads)))
+         exit(ret);
+      if(jobs.nbad){
+         fprintf(stderr, "ERROR : main : %s : %d pages decoded wrongly\n",
+                 page_names[k], jobs.nbad);
+         nfailed++;
+      }
+      printf("%-8s %4dx%-4d %10.1f %12.1f %12.1f\n", page_names[k],
+             width, height, jobs.clen / 1024.0, npages / t1, npages / tn);
+   }
+   if(nthreads > 1)
+      printf("(%d threads)\n", nthreads);
+
+   free_G4_ENC_CTX(enc);
+   pthread_mutex_destroy(&jobs.lock);
+   free(jobs.image);
+   free(jobs.cdata);
+   exit(nfailed ? -1 : 0);
+}
+
+/*****************************************************************/
+/* Fills a "width" x "height" page, 1 bit per pixel with 1 for   */
+/* black, with text like glyphs or fingerprint like ridges.      */
+/*****************************************************************/
+void gen_page(unsigned char *image, const int width, const int height,
+              const int kind)
+{
+   int x, y, lx, ly, edge, black;
+   unsigned int seed;
+
+   seed = 1;
+   memset(image, 0, (width / 8) * height);
+   for(y = 0; y < height; y++){
+      for(x = 0; x < width; x++){
+         if(kind == PAGE_TEXT){
+            /* Glyph boxes 12 wide and 30 high with speckled insides, */
+            /* inside a margin of 200 pixels.                         */
+            ly = y % 60;
+            lx = x % 18;
+            seed = seed * 1103515245 + 12345;
+            edge = (lx == 0 || lx == 11 || ly == 0 || ly == 29);
+            black = (y > 200 && y < height - 200 &&
+                     x > 200 && x < width - 200 && ly < 30 && lx < 12 &&
+                     (int)((seed >> 8) % 100) < (edge ? 90 : 3));
+         }
+         else
+            black = sin(x * 0.35 + 8.0 * sin(y * 0.01)) *
+                    cos(y * 0.3 + 5.0 * sin(x * 0.013)) > 0.2;
+         if(black)
+            image[y * (width / 8) + x / 8] |= 0x80 >> (x & 7);
+      }
+   }
+}
+
+/*****************************************************************/
+/* Decodes every "nthreads"-th page from "k" on, checking each   */
+/* against the page it was coded from.                           */
+/*****************************************************************/
+static int decode_pages_job(void *arg, const int k)
+{
+   G4_PAGE_JOBS *jobs = (G4_PAGE_JOBS *)arg;
+   G4_DEC_CTX *ctx;
+   unsigned char *odata;
+   int ret, i, size, olen, nbad;
+
+   size = (jobs->width / 8) * jobs->height;
+   odata = (unsigned char *)malloc(size);
+   if(odata == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : decode_pages_job : malloc : odata\n");
+      return(-2);
+   }
+   if((ret = alloc_G4_DEC_CTX(&ctx))){
+      free(odata);
+      return(ret);
+   }
+
+   nbad = 0;
+   for(i = k; i < jobs->npages; i += jobs->nthreads){
+      ret = grp4decomp_ctx(ctx, jobs->cdata, jobs->clen, jobs->width,
+                           jobs->height, odata, size, &olen);
+      if(ret || olen != size || memcmp(odata, jobs->image, size))
+         nbad++;
+   }
+
+   free_G4_DEC_CTX(ctx);
+   free(odata);
+
+   pthread_mutex_lock(&jobs->lock);
+   jobs->nbad += nbad;
+   pthread_mutex_unlock(&jobs->lock);
+   return(0);
+}
+
+/*****************************************************************/
+/* Decodes the coded page of "jobs" npages times on "nthreads"   */
+/* threads, returning the seconds taken.                         */
+/*****************************************************************/
+int time_pages(double *osecs, G4_PAGE_JOBS *jobs, const int nthreads)
+{
+   int ret;
+   double t0;
+
+   jobs->nthreads = nthreads;
+   t0 = now();
+   ret = wsq_run_jobs(nthreads, nthreads, decode_pages_job, jobs);
+   *osecs = now() - t0;
+   return(ret);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *npages, int *nthreads,
+              int *width, int *height)
+{
+   int i, *val;
+
+   *npages = 20;
+   *nthreads = 4;
+   *width = 2560;
+   *height = 3300;
+   for(i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2){
+      if(strcmp(argv[i], "-n") == 0)
+         val = npages;
+      else if(strcmp(argv[i], "-t") == 0)
+         val = nthreads;
+      else {
+         print_usage(argv[0]);
+         exit(-1);
+      }
+      if(sscanf(argv[i+1], "%d", val) != 1 || *val < 1){
+         print_usage(argv[0]);
+         exit(-1);
+      }
+   }
+   if(i < argc &&
+      (sscanf(argv[i++], "%dx%d", width, height) != 2 ||
+       *width < 8 || *width % 8 != 0 || *height < 1)){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+   if(i < argc){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n pages] [-t threads] [WxH]\n\n", arg0);
+   fprintf(stderr, "   -n pages   = pages decoded per timing (default 20)\n");
+   fprintf(stderr, "   -t threads = threads for the second timing\n");
+   fprintf(stderr, "                (default 4)\n");
+   fprintf(stderr, "   WxH        = page size, W a multiple of 8\n");
+   fprintf(stderr, "                (default 2560x3300)\n");
+}
@@ -0,0 +1,426 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     BENCHHUFF.C
+
+      DATE:     10/17/2026
+
+#cat: benchhuff - Times the building of huffman tables from WSQ and JPEGL
+#cat:             shaped histograms with the heap based find_huff_sizes
+#cat:             and with the rescanning one it replaced, and checks
+#cat:             that the heap builder never gives longer codes.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <jpegl.h>
+#include <wsq.h>
+
+/* Histogram shapes.  The first two are what the codecs count; the */
+/* rest are edge cases for the equivalence check only.             */
+#define HIST_WSQ      0   /* zero runs and laplacian coefficients */
+#define HIST_JPEGL    1   /* difference categories about a peak */
+#define HIST_TIES     2   /* few distinct small counts */
+#define HIST_SPARSE   3   /* most values unused */
+#define HIST_FIB      4   /* fibonacci counts, codes past 16 bits */
+#define NUM_HISTS     5
+
+static char *hist_names[NUM_HISTS] = {
+   "wsq", "jpegl", "ties", "sparse", "fibonacci" };
+
+typedef int (*HUFF_SIZER)(int **, int *, const int);
+typedef int (*HUFF_SORTER)(unsigned char **, int *, const int);
+
+void procargs(int, char **, int *, int *);
+void print_usage(char *);
+void gen_histogram(int *, const int, const int, const int);
+int build_table(int *, unsigned char **, unsigned char **, long *,
+                HUFF_SIZER, HUFF_SORTER, const int);
+int check_tables(const int, const int, const int, int *, int *);
+int time_tables(double *, HUFF_SIZER, HUFF_SORTER, const int, const int,
+                const int);
+int old_find_huff_sizes(int **, int *, const int);
+int old_sort_code_sizes(unsigned char **, int *, const int);
+
+int debug = 0;
+
+static unsigned int rand_state;
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+static int next_rand(void)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return((int)((rand_state >> 8) & 0x7fffff));
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, h, n, niters, ntrials, nfailed, nsame, nshorter;
+   double told, tnew;
+
+   procargs(argc, argv, &niters, &ntrials);
+
+   nfailed = 0;
+   printf("%-10s %8s %8s %8s %8s\n", "histogram", "symbols", "tables",
+          "same", "shorter");
+   for(h = 0; h < NUM_HISTS; h++){
+      for(n = MAX_HUFFCOUNTS_JPEGL; n <= MAX_HUFFCOUNTS_WSQ;
+          n += MAX_HUFFCOUNTS_WSQ - MAX_HUFFCOUNTS_JPEGL){
+         ret = check_tables(h, n, ntrials, &nsame, &nshorter);
+         if(ret < 0)
+            exit(ret);
+         nfailed += ret;
+         printf("%-10s %8d %8d %8d %8d\n", hist_names[h], n, ntrials,
+                nsame, nshorter);
+      }
+   }
+
+   printf("\n%-10s %8s %12s %12s %8s\n", "histogram", "symbols",
+          "old us", "heap us", "speedup");
+   for(h = HIST_WSQ; h <= HIST_JPEGL; h++){
+      n = (h == HIST_WSQ) ? MAX_HUFFCOUNTS_WSQ : MAX_HUFFCOUNTS_JPEGL;
+      if((ret = time_tables(&told, old_find_huff_sizes, old_sort_code_sizes,
+                            h, n, niters)))
+         exit(ret);
+      if((ret = time_tables(&tnew, find_huff_sizes, sort_code_sizes,
+                            h, n, niters)))
+         exit(ret);
+      printf("%-10s %8d %12.2f %12.2f %8.2f\n", hist_names[h], n,
+             told * 1.0e6, tnew * 1.0e6, told / tnew);
+   }
+
+   if(nfailed){
+      fprintf(stderr, "benchhuff : %d tables with longer codes\n", nfailed);
+      exit(-1);
+   }
+   exit(0);
+}
+
+/*****************************************************************/
+/* Fills "freq" with a histogram of "n" values of the given      */
+/* shape, varied by "trial", and sets the reserved count at      */
+/* freq[n] to 1 as the codecs do.                                */
+/*****************************************************************/
+void gen_histogram(int *freq, const int n, const int shape, const int trial)
+{
+   int i, v, a, b, t;
+   double scale;
+
+   rand_state = trial * 7919 + shape;
+   memset(freq, 0, (n + 1) * sizeof(int));
+   scale = 1.0 + (trial % 16);
+   switch(shape){
+   case HIST_WSQ:
+      /* Zero runs of 1 to 100, the 8 and 16 bit escapes, then the */
+      /* coefficients about category 180.  Narrow tables fold the  */
+      /* same shape onto fewer values.                             */
+      for(i = 0; i < n; i++){
+         v = i * MAX_HUFFCOUNTS_WSQ / n;
+         if(v >= 1 && v <= 100)
+            freq[i] = (int)(20000.0 * exp(-v / scale));
+         else if(v >= 101 && v <= 106)
+            freq[i] = next_rand() % 50;
+         else if(v >= 107 && v < 255 && v != 180)
+            freq[i] = (int)(200000.0 * exp(-abs(v - 180) / scale));
+         freq[i] += (freq[i] > 0) ? next_rand() % (freq[i] / 8 + 1) : 0;
+      }
+      break;
+   case HIST_JPEGL:
+      /* Categories of 8 bit differences peak a few bits in. */
+      for(i = 0; i < n; i++){
+         v = i - (2 + trial % 5);
+         if(i <= MAX_CATEGORY)
+            freq[i] = (int)(500000.0 * exp(-(v * v) / (1.0 + scale / 4.0)))
+                      + next_rand() % 16;
+      }
+      break;
+   case HIST_TIES:
+      for(i = 0; i < n; i++)
+         freq[i] = next_rand() % 5;
+      break;
+   case HIST_SPARSE:
+      for(i = 0; i < n; i++)
+         if(next_rand() % 7 == 0)
+            freq[i] = 1 + next_rand() % 100000;
+      break;
+   case HIST_FIB:
+      a = 1;
+      b = 1 + trial % 3;
+      for(i = 0; i < n && i < 30; i++){
+         freq[i] = a;
+         t = a + b;
+         a = b;
+         b = t;
+      }
+      break;
+   }
+   freq[n] = 1;
+}
+
+
+/*****************************************************************/
+/* Builds the code sizes and values of a huffman table for       */
+/* "freq" as the codecs do, limiting codes to MAX_HUFFBITS bits, */
+/* and returns the bits the histogram would code to in "ocost".  */
+/* "freq" is left as it was.                                     */
+/*****************************************************************/
+int build_table(int *freq, unsigned char **obits, unsigned char **ovalues,
+                long *ocost, HUFF_SIZER sizer, HUFF_SORTER sorter,
+                const int n)
+{
+   int ret, i, j, k, adjust;
+   int work[MAX_HUFFCOUNTS_WSQ+1];
+   int *codesize;
+   unsigned char *bits, *values;
+   long cost;
+
+   /* The old builder merges the counts it is given. */
+   memcpy(work, freq, (n + 1) * sizeof(int));
+   if((ret = (*sizer)(&codesize, work, n)))
+      return(ret);
+   if((ret = find_num_huff_sizes(&bits, &adjust, codesize, n))){
+      free(codesize);
+      return(ret);
+   }
+   if(adjust && (ret = sort_huffbits(bits))){
+      free(codesize);
+      free(bits);
+      return(ret);
+   }
+   if((ret = (*sorter)(&values, codesize, n))){
+      free(codesize);
+      free(bits);
+      return(ret);
+   }
+   free(codesize);
+
+   cost = 0;
+   k = 0;
+   for(i = 0; i < MAX_HUFFBITS<<1; i++)
+      for(j = 0; j < bits[i]; j++, k++)
+         cost += (long)freq[values[k]] * (i + 1);
+
+   *obits = bits;
+   *ovalues = values;
+   *ocost = cost;
+   return(0);
+}
+
+/*****************************************************************/
+/* Builds "ntrials" tables from histograms of shape "shape" with */
+/* both builders.  Counts the tables that code the histogram in  */
+/* as many bits as before, and the ones where the heap builder   */
+/* needs fewer, and returns the number where it needs more.      */
+/*****************************************************************/
+int check_tables(const int shape, const int n, const int ntrials,
+                 int *onsame, int *onshorter)
+{
+   int ret, t, nlonger;
+   int freq[MAX_HUFFCOUNTS_WSQ+1];
+   unsigned char *bits_old, *values_old, *bits_new, *values_new;
+   long cost_old, cost_new;
+
+   *onsame = 0;
+   *onshorter = 0;
+   nlonger = 0;
+   for(t = 0; t < ntrials; t++){
+      gen_histogram(freq, n, shape, t);
+      ret = build_table(freq, &bits_old, &values_old, &cost_old,
+                        old_find_huff_sizes, old_sort_code_sizes, n);
+      if(ret)
+         return(ret);
+      ret = build_table(freq, &bits_new, &values_new, &cost_new,
+                        find_huff_sizes, sort_code_sizes, n);
+      if(ret){
+         free(bits_old);
+         free(values_old);
+         return(ret);
+      }
+
+      if(cost_new == cost_old)
+         (*onsame)++;
+      else if(cost_new < cost_old)
+         (*onshorter)++;
+      else {
+         fprintf(stderr, "%s histogram %d of %d values : ",
+                 hist_names[shape], t, n);
+         fprintf(stderr, "heap codes take %ld bits, old ones %ld\n",
+                 cost_new, cost_old);
+         nlonger++;
+      }
+
+      free(bits_old);
+      free(values_old);
+      free(bits_new);
+      free(values_new);
+   }
+
+   return(nlonger);
+}
+
+/*****************************************************************/
+/* Builds tables for 16 histograms of shape "shape" "niters"     */
+/* times each with "sizer" and "sorter", returning the mean      */
+/* seconds per table.                                            */
+/*****************************************************************/
+int time_tables(double *osecs, HUFF_SIZER sizer, HUFF_SORTER sorter,
+                const int shape, const int n, const int niters)
+{
+   int ret, i, t;
+   int freq[16][MAX_HUFFCOUNTS_WSQ+1];
+   unsigned char *bits, *values;
+   long cost;
+   double t0;
+
+   for(t = 0; t < 16; t++)
+      gen_histogram(freq[t], n, shape, t);
+
+   t0 = now();
+   for(i = 0; i < niters; i++){
+      for(t = 0; t < 16; t++){
+         ret = build_table(freq[t], &bits, &values, &cost, sizer, sorter, n);
+         if(ret)
+            return(ret);
+         free(bits);
+         free(values);
+      }
+   }
+   *osecs = (now() - t0) / (16.0 * niters);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* find_huff_sizes as it was before the heap: each merge rescans */
+/* every count with find_least_freq and walks the chains of the  */
+/* merged values to bump their code sizes.  "freq" is merged in  */
+/* place.                                                        */
+/*****************************************************************/
+int old_find_huff_sizes(int **ocodesize, int *freq, const int max_huffcounts)
+{
+   int *codesize;       /*codesizes for each category*/
+   int *others;         /*pointer used to generate codesizes*/
+   int value1;          /*smallest and next smallest frequency*/
+   int value2;          /*of difference occurrence in the largest
+                          difference category*/
+   int i;               /*increment variable*/
+
+   codesize = (int *)calloc(max_huffcounts+1, sizeof(int));
+   if(codesize == (int *)NULL){
+      fprintf(stderr, "ERROR : old_find_huff_sizes : calloc : codesize\n");
+      return(-2);
+   }
+   others = (int *)malloc((max_huffcounts+1) * sizeof(int));
+   if(others == (int *)NULL){
+      fprintf(stderr, "ERROR : old_find_huff_sizes : malloc : others\n");
+      free(codesize);
+      return(-3);
+   }
+
+   for (i = 0; i <= max_huffcounts; i++)
+      others[i] = -1;
+
+   while(1) {
+      find_least_freq(&value1, &value2, freq, max_huffcounts);
+      if(value2 == -1)
+         break;
+
+      freq[value1] += freq[value2];
+      freq[value2] = 0;
+
+      codesize[value1]++;
+      while(others[value1] != -1) {
+         value1 = others[value1];
+         codesize[value1]++;
+      }
+      others[value1] = value2;
+      codesize[value2]++;
+
+      while(others[value2] != -1) {
+         value2 = others[value2];
+         codesize[value2]++;
+      }
+   }
+   free(others);
+
+   *ocodesize = codesize;
+   return(0);
+}
+
+/*****************************************************************/
+/* sort_code_sizes as it was before the counting sort: one pass  */
+/* over the values for every code size.                          */
+/*****************************************************************/
+int old_sort_code_sizes(unsigned char **ovalues, int *codesize,
+                        const int max_huffcounts)
+{
+   unsigned char *values;
+   int i, i2 = 0, i3;
+
+   values = (unsigned char *)calloc(max_huffcounts+1, sizeof(unsigned char));
+   if(values == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : old_sort_code_sizes : calloc : value\n");
+      return(-2);
+   }
+
+   for(i = 1; i <= (MAX_HUFFBITS<<1); i++) {
+      for(i3 = 0; i3 < max_huffcounts; i3++) {
+         if(codesize[i3] == i) {
+            values[i2] = i3;
+            i2++;
+         }
+      }
+   }
+
+   *ovalues = values;
+   return(0);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *niters, int *ntrials)
+{
+   int i, *val;
+
+   *niters = 1000;
+   *ntrials = 300;
+   for(i = 1; i < argc; i += 2){
+      if(strcmp(argv[i], "-n") == 0)
+         val = niters;
+      else if(strcmp(argv[i], "-t") == 0)
+         val = ntrials;
+      else {
+         print_usage(argv[0]);
+         exit(-1);
+      }
+      if(i + 1 >= argc || sscanf(argv[i+1], "%d", val) != 1 || *val < 1){
+         print_usage(argv[0]);
+         exit(-1);
+      }
+   }
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] [-t trials]\n\n", arg0);
+   fprintf(stderr, "   -n iterations = builds of 16 tables timed per shape\n");
+   fprintf(stderr, "                   (default 1000)\n");
+   fprintf(stderr, "   -t trials     = histograms checked per shape and\n");
+   fprintf(stderr, "                   table size (default 300)\n");
+}
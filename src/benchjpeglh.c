@@ -0,0 +1,329 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     BENCHJPEGLH.C
+
+      DATE:     10/17/2026
+
+#cat: benchjpeglh - Times the huffman decoding of the scans of JPEGL
+#cat:               files, reporting MB/s of compressed data for the
+#cat:               lookup table decoder and for the decode_data path it
+#cat:               replaced, and checks that both give the same
+#cat:               differences.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <jpegl.h>
+#include <dataio.h>
+#include <img_io.h>
+
+typedef int (*DIFF_DECODER)(short *, const int, const int, HUF_TABLE *,
+                            unsigned char **, unsigned char *);
+
+void procargs(int, char **, int *, int *);
+void print_usage(char *);
+int table_decode_scan(short *, const int, const int, HUF_TABLE *,
+                      unsigned char **, unsigned char *);
+int serial_decode_scan(short *, const int, const int, HUF_TABLE *,
+                       unsigned char **, unsigned char *);
+int time_decoder(double *, int *, short *, DIFF_DECODER, unsigned char *,
+                 const int, const int);
+
+int debug = 0;
+
+/* Extends the extra bits of each category to a difference. */
+static int huff_decoder[MAX_CATEGORY][LARGESTDIFF+1];
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, i, first, niters, nfailed, ilen, ndiffs;
+   unsigned char *idata;
+   short *dtable, *dserial;
+   double ttable, tserial;
+
+   procargs(argc, argv, &first, &niters);
+
+   build_huff_decode_table(huff_decoder);
+
+   nfailed = 0;
+   printf("%-32s %8s %12s %12s %8s\n", "file", "KB",
+          "table MB/s", "serial MB/s", "speedup");
+   for(i = first; i < argc; i++){
+      if((ret = read_raw_from_filesize(argv[i], &idata, &ilen))){
+         nfailed++;
+         continue;
+      }
+
+      /* The first pass only reads the frame header to find the */
+      /* size of the difference buffers.                         */
+      dtable = (short *)NULL;
+      dserial = (short *)NULL;
+      ret = time_decoder(&ttable, &ndiffs, (short *)NULL, table_decode_scan,
+                         idata, ilen, 0);
+      if(!ret){
+         dtable = (short *)calloc(ndiffs, sizeof(short));
+         dserial = (short *)calloc(ndiffs, sizeof(short));
+         if(dtable == (short *)NULL || dserial == (short *)NULL){
+            fprintf(stderr, "ERROR : main : calloc : differences\n");
+            ret = -2;
+         }
+      }
+      if(!ret)
+         ret = time_decoder(&ttable, &ndiffs, dtable, table_decode_scan,
+                            idata, ilen, niters);
+      if(!ret)
+         ret = time_decoder(&tserial, &ndiffs, dserial, serial_decode_scan,
+                            idata, ilen, niters);
+
+      if(ret)
+         nfailed++;
+      else if(memcmp(dtable, dserial, ndiffs * sizeof(short))){
+         fprintf(stderr, "ERROR : main : %s : differences differ\n",
+                 argv[i]);
+         nfailed++;
+      }
+      else
+         printf("%-32s %8.1f %12.2f %12.2f %8.2f\n", argv[i],
+                ilen / 1024.0, ilen * (double)niters / ttable / 1.0e6,
+                ilen * (double)niters / tserial / 1.0e6, tserial / ttable);
+
+      if(dtable != (short *)NULL)
+         free(dtable);
+      if(dserial != (short *)NULL)
+         free(dserial);
+      free(idata);
+   }
+
+   exit(nfailed ? -1 : 0);
+}
+
+/*****************************************************************/
+/* Parses a JPEGL file and huffman decodes the differences of    */
+/* each of its scans into "odiffs", component after component,   */
+/* "niters" times with "decoder", returning the seconds spent    */
+/* decoding.  Given niters of 0, only the frame header is read,  */
+/* to find the number of differences.  Scans with restart        */
+/* intervals are not handled, as the old path cannot read them.  */
+/*****************************************************************/
+int time_decoder(double *osecs, int *ondiffs, short *odiffs,
+                 DIFF_DECODER decoder, unsigned char *idata, const int ilen,
+                 const int niters)
+{
+   int ret, i, k, ppi, cmpnt_i, restart;
+   int offset[MAX_CMPNTS];
+   unsigned short marker;
+   unsigned char *cbufptr, *ebufptr;
+   HUF_TABLE *huf_table[MAX_CMPNTS];
+   FRM_HEADER_JPEGL *frm_header;
+   SCN_HEADER *scn_header;
+   JFIF_HEADER *jfif_header;
+   IMG_DAT *img_dat;
+   double t0;
+
+   *osecs = 0.0;
+   k = 0;
+   do{
+      for(i = 0; i < MAX_CMPNTS; i++)
+         huf_table[i] = (HUF_TABLE *)NULL;
+      restart = 0;
+      cbufptr = idata;
+      ebufptr = idata + ilen;
+      if((ret = getc_marker_jpegl(&marker, SOI, &cbufptr, ebufptr)))
+         return(ret);
+      if((ret = getc_marker_jpegl(&marker, APP0, &cbufptr, ebufptr)))
+         return(ret);
+      if((ret = getc_jfif_header(&jfif_header, &cbufptr, ebufptr)))
+         return(ret);
+      ret = get_ppi_jpegl(&ppi, jfif_header);
+      free(jfif_header);
+      if(ret)
+         return(ret);
+
+      ret = getc_marker_jpegl(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+      while(!ret && marker != SOF3){
+         if(marker == DRI)
+            ret = getc_restart_interval(&restart, &cbufptr, ebufptr);
+         else
+            ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
+         if(!ret)
+            ret = getc_marker_jpegl(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+      }
+      if(ret){
+         free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+         return(ret);
+      }
+
+      ret = getc_frame_header_jpegl(&frm_header, &cbufptr, ebufptr);
+      if(ret){
+         free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+         return(ret);
+      }
+      ret = setup_IMG_DAT_decode(&img_dat, ppi, frm_header);
+      free(frm_header);
+      if(ret){
+         free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+         return(ret);
+      }
+
+      *ondiffs = 0;
+      for(i = 0; i < img_dat->n_cmpnts; i++){
+         offset[i] = *ondiffs;
+         *ondiffs += img_dat->samp_width[i] * img_dat->samp_height[i];
+      }
+      if(niters == 0){
+         free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+         free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+         return(0);
+      }
+
+      ret = getc_marker_jpegl(&marker, TBLS_N_SOS, &cbufptr, ebufptr);
+      while(!ret && marker != EOI){
+         while(!ret && marker != SOS){
+            if(marker == DRI)
+               ret = getc_restart_interval(&restart, &cbufptr, ebufptr);
+            else
+               ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
+            if(!ret)
+               ret = getc_marker_jpegl(&marker, TBLS_N_SOS, &cbufptr,
+                                       ebufptr);
+         }
+         if(ret)
+            break;
+
+         if((ret = getc_scan_header(&scn_header, &cbufptr, ebufptr)))
+            break;
+         cmpnt_i = scn_header->Cs[0];
+         if(scn_header->Ns > 1 || restart > 0){
+            fprintf(stderr, "ERROR : time_decoder : ");
+            fprintf(stderr, "interleaved or restarted scans not handled\n");
+            ret = -5;
+         }
+         else if(huf_table[cmpnt_i] == (HUF_TABLE *)NULL ||
+                 huf_table[cmpnt_i]->def != 1){
+            fprintf(stderr, "ERROR : time_decoder : ");
+            fprintf(stderr, "huffman table %d not defined\n", cmpnt_i);
+            ret = -6;
+         }
+         free(scn_header);
+         if(ret)
+            break;
+
+         t0 = now();
+         ret = (*decoder)(odiffs + offset[cmpnt_i],
+                          img_dat->samp_width[cmpnt_i],
+                          img_dat->samp_height[cmpnt_i],
+                          huf_table[cmpnt_i], &cbufptr, ebufptr);
+         *osecs += now() - t0;
+         if(!ret)
+            ret = getc_ushort(&marker, &cbufptr, ebufptr);
+      }
+
+      free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+      free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+      if(ret)
+         return(ret);
+   } while(++k < niters);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* Decodes the differences of a scan a row at a time through the */
+/* lookup table and bit reservoir of the current decoder.        */
+/*****************************************************************/
+int table_decode_scan(short *odiffs, const int width, const int height,
+                      HUF_TABLE *huf_table, unsigned char **cbufptr,
+                      unsigned char *ebufptr)
+{
+   int ret, row;
+   HDEC_TABLE_JPEGL hdec;
+   BITBUF_JPEGL bitbuf;
+   unsigned char *sbufptr;
+
+   gen_hdec_table_jpegl(&hdec, huf_table);
+
+   bitbuf.bits = 0;
+   bitbuf.nbits = 0;
+   bitbuf.marker = 0;
+   sbufptr = *cbufptr;
+   for(row = 0; row < height; row++){
+      ret = getc_diff_row_jpegl(odiffs + row * width, width, &hdec, &bitbuf,
+                                cbufptr, ebufptr);
+      if(ret)
+         return(ret);
+   }
+   unget_bitbuf_jpegl(&bitbuf, cbufptr, sbufptr);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* The difference decoder as it was before the lookup table:     */
+/* each code is read a bit at a time through decode_data and its */
+/* extra bits through getc_nextbits_jpegl.                       */
+/*****************************************************************/
+int serial_decode_scan(short *odiffs, const int width, const int height,
+                       HUF_TABLE *huf_table, unsigned char **cbufptr,
+                       unsigned char *ebufptr)
+{
+   int ret, p, diff_cat, bit_count;
+   unsigned short diff_code;
+
+   bit_count = 0;
+   for(p = 0; p < width * height; p++){
+      ret = decode_data(&diff_cat, huf_table->mincode, huf_table->maxcode,
+                        huf_table->valptr, huf_table->values, cbufptr,
+                        ebufptr, &bit_count);
+      if(ret)
+         return(ret);
+      ret = getc_nextbits_jpegl(&diff_code, cbufptr, ebufptr, &bit_count,
+                                diff_cat);
+      if(ret)
+         return(ret);
+      odiffs[p] = huff_decoder[diff_cat][diff_code];
+   }
+
+   return(0);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *first, int *niters)
+{
+   *first = 1;
+   *niters = 20;
+   if(argc > 2 && strcmp(argv[1], "-n") == 0){
+      if(sscanf(argv[2], "%d", niters) != 1 || *niters < 1){
+         print_usage(argv[0]);
+         exit(-1);
+      }
+      *first = 3;
+   }
+   if(*first >= argc){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] <jpegl file> ...\n\n", arg0);
+   fprintf(stderr, "   -n iterations = decodes timed per file (default 20)\n");
+}
@@ -0,0 +1,175 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     BENCHLETS.C
+
+      DATE:     10/17/2026
+
+#cat: benchlets - Times the row and the column pass of the first level
+#cat:             of the WSQ wavelet decomposition on square images,
+#cat:             for get_lets_vec and for the get_lets it replaced.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wsq.h>
+
+/* Image sizes timed when none are given. */
+static int dflt_sizes[] = { 256, 512, 1024, 2000, 4000, 8000 };
+
+void procargs(int, char **, int *, int *, int *);
+void print_usage(char *);
+int time_passes(double *, double *, double *, double *, const int,
+                const int, const int);
+
+int debug = 0;
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, i, first, niters, nthreads, nsizes, size;
+   double vrow, vcol, rrow, rcol;
+
+   procargs(argc, argv, &first, &niters, &nthreads);
+
+   nsizes = (first < argc) ? argc - first :
+            (int)(sizeof(dflt_sizes) / sizeof(dflt_sizes[0]));
+   printf("%6s %12s %12s %12s %12s\n", "size", "row ms", "col ms",
+          "ref row ms", "ref col ms");
+   for(i = 0; i < nsizes; i++){
+      if(first < argc){
+         if(sscanf(argv[first + i], "%d", &size) != 1 || size < 16){
+            print_usage(argv[0]);
+            exit(-1);
+         }
+      }
+      else
+         size = dflt_sizes[i];
+
+      if((ret = time_passes(&vrow, &vcol, &rrow, &rcol, size, niters,
+                            nthreads)))
+         exit(ret);
+      printf("%6d %12.2f %12.2f %12.2f %12.2f\n", size, vrow * 1.0e3,
+             vcol * 1.0e3, rrow * 1.0e3, rcol * 1.0e3);
+   }
+
+   exit(0);
+}
+
+/*****************************************************************/
+/* Runs the row pass and then the column pass of the first       */
+/* decomposition level on a "size" x "size" image "niters"       */
+/* times, with get_lets_vec on "nthreads" threads and with       */
+/* get_lets, and returns the mean seconds for each pass.          */
+/*****************************************************************/
+int time_passes(double *vrow, double *vcol, double *rrow, double *rcol,
+                const int size, const int niters, const int nthreads)
+{
+   int ret, i, n;
+   float *fdata, *fdata1;
+   double t0;
+
+   n = size * size;
+   fdata = (float *)malloc(2 * (size_t)n * sizeof(float));
+   if(fdata == (float *)NULL){
+      fprintf(stderr, "ERROR : time_passes : malloc : fdata\n");
+      return(-2);
+   }
+   fdata1 = fdata + n;
+   for(i = 0; i < n; i++)
+      fdata[i] = (float)((i * 7919) % 255 - 128);
+   memset(fdata1, 0, n * sizeof(float));
+
+   *vrow = *vcol = *rrow = *rcol = 0.0;
+   for(i = 0; i < niters; i++){
+      t0 = now();
+      ret = get_lets_vec(fdata1, fdata, size, size, size, 1,
+                         hifilt, MAX_HIFILT, lofilt, MAX_LOFILT, 0,
+                         nthreads, (CODEC_ARENA *)NULL);
+      *vrow += now() - t0;
+      if(ret){
+         free(fdata);
+         return(ret);
+      }
+      t0 = now();
+      ret = get_lets_vec(fdata, fdata1, size, size, 1, size,
+                         hifilt, MAX_HIFILT, lofilt, MAX_LOFILT, 0,
+                         nthreads, (CODEC_ARENA *)NULL);
+      *vcol += now() - t0;
+      if(ret){
+         free(fdata);
+         return(ret);
+      }
+
+      t0 = now();
+      get_lets(fdata1, fdata, size, size, size, 1,
+               hifilt, MAX_HIFILT, lofilt, MAX_LOFILT, 0);
+      *rrow += now() - t0;
+      t0 = now();
+      get_lets(fdata, fdata1, size, size, 1, size,
+               hifilt, MAX_HIFILT, lofilt, MAX_LOFILT, 0);
+      *rcol += now() - t0;
+   }
+
+   *vrow /= niters;
+   *vcol /= niters;
+   *rrow /= niters;
+   *rcol /= niters;
+   free(fdata);
+   return(0);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *first, int *niters,
+              int *nthreads)
+{
+   int i;
+
+   *niters = 3;
+   *nthreads = 1;
+   for(i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2){
+      if(strcmp(argv[i], "-n") == 0){
+         if(sscanf(argv[i+1], "%d", niters) != 1 || *niters < 1){
+            print_usage(argv[0]);
+            exit(-1);
+         }
+      }
+      else if(strcmp(argv[i], "-t") == 0){
+         if(sscanf(argv[i+1], "%d", nthreads) != 1 || *nthreads < 1){
+            print_usage(argv[0]);
+            exit(-1);
+         }
+      }
+      else {
+         print_usage(argv[0]);
+         exit(-1);
+      }
+   }
+   *first = i;
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] [-t threads] [size ...]\n\n",
+           arg0);
+   fprintf(stderr, "   -n iterations = passes timed per size (default 3)\n");
+   fprintf(stderr, "   -t threads    = threads for get_lets_vec (default 1)\n");
+   fprintf(stderr, "   size          = image width and height (default\n");
+   fprintf(stderr, "                   256 512 1024 2000 4000 8000)\n");
+}
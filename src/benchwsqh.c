@@ -0,0 +1,282 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     BENCHWSQH.C
+
+      DATE:     10/17/2026
+
+#cat: benchwsqh - Times the huffman decoding of the blocks of WSQ files,
+#cat:             reporting MB/s of compressed data for the lookup table
+#cat:             decoder and for the bit serial decoder it replaced,
+#cat:             and checks that both give the same coefficients.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wsq.h>
+#include <img_io.h>
+
+typedef int (*HUFF_DECODER)(short *, DTT_TABLE *, DQT_TABLE *, DHT_TABLE *,
+                            unsigned char **, unsigned char *);
+
+void procargs(int, char **, int *, int *);
+void print_usage(char *);
+int serial_decode_data_mem(short *, DTT_TABLE *, DQT_TABLE *, DHT_TABLE *,
+                           unsigned char **, unsigned char *);
+int time_decoder(double *, short *, HUFF_DECODER, WSQ_CTX *,
+                 unsigned char *, const int, const int);
+
+int debug = 0;
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, i, first, niters, nfailed, ilen, ncoefs;
+   unsigned char *idata;
+   short *qtable, *qserial;
+   double ttable, tserial;
+   WSQ_CTX *ctx;
+
+   procargs(argc, argv, &first, &niters);
+
+   if((ret = alloc_WSQ_CTX(&ctx)))
+      exit(ret);
+
+   nfailed = 0;
+   printf("%-32s %8s %12s %12s %8s\n", "file", "KB",
+          "table MB/s", "serial MB/s", "speedup");
+   for(i = first; i < argc; i++){
+      if((ret = read_raw_from_filesize(argv[i], &idata, &ilen))){
+         nfailed++;
+         continue;
+      }
+
+      /* The first pass through the table decoder finds the size */
+      /* of the coefficient buffer from the frame header.        */
+      ncoefs = 0;
+      qtable = (short *)NULL;
+      qserial = (short *)NULL;
+      ret = time_decoder(&ttable, (short *)NULL, huffman_decode_data_mem,
+                         ctx, idata, ilen, 0);
+      if(!ret){
+         ncoefs = ctx->frm_header_wsq.width * ctx->frm_header_wsq.height;
+         qtable = (short *)calloc(ncoefs, sizeof(short));
+         qserial = (short *)calloc(ncoefs, sizeof(short));
+         if(qtable == (short *)NULL || qserial == (short *)NULL){
+            fprintf(stderr, "ERROR : main : calloc : coefficients\n");
+            ret = -2;
+         }
+      }
+      if(!ret)
+         ret = time_decoder(&ttable, qtable, huffman_decode_data_mem,
+                            ctx, idata, ilen, niters);
+      if(!ret)
+         ret = time_decoder(&tserial, qserial, serial_decode_data_mem,
+                            ctx, idata, ilen, niters);
+
+      if(ret)
+         nfailed++;
+      else if(memcmp(qtable, qserial, ncoefs * sizeof(short))){
+         fprintf(stderr, "ERROR : main : %s : coefficients differ\n",
+                 argv[i]);
+         nfailed++;
+      }
+      else
+         printf("%-32s %8.1f %12.2f %12.2f %8.2f\n", argv[i],
+                ilen / 1024.0, ilen * (double)niters / ttable / 1.0e6,
+                ilen * (double)niters / tserial / 1.0e6, tserial / ttable);
+
+      if(qtable != (short *)NULL)
+         free(qtable);
+      if(qserial != (short *)NULL)
+         free(qserial);
+      free(idata);
+   }
+
+   free_WSQ_CTX(ctx);
+   exit(nfailed ? -1 : 0);
+}
+
+/*****************************************************************/
+/* Parses the headers of a WSQ file up to its first block and    */
+/* decodes the blocks "niters" times with "decoder", returning   */
+/* the seconds spent decoding.  Given niters of 0, only the      */
+/* frame header is read into the context.                        */
+/*****************************************************************/
+int time_decoder(double *osecs, short *qdata, HUFF_DECODER decoder,
+                 WSQ_CTX *ctx, unsigned char *idata, const int ilen,
+                 const int niters)
+{
+   int ret, i;
+   unsigned short marker;
+   unsigned char *cbufptr, *ebufptr;
+   double t0;
+
+   *osecs = 0.0;
+   i = 0;
+   do{
+      reset_WSQ_CTX(ctx);
+      cbufptr = idata;
+      ebufptr = idata + ilen;
+      if((ret = getc_marker_wsq(&marker, SOI_WSQ, &cbufptr, ebufptr)))
+         return(ret);
+      if((ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr)))
+         return(ret);
+      while(marker != SOF_WSQ){
+         ret = getc_table_wsq(marker, &ctx->dtt_table, &ctx->dqt_table,
+                              ctx->dht_table, &cbufptr, ebufptr);
+         if(ret)
+            return(ret);
+         ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+         if(ret)
+            return(ret);
+      }
+      ret = getc_frame_header_wsq(&ctx->frm_header_wsq, &cbufptr, ebufptr);
+      if(ret || niters == 0)
+         return(ret);
+
+      t0 = now();
+      ret = (*decoder)(qdata, &ctx->dtt_table, &ctx->dqt_table,
+                       ctx->dht_table, &cbufptr, ebufptr);
+      *osecs += now() - t0;
+      if(ret)
+         return(ret);
+   } while(++i < niters);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* The huffman block decoder as it was before the lookup table:  */
+/* every code is read a bit at a time through decode_data_mem.   */
+/*****************************************************************/
+int serial_decode_data_mem(short *ip, DTT_TABLE *dtt_table,
+                           DQT_TABLE *dqt_table, DHT_TABLE *dht_table,
+                           unsigned char **cbufptr, unsigned char *ebufptr)
+{
+   int ret, bit_count, n, nodeptr, last_size;
+   int maxcode[MAX_HUFFBITS+1], mincode[MAX_HUFFBITS+1];
+   int valptr[MAX_HUFFBITS+1];
+   unsigned short marker, tbits;
+   unsigned char hufftable_id;
+   HUFFCODE *hufftable;
+
+   ret = getc_marker_wsq(&marker, TBLS_N_SOB, cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+
+   bit_count = 0;
+   hufftable_id = 0;
+   while(marker != EOI_WSQ) {
+      if(marker != 0) {
+         while(marker != SOB_WSQ) {
+            ret = getc_table_wsq(marker, dtt_table, dqt_table,
+                                 dht_table, cbufptr, ebufptr);
+            if(ret)
+               return(ret);
+            ret = getc_marker_wsq(&marker, TBLS_N_SOB, cbufptr, ebufptr);
+            if(ret)
+               return(ret);
+         }
+         ret = getc_block_header(&hufftable_id, cbufptr, ebufptr);
+         if(ret)
+            return(ret);
+         if((dht_table+hufftable_id)->tabdef != 1) {
+            fprintf(stderr, "ERROR : serial_decode_data_mem : ");
+            fprintf(stderr, "huffman table {%d} undefined.\n", hufftable_id);
+            return(-51);
+         }
+
+         ret = build_huffsizes(&hufftable, &last_size,
+                               (dht_table+hufftable_id)->huffbits,
+                               MAX_HUFFCOUNTS_WSQ);
+         if(ret)
+            return(ret);
+         build_huffcodes(hufftable);
+         gen_decode_table(hufftable, maxcode, mincode, valptr,
+                          (dht_table+hufftable_id)->huffbits);
+         free(hufftable);
+         bit_count = 0;
+         marker = 0;
+      }
+
+      ret = decode_data_mem(&nodeptr, mincode, maxcode, valptr,
+                            (dht_table+hufftable_id)->huffvalues, cbufptr,
+                            ebufptr, &bit_count, &marker);
+      if(ret)
+         return(ret);
+
+      if(nodeptr == -1)
+         continue;
+
+      if(nodeptr > 0 && nodeptr <= 100)
+         for(n = 0; n < nodeptr; n++)
+            *ip++ = 0;
+      else if(nodeptr > 106 && nodeptr < 0xff)
+         *ip++ = nodeptr - 180;
+      else if(nodeptr >= 101 && nodeptr <= 106){
+         /* 101, 102 and 105 carry 8 bits; 103, 104 and 106 carry 16 */
+         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr, ebufptr,
+                                 &bit_count,
+                                 (nodeptr == 101 || nodeptr == 102 ||
+                                  nodeptr == 105) ? 8 : 16);
+         if(ret)
+            return(ret);
+         if(nodeptr == 101 || nodeptr == 103)
+            *ip++ = tbits;
+         else if(nodeptr == 102 || nodeptr == 104)
+            *ip++ = -tbits;
+         else
+            for(n = tbits; n > 0; n--)
+               *ip++ = 0;
+      }
+      else {
+         fprintf(stderr,
+                 "ERROR : serial_decode_data_mem : Invalid code %d (%x).\n",
+                 nodeptr, nodeptr);
+         return(-52);
+      }
+   }
+
+   return(0);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *first, int *niters)
+{
+   *first = 1;
+   *niters = 20;
+   if(argc > 2 && strcmp(argv[1], "-n") == 0){
+      if(sscanf(argv[2], "%d", niters) != 1 || *niters < 1){
+         print_usage(argv[0]);
+         exit(-1);
+      }
+      *first = 3;
+   }
+   if(*first >= argc){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] <wsq file> ...\n\n", arg0);
+   fprintf(stderr, "   -n iterations = decodes timed per file (default 20)\n");
+}
@@ -0,0 +1,364 @@
+/***********************************************************************
+      LIBRARY: IMAGE - Image Manipulation and Processing Routines
+
+      FILE:    BINBLIT.C
+
+      Contains routines responsible for combining a subimage of one
+      binary image bitmap with another, 64 bits at a time.
+
+      ROUTINES:
+#cat: binary_blit_row - combines a run of bits from one binary scanline
+#cat:                   with a run in another using a logical operator.
+#cat: binary_subimage_blit - combines a subimage of one binary image
+#cat:                        with a subimage of another using a
+#cat:                        logical operator.
+
+***********************************************************************/
+
+/* LINTLIBRARY */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <binops.h>
+#include <copy.h>
+#include <ffpis/util/util.h>
+
+#ifndef BITSPERBYTE
+#define BITSPERBYTE CHAR_BIT
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLIT_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* Middle bytes in a row before the AVX2 kernel is worth calling. */
+#define BLIT_WIDE_BYTES	64
+
+/*
+ * Pixels are packed most significant bit first, so 8 bytes read in
+ * big-endian order make a word whose top bit is the leftmost pixel.
+ * The compiler turns the shifts below into a single load and byte swap.
+ */
+static unsigned long long load_word(const u_char *p)
+{
+return ((unsigned long long)p[0] << 56) | ((unsigned long long)p[1] << 48) |
+	((unsigned long long)p[2] << 40) | ((unsigned long long)p[3] << 32) |
+	((unsigned long long)p[4] << 24) | ((unsigned long long)p[5] << 16) |
+	((unsigned long long)p[6] << 8) | (unsigned long long)p[7];
+}
+
+static void store_word(u_char *p, unsigned long long w)
+{
+p[0] = (u_char)(w >> 56);
+p[1] = (u_char)(w >> 48);
+p[2] = (u_char)(w >> 40);
+p[3] = (u_char)(w >> 32);
+p[4] = (u_char)(w >> 24);
+p[5] = (u_char)(w >> 16);
+p[6] = (u_char)(w >> 8);
+p[7] = (u_char)w;
+}
+
+/*
+ * Returns the 64 source bits starting "t" bits into "sp[0]".  When "t"
+ * is not 0 the last "t" come from the top of "sp[8]", a funnel shift of
+ * the word and the byte after it; otherwise "sp[8]" is not read.
+ */
+static unsigned long long funnel_word(const u_char *sp, int t)
+{
+if (!t)
+	return load_word(sp);
+return (load_word(sp) << t) | ((unsigned long long)sp[8] >> (BITSPERBYTE - t));
+}
+
+static unsigned long long funnel_byte(const u_char *sp, int t)
+{
+if (!t)
+	return sp[0];
+return ((sp[0] << t) | (sp[1] >> (BITSPERBYTE - t))) & 0xFF;
+}
+
+/*
+ * As funnel_byte(), but for the partial bytes at either end of a run,
+ * whose source bytes may lie outside base[lo..hi-1]; those are not read.
+ */
+static unsigned long long edge_byte(const u_char *base, int b, int t,
+		int lo, int hi)
+{
+unsigned int s0, s1;
+
+s0 = (b >= lo && b < hi) ? base[b] : 0;
+if (!t)
+	return s0;
+s1 = (b + 1 >= lo && b + 1 < hi) ? base[b + 1] : 0;
+return ((s0 << t) | (s1 >> (BITSPERBYTE - t))) & 0xFF;
+}
+
+/*
+ * Combines the first whole bytes of a row's middle, returning how many
+ * it did; the rest are left to the word loop.  Chosen once per subimage.
+ */
+typedef int (*BLIT_WIDE)(int, const u_char *, int, u_char *, int);
+
+static int blit_wide_move(int op, const u_char *sp, int t, u_char *dp, int n)
+{
+(void)op;
+(void)t;
+memmove(dp, sp, n);
+return n;
+}
+
+#ifdef BLIT_X86_DISPATCH
+/* The bytes are shifted as 16-bit lanes, and the bits that cross into */
+/* the neighbouring byte of the lane masked off.                       */
+__attribute__((target("avx2")))
+static int blit_wide_avx2(int op, const u_char *sp, int t, u_char *dp, int n)
+{
+__m256i a, b, s, d, mhi, mlo;
+__m128i lsh, rsh;
+int k;
+
+lsh = _mm_cvtsi32_si128(t);
+rsh = _mm_cvtsi32_si128(BITSPERBYTE - t);
+mhi = _mm256_set1_epi8((char)((0xFF << t) & 0xFF));
+mlo = _mm256_set1_epi8((char)(0xFF >> (BITSPERBYTE - t)));
+for (k = 0; k + 32 <= n; k += 32) {
+	a = _mm256_loadu_si256((const __m256i *)(sp + k));
+	if (t) {
+		b = _mm256_loadu_si256((const __m256i *)(sp + k + 1));
+		s = _mm256_or_si256(_mm256_and_si256(_mm256_sll_epi16(a, lsh), mhi),
+			_mm256_and_si256(_mm256_srl_epi16(b, rsh), mlo));
+	}
+	else
+		s = a;
+	d = _mm256_loadu_si256((const __m256i *)(dp + k));
+	switch (op) {
+	case BINARY_COPY:	d = s; break;
+	case BINARY_OR:		d = _mm256_or_si256(d, s); break;
+	case BINARY_AND:	d = _mm256_and_si256(d, s); break;
+	case BINARY_XOR:	d = _mm256_xor_si256(d, s); break;
+	default:		d = _mm256_xor_si256(s, _mm256_set1_epi8(-1)); break;
+	}
+	_mm256_storeu_si256((__m256i *)(dp + k), d);
+}
+return k;
+}
+#endif
+
+/*
+ * The rows of a run, for an operator given as the expression "EXPR" of
+ * the destination bits "d" and source bits "s".  Each row is a masked
+ * leading byte, whole bytes b0 to b1-1 and a masked trailing byte b1,
+ * either partial byte absent when its mask is 0.  The whole bytes are
+ * taken by "wide" first, if set, then 8 at a time and then singly.
+ */
+#define ROW_LOOP(EXPR) \
+	for ( ; rows > 0; rows--, base += srcbw, dst += dstbw) { \
+		if (mlead) { \
+			d = dst[0]; \
+			s = edge_byte(base, 0, t, lo, hi); \
+			dst[0] = (u_char)((d & ~mlead) | ((EXPR) & mlead)); \
+		} \
+		dp = dst + b0; \
+		sp = base + b0; \
+		n = b1 - b0; \
+		if (wide != (BLIT_WIDE)NULL) { \
+			k = wide(op, sp, t, dp, n); \
+			dp += k; \
+			sp += k; \
+			n -= k; \
+		} \
+		for ( ; n >= 8; n -= 8, dp += 8, sp += 8) { \
+			d = load_word(dp); \
+			s = funnel_word(sp, t); \
+			store_word(dp, (EXPR)); \
+		} \
+		for ( ; n > 0; n--, dp++, sp++) { \
+			d = *dp; \
+			s = funnel_byte(sp, t); \
+			*dp = (u_char)(EXPR); \
+		} \
+		if (mtrail) { \
+			d = dst[b1]; \
+			s = edge_byte(base, b1, t, lo, hi); \
+			dst[b1] = (u_char)((d & ~mtrail) | ((EXPR) & mtrail)); \
+		} \
+	}
+
+/*
+ * Combines "rows" runs of "bits" pixels, from pixel "i" of scanlines
+ * "srcbw" bytes apart in "src" with those from pixel "j" of scanlines
+ * "dstbw" bytes apart in "dst".  The byte layout, shift and edge masks
+ * are the same for every row, so they are worked out once, and each
+ * operator has its own loop.
+ */
+static void blit_rows(int op, u_char *src, int srcbw, int i,
+		u_char *dst, int dstbw, int j, int bits, int rows)
+{
+u_char *base, *dp;
+const u_char *sp;
+int t, lo, hi, end, b0, b1, n, k;
+unsigned long long mlead, mtrail, s, d;
+BLIT_WIDE wide;
+
+if (bits <= 0 || rows <= 0)
+	return;
+
+/* Destination byte b holds run pixels 8b-j to 8b-j+7. */
+dst += j / BITSPERBYTE;
+j %= BITSPERBYTE;
+end = j + bits;
+if (end <= BITSPERBYTE) {
+	/* The whole run lies in one destination byte. */
+	mlead = (0xFF >> j) & (0xFF00 >> end);
+	mtrail = 0;
+	b0 = b1 = 0;
+}
+else {
+	mlead = j ? 0xFF >> j : 0;
+	mtrail = (0xFF00 >> (end % BITSPERBYTE)) & 0xFF;
+	b0 = (j != 0);
+	b1 = end / BITSPERBYTE;
+}
+
+if (op == BINARY_ZERO || op == BINARY_ONE) {
+	d = (op == BINARY_ONE) ? 0xFF : 0;
+	for ( ; rows > 0; rows--, dst += dstbw) {
+		if (mlead)
+			dst[0] = (u_char)((dst[0] & ~mlead) | (d & mlead));
+		memset(dst + b0, (int)d, b1 - b0);
+		if (mtrail)
+			dst[b1] = (u_char)((dst[b1] & ~mtrail) | (d & mtrail));
+	}
+	return;
+}
+
+/* Source bits for byte b start "t" bits into base[b], and only */
+/* base[lo..hi-1] belong to the source run.                     */
+src += i / BITSPERBYTE;
+i %= BITSPERBYTE;
+lo = (i < j);
+base = src - lo;
+t = i - j + lo * BITSPERBYTE;
+hi = lo + (i + bits + BITSPERBYTE - 1) / BITSPERBYTE;
+
+wide = (BLIT_WIDE)NULL;
+if (op == BINARY_COPY && !t)
+	wide = blit_wide_move;
+#ifdef BLIT_X86_DISPATCH
+else if (b1 - b0 >= BLIT_WIDE_BYTES && __builtin_cpu_supports("avx2"))
+	wide = blit_wide_avx2;
+#endif
+
+switch (op) {
+case BINARY_COPY:
+	ROW_LOOP(s)
+	break;
+case BINARY_OR:
+	ROW_LOOP(d | s)
+	break;
+case BINARY_AND:
+	ROW_LOOP(d & s)
+	break;
+case BINARY_XOR:
+	ROW_LOOP(d ^ s)
+	break;
+default:
+	ROW_LOOP(~s)
+	break;
+}
+}
+
+/************************************************************/
+/* binary_blit_row() sets the "bits" pixels from pixel "j"  */
+/* of the scanline "dst" to the logical operation "op" of   */
+/* themselves and the pixels from pixel "i" of "src".       */
+/*                                                          */
+/* Only the first and last bytes of the destination run    */
+/* are partial; they are masked once each, and only the     */
+/* bytes of the two runs are read or written.  The bytes    */
+/* between are taken 64 bits at a time, each word of        */
+/* source bits one 8-byte load funnel shifted with the byte */
+/* after it, or 256 bits at a time with AVX2 on wide rows   */
+/* where the CPU has it.  When the source and destination   */
+/* start at the same bit in a byte the middle of a copy is  */
+/* a single memmove.  "src" is not read for BINARY_ZERO and */
+/* BINARY_ONE, and may be NULL.                             */
+/************************************************************/
+void binary_blit_row(int op, u_char *src, int i, u_char *dst, int j,
+		int bits)
+{
+blit_rows(op, src, 0, i, dst, 0, j, bits, 1);
+}
+
+/************************************************************/
+/* binary_subimage_blit() combines the "cpw" by "cph"       */
+/* subimage at ("srcx","srcy") of the binary image "src"    */
+/* with the subimage at ("dstx","dsty") of "dst" using the  */
+/* logical operator "op", one of the BINARY_* operators.    */
+/* Image widths must be multiples of 8; all other           */
+/* dimensions are in bits.  "src" is not read for          */
+/* BINARY_ZERO and BINARY_ONE, and may be NULL.             */
+/************************************************************/
+void binary_subimage_blit(int op,
+	u_char *src, int  srcw,int srch,
+	u_char  *dst, int dstw, int dsth,
+	int srcx,int srcy,
+	int  cpw,int cph,
+	int dstx,int dsty)
+{
+int srcbw, dstbw, nosrc;
+
+if ((op < BINARY_COPY) || (op > BINARY_ONE))
+	fatalerr("binary_subimage_blit","bad operator",(char *)NULL);
+
+nosrc = (op == BINARY_ZERO) || (op == BINARY_ONE);
+
+if ((src == (u_char *) NULL) && !nosrc)
+	fatalerr("binary_subimage_blit","Null source image pointer",(char *)NULL);
+
+if (dst == (u_char *) NULL)
+	fatalerr("binary_subimage_blit","Null destination image pointer",(char *)NULL);
+
+if ((srcw < 0) || (srch < 0))
+	fatalerr("binary_subimage_blit","Negative source image dimension(s)",(char *)NULL);
+
+if ((dstw < 0) || (dsth < 0))
+	fatalerr("binary_subimage_blit","Negative destination image dimension(s)",(char *)NULL);
+
+if ((cpw < 0) || (cph < 0))
+	fatalerr("binary_subimage_blit","Negative subimage dimension(s)",(char *)NULL);
+
+if ((srcx < 0) || (srcy < 0) || (dstx < 0) || (dsty < 0))
+	fatalerr("binary_subimage_blit","Negative subimage origin",(char *)NULL);
+
+if (srcw % BITSPERBYTE)
+	fatalerr("binary_subimage_blit",
+		"Source image width must be a multiple of 8",(char *)NULL);
+
+if (dstw % BITSPERBYTE)
+	fatalerr("binary_subimage_blit",
+		"Destination image width must be a multiple of 8",(char *)NULL);
+
+if (!nosrc && (((srcx + cpw) > srcw) || ((srcy + cph) > srch)))
+	fatalerr("binary_subimage_blit",
+		"Subimage exceeds source image dimension(s)",(char *)NULL);
+
+if (((dstx + cpw) > dstw) || ((dsty + cph) > dsth))
+	fatalerr("binary_subimage_blit",
+		"Subimage exceeds destination image dimension(s)",(char *)NULL);
+
+if (!cpw || !cph)
+	return;
+
+srcbw = srcw / BITSPERBYTE;
+dstbw = dstw / BITSPERBYTE;
+
+dst += dsty * dstbw;
+if (!nosrc)
+	src += srcy * srcbw;
+blit_rows(op,src,srcbw,srcx,dst,dstbw,dstx,cpw,cph);
+}
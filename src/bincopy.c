@@ -48,13 +48,6 @@ void binary_subimage_copy_8 (
        int  cpw,int cph,
        int dstx,int dsty)
 {
-int i, j, i_inv, j_inv, cpbw, srcbw, dstbw, dx, dy;
-u_char m0, m1, m2;
-register int bytes;
-register u_char c;
-
-
-
 if (src == (u_char *) NULL)
 	fatalerr("binary_subimage_copy_8","Null source image pointer",(char *)NULL);
 
@@ -96,165 +89,15 @@ if (!srcw || !srch)
 if (!dstw || !dsth)
 	return;
 
-	i = srcx % BITSPERBYTE;
-	i_inv = BITSPERBYTE - i;
-
-j = dstx % BITSPERBYTE;
-j_inv = BITSPERBYTE - j;
-
-	if (cpw % BITSPERBYTE)
-		fatalerr("binary_subimage_copy_8",
-			"Copy width not a multiple of eight",(char *)NULL);
-
-
-	srcbw = srcw / BITSPERBYTE;
-
-dstbw = dstw / BITSPERBYTE;
-
-cpbw  = cpw  / BITSPERBYTE;
-
-
-	/* Increment src to the byte in the upper left corner of the */
-	/* subimage to be copied. Increment dst to the upper left corner */
-	/* of the byte in the destination that will be modified. */
-	src += srcy * srcbw + srcx / BITSPERBYTE;
-
-dst += dsty * dstbw + dstx / BITSPERBYTE;
-
-
-	/* Set dx (dy) to be the increment needed to get src (dst) to the */
-	/* first byte in the next scan line to be copied (or modified) from */
-	/* the last byte in the current scan line. */
-	dx = srcbw - cpbw;
-
-dy = dstbw - cpbw;
-
-
-if (!i && !j) {			/* Both src & dst are byte-aligned. */
-	while (cph--) {
-		bytes = cpbw;
-		while (bytes--)
-			*dst++ = *src++;
-
-
-		src += dx;
-		dst += dy;
-	}
-	return;
-}
-
-
-
-
-
-
-if (!j) {			/* Dst is byte-aligned. */
-	while (cph--) {
-		bytes = cpbw;
-		while (bytes--) {
-			c = (*src << i) | (*(src+1) >> i_inv);
-			*dst++ = c;
-			src++;
-		}
-		src += dx;
-		dst += dy;
-	}
-	return;
-}
-
-
-
-
-
-
-
-
-if (!i) {					/* Src is byte-aligned. */
-	m1 = mask_end_0[j_inv];				/* eg. 11110000 */
-	m2 = mask_begin_0[j];				/* eg. 00001111 */
-
-	while (cph--) {
-		bytes = cpbw;
-		while (bytes--) {
-			c = *src++;
-			*dst = (*dst & m1) | (c >> j);
-			dst++;
-			*dst = (*dst & m2) | (c << j_inv);
-		}
-		;
-		src += dx;
-		dst += dy;
-	}
-	return;
-}
-
-
-
-
-
-
-if (i == j) {
-	m0 = mask_begin_1[i];
-	m1 = mask_end_0[i_inv];
-	m2 = mask_end_1[i_inv];
-
-	/* Neither src nor dst is byte-aligned, but they */
-	/* are offset by the same amount, so we can copy */
-	/* (cpbw - 1) bytes directly from src to dst. The */
-	/* bits in the other byte are on the ends of the */
-	/* scan line and are treated specially. */
-
-
-	if (cpbw == 1) {
-		while (cph--) {
-			*dst = (*dst & m0) | (*src++ & m2);
-			dst++;
-			*dst = (*dst & m2) | (*src & m0);
-			;
-			src += dx;
-			dst += dy;
-		}
-		return;
-	}
-
-	while (cph--) {
-		*dst = (*dst & m0) | (*src++ & m2);
-		dst++;
-
-		bytes = cpbw - 1;
-		while (bytes--)
-			*dst++ = *src++;
+if (cpw % BITSPERBYTE)
+	fatalerr("binary_subimage_copy_8",
+		"Copy width not a multiple of eight",(char *)NULL);
 
-		*dst = (*dst & m2) | (*src & m0);
-		;
-		src += dx;
-		dst += dy;
-	}
-	return;
-}
-
-
-
-
-
-
-m1 = mask_end_0[j_inv];		/* eg. 11111000 */
-m2 = mask_begin_0[j];		/* eg. 00000111 */
-
-
-while (cph--) {				/* The absolute worst case. Neither */
-	bytes = cpbw;			/* src nor dst is byte-aligned, and */
-	while (bytes--) {		/* they are offset by diff. amounts. */
-		c = (*src << i) | (*(src+1) >> i_inv);
-		*dst = (*dst & m1) | (c >> j);
-		dst++;
-		*dst = (*dst & m2) | (c << j_inv);
-		src++;
-	}
-	;
-	src += dx;
-	dst += dy;
-}
+/* Each scan line is copied 64 bits at a time, with only its */
+/* first and last words masked, whatever the bit offsets of  */
+/* the source and destination.                               */
+binary_subimage_blit(BINARY_COPY,src,srcw,srch,dst,dstw,dsth,
+			srcx,srcy,cpw,cph,dstx,dsty);
 }
 /* LINTLIBRARY */
 
@@ -271,7 +114,8 @@ while (cph--) {				/* The absolute worst case. Neither */
 /*	Date:		11/16/90				*/
 /*								*/
 /* binary_subimage_copy_8() is a bit-level copy utility for	*/
-/*	subimages that are a multiple of 8 bits wide.		*/
+/*	subimages that are a multiple of 8 bits wide.  It	*/
+/*	copies through binary_subimage_blit().			*/
 /* binary_subimage_copy_{gt,lt,eq}() are bit-level copy		*/
 /*	utilities for subimages that are not a multiple of 8	*/
 /*	bits wide and where the space remaining in the last	*/
@@ -595,7 +439,8 @@ while (cph--) {				/* The absolute worst case. Neither */
 /*	Date:		11/16/90				*/
 /*								*/
 /* binary_subimage_copy_8() is a bit-level copy utility for	*/
-/*	subimages that are a multiple of 8 bits wide.		*/
+/*	subimages that are a multiple of 8 bits wide.  It	*/
+/*	copies through binary_subimage_blit().			*/
 /* binary_subimage_copy_{gt,lt,eq}() are bit-level copy		*/
 /*	utilities for subimages that are not a multiple of 8	*/
 /*	bits wide and where the space remaining in the last	*/
@@ -919,7 +764,8 @@ while (cph--) {				/* The absolute worst case. Neither */
 /*	Date:		11/16/90				*/
 /*								*/
 /* binary_subimage_copy_8() is a bit-level copy utility for	*/
-/*	subimages that are a multiple of 8 bits wide.		*/
+/*	subimages that are a multiple of 8 bits wide.  It	*/
+/*	copies through binary_subimage_blit().			*/
 /* binary_subimage_copy_{gt,lt,eq}() are bit-level copy		*/
 /*	utilities for subimages that are not a multiple of 8	*/
 /*	bits wide and where the space remaining in the last	*/
@@ -1251,10 +1097,8 @@ while (cph--) {				/* The absolute worst case. Neither */
 /*         Date:      11/16/90                              */
 /*                                                          */
 /* binary_subimage_copy() is an all-purpose bit-level copy  */
-/*    utility.                                              */
-/* If the subimage to be copied is a multiple of 8 bits     */
-/*    wide, it calls binary_subimage_copy_8(). Otherwise it */
-/*    calls one binary_subimage_copy_{gt,lt,eq}().          */
+/*    utility.  It copies through binary_subimage_blit(),   */
+/*    a word at a time, whatever the width and offsets.     */
 /* binary_subimage_copy_{gt,lt,eq}() are bit-level copy     */
 /*    utilities for subimages that are not a multiple of 8  */
 /*    bits wide and where the space remaining in the last   */
@@ -1277,8 +1121,6 @@ void binary_subimage_copy (
        int  cpw,int cph,
        int dstx,int dsty)
 {
-register int j_inv, b, diff;
-
 if (src == (u_char *) NULL)
 	fatalerr("binary_subimage_copy",
 		"Null source image pointer",(char *)NULL);
@@ -1316,32 +1158,7 @@ if (!srcw || !srch)
 if (!dstw || !dsth)
 	return;
 
-b = cpw % BITSPERBYTE;
-if (!b) {
-	binary_subimage_copy_8(src,srcw,srch,
-				dst,dstw,dsth,
-				srcx,srcy,cpw,cph,dstx,dsty);
-	return;
-}
-
-j_inv = BITSPERBYTE - dstx % BITSPERBYTE;
-diff = j_inv - b;
-
-if (diff > 0) {
-	binary_subimage_copy_gt(src,srcw,srch,
-				dst,dstw,dsth,
-				srcx,srcy,cpw,cph,dstx,dsty);
-	return;
-}
-
-if (diff < 0) {
-	binary_subimage_copy_lt(src,srcw,srch,
-				dst,dstw,dsth,
-				srcx,srcy,cpw,cph,dstx,dsty);
-	return;
-}
-
-	binary_subimage_copy_eq(src,srcw,srch,
-				dst,dstw,dsth,
-				srcx,srcy,cpw,cph,dstx,dsty);
+binary_subimage_blit(BINARY_COPY,src,srcw,srch,
+			dst,dstw,dsth,
+			srcx,srcy,cpw,cph,dstx,dsty);
 }
@@ -0,0 +1,179 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     CHKLETS.C
+
+      DATE:     10/17/2026
+
+#cat: chklets - Checks that get_lets_vec and join_lets_vec give the same
+#cat:           samples as get_lets and join_lets for both filter banks,
+#cat:           along rows and columns, on scanlines of 2 to 40 samples,
+#cat:           and that no samples outside the scanlines are read.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wsq.h>
+
+/* Samples of margin kept around the block of scanlines. */
+#define PAD  8
+
+typedef struct filt_bank {
+   char *name;
+   float *hi;
+   int hsz;
+   float *lo;
+   int lsz;
+} FILT_BANK;
+
+static float hi97[7] = {  0.06453888262893845, -0.04068941760955844,
+                         -0.41809227322221221,  0.78848561640566439,
+                         -0.41809227322221221, -0.04068941760955844,
+                          0.06453888262893845 };
+static float lo97[9] = {  0.03782845550699546, -0.02384946501938000,
+                         -0.11062440441842342,  0.37740285561265380,
+                          0.85269867900940344,  0.37740285561265380,
+                         -0.11062440441842342, -0.02384946501938000,
+                          0.03782845550699546 };
+static float hi88[8] = {  0.03226944131446922, -0.05261415011924844,
+                         -0.18870142780632693,  0.60328894481393847,
+                         -0.60328894481393847,  0.18870142780632693,
+                          0.05261415011924844, -0.03226944131446922 };
+static float lo88[8] = {  0.07565691101399093, -0.12335584105275092,
+                         -0.09789296778409587,  0.85269867900940344,
+                          0.85269867900940344, -0.09789296778409587,
+                         -0.12335584105275092,  0.07565691101399093 };
+static float hi22[2] = {  0.70710678118654752, -0.70710678118654752 };
+static float lo22[2] = {  0.70710678118654752,  0.70710678118654752 };
+
+static FILT_BANK banks[] = {
+   { "9/7", hi97, 7, lo97, 9 },
+   { "8/8", hi88, 8, lo88, 8 },
+   { "2/2", hi22, 2, lo22, 2 }
+};
+
+int check_lets(const FILT_BANK *, const int, const int, const int,
+               const int);
+
+int debug = 0;
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int b, len2, inv, rows, nfailed;
+
+   (void)argc;
+   (void)argv;
+
+   nfailed = 0;
+   for(b = 0; b < (int)(sizeof(banks) / sizeof(banks[0])); b++)
+      for(len2 = 2; len2 <= 40; len2++)
+         for(inv = 0; inv < 2; inv++)
+            for(rows = 0; rows < 2; rows++)
+               nfailed += check_lets(&banks[b], len2, inv, rows, 0) +
+                          check_lets(&banks[b], len2, inv, rows, 1);
+
+   if(nfailed){
+      fprintf(stderr, "chklets : %d checks failed\n", nfailed);
+      exit(-1);
+   }
+   exit(0);
+}
+
+/*****************************************************************/
+/* Filters a block of 11 scanlines of "len2" samples, each way,  */
+/* with "join" selecting synthesis.  The block sits in a larger  */
+/* image whose margin is filled twice with different values;     */
+/* the reference must not change with the margin, and the        */
+/* vectorized routine must match it exactly.  Returns 1 on a     */
+/* mismatch and 0 otherwise.                                     */
+/*****************************************************************/
+int check_lets(const FILT_BANK *bank, const int len2, const int inv,
+               const int rows, const int join)
+{
+   int ret, i, x, y, w, h, len1, pitch, stride, fail;
+   float *old, *ref, *ref2, *vec, *obase;
+
+   len1 = 11;
+   if(rows){
+      w = len2 + 2 * PAD;
+      h = len1 + 2 * PAD;
+      pitch = w;
+      stride = 1;
+   }
+   else {
+      w = len1 + 2 * PAD;
+      h = len2 + 2 * PAD;
+      pitch = 1;
+      stride = w;
+   }
+
+   old = (float *)malloc(4 * w * h * sizeof(float));
+   if(old == (float *)NULL){
+      fprintf(stderr, "ERROR : check_lets : malloc : old\n");
+      return(1);
+   }
+   ref = old + w * h;
+   ref2 = ref + w * h;
+   vec = ref2 + w * h;
+   obase = old + PAD * w + PAD;
+
+   for(y = 0; y < h; y++)
+      for(x = 0; x < w; x++)
+         old[y * w + x] = (float)(((x * 7 + y * 13) % 31) - 15);
+   for(i = 0; i < w * h; i++)
+      ref[i] = ref2[i] = vec[i] = 0.0;
+
+   if(join){
+      join_lets(ref + (obase - old), obase, len1, len2, pitch, stride,
+                bank->hi, bank->hsz, bank->lo, bank->lsz, inv);
+      ret = join_lets_vec(vec + (obase - old), obase, len1, len2, pitch,
+                stride, bank->hi, bank->hsz, bank->lo, bank->lsz, inv, 1,
+                (CODEC_ARENA *)NULL);
+   }
+   else {
+      get_lets(ref + (obase - old), obase, len1, len2, pitch, stride,
+               bank->hi, bank->hsz, bank->lo, bank->lsz, inv);
+      ret = get_lets_vec(vec + (obase - old), obase, len1, len2, pitch,
+               stride, bank->hi, bank->hsz, bank->lo, bank->lsz, inv, 1,
+               (CODEC_ARENA *)NULL);
+   }
+
+   /* Refill the margin and filter again with the reference. */
+   for(y = 0; y < h; y++)
+      for(x = 0; x < w; x++)
+         if(y < PAD || y >= h - PAD || x < PAD || x >= w - PAD)
+            old[y * w + x] = 1.0e6;
+   if(join)
+      join_lets(ref2 + (obase - old), obase, len1, len2, pitch, stride,
+                bank->hi, bank->hsz, bank->lo, bank->lsz, inv);
+   else
+      get_lets(ref2 + (obase - old), obase, len1, len2, pitch, stride,
+               bank->hi, bank->hsz, bank->lo, bank->lsz, inv);
+
+   fail = 0;
+   if(ret)
+      fail = 1;
+   else if(memcmp(ref, ref2, w * h * sizeof(float))){
+      fprintf(stderr, "%s_lets %s len2 %d inv %d %s : "
+              "reads outside the scanline\n", join ? "join" : "get",
+              bank->name, len2, inv, rows ? "rows" : "columns");
+      fail = 1;
+   }
+   else if(memcmp(ref, vec, w * h * sizeof(float))){
+      fprintf(stderr, "%s_lets_vec %s len2 %d inv %d %s : "
+              "differs from %s_lets\n", join ? "join" : "get",
+              bank->name, len2, inv, rows ? "rows" : "columns",
+              join ? "join" : "get");
+      fail = 1;
+   }
+
+   free(old);
+   return(fail);
+}
@@ -0,0 +1,189 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     CHKWSQFX.C
+
+      DATE:     10/17/2026
+
+#cat: chkwsqfx - Decodes WSQ files with the floating point and with the
+#cat:            fixed point reconstruction, reporting the largest pixel
+#cat:            difference, the pixels that differ, and the speedup of
+#cat:            the fixed point decode.  Fails when a file differs by
+#cat:            more than the allowed error.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wsq.h>
+#include <img_io.h>
+
+void procargs(int, char **, int *, int *, int *);
+void print_usage(char *);
+int time_decode(double *, unsigned char **, int *, int *, WSQ_CTX *,
+                const int, unsigned char *, const int, const int);
+
+int debug = 0;
+
+static double now(void)
+{
+   struct timeval tv;
+
+   gettimeofday(&tv, NULL);
+   return(tv.tv_sec + tv.tv_usec * 1.0e-6);
+}
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, i, j, first, niters, maxerr, nfailed, ilen;
+   int w, h, fw, fh, err, worst, ndiff;
+   unsigned char *idata, *flt, *fix;
+   double tflt, tfix;
+   WSQ_CTX *ctx;
+
+   procargs(argc, argv, &first, &niters, &maxerr);
+
+   if((ret = alloc_WSQ_CTX(&ctx)))
+      exit(ret);
+
+   nfailed = 0;
+   printf("%-32s %11s %7s %9s %10s %10s %8s\n", "file", "size",
+          "maxerr", "differ", "float ms", "fixed ms", "speedup");
+   for(i = first; i < argc; i++){
+      if((ret = read_raw_from_filesize(argv[i], &idata, &ilen))){
+         nfailed++;
+         continue;
+      }
+
+      flt = (unsigned char *)NULL;
+      fix = (unsigned char *)NULL;
+      ret = time_decode(&tflt, &flt, &w, &h, ctx, 0, idata, ilen, niters);
+      if(!ret){
+         ret = time_decode(&tfix, &fix, &fw, &fh, ctx, 1, idata, ilen,
+                           niters);
+         /* Only the 9/7 filters have a fixed point reconstruction. */
+         if(!ret && !wsq_fixed_filters(&ctx->dtt_table))
+            fprintf(stderr, "%s : filters not 9/7, fixed point decode "
+                    "fell back to floating point\n", argv[i]);
+      }
+      free(idata);
+      if(!ret && (fw != w || fh != h)){
+         fprintf(stderr, "ERROR : main : %s : decodes to %dx%d and %dx%d\n",
+                 argv[i], w, h, fw, fh);
+         ret = -2;
+      }
+      if(ret){
+         if(flt != (unsigned char *)NULL)
+            free(flt);
+         if(fix != (unsigned char *)NULL)
+            free(fix);
+         nfailed++;
+         continue;
+      }
+
+      worst = 0;
+      ndiff = 0;
+      for(j = 0; j < w * h; j++){
+         err = abs(flt[j] - fix[j]);
+         if(err){
+            ndiff++;
+            if(err > worst)
+               worst = err;
+         }
+      }
+      free(flt);
+      free(fix);
+
+      printf("%-32s %5dx%-5d %7d %8.4f%% %10.2f %10.2f %8.2f\n", argv[i],
+             w, h, worst, ndiff * 100.0 / (w * h), tflt * 1.0e3,
+             tfix * 1.0e3, tflt / tfix);
+      if(worst > maxerr){
+         fprintf(stderr, "ERROR : main : %s : pixels differ by %d, ",
+                 argv[i], worst);
+         fprintf(stderr, "more than %d\n", maxerr);
+         nfailed++;
+      }
+   }
+
+   free_WSQ_CTX(ctx);
+   exit(nfailed ? -1 : 0);
+}
+
+/*****************************************************************/
+/* Decodes a WSQ datastream "niters" times, with the fixed point */
+/* reconstruction if "fixed" is set, returning the mean seconds  */
+/* per decode and the pixels of the last one.                    */
+/*****************************************************************/
+int time_decode(double *osecs, unsigned char **odata, int *ow, int *oh,
+                WSQ_CTX *ctx, const int fixed, unsigned char *idata,
+                const int ilen, const int niters)
+{
+   int ret, i, d, ppi, lossy;
+   unsigned char *odata1;
+   double t0;
+
+   ctx->fixed = fixed;
+   *osecs = 0.0;
+   *odata = (unsigned char *)NULL;
+   for(i = 0; i < niters; i++){
+      t0 = now();
+      ret = wsq_decode_mem_ctx(ctx, &odata1, ow, oh, &d, &ppi, &lossy,
+                               idata, ilen);
+      *osecs += now() - t0;
+      if(ret)
+         return(ret);
+      if(*odata != (unsigned char *)NULL)
+         free(*odata);
+      *odata = odata1;
+   }
+
+   *osecs /= niters;
+   return(0);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, int *first, int *niters,
+              int *maxerr)
+{
+   int i, *val;
+
+   *niters = 5;
+   *maxerr = 1;
+   for(i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2){
+      if(strcmp(argv[i], "-n") == 0)
+         val = niters;
+      else if(strcmp(argv[i], "-e") == 0)
+         val = maxerr;
+      else {
+         print_usage(argv[0]);
+         exit(-1);
+      }
+      if(sscanf(argv[i+1], "%d", val) != 1 || *val < 0 ||
+         (val == niters && *val < 1)){
+         print_usage(argv[0]);
+         exit(-1);
+      }
+   }
+   *first = i;
+   if(*first >= argc){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+}
+
+/*****************************************************************/
+void print_usage(char *arg0)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] [-e maxerr] <wsq file> ...\n\n",
+           arg0);
+   fprintf(stderr, "   -n iterations = decodes timed per file (default 5)\n");
+   fprintf(stderr, "   -e maxerr     = largest pixel difference allowed\n");
+   fprintf(stderr, "                   (default 1)\n");
+}
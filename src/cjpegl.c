@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/param.h>
 #include <math.h>
 #include <jpegl.h>
@@ -30,7 +31,7 @@
 #include <ffpis/util/ioutil.h>
 
 void procargs(int, char **, char **, char **, int *, int *, int *, int *,
-              int *, int *, int *, int *, int *, char **);
+              int *, int *, int *, int *, int *, char **, int *, int *);
 void print_usage(char *);
 
 int debug = 0;
@@ -51,15 +52,18 @@ int main(int argc, char *argv[])
    int hor_sampfctr[MAX_CMPNTS], vrt_sampfctr[MAX_CMPNTS];
    int n_cmpnts;
    char *comment_text;
+   int nthreads;                  /* encoder threads */
+   int restart_rows;              /* rows per restart interval */
 
 
 
    procargs(argc, argv, &outext, &ifile, &rawflag,
             &width, &height, &depth, &ppi, &intrlvflag,
-            hor_sampfctr, vrt_sampfctr, &n_cmpnts, &cfile);
+            hor_sampfctr, vrt_sampfctr, &n_cmpnts, &cfile, &nthreads,
+            &restart_rows);
 
    /* If nonintrlv or H,V's are specified for YCbCr ... */
-   if((!intrlvflag) || (argc > 6)){
+   if((!intrlvflag) || (rawflag && (argc > 6))){
       ret = read_raw_from_filesize(ifile, &idata, &ilen);
       if(ret)
          exit(ret);
@@ -137,7 +141,8 @@ int main(int argc, char *argv[])
       fflush(stderr);
    }
 
-   ret = jpegl_encode_mem(&odata, &olen, img_dat, comment_text);
+   ret = jpegl_encode_mem_restart(&odata, &olen, img_dat, comment_text,
+                                  restart_rows, nthreads);
    if(ret){
       free_IMG_DAT(img_dat, FREE_IMAGE);
       if(comment_text != (char *)NULL)
@@ -175,9 +180,35 @@ void procargs(int argc, char **argv,
               char **outext, char **ifile, int *rawflag,
               int *width, int *height, int *depth, int *ppi, int *intrlvflag,
               int *hor_sampfctr, int *vrt_sampfctr, int *n_cmpnts,
-              char **cfile)
+              char **cfile, int *nthreads, int *restart_rows)
 {
-   int argi;
+   int argi, *count;
+   long ncpus;
+
+   /* Trailing "-threads n" codes up to n components at once, where */
+   /* 0 uses every online processor.  Trailing "-restart n" puts a   */
+   /* restart marker every n rows, so the decoder can split them.    */
+   *nthreads = 1;
+   *restart_rows = 0;
+   while(argc > 4){
+      if(strncmp(argv[argc-2], "-t", 2) == 0)
+         count = nthreads;
+      else if(strncmp(argv[argc-2], "-re", 3) == 0)
+         count = restart_rows;
+      else
+         break;
+      if(sscanf(argv[argc-1], "%d", count) != 1 || *count < 0){
+         print_usage(argv[0]);
+         fprintf(stderr, "       invalid count \"%s\" for %s\n",
+                 argv[argc-1], argv[argc-2]);
+         exit(-1);
+      }
+      argc -= 2;
+   }
+   if(*nthreads == 0){
+      ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+      *nthreads = (ncpus > 0) ? (int)ncpus : 1;
+   }
 
    if((argc < 3) || (argc > 9)){
       print_usage(argv[0]);
@@ -293,4 +324,5 @@ void print_usage(char *arg0)
    fprintf(stderr, "                     [-nonintrlv]\n");
    fprintf(stderr, "                     [-YCbCr H0,V0:H1,V1:H2,V2]]\n");
    fprintf(stderr, "                  [comment file]\n");
+   fprintf(stderr, "                  [-restart n] [-threads n]\n");
 }
@@ -0,0 +1,388 @@
+/***********************************************************************
+      LIBRARY: IMAGE - Image Manipulation and Processing Routines
+
+      FILE:    CODECMEM.C
+
+      Contains routines responsible for the working memory of the
+      image codecs.  Temporaries are taken from a replaceable
+      allocator, which defaults to the C library, and the calls made
+      to it are counted with atomic adds, so no lock is taken on the
+      allocation path.  Image sized planes may instead come from a
+      bump arena that is reset between images, so that once it has
+      grown to fit, coding an image takes no memory from the heap.
+
+      ROUTINES:
+#cat: set_codec_allocator - installs the allocator the codecs take
+#cat:               their working memory from.
+#cat: codec_malloc - allocates working memory from the codec allocator.
+#cat:
+#cat: codec_calloc - allocates zeroed working memory from the codec
+#cat:               allocator.
+#cat: codec_realloc - resizes working memory from the codec allocator.
+#cat:
+#cat: codec_free - returns working memory to the codec allocator.
+#cat:
+#cat: get_codec_mem_stats - gets the counts of allocations made.
+#cat:
+#cat: reset_codec_mem_stats - zeroes the counts of allocations made.
+#cat:
+#cat: init_codec_arena - sets up an empty arena.
+#cat:
+#cat: codec_arena_alloc - allocates from an arena, or from the codec
+#cat:               allocator if there is none.
+#cat: codec_arena_calloc - allocates zeroed memory from an arena, or
+#cat:               from the codec allocator if there is none.
+#cat: codec_arena_realloc - resizes memory from codec_arena_alloc.
+#cat:
+#cat: codec_arena_free - releases memory from codec_arena_alloc.
+#cat:
+#cat: codec_arena_mark - records how much of an arena is in use.
+#cat:
+#cat: codec_arena_release - releases what was allocated from an arena
+#cat:               since a mark.
+#cat: reset_codec_arena - releases all of an arena's allocations,
+#cat:               keeping its memory for reuse.
+#cat: free_codec_arena - returns an arena's memory to the allocator.
+#cat:
+
+***********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <codecmem.h>
+
+/* Counters are updated with relaxed atomic adds where the compiler */
+/* has them; they are only statistics, so no ordering is needed.    */
+/* Elsewhere they are plain adds, which threads may race on.        */
+#if defined(__GNUC__)
+#define STAT_ADD(c, n)  __atomic_fetch_add(&(c), (n), __ATOMIC_RELAXED)
+#define STAT_GET(c)     __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#define STAT_CLEAR(c)   __atomic_store_n(&(c), 0, __ATOMIC_RELAXED)
+#else
+#define STAT_ADD(c, n)  ((c) += (n))
+#define STAT_GET(c)     (c)
+#define STAT_CLEAR(c)   ((c) = 0)
+#endif
+
+/* Running counts behind CODEC_MEM_STATS, with byte totals kept as */
+/* integers so they can be added to atomically.                    */
+typedef struct codec_mem_counts {
+   long nmallocs;
+   long nreallocs;
+   long nfrees;
+   unsigned long long nbytes;
+   long narena;
+   unsigned long long narena_bytes;
+} CODEC_MEM_COUNTS;
+
+static void *libc_malloc(size_t size, void *arg)
+{
+   (void)arg;
+   return(malloc(size));
+}
+
+static void *libc_realloc(void *ptr, size_t size, void *arg)
+{
+   (void)arg;
+   return(realloc(ptr, size));
+}
+
+static void libc_free(void *ptr, void *arg)
+{
+   (void)arg;
+   free(ptr);
+}
+
+static CODEC_ALLOCATOR codec_allocator = {
+   libc_malloc, libc_realloc, libc_free, (void *)NULL
+};
+static CODEC_MEM_COUNTS codec_mem_counts;
+
+/* Arena block headers are padded to keep allocations aligned. */
+#define ARENA_ROUND(n)  (((n) + CODEC_ARENA_ALIGN - 1) & \
+                         ~(size_t)(CODEC_ARENA_ALIGN - 1))
+#define ARENA_HEADER    ARENA_ROUND(sizeof(CODEC_ARENA_BLOCK))
+
+/***********************************************************************/
+/* Installs the allocator the codecs take their working memory from,   */
+/* or the C library's if "allocator" is NULL.  This must be done while */
+/* no codec memory is outstanding, as before any image is coded.       */
+/* Buffers returned to the caller, such as decoded pixmaps and coded   */
+/* datastreams, are always from malloc.                                */
+/***********************************************************************/
+void set_codec_allocator(const CODEC_ALLOCATOR *allocator)
+{
+   if(allocator == (CODEC_ALLOCATOR *)NULL){
+      codec_allocator.malloc_fn = libc_malloc;
+      codec_allocator.realloc_fn = libc_realloc;
+      codec_allocator.free_fn = libc_free;
+      codec_allocator.arg = (void *)NULL;
+   }
+   else
+      codec_allocator = *allocator;
+}
+
+/***********************************************************************/
+void *codec_malloc(const size_t size)
+{
+   STAT_ADD(codec_mem_counts.nmallocs, 1);
+   STAT_ADD(codec_mem_counts.nbytes, size);
+
+   return((*codec_allocator.malloc_fn)(size, codec_allocator.arg));
+}
+
+/***********************************************************************/
+void *codec_calloc(const size_t n, const size_t size)
+{
+   void *ptr;
+
+   if(size != 0 && n > (size_t)-1 / size)
+      return((void *)NULL);
+   ptr = codec_malloc(n * size);
+   if(ptr != (void *)NULL)
+      memset(ptr, 0, n * size);
+   return(ptr);
+}
+
+/***********************************************************************/
+void *codec_realloc(void *ptr, const size_t size)
+{
+   if(ptr == (void *)NULL){
+      STAT_ADD(codec_mem_counts.nmallocs, 1);
+      STAT_ADD(codec_mem_counts.nbytes, size);
+   }
+   else
+      STAT_ADD(codec_mem_counts.nreallocs, 1);
+
+   return((*codec_allocator.realloc_fn)(ptr, size, codec_allocator.arg));
+}
+
+/***********************************************************************/
+void codec_free(void *ptr)
+{
+   if(ptr == (void *)NULL)
+      return;
+
+   STAT_ADD(codec_mem_counts.nfrees, 1);
+
+   (*codec_allocator.free_fn)(ptr, codec_allocator.arg);
+}
+
+/***********************************************************************/
+void get_codec_mem_stats(CODEC_MEM_STATS *stats)
+{
+   stats->nmallocs = STAT_GET(codec_mem_counts.nmallocs);
+   stats->nreallocs = STAT_GET(codec_mem_counts.nreallocs);
+   stats->nfrees = STAT_GET(codec_mem_counts.nfrees);
+   stats->nbytes = (double)STAT_GET(codec_mem_counts.nbytes);
+   stats->narena = STAT_GET(codec_mem_counts.narena);
+   stats->narena_bytes = (double)STAT_GET(codec_mem_counts.narena_bytes);
+}
+
+/***********************************************************************/
+void reset_codec_mem_stats(void)
+{
+   STAT_CLEAR(codec_mem_counts.nmallocs);
+   STAT_CLEAR(codec_mem_counts.nreallocs);
+   STAT_CLEAR(codec_mem_counts.nfrees);
+   STAT_CLEAR(codec_mem_counts.nbytes);
+   STAT_CLEAR(codec_mem_counts.narena);
+   STAT_CLEAR(codec_mem_counts.narena_bytes);
+}
+
+/***********************************************************************/
+void init_codec_arena(CODEC_ARENA *arena)
+{
+   memset(arena, 0, sizeof(CODEC_ARENA));
+}
+
+/***********************************************************************/
+/* Allocates "size" bytes from "arena", taking a new block from the    */
+/* codec allocator when the current one is full.  With no arena, the   */
+/* memory comes from the codec allocator itself.                       */
+/***********************************************************************/
+void *codec_arena_alloc(CODEC_ARENA *arena, const size_t size)
+{
+   CODEC_ARENA_BLOCK *blk;
+   size_t nsize, bsize;
+   void *ptr;
+
+   if(arena == (CODEC_ARENA *)NULL)
+      return(codec_malloc(size));
+
+   nsize = ARENA_ROUND(size);
+   blk = arena->blocks;
+   if(blk == (CODEC_ARENA_BLOCK *)NULL || blk->size - blk->used < nsize){
+      bsize = (nsize > CODEC_ARENA_BLKSIZE) ? nsize : CODEC_ARENA_BLKSIZE;
+      blk = (CODEC_ARENA_BLOCK *)codec_malloc(ARENA_HEADER + bsize);
+      if(blk == (CODEC_ARENA_BLOCK *)NULL)
+         return((void *)NULL);
+      blk->next = arena->blocks;
+      blk->size = bsize;
+      blk->used = 0;
+      arena->blocks = blk;
+   }
+
+   ptr = (unsigned char *)blk + ARENA_HEADER + blk->used;
+   blk->used += nsize;
+   arena->used += nsize;
+   if(arena->used > arena->peak)
+      arena->peak = arena->used;
+   arena->nallocs++;
+
+   STAT_ADD(codec_mem_counts.narena, 1);
+   STAT_ADD(codec_mem_counts.narena_bytes, size);
+
+   return(ptr);
+}
+
+/***********************************************************************/
+void *codec_arena_calloc(CODEC_ARENA *arena, const size_t n,
+                         const size_t size)
+{
+   void *ptr;
+
+   if(size != 0 && n > (size_t)-1 / size)
+      return((void *)NULL);
+   ptr = codec_arena_alloc(arena, n * size);
+   if(ptr != (void *)NULL)
+      memset(ptr, 0, n * size);
+   return(ptr);
+}
+
+/***********************************************************************/
+/* Resizes "ptr", of "osize" bytes from codec_arena_alloc, to "size"   */
+/* bytes.  The last allocation from an arena grows in place while its  */
+/* block has room; anything else is copied to a new allocation.  With  */
+/* no arena, this is codec_realloc.                                    */
+/***********************************************************************/
+void *codec_arena_realloc(CODEC_ARENA *arena, void *ptr, const size_t osize,
+                          const size_t size)
+{
+   CODEC_ARENA_BLOCK *blk;
+   size_t start;
+   void *nptr;
+
+   if(arena == (CODEC_ARENA *)NULL)
+      return(codec_realloc(ptr, size));
+   if(ptr == (void *)NULL)
+      return(codec_arena_alloc(arena, size));
+
+   blk = arena->blocks;
+   start = blk->used - ARENA_ROUND(osize);
+   if(ARENA_ROUND(osize) <= blk->used &&
+      (unsigned char *)ptr == (unsigned char *)blk + ARENA_HEADER + start &&
+      ARENA_ROUND(size) <= blk->size - start){
+      arena->used += ARENA_ROUND(size) - ARENA_ROUND(osize);
+      blk->used = start + ARENA_ROUND(size);
+      if(arena->used > arena->peak)
+         arena->peak = arena->used;
+      STAT_ADD(codec_mem_counts.narena, 1);
+      STAT_ADD(codec_mem_counts.narena_bytes, size);
+      return(ptr);
+   }
+
+   nptr = codec_arena_alloc(arena, size);
+   if(nptr != (void *)NULL)
+      memcpy(nptr, ptr, (osize < size) ? osize : size);
+   return(nptr);
+}
+
+/***********************************************************************/
+/* Releases memory from codec_arena_alloc.  Memory in an arena is only */
+/* given back when the arena is reset, so this does nothing there.     */
+/***********************************************************************/
+void codec_arena_free(CODEC_ARENA *arena, void *ptr)
+{
+   if(arena == (CODEC_ARENA *)NULL)
+      codec_free(ptr);
+}
+
+/***********************************************************************/
+/* Records in "mark" how much of "arena" is in use, so scratch memory  */
+/* taken after it can be given back by codec_arena_release.            */
+/***********************************************************************/
+void codec_arena_mark(CODEC_ARENA *arena, CODEC_ARENA_MARK *mark)
+{
+   if(arena == (CODEC_ARENA *)NULL)
+      return;
+
+   mark->block = arena->blocks;
+   mark->block_used = (arena->blocks != (CODEC_ARENA_BLOCK *)NULL) ?
+                      arena->blocks->used : 0;
+   mark->used = arena->used;
+}
+
+/***********************************************************************/
+/* Releases everything allocated from "arena" since "mark".  Blocks    */
+/* taken since then are returned to the allocator; reset_codec_arena   */
+/* will size the next image's block to cover them.                     */
+/***********************************************************************/
+void codec_arena_release(CODEC_ARENA *arena, const CODEC_ARENA_MARK *mark)
+{
+   CODEC_ARENA_BLOCK *blk;
+
+   if(arena == (CODEC_ARENA *)NULL)
+      return;
+
+   while(arena->blocks != mark->block){
+      blk = arena->blocks;
+      arena->blocks = blk->next;
+      codec_free(blk);
+   }
+   if(arena->blocks != (CODEC_ARENA_BLOCK *)NULL)
+      arena->blocks->used = mark->block_used;
+   arena->used = mark->used;
+}
+
+/***********************************************************************/
+/* Releases everything allocated from "arena".  If the last image did  */
+/* not fit in one block, its blocks are replaced by one big enough for */
+/* the most the arena has held, so an image like it fits without       */
+/* taking more memory.  A NULL arena is ignored.                       */
+/***********************************************************************/
+void reset_codec_arena(CODEC_ARENA *arena)
+{
+   CODEC_ARENA_BLOCK *blk, *next;
+
+   if(arena == (CODEC_ARENA *)NULL)
+      return;
+
+   blk = arena->blocks;
+   if(blk != (CODEC_ARENA_BLOCK *)NULL &&
+      (blk->next != (CODEC_ARENA_BLOCK *)NULL || blk->size < arena->peak)){
+      for(; blk != (CODEC_ARENA_BLOCK *)NULL; blk = next){
+         next = blk->next;
+         codec_free(blk);
+      }
+      blk = (CODEC_ARENA_BLOCK *)codec_malloc(ARENA_HEADER + arena->peak);
+      if(blk != (CODEC_ARENA_BLOCK *)NULL){
+         blk->next = (CODEC_ARENA_BLOCK *)NULL;
+         blk->size = arena->peak;
+      }
+      arena->blocks = blk;
+   }
+   if(blk != (CODEC_ARENA_BLOCK *)NULL)
+      blk->used = 0;
+
+   arena->used = 0;
+   arena->nresets++;
+}
+
+/***********************************************************************/
+/* Returns all of an arena's memory to the codec allocator, leaving it */
+/* empty.                                                              */
+/***********************************************************************/
+void free_codec_arena(CODEC_ARENA *arena)
+{
+   CODEC_ARENA_BLOCK *blk, *next;
+
+   if(arena == (CODEC_ARENA *)NULL)
+      return;
+
+   for(blk = arena->blocks; blk != (CODEC_ARENA_BLOCK *)NULL; blk = next){
+      next = blk->next;
+      codec_free(blk);
+   }
+   init_codec_arena(arena);
+}
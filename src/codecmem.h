@@ -0,0 +1,76 @@
+#ifndef _CODECMEM_H
+#define _CODECMEM_H
+
+#include <stddef.h>
+
+/* Allocator the codecs take their working memory from.  "arg" is    */
+/* passed back on every call.  The realloc and free routines are     */
+/* only ever given memory from the same allocator.                   */
+typedef struct codec_allocator {
+   void *(*malloc_fn)(size_t, void *);
+   void *(*realloc_fn)(void *, size_t, void *);
+   void (*free_fn)(void *, void *);
+   void *arg;
+} CODEC_ALLOCATOR;
+
+/* Counts of the allocations made through the codec allocator and */
+/* served from arenas, since start up or the last reset.          */
+typedef struct codec_mem_stats {
+   long nmallocs;          /* blocks obtained from the allocator */
+   long nreallocs;         /* blocks resized */
+   long nfrees;            /* blocks returned */
+   double nbytes;          /* bytes requested from the allocator */
+   long narena;            /* allocations served from arenas */
+   double narena_bytes;    /* bytes served from arenas */
+} CODEC_MEM_STATS;
+
+/* Memory an arena takes from the allocator at a time, and the */
+/* alignment of what it hands out.                             */
+#define CODEC_ARENA_BLKSIZE  (1 << 20)
+#define CODEC_ARENA_ALIGN    32
+
+typedef struct codec_arena_block {
+   struct codec_arena_block *next;   /* block filled before this one */
+   size_t size;                      /* bytes usable in the block */
+   size_t used;                      /* bytes handed out from it */
+} CODEC_ARENA_BLOCK;
+
+/* Bump allocator for the working memory of one image.  Memory is   */
+/* only released all at once by reset_codec_arena, which keeps the  */
+/* blocks for the next image.  An arena is used by one thread at a  */
+/* time; a zeroed arena is empty and ready for use.                 */
+typedef struct codec_arena {
+   CODEC_ARENA_BLOCK *blocks;        /* block being filled first */
+   size_t used;                      /* bytes handed out since reset */
+   size_t peak;                      /* most bytes handed out at once */
+   long nallocs;                     /* allocations served */
+   long nresets;
+} CODEC_ARENA;
+
+/* Point in an arena that later allocations may be released back to. */
+typedef struct codec_arena_mark {
+   CODEC_ARENA_BLOCK *block;         /* block being filled at the mark */
+   size_t block_used;
+   size_t used;
+} CODEC_ARENA_MARK;
+
+/* codecmem.c */
+extern void set_codec_allocator(const CODEC_ALLOCATOR *);
+extern void *codec_malloc(const size_t);
+extern void *codec_calloc(const size_t, const size_t);
+extern void *codec_realloc(void *, const size_t);
+extern void codec_free(void *);
+extern void get_codec_mem_stats(CODEC_MEM_STATS *);
+extern void reset_codec_mem_stats(void);
+extern void init_codec_arena(CODEC_ARENA *);
+extern void *codec_arena_alloc(CODEC_ARENA *, const size_t);
+extern void *codec_arena_calloc(CODEC_ARENA *, const size_t, const size_t);
+extern void *codec_arena_realloc(CODEC_ARENA *, void *, const size_t,
+                                 const size_t);
+extern void codec_arena_free(CODEC_ARENA *, void *);
+extern void codec_arena_mark(CODEC_ARENA *, CODEC_ARENA_MARK *);
+extern void codec_arena_release(CODEC_ARENA *, const CODEC_ARENA_MARK *);
+extern void reset_codec_arena(CODEC_ARENA *);
+extern void free_codec_arena(CODEC_ARENA *);
+
+#endif /* !_CODECMEM_H */
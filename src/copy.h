@@ -20,6 +20,12 @@ int binary_image_mpad( u_char **image,
 int binary_image_pad( u_char **image,
 		u_int w,u_int  h,u_int  padw,u_int  padh, int bg);
 
+void binary_blit_row(int op, u_char *src, int i, u_char *dst, int j,
+		int bits);
+void binary_subimage_blit(int op, u_char *src, int  srcw,int srch,
+		u_char  *dst, int dstw, int dsth, int srcx,int srcy,
+		int  cpw,int cph, int dstx,int dsty);
+
 void binary_subimage_copy ( u_char *src, int  srcw,int srch, u_char  *dst,
 	       	int dstw, int dsth, int srcx,int srcy, int  cpw,int cph,
 		int dstx,int dsty);
@@ -14,6 +14,10 @@
 #cat:        This is an implementation based on the Crinimal Justice
 #cat:        Information Services (CJIS) document "WSQ Gray-scale
 #cat:        Fingerprint Compression Specification", Dec. 1997.
+#cat:        Given "-batch n", the image file names a list file or a
+#cat:        directory whose images are all encoded by n workers.
+#cat:        The bitrate may instead be given as a compression ratio
+#cat:        ("15:1") or a most number of bytes ("40000b") to fit.
 
 *************************************************************************/
 
@@ -25,17 +29,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <unistd.h>
 #include <wsq.h>
 #include <ihead.h>
 #include <img_io.h>
 #include <parsargs.h>
 #include <getnset.h>
+#include <batch.h>
 #include <ffpis/util/dataio.h>
 #include <ffpis/util/ioutil.h>
 
-void procargs(int, char **, float *, char **, char **, int *,
-              int *, int *, int *, int *, char **);
+/* Settings shared by every image encoded. */
+typedef struct cwsq_args {
+   float r_bitrate;         /* target bit compression rate */
+   float cratio;            /* or target compression ratio, if > 0 */
+   int max_len;             /* or most bytes to encode to, if > 0 */
+   char *outext;
+   int rawflag;             /* input image flag: 0 == Raw, 1 == IHead */
+   int width, height;       /* raw image attributes */
+   int depth, ppi;
+   char *comment_text;
+   WSQ_CTX **ctxs;          /* encoder working state of each worker */
+} CWSQ_ARGS;
+
+/* An input image read ahead of its encoding. */
+typedef struct cwsq_image {
+   unsigned char *idata;
+   int width, height;
+   int depth, ppi;
+} CWSQ_IMAGE;
+
+void procargs(int, char **, float *, float *, int *, char **, char **,
+              int *, int *, int *, int *, int *, char **, int *, int *);
 void print_usage(char *);
+int read_cwsq_image(CWSQ_IMAGE *, char *, CWSQ_ARGS *);
+int encode_cwsq_image(CWSQ_IMAGE *, char *, CWSQ_ARGS *, WSQ_CTX *, int *);
+int load_cwsq_item(BATCH_ITEM *, void *);
+int run_cwsq_item(BATCH_ITEM *, const int, void *);
 
 /* Contols globally, the level of debug reporting */
 /* in this application. */
@@ -47,98 +77,274 @@ int debug = 0;
 
 int main(int argc, char *argv[])
 {
-   int ret;
-   char *outext;
-   int rawflag;             /* input image flag: 0 == Raw, 1 == IHead */
-   float r_bitrate;         /* target bit compression rate */
-   char *ifile, *cfile, ofile[MAXPATHLEN];     /* Input/Output filenames */
-   IHEAD *ihead;            /* Ihead pointer */
-   unsigned char *idata;    /* Input data */
-   int width, height;       /* image characteristic parameters */
-   int depth, ppi;
-   unsigned char *odata;    /* Output data */
+   int ret, i;
+   char *ifile, *cfile;     /* Input filenames */
+   CWSQ_ARGS args;
+   CWSQ_IMAGE image;
    int olen;                /* Number of bytes in output data. */
-   char *comment_text;
+   int nthreads;            /* encoder threads */
+   int nworkers;            /* batch workers, 0 for a single image */
+   WSQ_CTX *ctx;            /* encoder working state */
+   char **files;
+   int nfiles;
+   BATCH_STATS stats;
+   long hits, misses;             /* tree cache counters */
+   int nsizes;
 
 
    /* Process the command-line argument list. */
-   procargs(argc, argv, &r_bitrate, &outext, &ifile, &rawflag,
-            &width, &height, &depth, &ppi, &cfile);
+   procargs(argc, argv, &args.r_bitrate, &args.cratio, &args.max_len,
+            &args.outext, &ifile,
+            &args.rawflag, &args.width, &args.height, &args.depth,
+            &args.ppi, &cfile, &nthreads, &nworkers);
 
-   /* Read the image into memory (IHead or raw pixmap). */
-   ret = read_raw_or_ihead_wsq(!rawflag, ifile,
-		   &ihead, &idata, &width, &height, &depth);
-   if(ret)
+   if(cfile == (char *)NULL)
+      args.comment_text = (char *)NULL;
+   else{
+      ret = read_ascii_file(cfile, &args.comment_text);
+      if(ret)
+         exit(ret);
+   }
+
+   if(nworkers == 0){
+      ret = alloc_WSQ_CTX(&ctx);
+      if(!ret){
+         ctx->nthreads = nthreads;
+         /* Read the image into memory (IHead or raw pixmap). */
+         ret = read_cwsq_image(&image, ifile, &args);
+         if(!ret)
+            ret = encode_cwsq_image(&image, ifile, &args, ctx, &olen);
+         free_WSQ_CTX(ctx);
+      }
+      if(args.comment_text != (char *)NULL)
+         free(args.comment_text);
       exit(ret);
+   }
+
+   /* Batch of images, each worker with its own context. */
+   ret = read_batch_list(&files, &nfiles, ifile);
+   if(ret){
+      if(args.comment_text != (char *)NULL)
+         free(args.comment_text);
+      exit(ret);
+   }
+
+   args.ctxs = (WSQ_CTX **)calloc(nworkers, sizeof(WSQ_CTX *));
+   if(args.ctxs == (WSQ_CTX **)NULL){
+      fprintf(stderr, "ERROR : main : calloc : ctxs\n");
+      ret = -2;
+   }
+   for(i = 0; !ret && i < nworkers; i++){
+      ret = alloc_WSQ_CTX(&args.ctxs[i]);
+      if(!ret)
+         args.ctxs[i]->nthreads = nthreads;
+   }
+
+   if(!ret){
+      /* Most batches hold a few common scan sizes. */
+      preload_wsq_trees((int *)NULL, 0);
+      ret = run_batch(files, nfiles, nworkers, load_cwsq_item,
+                      run_cwsq_item, &args, &stats);
+      if(!ret){
+         print_batch_stats(stdout, &stats);
+         get_wsq_tree_cache_stats(&hits, &misses, &nsizes);
+         fprintf(stdout, "%ld of %ld tree lookups cached, %d image sizes\n",
+                 hits, hits + misses, nsizes);
+         if(stats.nfailed)
+            ret = -1;
+      }
+   }
+
+   if(args.ctxs != (WSQ_CTX **)NULL){
+      for(i = 0; i < nworkers; i++)
+         free_WSQ_CTX(args.ctxs[i]);
+      free(args.ctxs);
+   }
+   free_batch_list(files, nfiles);
+   if(args.comment_text != (char *)NULL)
+      free(args.comment_text);
+
+   /* Exit normally. */
+   exit(ret);
+}
+
+/*****************************************************************/
+/* Reads an IHead or raw pixmap to be encoded.                   */
+/*****************************************************************/
+int read_cwsq_image(CWSQ_IMAGE *image, char *ifile, CWSQ_ARGS *args)
+{
+   int ret;
+   IHEAD *ihead;            /* Ihead pointer */
+
+   image->width = args->width;
+   image->height = args->height;
+   image->depth = args->depth;
+   image->ppi = args->ppi;
+
+   ret = read_raw_or_ihead_wsq(!args->rawflag, ifile,
+		   &ihead, &image->idata, &image->width, &image->height,
+		   &image->depth);
+   if(ret)
+      return(ret);
 
    if(debug > 0)
       fprintf(stdout, "File %s read\n", ifile);
 
    /* If IHead image file ... */
-   if(!rawflag){
+   if(!args->rawflag){
       /* Get PPI from IHead. */
-      ppi = get_density(ihead);
+      image->ppi = get_density(ihead);
       free(ihead);
    }
 
-   if(cfile == (char *)NULL)
-      comment_text = (char *)NULL;
-   else{
-      ret = read_ascii_file(cfile, &comment_text);
-      if(ret){
-         free(idata);
-         exit(ret);
-      }
-   }
+   return(0);
+}
 
-   /* Encode/compress the image pixmap. */
-   ret = wsq_encode_mem(&odata, &olen, r_bitrate,
-		   idata, width, height, depth, ppi, comment_text);
-   if(ret){
-      free(idata);
-      if(comment_text != (char *)NULL)
-         free(comment_text);
-      exit(ret);
-   }
+/*****************************************************************/
+/* Encodes a pixmap and writes it next to its input file.  The   */
+/* pixmap is freed.                                              */
+/*****************************************************************/
+int encode_cwsq_image(CWSQ_IMAGE *image, char *ifile, CWSQ_ARGS *args,
+                      WSQ_CTX *ctx, int *olen)
+{
+   int ret, max_len;
+   char ofile[MAXPATHLEN];  /* Output filename */
+   unsigned char *odata;    /* Output data */
 
-   free(idata);
-   if(comment_text != (char *)NULL)
-      free(comment_text);
+   /* Encode/compress the image pixmap, to a size if one is given. */
+   max_len = args->max_len;
+   if(args->cratio > 0.0)
+      max_len = (int)((image->width * image->height) / args->cratio);
+   if(max_len > 0)
+      ret = wsq_encode_mem_size_ctx(ctx, &odata, olen, max_len,
+		   image->idata, image->width, image->height, image->depth,
+		   image->ppi, args->comment_text);
+   else
+      ret = wsq_encode_mem_ctx(ctx, &odata, olen, args->r_bitrate,
+		   image->idata, image->width, image->height, image->depth,
+		   image->ppi, args->comment_text);
+   free(image->idata);
+   if(ret)
+      return(ret);
 
    if(debug > 0)
       fprintf(stdout, "Image data encoded, compressed byte length = %d\n",
-              olen);
+              *olen);
 
    /* Generate the output filename. */
-   fileroot(ifile);
-   sprintf(ofile, "%s.%s", ifile, outext);
-
-   ret = write_raw_from_memsize(ofile, odata, olen);
-   if(ret){
+   if(strlen(ifile) + strlen(args->outext) + 2 > MAXPATHLEN){
+      fprintf(stderr, "ERROR : encode_cwsq_image : name too long : %s\n",
+              ifile);
       free(odata);
-      exit(ret);
+      return(-3);
    }
+   strcpy(ofile, ifile);
+   fileroot(ofile);
+   strcat(ofile, ".");
+   strcat(ofile, args->outext);
+
+   ret = write_raw_from_memsize(ofile, odata, *olen);
+   free(odata);
+   if(ret)
+      return(ret);
 
    if(debug > 0)
       fprintf(stdout, "Image data written to file %s\n", ofile);
 
-   free(odata);
+   return(0);
+}
 
-   /* Exit normally. */
-   exit(0);
+/*****************************************************************/
+/* Batch read-ahead of one input image.                          */
+/*****************************************************************/
+int load_cwsq_item(BATCH_ITEM *item, void *arg)
+{
+   int ret;
+   CWSQ_IMAGE *image;
+
+   image = (CWSQ_IMAGE *)malloc(sizeof(CWSQ_IMAGE));
+   if(image == (CWSQ_IMAGE *)NULL){
+      fprintf(stderr, "ERROR : load_cwsq_item : malloc : image\n");
+      return(-2);
+   }
+
+   ret = read_cwsq_image(image, item->ifile, (CWSQ_ARGS *)arg);
+   if(ret){
+      free(image);
+      return(ret);
+   }
+
+   item->data = image;
+   item->ilen = image->width * image->height;
+   return(0);
 }
 
 /*****************************************************************/
-void procargs(int argc, char **argv, float *r_bitrate,
-              char **outext, char **ifile, int *rawflag,
-              int *width, int *height, int *depth, int *ppi, char **cfile)
+/* Batch encoding of one image already read.                     */
+/*****************************************************************/
+int run_cwsq_item(BATCH_ITEM *item, const int worker, void *arg)
 {
+   int ret;
+   CWSQ_ARGS *args = (CWSQ_ARGS *)arg;
+
+   ret = encode_cwsq_image((CWSQ_IMAGE *)item->data, item->ifile, args,
+                           args->ctxs[worker], &item->olen);
+   free(item->data);
+   item->data = NULL;
+   return(ret);
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, float *r_bitrate, float *cratio,
+              int *max_len, char **outext, char **ifile, int *rawflag,
+              int *width, int *height, int *depth, int *ppi, char **cfile,
+              int *nthreads, int *nworkers)
+{
+   long ncpus;
+   int *nptr, len, ok;
+
+   /* Trailing "-threads n" sets the number of encoder threads per */
+   /* image and "-batch n" the number of images encoded at once,   */
+   /* where 0 uses every online processor.                         */
+   *nthreads = 1;
+   *nworkers = 0;
+   while((argc > 5) && ((strncmp(argv[argc-2], "-t", 2) == 0) ||
+                        (strncmp(argv[argc-2], "-b", 2) == 0))){
+      nptr = (argv[argc-2][1] == 't') ? nthreads : nworkers;
+      if(sscanf(argv[argc-1], "%d", nptr) != 1 || *nptr < 0){
+         print_usage(argv[0]);
+         fprintf(stderr, "       invalid count \"%s\" for %s\n",
+                 argv[argc-1], argv[argc-2]);
+         exit(-1);
+      }
+      if(*nptr == 0){
+         ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+         *nptr = (ncpus > 0) ? (int)ncpus : 1;
+      }
+      argc -= 2;
+   }
+
    if((argc < 4) || (argc > 7)){
       print_usage(argv[0]);
       exit(-1);
    }
 
-   sscanf(argv[1], "%f", r_bitrate);
+   /* Bitrate, "<ratio>:1" or "<bytes>b". */
+   *r_bitrate = 0.0;
+   *cratio = 0.0;
+   *max_len = 0;
+   len = strlen(argv[1]);
+   if(strchr(argv[1], ':') != (char *)NULL)
+      ok = (sscanf(argv[1], "%f:1", cratio) == 1 && *cratio > 0.0);
+   else if(len > 0 && (argv[1][len-1] == 'b' || argv[1][len-1] == 'B'))
+      ok = (sscanf(argv[1], "%d", max_len) == 1 && *max_len > 0);
+   else
+      ok = (sscanf(argv[1], "%f", r_bitrate) == 1);
+   if(!ok){
+      print_usage(argv[0]);
+      fprintf(stderr, "       invalid bitrate \"%s\"\n", argv[1]);
+      exit(-1);
+   }
    *outext = argv[2];
    *ifile = argv[3];
    *rawflag = 0;
@@ -185,7 +391,21 @@ void print_usage(char *arg0)
    fprintf(stderr, "Usage: %s ", arg0);
    fprintf(stderr, "<r bitrate> <outext> <image file>\n");
    fprintf(stderr,
-           "                 [-raw_in w,h,d,[ppi]] [comment file]\n\n");
+           "                 [-raw_in w,h,d,[ppi]] [comment file]\n");
+   fprintf(stderr,
+           "                 [-threads n] [-batch n]\n\n");
+   fprintf(stderr,
+           "   r bitrate = compression bit rate (2.25==>5:1, .75==>15:1)\n");
+   fprintf(stderr,
+           "               or \"15:1\" for a compression ratio, or\n");
+   fprintf(stderr,
+           "               \"40000b\" for a most number of bytes\n");
+   fprintf(stderr,
+           "   -threads n = encoder threads per image (default 1)\n");
+   fprintf(stderr,
+           "   -batch n = <image file> is a list file or directory whose\n");
+   fprintf(stderr,
+           "              images are encoded by n workers\n");
    fprintf(stderr,
-           "   r bitrate = compression bit rate (2.25==>5:1, .75==>15:1)\n\n");
+           "   a count of 0 uses one per processor\n\n");
 }
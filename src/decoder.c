@@ -13,6 +13,13 @@
 #cat: jpegl_decode_mem - Decodes a datastream of JPEGL compressed bytes
 #cat:                    from a memory buffer, returning a lossless
 #cat:                    reconstructed pixmap.
+#cat: jpegl_decode_mem_mt - Decodes a datastream of JPEGL compressed bytes
+#cat:                    from a memory buffer, decoding restart intervals
+#cat:                    on parallel threads.
+#cat: jpegl_decode_mem_into - Decodes a datastream of JPEGL compressed
+#cat:                    bytes into a caller supplied buffer.
+#cat: jpegl_probe_mem - Reads the image attributes and output buffer
+#cat:                    size of a JPEGL datastream from its headers.
 #cat: build_huff_decode_table - Builds a table of pixel difference values.
 #cat:
 #cat: decode_data - Decodes compressed data buffer.
@@ -21,32 +28,253 @@
 #cat:                    from an open file.
 #cat: getc_nextbits_jpegl - Gets next sequence of bits for data decoding
 #cat:                    from a memory buffer.
+#cat: gen_hdec_table_jpegl - Builds the lookup table used to decode
+#cat:                    difference values.
+#cat: fill_bitbuf_jpegl - Loads bytes from a memory buffer into a bit
+#cat:                    reservoir.
+#cat: unget_bitbuf_jpegl - Returns the whole bytes left in a bit reservoir
+#cat:                    to a memory buffer.
+#cat: getc_diff_row_jpegl - Decodes a row of difference values from a bit
+#cat:                    reservoir.
 
 ***********************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <jpegl.h>
+#include <wsq.h>
 #include <dataio.h>
 
-/******************/
-/*Start of Decoder*/
-/******************/
-int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
-                     unsigned char *idata, const int ilen)
+/* Restart intervals of a scan being decoded on their own threads. */
+typedef struct jpegl_interval_jobs {
+   IMG_DAT *img_dat;
+   int cmpnt_i;
+   int pitch;
+   int rows;                 /* rows per interval */
+   HDEC_TABLE_JPEGL *hdec;
+   unsigned char **starts;   /* start of each interval's coded data */
+   unsigned char **ends;     /* and the marker ending it */
+} JPEGL_INTERVAL_JOBS;
+
+/*****************************************************************/
+/* Works out where each component plane of "img_dat" goes in an  */
+/* output buffer whose rows are "ostride" bytes apart, or packed */
+/* to the width of each plane if "ostride" is 0.  Planes follow  */
+/* one another, so a packed buffer holds them as                 */
+/* get_IMG_DAT_image returns them.                               */
+/*****************************************************************/
+static int layout_jpegl_planes(IMG_DAT *img_dat, const int ostride,
+                               int *pitch, int *offset, int *osize)
+{
+   int i, size;
+
+   size = 0;
+   for(i = 0; i < img_dat->n_cmpnts; i++){
+      pitch[i] = (ostride > 0) ? ostride : img_dat->samp_width[i];
+      if(pitch[i] < img_dat->samp_width[i]){
+         fprintf(stderr, "ERROR : layout_jpegl_planes : ");
+         fprintf(stderr, "row stride %d less than component %d width %d\n",
+                 pitch[i], i, img_dat->samp_width[i]);
+         return(-3);
+      }
+      offset[i] = size;
+      size += pitch[i] * img_dat->samp_height[i];
+   }
+
+   *osize = size;
+   return(0);
+}
+
+/*****************************************************************/
+/* Decodes "nrows" rows of component "cmpnt_i", from "row0" on,  */
+/* out of the coded data at "cbufptr", leaving it just past the  */
+/* data decoded.                                                 */
+/* Prediction starts over at "row0", as it does at the start of  */
+/* the scan and of each restart interval.                        */
+/*****************************************************************/
+static int decode_jpegl_rows(IMG_DAT *img_dat, const int cmpnt_i,
+                             const int pitch, const int row0,
+                             const int nrows, HDEC_TABLE_JPEGL *hdec,
+                             unsigned char **cbufptr, unsigned char *ebufptr)
+{
+   int ret, row, width;
+   short *diff_row;        /*difference values of a row*/
+   BITBUF_JPEGL bitbuf;    /*bits read ahead from the input buffer*/
+   unsigned char *sbufptr; /*start of the coded data*/
+   unsigned char *optr;
+
+   width = img_dat->samp_width[cmpnt_i];
+   diff_row = (short *)malloc(width * sizeof(short));
+   if(diff_row == (short *)NULL){
+      fprintf(stderr, "ERROR : decode_jpegl_rows : malloc : diff_row\n");
+      return(-7);
+   }
+
+   bitbuf.bits = 0;
+   bitbuf.nbits = 0;
+   bitbuf.marker = 0;
+   sbufptr = *cbufptr;
+
+   for(row = 0; row < nrows; row++){
+      ret = getc_diff_row_jpegl(diff_row, width, hdec, &bitbuf,
+                                cbufptr, ebufptr);
+      if(ret){
+         free(diff_row);
+         return(ret);
+      }
+      optr = img_dat->image[cmpnt_i] + ((row0 + row) * pitch);
+      ret = undo_predict_row(optr, diff_row, width, pitch, row,
+                             img_dat->cmpnt_depth,
+                             img_dat->predict[cmpnt_i],
+                             img_dat->point_trans[cmpnt_i]);
+      if(ret){
+         free(diff_row);
+         return(ret);
+      }
+   }
+   free(diff_row);
+
+   /*hand back the bytes read ahead of the next marker*/
+   unget_bitbuf_jpegl(&bitbuf, cbufptr, sbufptr);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* Decodes restart interval "k" of a scan.                       */
+/*****************************************************************/
+static int decode_interval_job(void *arg, const int k)
+{
+   JPEGL_INTERVAL_JOBS *jobs = (JPEGL_INTERVAL_JOBS *)arg;
+   unsigned char *cbufptr;
+   int row0, nrows;
+
+   row0 = k * jobs->rows;
+   nrows = jobs->img_dat->samp_height[jobs->cmpnt_i] - row0;
+   if(nrows > jobs->rows)
+      nrows = jobs->rows;
+
+   cbufptr = jobs->starts[k];
+   return(decode_jpegl_rows(jobs->img_dat, jobs->cmpnt_i, jobs->pitch,
+                            row0, nrows, jobs->hdec, &cbufptr,
+                            jobs->ends[k]));
+}
+
+/*****************************************************************/
+/* Decodes a scan of component "cmpnt_i" split into restart      */
+/* intervals of "restart" samples.  The RSTn markers are found   */
+/* first, then the intervals, which share nothing, are decoded   */
+/* on up to "nthreads" threads.  "cbufptr" is left at the marker */
+/* ending the scan.                                              */
+/* Only intervals of whole rows, as jpegl_encode_mem_restart     */
+/* writes, are handled.  Rows are decoded and predicted whole,   */
+/* so a scan whose intervals start part way along a row is       */
+/* rejected, however many threads are used.                      */
+/*****************************************************************/
+static int decode_jpegl_intervals(IMG_DAT *img_dat, const int cmpnt_i,
+                                  const int pitch, const int restart,
+                                  HDEC_TABLE_JPEGL *hdec,
+                                  unsigned char **cbufptr,
+                                  unsigned char *ebufptr, const int nthreads)
+{
+   int ret, k, nints, width, height;
+   unsigned char *cptr;
+   JPEGL_INTERVAL_JOBS jobs;
+
+   width = img_dat->samp_width[cmpnt_i];
+   height = img_dat->samp_height[cmpnt_i];
+   if(restart % width != 0){
+      fprintf(stderr, "ERROR : decode_jpegl_intervals : ");
+      fprintf(stderr, "restart interval %d not a multiple of the ", restart);
+      fprintf(stderr, "row length %d is not supported\n", width);
+      return(-10);
+   }
+   jobs.rows = restart / width;
+   nints = (height + jobs.rows - 1) / jobs.rows;
+
+   jobs.starts = (unsigned char **)malloc(2 * nints * sizeof(unsigned char *));
+   if(jobs.starts == (unsigned char **)NULL){
+      fprintf(stderr, "ERROR : decode_jpegl_intervals : malloc : starts\n");
+      return(-7);
+   }
+   jobs.ends = jobs.starts + nints;
+
+   /* Walk the coded data to the marker ending the scan, noting the */
+   /* restart markers along the way.  0xFF 0x00 is a stuffed byte   */
+   /* and any 0xFF may be a fill byte in front of a marker.         */
+   k = 0;
+   cptr = *cbufptr;
+   jobs.starts[0] = cptr;
+   while(1){
+      cptr = (unsigned char *)memchr(cptr, 0xFF, ebufptr - cptr);
+      if(cptr == (unsigned char *)NULL || cptr + 1 >= ebufptr){
+         cptr = ebufptr;
+         break;
+      }
+      if(*(cptr+1) == 0x00){
+         cptr += 2;
+         continue;
+      }
+      if(*(cptr+1) == 0xFF){
+         cptr++;
+         continue;
+      }
+      if((*(cptr+1) & 0xF8) != (RST0 & 0xFF))
+         break;
+
+      if(k + 1 >= nints || (*(cptr+1) & 0x07) != (k & 0x07)){
+         fprintf(stderr, "ERROR : decode_jpegl_intervals : ");
+         fprintf(stderr, "restart marker %04X out of sequence ",
+                 (*cptr << 8) | *(cptr+1));
+         fprintf(stderr, "after interval %d of %d\n", k+1, nints);
+         free(jobs.starts);
+         return(-11);
+      }
+      jobs.ends[k] = cptr;
+      cptr += 2;
+      k++;
+      jobs.starts[k] = cptr;
+   }
+   jobs.ends[k] = cptr;
+   if(k + 1 != nints){
+      fprintf(stderr, "ERROR : decode_jpegl_intervals : ");
+      fprintf(stderr, "found %d of %d restart intervals\n", k+1, nints);
+      free(jobs.starts);
+      return(-11);
+   }
+
+   jobs.img_dat = img_dat;
+   jobs.cmpnt_i = cmpnt_i;
+   jobs.pitch = pitch;
+   jobs.hdec = hdec;
+   ret = wsq_run_jobs(nthreads, nints, decode_interval_job, &jobs);
+
+   free(jobs.starts);
+   if(ret)
+      return(ret);
+
+   *cbufptr = cptr;
+   return(0);
+}
+
+/*****************************************************************/
+/* Decodes a JPEGL datastream.  If "obuf" is NULL the component  */
+/* planes are allocated; otherwise they are written into the     */
+/* "osize" byte buffer "obuf" as laid out by layout_jpegl_planes */
+/* and are not freed with the returned IMG_DAT.  Scans split     */
+/* into restart intervals are decoded on up to "nthreads"        */
+/* threads.                                                      */
+/*****************************************************************/
+static int decode_jpegl(IMG_DAT **oimg_dat, int *lossyflag,
+                        unsigned char *obuf, const int ostride,
+                        const int osize, unsigned char *idata,
+                        const int ilen, const int nthreads)
 {
    int ret;
    int i, cmpnt_i;
-   unsigned short diff_code;       /*"raw" difference pixel*/
-   int diff_cat;           /*code word category*/
-   long pixel;             /*current pixel number*/
-   int full_diff_code;     /*difference code extend to full precision*/
-   int num_pixels;         /*number of pixels image will expand too*/
-   int bit_count = 0;      /*marks the bit to receive from the input byte*/
-   short data_pred;        /*prediction of pixel value*/
-   /*holds the code for all possible
-     difference values that occur when encoding*/
-   int huff_decoder[MAX_CATEGORY][LARGESTDIFF+1];
+   HDEC_TABLE_JPEGL hdec;  /*used in decoding difference values*/
+   int restart = 0;        /*samples per restart interval, 0 for none*/
    int ppi;
    HUF_TABLE         *huf_table[MAX_CMPNTS];
    FRM_HEADER_JPEGL  *frm_header;
@@ -56,9 +284,14 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
    unsigned short marker;
    unsigned char *cbufptr, *ebufptr;
    unsigned char *optr;
+   int col;                /*position in row*/
+   int row;
+   int pitch[MAX_CMPNTS];  /*bytes between the rows of each component*/
+   int offset[MAX_CMPNTS]; /*start of each component in "obuf"*/
+   int size;
+   int free_flag;          /*whether image planes belong to the decoder*/
 
-   /*this routine builds a table used in decoding coded difference pixels*/
-   build_huff_decode_table(huff_decoder);
+   free_flag = (obuf == (unsigned char *)NULL) ? FREE_IMAGE : NO_FREE_IMAGE;
 
    for(i = 0; i < MAX_CMPNTS; i++)
       huf_table[i] = (HUF_TABLE *)NULL;
@@ -91,8 +324,11 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
 
    /* While not at Start of Frame ... */
    while(marker != SOF3){
-      /* Get next Huffman table or comment ... */
-      ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
+      /* Get next Huffman table, restart interval or comment ... */
+      if(marker == DRI)
+         ret = getc_restart_interval(&restart, &cbufptr, ebufptr);
+      else
+         ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
       if(ret){
          free_HUFF_TABLES(huf_table, MAX_CMPNTS);
          return(ret);
@@ -121,6 +357,26 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
    }
    free(frm_header);
 
+   /* Lay the component planes out in the caller's buffer, if given. */
+   ret = layout_jpegl_planes(img_dat, ostride, pitch, offset, &size);
+   if(ret){
+      free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+      free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+      return(ret);
+   }
+   if(obuf != (unsigned char *)NULL){
+      if(osize < size){
+         fprintf(stderr, "ERROR : decode_jpegl : ");
+         fprintf(stderr, "buffer of %d bytes less than the %d needed\n",
+                 osize, size);
+         free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+         free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+         return(-4);
+      }
+      for(i = 0; i < img_dat->n_cmpnts; i++)
+         img_dat->image[i] = obuf + offset[i];
+   }
+
    ret = getc_marker_jpegl(&marker, TBLS_N_SOS, &cbufptr, ebufptr);
    if(ret){
       free_HUFF_TABLES(huf_table, MAX_CMPNTS);
@@ -132,18 +388,21 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
    while(marker != EOI) {
       /* While not at Start of Scan ... */
       while(marker != SOS) {
-         /* Get next Huffman table or comment ... */
-         ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
+         /* Get next Huffman table, restart interval or comment ... */
+         if(marker == DRI)
+            ret = getc_restart_interval(&restart, &cbufptr, ebufptr);
+         else
+            ret = getc_table_jpegl(marker, huf_table, &cbufptr, ebufptr);
          if(ret){
             free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-            free_IMG_DAT(img_dat, FREE_IMAGE);
+            free_IMG_DAT(img_dat, free_flag);
             return(ret);
          }
          /* Get next marker ... */
 	 ret = getc_marker_jpegl(&marker, TBLS_N_SOS, &cbufptr, ebufptr);
          if(ret){
             free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-            free_IMG_DAT(img_dat, FREE_IMAGE);
+            free_IMG_DAT(img_dat, free_flag);
             return(ret);
          }
       }
@@ -152,7 +411,7 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
       ret = getc_scan_header(&scn_header, &cbufptr, ebufptr);
       if(ret){
          free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-         free_IMG_DAT(img_dat, FREE_IMAGE);
+         free_IMG_DAT(img_dat, free_flag);
          return(ret);
       }
 
@@ -162,71 +421,42 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
       if(ret){
          free_HUFF_TABLES(huf_table, MAX_CMPNTS);
          free(scn_header);
-         free_IMG_DAT(img_dat, FREE_IMAGE);
+         free_IMG_DAT(img_dat, free_flag);
          return(ret);
       }
 
       /* If encoded data is NOT interleaved ... */
       if(!(img_dat->intrlv)) {
 	 cmpnt_i = scn_header->Cs[0];
-	 optr = img_dat->image[cmpnt_i];
-         /*decompress the pixel "differences" sequentially*/
-	 num_pixels = img_dat->samp_width[cmpnt_i] *
-                      img_dat->samp_height[cmpnt_i];
-         bit_count = 0;
-	 for(pixel = 0; pixel < num_pixels; pixel++) {
-            /*get next huffman category code from compressed input
-              data stream*/
-		 ret = decode_data(&diff_cat,
-				 huf_table[cmpnt_i]->mincode,
-				 huf_table[cmpnt_i]->maxcode,
-				 huf_table[cmpnt_i]->valptr,
-				 huf_table[cmpnt_i]->values,
-				 &cbufptr, ebufptr, &bit_count);
-            if(ret){
-               free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-               free_IMG_DAT(img_dat, FREE_IMAGE);
-               free(scn_header);
-               return(ret);
-            }
 
-            /*get the required bits (given by huffman code) to reconstruct
-              the difference value for the pixel*/
-		 ret = getc_nextbits_jpegl(&diff_code,
-				 &cbufptr, ebufptr, &bit_count, diff_cat);
-            if(ret){
-               free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-               free_IMG_DAT(img_dat, FREE_IMAGE);
-               free(scn_header);
-               return(ret);
-            }
-
-            /*extend the difference value to full precision*/
-            full_diff_code = huff_decoder[diff_cat][diff_code];
-
-            /*reverse the pixel prediction and store the pixel value in the
-              output buffer*/
-	    ret = predict(&data_pred, optr,
-			    img_dat->samp_width[cmpnt_i], pixel,
-			    img_dat->cmpnt_depth, img_dat->predict[cmpnt_i],
-			    img_dat->point_trans[cmpnt_i]);
-            if(ret){
-               free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-               free_IMG_DAT(img_dat, FREE_IMAGE);
-               free(scn_header);
-               return(ret);
-            }
-
-            *optr++ = full_diff_code + data_pred;
+         /*this routine builds the lookup table used in decoding the
+           difference values*/
+         gen_hdec_table_jpegl(&hdec, huf_table[cmpnt_i]);
+
+         /*decompress the pixel "differences" a row at a time and
+           reverse the pixel prediction*/
+         if(restart > 0)
+            ret = decode_jpegl_intervals(img_dat, cmpnt_i, pitch[cmpnt_i],
+                                         restart, &hdec, &cbufptr, ebufptr,
+                                         nthreads);
+         else
+            ret = decode_jpegl_rows(img_dat, cmpnt_i, pitch[cmpnt_i], 0,
+                                    img_dat->samp_height[cmpnt_i], &hdec,
+                                    &cbufptr, ebufptr);
+         if(ret){
+            free_HUFF_TABLES(huf_table, MAX_CMPNTS);
+            free_IMG_DAT(img_dat, free_flag);
+            free(scn_header);
+            return(ret);
          }
       }
       /* Otherwise, encoded data IS interleaved ... */
       else {
-         fprintf(stderr, "ERROR: jpegl_decode_mem : ");
+         fprintf(stderr, "ERROR: decode_jpegl : ");
          fprintf(stderr, "Sorry, this decoder does not handle ");
          fprintf(stderr, "encoded data that is interleaved.\n");
          free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-         free_IMG_DAT(img_dat, FREE_IMAGE);
+         free_IMG_DAT(img_dat, free_flag);
          return(-2);
       }
 
@@ -234,10 +464,11 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
 
       for(i = 0; i < img_dat->n_cmpnts; i++) {
          if(img_dat->point_trans[i]) {
-            for(pixel = 0;
-                pixel < img_dat->samp_width[i] * img_dat->samp_height[i];
-                pixel++)
-               *(img_dat->image[i]+pixel) <<= img_dat->point_trans[i];
+            for(row = 0; row < img_dat->samp_height[i]; row++){
+               optr = img_dat->image[i] + (row * pitch[i]);
+               for(col = 0; col < img_dat->samp_width[i]; col++)
+                  optr[col] <<= img_dat->point_trans[i];
+            }
          }
       }
 
@@ -245,17 +476,152 @@ int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
       ret = getc_ushort(&marker, &cbufptr, ebufptr);
       if(ret){
          free_HUFF_TABLES(huf_table, MAX_CMPNTS);
-         free_IMG_DAT(img_dat, FREE_IMAGE);
+         free_IMG_DAT(img_dat, free_flag);
          return(ret);
       }
    }
 
+   free_HUFF_TABLES(huf_table, MAX_CMPNTS);
    *oimg_dat = img_dat;
    *lossyflag = 0;
 
    return(0);
 }
 
+/******************/
+/*Start of Decoder*/
+/******************/
+int jpegl_decode_mem(IMG_DAT **oimg_dat, int *lossyflag,
+                     unsigned char *idata, const int ilen)
+{
+   return(decode_jpegl(oimg_dat, lossyflag, (unsigned char *)NULL, 0, 0,
+                       idata, ilen, 1));
+}
+
+/*****************************************************************/
+/* Decodes as jpegl_decode_mem does, decoding the restart        */
+/* intervals of each scan on up to "nthreads" threads.  Scans    */
+/* without restart intervals are decoded on the calling thread.  */
+/* Restart intervals must hold whole rows.                       */
+/*****************************************************************/
+int jpegl_decode_mem_mt(IMG_DAT **oimg_dat, int *lossyflag,
+                     unsigned char *idata, const int ilen, const int nthreads)
+{
+   return(decode_jpegl(oimg_dat, lossyflag, (unsigned char *)NULL, 0, 0,
+                       idata, ilen, nthreads));
+}
+
+/*****************************************************************/
+/* Decodes a JPEGL datastream straight into the "osize" byte     */
+/* buffer "obuf", which is not reallocated.  Component planes    */
+/* follow one another with rows "ostride" bytes apart, or packed */
+/* if "ostride" is 0, in which case the buffer matches what      */
+/* get_IMG_DAT_image returns.  The size needed may be found      */
+/* beforehand with jpegl_probe_mem.                              */
+/*****************************************************************/
+int jpegl_decode_mem_into(unsigned char *obuf, const int ostride,
+                     const int osize, int *ow, int *oh, int *od, int *oppi,
+                     int *lossyflag, unsigned char *idata, const int ilen)
+{
+   int ret;
+   IMG_DAT *img_dat;
+
+   if(obuf == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : jpegl_decode_mem_into : NULL buffer\n");
+      return(-5);
+   }
+
+   ret = decode_jpegl(&img_dat, lossyflag, obuf, ostride, osize,
+                      idata, ilen, 1);
+   if(ret)
+      return(ret);
+
+   *ow = img_dat->max_width;
+   *oh = img_dat->max_height;
+   *od = img_dat->pix_depth;
+   *oppi = img_dat->ppi;
+   free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+
+   return(0);
+}
+
+/*****************************************************************/
+/* Reads only the headers of a JPEGL datastream, returning the   */
+/* image attributes and, in "osize", the bytes a buffer passed   */
+/* to jpegl_decode_mem_into with the same "ostride" must hold.   */
+/* Tables are stepped over by their lengths.                     */
+/*****************************************************************/
+int jpegl_probe_mem(int *ow, int *oh, int *od, int *oppi, int *osize,
+                     const int ostride, unsigned char *idata,
+                     const int ilen)
+{
+   int ret, ppi, size;
+   int pitch[MAX_CMPNTS], offset[MAX_CMPNTS];
+   unsigned short marker, len;
+   unsigned char *cbufptr, *ebufptr;
+   JFIF_HEADER *jfif_header;
+   FRM_HEADER_JPEGL *frm_header;
+   IMG_DAT *img_dat;
+
+   cbufptr = idata;
+   ebufptr = idata + ilen;
+
+   ret = getc_marker_jpegl(&marker, SOI, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = getc_marker_jpegl(&marker, APP0, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = getc_jfif_header(&jfif_header, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = get_ppi_jpegl(&ppi, jfif_header);
+   free(jfif_header);
+   if(ret)
+      return(ret);
+
+   ret = getc_marker_jpegl(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   while(marker != SOF3){
+      ret = getc_ushort(&len, &cbufptr, ebufptr);
+      if(ret)
+         return(ret);
+      if(len < 2 || len - 2 > ebufptr - cbufptr){
+         fprintf(stderr, "ERROR : jpegl_probe_mem : ");
+         fprintf(stderr, "table segment of length %d runs past data\n", len);
+         return(-6);
+      }
+      cbufptr += len - 2;
+      ret = getc_marker_jpegl(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+      if(ret)
+         return(ret);
+   }
+
+   ret = getc_frame_header_jpegl(&frm_header, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = setup_IMG_DAT_decode(&img_dat, ppi, frm_header);
+   free(frm_header);
+   if(ret)
+      return(ret);
+
+   ret = layout_jpegl_planes(img_dat, ostride, pitch, offset, &size);
+   if(ret){
+      free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+      return(ret);
+   }
+
+   *ow = img_dat->max_width;
+   *oh = img_dat->max_height;
+   *od = img_dat->pix_depth;
+   *oppi = img_dat->ppi;
+   *osize = size;
+   free_IMG_DAT(img_dat, NO_FREE_IMAGE);
+
+   return(0);
+}
+
 /***************************************************/
 /*Routine to build code table for difference values*/
 /***************************************************/
@@ -427,3 +793,200 @@ int getc_nextbits_jpegl(unsigned short *obits, unsigned char **cbufptr,
    *obits = bits;
    return(0);
 }
+
+/*****************************************************************/
+/* Routine to build the lookup table used to decode difference   */
+/* values coded with "huf_table".  Categories too large for the  */
+/* decoder are left to the search, which reports them.           */
+/*****************************************************************/
+void gen_hdec_table_jpegl(HDEC_TABLE_JPEGL *hdec, HUF_TABLE *huf_table)
+{
+   int j, size, shift, first, count;
+   int code, cat, extra;
+
+   hdec->maxcode = huf_table->maxcode;
+   hdec->mincode = huf_table->mincode;
+   hdec->valptr = huf_table->valptr;
+   hdec->huffvalues = huf_table->values;
+
+   memset(hdec->look_size, 0, sizeof(hdec->look_size));
+   memset(hdec->look_nbits, 0, sizeof(hdec->look_nbits));
+
+   for(size = 1; size <= JPEGL_HUFF_LOOKAHEAD; size++) {
+      if(hdec->maxcode[size] < 0)
+         continue;
+      shift = JPEGL_HUFF_LOOKAHEAD - size;
+      for(code = hdec->mincode[size]; code <= hdec->maxcode[size]; code++) {
+         cat = hdec->huffvalues[hdec->valptr[size] + code -
+                                hdec->mincode[size]];
+         if(cat >= MAX_CATEGORY)
+            continue;
+         first = code << shift;
+         count = 1 << shift;
+         for(j = first; j < first + count; j++) {
+            hdec->look_size[j] = (unsigned char)size;
+            hdec->look_cat[j] = (unsigned char)cat;
+            if(size + cat > JPEGL_HUFF_LOOKAHEAD)
+               continue;
+            /* The extra bits follow the code in the lookahead. */
+            extra = (j >> (shift - cat)) & ((1 << cat) - 1);
+            if(cat != 0 && extra < (1 << (cat - 1)))
+               extra -= (1 << cat) - 1;
+            hdec->look_nbits[j] = (unsigned char)(size + cat);
+            hdec->look_diff[j] = (short)extra;
+         }
+      }
+   }
+}
+
+/*****************************************************************/
+/* Routine to load bytes from a memory buffer into a bit         */
+/* reservoir until it holds more than 56 bits, the buffer is     */
+/* exhausted, or a marker is found.  The marker is left unread.  */
+/*****************************************************************/
+void fill_bitbuf_jpegl(BITBUF_JPEGL *bitbuf, unsigned char **cbufptr,
+                       unsigned char *ebufptr)
+{
+   unsigned char *cptr;
+   unsigned int code;
+
+   cptr = *cbufptr;
+   while(bitbuf->nbits <= 56 && cptr < ebufptr) {
+      code = *cptr;
+      if(code == 0xFF) {
+         if(cptr + 1 >= ebufptr)
+            break;
+         if(*(cptr+1) != 0x00) {
+            bitbuf->marker = 1;
+            break;
+         }
+         /* Skip the stuffed zero. */
+         cptr += 2;
+      }
+      else
+         cptr++;
+      bitbuf->bits |= (unsigned long long)code << (56 - bitbuf->nbits);
+      bitbuf->nbits += 8;
+   }
+   *cbufptr = cptr;
+}
+
+/*****************************************************************/
+/* Routine to step "cbufptr" back over the whole bytes still in  */
+/* a bit reservoir, leaving it just past the last byte that was  */
+/* decoded from, as reading the data a bit at a time would.  A   */
+/* zero preceded by 0xFF is always a stuffed byte, so the data   */
+/* can be walked backwards, never past "sbufptr".                */
+/*****************************************************************/
+void unget_bitbuf_jpegl(BITBUF_JPEGL *bitbuf, unsigned char **cbufptr,
+                        unsigned char *sbufptr)
+{
+   unsigned char *cptr;
+   int nbytes;
+
+   cptr = *cbufptr;
+   for(nbytes = bitbuf->nbits / BITSPERBYTE;
+       nbytes > 0 && cptr > sbufptr; nbytes--) {
+      if(cptr - sbufptr >= 2 && *(cptr-1) == 0x00 && *(cptr-2) == 0xFF)
+         cptr -= 2;
+      else
+         cptr--;
+   }
+   *cbufptr = cptr;
+
+   bitbuf->bits = 0;
+   bitbuf->nbits = 0;
+   bitbuf->marker = 0;
+}
+
+/*****************************************************************/
+/* Routine to decode "width" difference values into "odiff".     */
+/* Each code and its extra bits are taken from the reservoir     */
+/* together, most with a single lookup.                          */
+/*****************************************************************/
+int getc_diff_row_jpegl(short *odiff, const int width,
+                        HDEC_TABLE_JPEGL *hdec, BITBUF_JPEGL *bitbuf,
+                        unsigned char **cbufptr, unsigned char *ebufptr)
+{
+   int x, look, size, cat, code, extra;
+   unsigned long long bits;
+   int nbits;
+
+   bits = bitbuf->bits;
+   nbits = bitbuf->nbits;
+   for(x = 0; x < width; x++) {
+      /* A code and its extra bits take at most 25 bits. */
+      if(nbits < 32) {
+         bitbuf->bits = bits;
+         bitbuf->nbits = nbits;
+         fill_bitbuf_jpegl(bitbuf, cbufptr, ebufptr);
+         bits = bitbuf->bits;
+         nbits = bitbuf->nbits;
+      }
+
+      look = (int)(bits >> (64 - JPEGL_HUFF_LOOKAHEAD));
+      size = hdec->look_nbits[look];
+      if(size != 0 && size <= nbits) {
+         bits <<= size;
+         nbits -= size;
+         odiff[x] = hdec->look_diff[look];
+         continue;
+      }
+
+      size = hdec->look_size[look];
+      if(size != 0 && size <= nbits)
+         cat = hdec->look_cat[look];
+      else {
+         /* Long code, or fewer bits remain than the lookahead. */
+         for(size = 1; size <= MAX_HUFFBITS && size <= nbits; size++) {
+            code = (int)(bits >> (64 - size));
+            if(code <= hdec->maxcode[size])
+               break;
+         }
+         if(size > MAX_HUFFBITS) {
+            fprintf(stderr, "ERROR : getc_diff_row_jpegl : ");
+            fprintf(stderr, "invalid huffman code\n");
+            return(-8);
+         }
+         if(size > nbits)
+            break;
+         cat = hdec->huffvalues[hdec->valptr[size] + code -
+                                hdec->mincode[size]];
+         if(cat >= MAX_CATEGORY) {
+            fprintf(stderr, "ERROR : getc_diff_row_jpegl : ");
+            fprintf(stderr, "invalid difference category %d\n", cat);
+            return(-8);
+         }
+      }
+      if(size + cat > nbits)
+         break;
+      bits <<= size;
+      nbits -= size;
+
+      /* Extend the extra bits to the full difference value. */
+      if(cat == 0)
+         extra = 0;
+      else {
+         extra = (int)(bits >> (64 - cat));
+         bits <<= cat;
+         nbits -= cat;
+         if(extra < (1 << (cat - 1)))
+            extra -= (1 << cat) - 1;
+      }
+      odiff[x] = (short)extra;
+   }
+
+   bitbuf->bits = bits;
+   bitbuf->nbits = nbits;
+   if(x < width) {
+      if(bitbuf->marker) {
+         fprintf(stderr, "ERROR: getc_diff_row_jpegl : no stuffed zeros\n");
+         return(-2);
+      }
+      fprintf(stderr, "ERROR : getc_diff_row_jpegl : ");
+      fprintf(stderr, "premature end of buffer\n");
+      return(-9);
+   }
+
+   return(0);
+}
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/param.h>
 #include <jpegl.h>
 #include <intrlv.h>
@@ -26,7 +27,7 @@
 #include <ffpis/util/ioutil.h>
 #include <ffpis/util/util.h>
 
-void procargs(int, char **, char **, char **, int *, int *);
+void procargs(int, char **, char **, char **, int *, int *, int *);
 
 int debug = 0;
 
@@ -48,15 +49,16 @@ int main(int argc, char *argv[])
    int lossyflag;                 /* data loss flag */
    NISTCOM *nistcom;              /* NIST Comment */
    int force_raw;
+   int nthreads;                  /* decoder threads */
 
 
-   procargs(argc, argv, &outext, &ifile, &rawflag, &intrlvflag);
+   procargs(argc, argv, &outext, &ifile, &rawflag, &intrlvflag, &nthreads);
 
    ret = read_raw_from_filesize(ifile, &idata, &ilen);
    if(ret)
       exit(ret);
 
-   ret = jpegl_decode_mem(&img_dat, &lossyflag, idata, ilen);
+   ret = jpegl_decode_mem_mt(&img_dat, &lossyflag, idata, ilen, nthreads);
    if(ret){
       free(idata);
       exit(ret);
@@ -195,13 +197,32 @@ void print_usage(const char *arg0)
 {
    fprintf(stderr, "Usage: %s <outext> <image file>\n", arg0);
    fprintf(stderr, "               [-raw_out [-nonintrlv]]\n");
+   fprintf(stderr, "               [-threads n]\n");
 }
 
 /*****************************************************************/
 void procargs(int argc, char **argv, char **outext, char **ifile,
-              int *rawflag, int *intrlvflag)
+              int *rawflag, int *intrlvflag, int *nthreads)
 {
    int argi;
+   long ncpus;
+
+   /* Trailing "-threads n" decodes up to n restart intervals at */
+   /* once, where 0 uses every online processor.                */
+   *nthreads = 1;
+   if((argc > 4) && (strncmp(argv[argc-2], "-t", 2) == 0)){
+      if(sscanf(argv[argc-1], "%d", nthreads) != 1 || *nthreads < 0){
+         print_usage(argv[0]);
+         fprintf(stderr, "       invalid count \"%s\" for %s\n",
+                 argv[argc-1], argv[argc-2]);
+         exit(-1);
+      }
+      if(*nthreads == 0){
+         ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+         *nthreads = (ncpus > 0) ? (int)ncpus : 1;
+      }
+      argc -= 2;
+   }
 
    if((argc < 3) || (argc > 5)){
       print_usage(argv[0]);
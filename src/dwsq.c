@@ -16,6 +16,10 @@
 #cat:        This is an implementation based on the Crinimal Justice
 #cat:        Information Services (CJIS) document "WSQ Gray-scale
 #cat:        Fingerprint Compression Specification", Dec. 1997.
+#cat:        Given "-fixed", the pixmap is reconstructed in fixed point
+#cat:        integer arithmetic, giving the same pixels on every machine.
+#cat:        Given "-batch n", the image file names a list file or a
+#cat:        directory whose images are all decoded by n workers.
 
 *************************************************************************/
 
@@ -23,13 +27,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
+#include <unistd.h>
 #include <wsq.h>
 #include <ihead.h>
 #include <ffpis/util/ioutil.h>
 #include <img_io.h>
+#include <batch.h>
 #include <ffpis/util/util.h>
 
-void procargs(int , char **, char **, char **, int *);
+/* Settings shared by every image decoded. */
+typedef struct dwsq_args {
+   char *outext;            /* ouput file extension */
+   int rawflag;             /* raw input data or Ihead image */
+   int fixedflag;           /* fixed point reconstruction */
+   WSQ_CTX **ctxs;          /* decoder working state of each worker */
+} DWSQ_ARGS;
+
+void procargs(int , char **, char **, char **, int *, int *, int *);
+int decode_dwsq_image(unsigned char *, const int, char *, DWSQ_ARGS *,
+                      WSQ_CTX *, int *);
+int load_dwsq_item(BATCH_ITEM *, void *);
+int run_dwsq_item(BATCH_ITEM *, const int, void *);
 
 int debug = 0; 
 
@@ -38,43 +56,131 @@ int debug = 0;
 /******************/
 
 int main( int argc, char **argv)
+{
+   int ret, i;
+   char *ifile;                   /* file names */
+   int ilen, olen;
+   unsigned char *idata;          /* image pointers */
+   DWSQ_ARGS args;
+   int nworkers;                  /* batch workers, 0 for a single image */
+   WSQ_CTX *ctx;
+   char **files;
+   int nfiles;
+   BATCH_STATS stats;
+   long hits, misses;             /* tree cache counters */
+   int nsizes;
+
+   procargs(argc, argv, &args.outext, &ifile, &args.rawflag, &args.fixedflag,
+            &nworkers);
+
+   if(nworkers == 0){
+      ret = read_raw_from_filesize(ifile, &idata, &ilen);
+      if(ret)
+         exit(ret);
+
+      ret = alloc_WSQ_CTX(&ctx);
+      if(ret){
+         free(idata);
+         exit(ret);
+      }
+      ctx->fixed = args.fixedflag;
+      ret = decode_dwsq_image(idata, ilen, ifile, &args, ctx, &olen);
+      free_WSQ_CTX(ctx);
+      exit(ret);
+   }
+
+   /* Batch of images, each worker with its own context. */
+   ret = read_batch_list(&files, &nfiles, ifile);
+   if(ret)
+      exit(ret);
+
+   args.ctxs = (WSQ_CTX **)calloc(nworkers, sizeof(WSQ_CTX *));
+   if(args.ctxs == (WSQ_CTX **)NULL){
+      fprintf(stderr, "ERROR : main : calloc : ctxs\n");
+      ret = -2;
+   }
+   for(i = 0; !ret && i < nworkers; i++){
+      ret = alloc_WSQ_CTX(&args.ctxs[i]);
+      if(!ret)
+         args.ctxs[i]->fixed = args.fixedflag;
+   }
+
+   if(!ret){
+      /* Most batches hold a few common scan sizes. */
+      preload_wsq_trees((int *)NULL, 0);
+      ret = run_batch(files, nfiles, nworkers, load_dwsq_item,
+                      run_dwsq_item, &args, &stats);
+      if(!ret){
+         print_batch_stats(stdout, &stats);
+         get_wsq_tree_cache_stats(&hits, &misses, &nsizes);
+         fprintf(stdout, "%ld of %ld tree lookups cached, %d image sizes\n",
+                 hits, hits + misses, nsizes);
+         if(stats.nfailed)
+            ret = -1;
+      }
+   }
+
+   if(args.ctxs != (WSQ_CTX **)NULL){
+      for(i = 0; i < nworkers; i++)
+         free_WSQ_CTX(args.ctxs[i]);
+      free(args.ctxs);
+   }
+   free_batch_list(files, nfiles);
+
+   exit(ret);
+}
+
+/*****************************************************************/
+/* Decodes a WSQ datastream, writing the pixmap and its NISTCOM  */
+/* next to the input file.  The datastream is freed.             */
+/*****************************************************************/
+int decode_dwsq_image(unsigned char *idata, const int ilen, char *ifile,
+                      DWSQ_ARGS *args, WSQ_CTX *ctx, int *olen)
 {
    int ret;
-   int rawflag;                   /* raw input data or Ihead image */
-   char *outext;                  /* ouput file extension */
-   char *ifile, ofile[MAXPATHLEN];  /* file names */
-   int ilen;
+   char ofile[MAXPATHLEN], iroot[MAXPATHLEN];  /* file names */
    int width, height;             /* image parameters */
    int depth, ppi;
-   unsigned char *idata, *odata;  /* image pointers */
+   unsigned char *odata;          /* image pointers */
    int lossyflag;                 /* data loss flag */
    NISTCOM *nistcom;              /* NIST Comment */
    char *ppi_str;
 
-
-   procargs(argc, argv, &outext, &ifile, &rawflag);
-
-   ret = read_raw_from_filesize(ifile, &idata, &ilen);
-   if(ret)
-      exit(ret);
-
-   ret = wsq_decode_mem(&odata, &width, &height, &depth, &ppi, &lossyflag, idata, ilen);
+   ret = wsq_decode_mem_ctx(ctx, &odata, &width, &height, &depth, &ppi,
+                            &lossyflag, idata, ilen);
    if(ret){
       free(idata);
-      exit(ret);
+      return(ret);
    }
 
    if(debug > 1)
       fprintf(stderr, "Image pixmap constructed\n");
 
-   fileroot(ifile);
-   sprintf(ofile, "%s.%s", ifile, NCM_EXT);
+   if(strlen(ifile) + strlen(args->outext) + strlen(NCM_EXT) + 2
+      > MAXPATHLEN){
+      fprintf(stderr, "ERROR : decode_dwsq_image : name too long : %s\n",
+              ifile);
+      free(idata);
+      free(odata);
+      return(-3);
+   }
+   strcpy(iroot, ifile);
+   fileroot(iroot);
+   if(snprintf(ofile, sizeof(ofile), "%s.%s", iroot, NCM_EXT)
+      >= (int)sizeof(ofile)){
+      fprintf(stderr, "ERROR : decode_dwsq_image : name too long : %s\n",
+              ifile);
+      free(idata);
+      free(odata);
+      return(-3);
+   }
 
    /* Get NISTCOM from compressed data file */
    ret = getc_nistcom_wsq(&nistcom, idata, ilen);
    if(ret){
       free(idata);
-      exit(ret);
+      free(odata);
+      return(ret);
    }
    free(idata);
    /* WSQ decoder always returns ppi=-1, so believe PPI in NISTCOM, */
@@ -85,7 +191,7 @@ int main( int argc, char **argv)
       if(ret){
          free(odata);
          freefet(nistcom);
-         exit(ret);
+         return(ret);
       }
    }
    if(ppi_str != (char *)NULL){
@@ -100,13 +206,13 @@ int main( int argc, char **argv)
      free(odata);
      if(nistcom != (NISTCOM *)NULL)
         freefet(nistcom);
-     exit(ret);
+     return(ret);
    }
    ret = del_wsq_nistcom(nistcom);
    if(ret){
      free(odata);
      freefet(nistcom);
-     exit(ret);
+     return(ret);
    }
 
    /* Write NISTCOM */
@@ -114,46 +220,113 @@ int main( int argc, char **argv)
    if(ret){
      free(odata);
      freefet(nistcom);
-     exit(ret);
+     return(ret);
    }
    freefet(nistcom);
 
    /* Write decoded image file. */
-   sprintf(ofile, "%s.%s", ifile, outext);
-   ret = write_raw_or_ihead(!rawflag, ofile, odata, width, height, depth, ppi);
-   if(ret){
+   if(snprintf(ofile, sizeof(ofile), "%s.%s", iroot, args->outext)
+      >= (int)sizeof(ofile)){
+      fprintf(stderr, "ERROR : decode_dwsq_image : name too long : %s\n",
+              ifile);
       free(odata);
-      exit(ret);
+      return(-3);
    }
+   ret = write_raw_or_ihead(!args->rawflag, ofile, odata, width, height,
+                            depth, ppi);
    free(odata);
+   if(ret)
+      return(ret);
+
+   *olen = width * height * (depth / 8);
 
    if(debug > 1)
       fprintf(stdout, "Image pixmap written to %s\n", ofile);
 
-   exit(0);
+   return(0);
+}
+
+/*****************************************************************/
+/* Batch read-ahead of one WSQ file.                             */
+/*****************************************************************/
+int load_dwsq_item(BATCH_ITEM *item, void *arg)
+{
+   int ret;
+   unsigned char *idata;
+
+   (void)arg;
+   ret = read_raw_from_filesize(item->ifile, &idata, &item->ilen);
+   if(ret)
+      return(ret);
+   item->data = idata;
+   return(0);
+}
+
+/*****************************************************************/
+/* Batch decoding of one WSQ file already read.                  */
+/*****************************************************************/
+int run_dwsq_item(BATCH_ITEM *item, const int worker, void *arg)
+{
+   int ret;
+   DWSQ_ARGS *args = (DWSQ_ARGS *)arg;
+
+   ret = decode_dwsq_image((unsigned char *)item->data, item->ilen,
+                           item->ifile, args, args->ctxs[worker],
+                           &item->olen);
+   item->data = NULL;
+   return(ret);
 }
 
 /*****************************************************************/
-void procargs(int argc, char **argv, char **outext, char **ifile, int *rawflag)
+void procargs(int argc, char **argv, char **outext, char **ifile, int *rawflag,
+              int *fixedflag, int *nworkers)
 {
-   if((argc < 3) || (argc > 4)){
-      fprintf(stderr, "Usage: %s <outext> <image file> [-raw_out]\n", argv[0]);
+   long ncpus;
+   int i;
+
+   /* A trailing "-batch n" decodes a list file or directory of */
+   /* images with n workers, where 0 uses every processor.      */
+   *nworkers = 0;
+   if((argc > 4) && (strncmp(argv[argc-2], "-b", 2) == 0)){
+      if(sscanf(argv[argc-1], "%d", nworkers) != 1 || *nworkers < 0){
+         fprintf(stderr,
+                 "Usage: %s <outext> <image file> [-raw_out] [-fixed]"
+                 " [-batch n]\n", argv[0]);
+         fprintf(stderr, "       invalid worker count \"%s\"\n",
+                 argv[argc-1]);
+         exit(-1);
+      }
+      if(*nworkers == 0){
+         ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+         *nworkers = (ncpus > 0) ? (int)ncpus : 1;
+      }
+      argc -= 2;
+   }
+
+   if((argc < 3) || (argc > 5)){
+      fprintf(stderr,
+              "Usage: %s <outext> <image file> [-raw_out] [-fixed]"
+              " [-batch n]\n", argv[0]);
       exit(-1);
    }
 
    *rawflag = 0;
+   *fixedflag = 0;
    *outext = argv[1];
    *ifile = argv[2];
-
-   if(argc == 4){
+   for(i = 3; i < argc; i++){
       /* If rawflag ... */
-      if(strncmp(argv[3], "-r", 2) == 0)
+      if(strncmp(argv[i], "-r", 2) == 0)
          *rawflag = 1;
+      else if(strncmp(argv[i], "-f", 2) == 0)
+         *fixedflag = 1;
       else{
          fprintf(stderr,
-                 "Usage: %s <outext> <image file> [-raw_out]\n", argv[0]);
+                 "Usage: %s <outext> <image file> [-raw_out] [-fixed]"
+                 " [-batch n]\n", argv[0]);
          fprintf(stderr,
-                 "       invalid arg 3, expected \"-raw_out\" option\n");
+                 "       invalid arg %d, expected \"-raw_out\" or \"-fixed\"\n",
+                 i);
          exit(-1);
       }
    }
@@ -164,7 +337,7 @@ void procargs(int argc, char **argv, char **outext, char **ifile, int *rawflag)
 
 void print_usage(const char *prog)
 {
-	const char utxt[]="Usage: %s <outext> <image file> [-raw_out]\n";
+	const char utxt[]="Usage: %s <outext> <image file> [-raw_out] [-fixed] [-batch n]\n";
 	fprintf(stderr,utxt,prog);
 	exit(-1);
 }
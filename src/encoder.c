@@ -12,10 +12,18 @@
       ROUTINES:
 #cat: jpegl_encode_mem - JPEGL encodes image data storing the compressed
 #cat:                    bytes to a memory buffer.
+#cat: jpegl_encode_mem_mt - JPEGL encodes image data, coding its components
+#cat:                    on parallel threads.
+#cat: jpegl_encode_mem_restart - JPEGL encodes image data, splitting each
+#cat:                    scan into restart intervals of whole rows.
 #cat: gen_diff_freqs - Computes pixel differences and their fequency.
 #cat:
+#cat: gen_cmpnt_diff_freqs - Computes the pixel differences of one
+#cat:                    component and their frequency.
 #cat: compress_image_intrlv - Compresses difference values from
 #cat:                    non-interleaved image data.
+#cat: compress_cmpnt_non_intrlv - Compresses the difference values of one
+#cat:                    component.
 #cat: code_diff - Huffman encodes difference values.
 #cat:
 
@@ -23,14 +31,60 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <jpegl.h>
+#include <wsq.h>
 #include <dataio.h>
+#include <codecmem.h>
+
+/* Components being coded on their own threads.  Each is coded into */
+/* its own buffer; the scans are joined in component order after.   */
+typedef struct jpegl_cmpnt_jobs {
+   IMG_DAT *img_dat;
+   HUF_TABLE *huf_table[MAX_CMPNTS];
+   unsigned char *buf[MAX_CMPNTS];
+   int len[MAX_CMPNTS];
+   int alloc;        /* bytes in each buffer */
+   int restart_rows; /* rows per restart interval, or 0 */
+} JPEGL_CMPNT_JOBS;
+
+static int flush_bits_jpegl(unsigned long long, const int, unsigned char *,
+                            const int, int *);
+static int encode_cmpnt_job(void *, const int);
+static int encode_cmpnts_mt(IMG_DAT *, unsigned char *, const int, int *,
+                            const int, const int);
 
 /******************/
 /*Start of Encoder*/
 /******************/
 int jpegl_encode_mem(unsigned char **odata, int *olen, IMG_DAT *img_dat,
                      char *comment_text)
+{
+   return(jpegl_encode_mem_mt(odata, olen, img_dat, comment_text, 1));
+}
+
+/*****************************************************************/
+/* Encodes as jpegl_encode_mem does, coding the components of a  */
+/* multi-component image on up to "nthreads" threads.  Each has  */
+/* its own huffman table and scan, so the datastream is the same */
+/* however many threads are used.                                */
+/*****************************************************************/
+int jpegl_encode_mem_mt(unsigned char **odata, int *olen, IMG_DAT *img_dat,
+                        char *comment_text, const int nthreads)
+{
+   return(jpegl_encode_mem_restart(odata, olen, img_dat, comment_text, 0,
+                                   nthreads));
+}
+
+/*****************************************************************/
+/* Encodes as jpegl_encode_mem_mt does, splitting the scan of    */
+/* each component into restart intervals of "restart_rows" rows, */
+/* each ended by an RSTn marker, so they can be decoded apart.   */
+/* With "restart_rows" of 0 the scans are not split.             */
+/*****************************************************************/
+int jpegl_encode_mem_restart(unsigned char **odata, int *olen,
+                        IMG_DAT *img_dat, char *comment_text,
+                        const int restart_rows, const int nthreads)
 {
    int ret, i;
    HUF_TABLE *huf_table[MAX_CMPNTS];
@@ -113,27 +167,44 @@ int jpegl_encode_mem(unsigned char **odata, int *olen, IMG_DAT *img_dat,
    }
    free(frm_header);
 
-   ret = gen_diff_freqs(img_dat, huf_table);
-   if(ret){
-      free(outbuf);
-      return(ret);
+   if((nthreads > 1) && (img_dat->n_cmpnts > 1)){
+      ret = encode_cmpnts_mt(img_dat, outbuf, outalloc, &outlen, nthreads,
+                             restart_rows);
+      if(ret){
+         free(outbuf);
+         return(ret);
+      }
    }
+   else{
+      for(i = 0; i < img_dat->n_cmpnts; i++)
+         huf_table[i] = (HUF_TABLE *)NULL;
+      for(i = 0; i < img_dat->n_cmpnts; i++){
+         ret = gen_cmpnt_diff_freqs(img_dat, huf_table, i, restart_rows);
+         if(ret){
+            free(outbuf);
+            free_HUFF_TABLES(huf_table, i);
+            return(ret);
+         }
+      }
 
-   ret = gen_huff_tables(huf_table, img_dat->n_cmpnts);
-   if(ret){
-      free(outbuf);
-      free_HUFF_TABLES(huf_table, img_dat->n_cmpnts);
-      return(ret);
-   }
+      ret = gen_huff_tables(huf_table, img_dat->n_cmpnts);
+      if(ret){
+         free(outbuf);
+         free_HUFF_TABLES(huf_table, img_dat->n_cmpnts);
+         return(ret);
+      }
 
-   ret = compress_image_non_intrlv(img_dat, huf_table,
-		   outbuf, outalloc, &outlen);
-   if(ret){
-      free(outbuf);
+      for(i = 0; i < img_dat->n_cmpnts; i++){
+         ret = compress_cmpnt_non_intrlv(img_dat, huf_table, i,
+                         restart_rows, outbuf, outalloc, &outlen);
+         if(ret){
+            free(outbuf);
+            free_HUFF_TABLES(huf_table, img_dat->n_cmpnts);
+            return(ret);
+         }
+      }
       free_HUFF_TABLES(huf_table, img_dat->n_cmpnts);
-      return(ret);
    }
-   free_HUFF_TABLES(huf_table, img_dat->n_cmpnts);
 
    ret = putc_ushort(EOI, outbuf, outalloc, &outlen);
    if(ret){
@@ -146,17 +217,83 @@ int jpegl_encode_mem(unsigned char **odata, int *olen, IMG_DAT *img_dat,
    return(0);
 }
 
+/*****************************************************************/
+/* Predicts, counts and codes component "i" into its own buffer. */
+/*****************************************************************/
+static int encode_cmpnt_job(void *arg, const int i)
+{
+   JPEGL_CMPNT_JOBS *jobs = (JPEGL_CMPNT_JOBS *)arg;
+   int ret;
+
+   ret = gen_cmpnt_diff_freqs(jobs->img_dat, jobs->huf_table, i,
+                              jobs->restart_rows);
+   if(ret)
+      return(ret);
+
+   ret = gen_huff_table(jobs->huf_table[i], MIN_HUFFTABLE_ID + i);
+   if(ret)
+      return(ret);
+
+   jobs->buf[i] = (unsigned char *)codec_malloc(jobs->alloc);
+   if(jobs->buf[i] == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : encode_cmpnt_job : malloc : buf[%d]\n", i);
+      return(-3);
+   }
+
+   return(compress_cmpnt_non_intrlv(jobs->img_dat, jobs->huf_table, i,
+                                    jobs->restart_rows, jobs->buf[i],
+                                    jobs->alloc, &jobs->len[i]));
+}
+
+/*****************************************************************/
+/* Codes the components of "img_dat" on up to "nthreads" threads */
+/* and appends their tables and scans to "outbuf" in order.  So  */
+/* that the same images fit as when coding them one after       */
+/* another, each buffer is given all the room left in "outbuf".  */
+/*****************************************************************/
+static int encode_cmpnts_mt(IMG_DAT *img_dat, unsigned char *outbuf,
+                            const int outalloc, int *outlen,
+                            const int nthreads, const int restart_rows)
+{
+   JPEGL_CMPNT_JOBS jobs;
+   int ret, i;
+
+   jobs.img_dat = img_dat;
+   jobs.alloc = outalloc - *outlen;
+   jobs.restart_rows = restart_rows;
+   for(i = 0; i < MAX_CMPNTS; i++){
+      jobs.huf_table[i] = (HUF_TABLE *)NULL;
+      jobs.buf[i] = (unsigned char *)NULL;
+      jobs.len[i] = 0;
+   }
+
+   ret = wsq_run_jobs(nthreads, img_dat->n_cmpnts, encode_cmpnt_job, &jobs);
+
+   for(i = 0; i < img_dat->n_cmpnts && ret == 0; i++){
+      if((*outlen) + jobs.len[i] >= outalloc){
+         fprintf(stderr, "ERROR : encode_cmpnts_mt : ");
+         fprintf(stderr, "buffer overlow: alloc = %d, request = %d\n",
+                          outalloc, (*outlen) + jobs.len[i]);
+         ret = -4;
+         break;
+      }
+      memcpy(outbuf + (*outlen), jobs.buf[i], jobs.len[i]);
+      (*outlen) += jobs.len[i];
+   }
+
+   for(i = 0; i < img_dat->n_cmpnts; i++)
+      codec_free(jobs.buf[i]);
+   free_HUFF_TABLES(jobs.huf_table, img_dat->n_cmpnts);
+
+   return(ret);
+}
+
 /*****************************************/
 /*routine to obtain the pixel differences*/
 /*****************************************/
 int gen_diff_freqs(IMG_DAT *img_dat, HUF_TABLE **huf_table)
 {
-   int ret, i, pixel, np; /*current pixel and total number of pixels*/
-   short data_pred;       /*predicted pixel value*/
-   short *data_diff;      /*difference values*/
-   short diff_cat;        /*difference category*/
-   unsigned char *indata;
-   unsigned char p, Pt;
+   int ret, i;
 
    /* Need this initialization for deallocation of huf_table upon ERROR. */
    for(i = 0; i < img_dat->n_cmpnts; i++)
@@ -164,73 +301,110 @@ int gen_diff_freqs(IMG_DAT *img_dat, HUF_TABLE **huf_table)
 
    /* Foreach component ... */
    for(i = 0; i < img_dat->n_cmpnts; i++) {
-      np = (img_dat->samp_width[i] * img_dat->samp_height[i]);
-      /* Calloc inits all member addresses to NULL. */
-      huf_table[i] = (HUF_TABLE *)calloc(1, sizeof(HUF_TABLE));
-      if(huf_table[i] == (HUF_TABLE *)NULL){
-         fprintf(stderr, "ERROR : gen_diff_freqs : calloc : ");
-         fprintf(stderr, "huf_table[%d]\n", i);
+      ret = gen_cmpnt_diff_freqs(img_dat, huf_table, i, 0);
+      if(ret){
          free_HUFF_TABLES(huf_table, i);
-         return(-2);
-      }
-      huf_table[i]->freq = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1, sizeof(int));
-      if(huf_table[i]->freq == (int *)NULL){
-         fprintf(stderr, "ERROR : gen_diff_freqs : calloc : ");
-         fprintf(stderr, "huf_table[%d]->freq\n", i);
-         free_HUFF_TABLES(huf_table, i+1);
-         return(-3);
+         return(ret);
       }
+   }
 
-      huf_table[i]->freq[MAX_HUFFCOUNTS_JPEGL] = 1;
+   return(0);
+}
 
-      img_dat->diff[i] = (short *)malloc(np * sizeof(short));
-      if(img_dat->diff[i] == (short *)NULL){
-         fprintf(stderr, "ERROR : gen_diff_freqs : malloc : ");
-         fprintf(stderr, "img_dat->diff[%d]\n", i);
-         free_HUFF_TABLES(huf_table, i+1);
-         return(-4);
-      }
+/*************************************************************/
+/*Obtains the pixel differences of component "i" and their  */
+/*frequencies, allocating huf_table[i].  Prediction starts  */
+/*over every "restart_rows" rows, if not 0.  Components touch*/
+/*nothing of one another's, so they may be done in parallel. */
+/*On error huf_table[i] is left NULL.                        */
+/*************************************************************/
+int gen_cmpnt_diff_freqs(IMG_DAT *img_dat, HUF_TABLE **huf_table, const int i,
+                         const int restart_rows)
+{
+   int ret, pixel, np;    /*current pixel and total number of pixels*/
+   int row, x, width;     /*current row and column, and row length*/
+   short *data_diff;      /*difference values*/
+   short diff_cat;        /*difference category*/
+   unsigned char *indata;
+   unsigned char p, Pt;
 
-      /* If intrlv ... */
-      if(!(img_dat->intrlv)) {
-         Pt = img_dat->point_trans[i];
-         p = img_dat->predict[i];
-      }
-      /* Otherwise, nonintrlv ... */
-      else {
-         Pt = img_dat->point_trans[0];
-         p = img_dat->predict[0];
-      }
+   np = (img_dat->samp_width[i] * img_dat->samp_height[i]);
+   /* Calloc inits all member addresses to NULL. */
+   huf_table[i] = (HUF_TABLE *)codec_calloc(1, sizeof(HUF_TABLE));
+   if(huf_table[i] == (HUF_TABLE *)NULL){
+      fprintf(stderr, "ERROR : gen_diff_freqs : calloc : ");
+      fprintf(stderr, "huf_table[%d]\n", i);
+      return(-2);
+   }
+   huf_table[i]->freq = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1, sizeof(int));
+   if(huf_table[i]->freq == (int *)NULL){
+      fprintf(stderr, "ERROR : gen_diff_freqs : calloc : ");
+      fprintf(stderr, "huf_table[%d]->freq\n", i);
+      free_HUFF_TABLE(huf_table[i]);
+      huf_table[i] = (HUF_TABLE *)NULL;
+      return(-3);
+   }
 
-      /* Set pointer to next component plane origin. */
-      indata = img_dat->image[i];
-      data_diff = img_dat->diff[i];
-      for(pixel = 0; pixel < np; pixel++) {
-         *indata >>= Pt;
-	 ret = predict(&data_pred, indata, img_dat->samp_width[i],
-			 pixel, img_dat->cmpnt_depth, p, Pt);
-         if(ret){
-            free_HUFF_TABLES(huf_table, i+1);
-            return(ret);
-         }
-         *data_diff = ((short)*indata) - data_pred;
-         indata++;
-         diff_cat = categorize(*data_diff);
+   huf_table[i]->freq[MAX_HUFFCOUNTS_JPEGL] = 1;
+
+   img_dat->diff[i] = (short *)codec_malloc(np * sizeof(short));
+   if(img_dat->diff[i] == (short *)NULL){
+      fprintf(stderr, "ERROR : gen_diff_freqs : malloc : ");
+      fprintf(stderr, "img_dat->diff[%d]\n", i);
+      free_HUFF_TABLE(huf_table[i]);
+      huf_table[i] = (HUF_TABLE *)NULL;
+      return(-4);
+   }
+
+   /* If intrlv ... */
+   if(!(img_dat->intrlv)) {
+      Pt = img_dat->point_trans[i];
+      p = img_dat->predict[i];
+   }
+   /* Otherwise, nonintrlv ... */
+   else {
+      Pt = img_dat->point_trans[0];
+      p = img_dat->predict[0];
+   }
+
+   /* Set pointer to next component plane origin. */
+   indata = img_dat->image[i];
+   data_diff = img_dat->diff[i];
+   width = img_dat->samp_width[i];
+   /* Point transform and predict a row at a time; prediction only */
+   /* looks back to pixels already transformed.                    */
+   for(row = 0; row < img_dat->samp_height[i]; row++) {
+      if(Pt)
+         for(x = 0; x < width; x++)
+            indata[x] >>= Pt;
+      /* Prediction starts over at each restart interval. */
+      ret = predict_diff_row(data_diff, indata, width, width,
+                             (restart_rows > 0) ? row % restart_rows : row,
+                             img_dat->cmpnt_depth, p, Pt);
+      if(ret){
+         free_HUFF_TABLE(huf_table[i]);
+         huf_table[i] = (HUF_TABLE *)NULL;
+         return(ret);
+      }
+      for(x = 0; x < width; x++) {
+         diff_cat = categorize(data_diff[x]);
          if((diff_cat < 0) || (diff_cat > MAX_HUFFCOUNTS_JPEGL)){
             fprintf(stderr, "ERROR : gen_diff_freqs : ");
             fprintf(stderr, "Invalid code length = %d\n", diff_cat);
-            free_HUFF_TABLES(huf_table, i+1);
+            free_HUFF_TABLE(huf_table[i]);
+            huf_table[i] = (HUF_TABLE *)NULL;
             return(-5);
          }
          huf_table[i]->freq[diff_cat]++;
-         data_diff++;
       }
+      indata += width;
+      data_diff += width;
+   }
 
-      if(debug > 2){
-         for(pixel = 0; pixel < MAX_HUFFCOUNTS_JPEGL+1; pixel++)
-            fprintf(stdout, "freqs[%d] = %d\n", pixel,
-                    huf_table[i]->freq[pixel]);
-      }
+   if(debug > 2){
+      for(pixel = 0; pixel < MAX_HUFFCOUNTS_JPEGL+1; pixel++)
+         fprintf(stdout, "freqs[%d] = %d\n", pixel,
+                 huf_table[i]->freq[pixel]);
    }
 
    return(0);
@@ -241,124 +415,198 @@ int gen_diff_freqs(IMG_DAT *img_dat, HUF_TABLE **huf_table)
 /*********************************************/
 int compress_image_non_intrlv(IMG_DAT *img_dat, HUF_TABLE **huf_table,
              unsigned char *outbuf, const int outalloc, int *outlen)
+{
+   int ret, i;
+
+   for(i = 0; i < img_dat->n_cmpnts; i++) {
+      ret = compress_cmpnt_non_intrlv(img_dat, huf_table, i, 0,
+                                      outbuf, outalloc, outlen);
+      if(ret)
+         return(ret);
+   }
+
+   return(0);
+}
+
+/*************************************************************/
+/*Writes out the bits left in "acc" at the end of a scan or  */
+/*restart interval, padding the last byte with 1 bits.       */
+/*************************************************************/
+static int flush_bits_jpegl(unsigned long long acc, const int nacc,
+             unsigned char *outbuf, const int outalloc, int *outlen)
+{
+   unsigned char byte;
+
+   if(nacc > 0) {
+      byte = (unsigned char)((acc << (8 - nacc)) |
+                             ((1 << (8 - nacc)) - 1));
+      outbuf[*outlen] = byte;
+      if(byte == 0xff) {
+         (*outlen)++;
+         if((*outlen) >= outalloc){
+            fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
+            fprintf(stderr, "buffer overlow: ");
+            fprintf(stderr, "alloc = %d, request = %d\n",
+                             outalloc, *outlen);
+            return(-6);
+         }
+         outbuf[*outlen] = 0;
+      }
+      (*outlen)++;
+   }
+
+   return(0);
+}
+
+/*************************************************************/
+/*Writes the huffman table and scan of component "i",        */
+/*appending them to "outbuf".  If "restart_rows" is set,   */
+/*the scan is split into restart intervals of that many rows,*/
+/*each ended by an RSTn marker.                              */
+/*************************************************************/
+int compress_cmpnt_non_intrlv(IMG_DAT *img_dat, HUF_TABLE **huf_table,
+             const int i, const int restart_rows, unsigned char *outbuf,
+             const int outalloc, int *outlen)
 {
    int ret, size;       /*huffman code size*/
    unsigned int code;           /*huffman code*/
-   int i, i2, p, np; /*current pixel and total number of pixels*/
-   unsigned char bits;          /*bits to transfer*/
-   HUFFCODE *huff_encoder;
+   int p, np;                   /*current pixel and total number of pixels*/
+   unsigned char byte;          /*completed output byte*/
+   unsigned long long acc;      /*bits not yet written, last bit lowest*/
+   int nacc;                    /*number of bits in acc*/
+   int interval;                /*pixels per restart interval, or 0*/
+   int next_rst, nrst;          /*pixel ending the interval, and count*/
+   HUFFCODE *huff_encoder, *hptr;
    short *diffptr;
-   int outbit = FIRSTBIT;
    SCN_HEADER *scn_header;
-   unsigned char *outptr;
-
 
-   for(i = 0; i < img_dat->n_cmpnts; i++) {
-      ret = putc_huffman_table(DHT, huf_table[i]->table_id,
+   ret = putc_huffman_table(DHT, huf_table[i]->table_id,
 		      huf_table[i]->bits, huf_table[i]->values, outbuf,
 		      outalloc, outlen);
-      if(ret)
-         return(ret);
+   if(ret)
+      return(ret);
 
-      ret = setup_scan_header(&scn_header, img_dat, i);
-      if(ret)
-         return(ret);
+   np =(img_dat->samp_width[i] * img_dat->samp_height[i]);
 
-      ret = putc_scan_header(scn_header, outbuf, outalloc, outlen);
+   /* A restart interval holds whole rows.  It carries over to later */
+   /* scans, so one is written before each scan, 0 if not needed.   */
+   interval = 0;
+   if(restart_rows > 0){
+      if(restart_rows < img_dat->samp_height[i])
+         interval = restart_rows * img_dat->samp_width[i];
+      ret = putc_restart_interval(interval, outbuf, outalloc, outlen);
       if(ret)
          return(ret);
-      free(scn_header);
+   }
 
-      huff_encoder = (HUFFCODE *)calloc((LARGESTDIFF<<1)+1,
-                                        sizeof(HUFFCODE));
-      if(huff_encoder == (HUFFCODE *)NULL){
-         fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
-         fprintf(stderr, "calloc : huff_encoder[%d]\n", i);
-         return(-2);
-      }
+   ret = setup_scan_header(&scn_header, img_dat, i);
+   if(ret)
+      return(ret);
 
-      np =(img_dat->samp_width[i] * img_dat->samp_height[i]);
-      diffptr = img_dat->diff[i];
+   ret = putc_scan_header(scn_header, outbuf, outalloc, outlen);
+   if(ret)
+      return(ret);
+   free(scn_header);
 
-      if((*outlen) >= outalloc){
-         fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
-         fprintf(stderr, "buffer overlow: alloc = %d, request = %d\n",
-                          outalloc, *outlen);
-         free(huff_encoder);
-         return(-3);
-      }
-      outptr = outbuf + (*outlen);
-      *outptr = 0;
+   huff_encoder = (HUFFCODE *)codec_calloc((LARGESTDIFF<<1)+1,
+                                           sizeof(HUFFCODE));
+   if(huff_encoder == (HUFFCODE *)NULL){
+      fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
+      fprintf(stderr, "calloc : huff_encoder[%d]\n", i);
+      return(-2);
+   }
+
+   diffptr = img_dat->diff[i];
+
+   if((*outlen) >= outalloc){
+      fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
+      fprintf(stderr, "buffer overlow: alloc = %d, request = %d\n",
+                       outalloc, *outlen);
+      codec_free(huff_encoder);
+      return(-3);
+   }
 
-      for(p = 0; p < np; p++) {
-         ret = code_diff(huf_table[i]->huffcode_table,
-			 (huff_encoder + (*diffptr) + LARGESTDIFF),
-			 &size, &code, diffptr);
+   /* Codes are gathered in "acc" and written out a byte at a time, */
+   /* each 0xff byte followed by a stuffed 0x00.  There must always */
+   /* be room for the byte being filled.                            */
+   acc = 0;
+   nacc = 0;
+   next_rst = (interval > 0) ? interval : np;
+   nrst = 0;
+   for(p = 0; p < np; p++) {
+      /* End the interval and start the next after a restart marker. */
+      if(p == next_rst) {
+         ret = flush_bits_jpegl(acc, nacc, outbuf, outalloc, outlen);
          if(ret){
-            free(huff_encoder);
+            codec_free(huff_encoder);
             return(ret);
          }
-
-         diffptr++;
-
-         for(--size; size >= 0; size--) {
-            bits = ((unsigned char)((code >> size) & LSBITMASK));
-            if((bits & BITSET) != 0)
-               *outptr |= (BITSET << outbit);
-
-            if(--(outbit) < 0) {
-               if(*outptr == 0xff) {
-                  (*outlen)++;
-                  outptr++;
-                  if((*outlen) >= outalloc){
-                     fprintf(stderr, "ERROR : compress_image_intrlv : ");
-                     fprintf(stderr, "buffer overlow: ");
-                     fprintf(stderr, "alloc = %d, request = %d\n",
-                                      outalloc, *outlen);
-                     free(huff_encoder);
-                     return(-4);
-                  }
-                  *outptr = 0;
-               }
-               (*outlen)++;
-               outptr++;
-               if((*outlen) >= outalloc){
-                  fprintf(stderr, "ERROR : compress_image_intrlv : ");
-                  fprintf(stderr, "buffer overlow: ");
-                  fprintf(stderr, "alloc = %d, request = %d\n",
-                                   outalloc, *outlen);
-                  free(huff_encoder);
-                  return(-5);
-               }
-               *outptr = 0;
-               outbit = FIRSTBIT;
-            }
+         acc = 0;
+         nacc = 0;
+         ret = putc_ushort(RST0 + (nrst & 7), outbuf, outalloc, outlen);
+         if(ret == 0 && (*outlen) >= outalloc){
+            fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
+            fprintf(stderr, "buffer overlow: ");
+            fprintf(stderr, "alloc = %d, request = %d\n",
+                             outalloc, *outlen);
+            ret = -7;
+         }
+         if(ret){
+            codec_free(huff_encoder);
+            return(ret);
          }
+         next_rst += interval;
+         nrst++;
       }
-      free(huff_encoder);
 
-      /* Flush the Buffer */
-      if(outbit != FIRSTBIT) {
-         for(i2 = outbit; i2 >= 0; i2--)
-            *outptr |= (BITSET << i2);
-         if(*outptr == 0xff) {
+      hptr = huff_encoder + (*diffptr) + LARGESTDIFF;
+      if(hptr->size != 0) {
+         size = hptr->size;
+         code = hptr->code;
+      }
+      else {
+         ret = code_diff(huf_table[i]->huffcode_table, hptr,
+                         &size, &code, diffptr);
+         if(ret){
+            codec_free(huff_encoder);
+            return(ret);
+         }
+      }
+      diffptr++;
+
+      acc = (acc << size) | code;
+      nacc += size;
+      while(nacc >= 8) {
+         nacc -= 8;
+         byte = (unsigned char)(acc >> nacc);
+         outbuf[*outlen] = byte;
+         if(byte == 0xff) {
             (*outlen)++;
-            outptr++;
             if((*outlen) >= outalloc){
                fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
                fprintf(stderr, "buffer overlow: ");
                fprintf(stderr, "alloc = %d, request = %d\n",
                                 outalloc, *outlen);
-               return(-6);
+               codec_free(huff_encoder);
+               return(-4);
             }
-            *outptr = 0;
+            outbuf[*outlen] = 0;
          }
          (*outlen)++;
+         if((*outlen) >= outalloc){
+            fprintf(stderr, "ERROR : compress_image_non_intrlv : ");
+            fprintf(stderr, "buffer overlow: ");
+            fprintf(stderr, "alloc = %d, request = %d\n",
+                             outalloc, *outlen);
+            codec_free(huff_encoder);
+            return(-5);
+         }
       }
-      outbit = FIRSTBIT;
    }
+   codec_free(huff_encoder);
 
-   return(0);
+   /* Flush the Buffer, padding the last byte with 1 bits. */
+   return(flush_bits_jpegl(acc, nacc, outbuf, outalloc, outlen));
 }
 
 /*****************************************************************/
@@ -80,3 +80,33 @@ int findblob_stats_rw( unsigned char *ras, int w,int  h,int  *start_x,
 int findblob_stats_cl( unsigned char *ras, int w,int  h,int  *start_x,
 		int  *start_y, int *box_x,int  *box_y,int  *box_w,int  *box_h);
 void end_findblobs(void);
+
+/* One horizontal run of true pixels: x_on through x_off-1 of row y. */
+typedef struct blob_run {
+  int y;
+  int x_on, x_off;
+} BLOB_RUN;
+
+/* One connected component found by label_blobs. */
+typedef struct blob {
+  int box_x, box_y, box_w, box_h;  /* bounding box */
+  int npixels;                     /* true pixels in the blob */
+  int nruns;
+  BLOB_RUN *runs;                  /* the blob's runs, top to bottom */
+} BLOB;
+
+/* Every blob of a raster, in the order their first pixels are met in */
+/* a row-major scan.  The runs of all blobs share one allocation.     */
+typedef struct blob_list {
+  int nblobs;
+  BLOB *blobs;
+  int nruns;
+  BLOB_RUN *runs;
+} BLOB_LIST;
+
+/* Fewest rows worth handing to a labeling thread of their own. */
+#define BLOB_MIN_STRIPE_ROWS  64
+
+int label_blobs(BLOB_LIST **oblist, unsigned char *ras, const int w,
+		const int h, const int connectivity, const int nthreads);
+void free_BLOB_LIST(BLOB_LIST *blist);
@@ -3,15 +3,23 @@
 
       FILE:    GRP4COMP.C
       AUTHORS: CALS Test Network
-               
+
       DATE:    01/25/1990
 
       Contains routines responsible for CCITT Group 4 encoding
-      a binary image pixel datastream.
+      a binary image pixel datastream.  The state of an encode is
+      kept in a caller owned context, so that separate contexts may
+      encode images concurrently.
 
       ROUTINES:
 #cat: grp4comp - CCITT Group 4 compresses a binary image (bitmap).
 #cat:
+#cat: grp4comp_ctx - CCITT Group 4 compresses a binary image (bitmap)
+#cat:                into a bounded buffer, using an encoder context.
+#cat: alloc_G4_ENC_CTX - Allocates a Group 4 encoder context.
+#cat:
+#cat: free_G4_ENC_CTX - Deallocates a Group 4 encoder context and the
+#cat:                line buffers it owns.
 
 ***********************************************************************/
 
@@ -30,43 +38,133 @@
 *               result was garbage because of an overflowed line    *
 *               counter. The new declaration has a limit of 2^31    *
 *				   				    *
-*   Contents:   ccitt4_compress()				    *
-*		read_uncompressed_file_into_memory()		    *
-*		control_compression()				    *
-*		prepare_to_compress()				    *
-*		compress_image()				    *
+*   Contents:   grp4comp()					    *
+*		grp4comp_ctx()					    *
+*		alloc_G4_ENC_CTX()				    *
+*		free_G4_ENC_CTX()				    *
 *		make_array_of_changing_elements()		    *
-*		set_up_first_and_last_changing_elements_c()	    *
-*		prepare_to_compress_next_line()			    *
-*		set_up_first_line()				    *
-*		crash_c()				  	    *
-*								    *	
+*		compress_line()					    *
+*		write_run_length()				    *
+*		write_bits_c()					    *
+*		flush_buffer()					    *
+*								    *
 ********************************************************************/
 
-#ifdef TIME
-#include <sys/time.h>
-#endif
-#include <memory.h>
 #include <stdlib.h>
-#include <math.h>
+#include <limits.h>
 #include <grp4comp.h>
 
-/* Added by MDG in order have option of passing alloc responsibilities */
-/* to caller */
-#define NOALLOC 0
-#define ALLOC	1
-int comp_alloc_flag = ALLOC;
-int comp_write_init_flag;
-#ifdef TIME
-  struct timeval  t1, t2;
-  struct timezone tz;
-#endif
+/******************************************************************************
+
+	Codes are packed into an integer, the code's bits above its length in
+	bits.  Codes are written most significant bit first.
+
+******************************************************************************/
+#define G4_CODE(bits, len)		(((bits) << 4) | (len))
+#define G4_CODE_BITS(code)		((code) >> 4)
+#define G4_CODE_LEN(code)		((code) & 0xf)
+
+#define Pass_code				G4_CODE(0x1, 4)		/* 0001 */
+#define Horizontal_code			G4_CODE(0x1, 3)		/* 001 */
+
+/* two EOL codes, 000000000001 000000000001, end the image */
+#define EOFB_bits				0x001001
+#define EOFB_len				24
+
+/* vertical mode codes, indexed by a1 - b1 - VL3 */
+static const unsigned int vertical_code[VR3 - VL3 + 1] =
+{
+	G4_CODE(0x02, 7),	/* VL3 0000010 */
+	G4_CODE(0x02, 6),	/* VL2 000010 */
+	G4_CODE(0x02, 3),	/* VL1 010 */
+	G4_CODE(0x01, 1),	/* V0  1 */
+	G4_CODE(0x03, 3),	/* VR1 011 */
+	G4_CODE(0x03, 6),	/* VR2 000011 */
+	G4_CODE(0x03, 7),	/* VR3 0000011 */
+};
+
+static const unsigned int white_terminating_code[64] =
+{
+	G4_CODE(0x035,  8), G4_CODE(0x007,  6), G4_CODE(0x007,  4), G4_CODE(0x008,  4),
+	G4_CODE(0x00b,  4), G4_CODE(0x00c,  4), G4_CODE(0x00e,  4), G4_CODE(0x00f,  4),
+	G4_CODE(0x013,  5), G4_CODE(0x014,  5), G4_CODE(0x007,  5), G4_CODE(0x008,  5),
+	G4_CODE(0x008,  6), G4_CODE(0x003,  6), G4_CODE(0x034,  6), G4_CODE(0x035,  6),
+	G4_CODE(0x02a,  6), G4_CODE(0x02b,  6), G4_CODE(0x027,  7), G4_CODE(0x00c,  7),
+	G4_CODE(0x008,  7), G4_CODE(0x017,  7), G4_CODE(0x003,  7), G4_CODE(0x004,  7),
+	G4_CODE(0x028,  7), G4_CODE(0x02b,  7), G4_CODE(0x013,  7), G4_CODE(0x024,  7),
+	G4_CODE(0x018,  7), G4_CODE(0x002,  8), G4_CODE(0x003,  8), G4_CODE(0x01a,  8),
+	G4_CODE(0x01b,  8), G4_CODE(0x012,  8), G4_CODE(0x013,  8), G4_CODE(0x014,  8),
+	G4_CODE(0x015,  8), G4_CODE(0x016,  8), G4_CODE(0x017,  8), G4_CODE(0x028,  8),
+	G4_CODE(0x029,  8), G4_CODE(0x02a,  8), G4_CODE(0x02b,  8), G4_CODE(0x02c,  8),
+	G4_CODE(0x02d,  8), G4_CODE(0x004,  8), G4_CODE(0x005,  8), G4_CODE(0x00a,  8),
+	G4_CODE(0x00b,  8), G4_CODE(0x052,  8), G4_CODE(0x053,  8), G4_CODE(0x054,  8),
+	G4_CODE(0x055,  8), G4_CODE(0x024,  8), G4_CODE(0x025,  8), G4_CODE(0x058,  8),
+	G4_CODE(0x059,  8), G4_CODE(0x05a,  8), G4_CODE(0x05b,  8), G4_CODE(0x04a,  8),
+	G4_CODE(0x04b,  8), G4_CODE(0x032,  8), G4_CODE(0x033,  8), G4_CODE(0x034,  8),
+};/* end array of white terminating code */
+
+static const unsigned int black_terminating_code[64] =
+{
+	G4_CODE(0x037, 10), G4_CODE(0x002,  3), G4_CODE(0x003,  2), G4_CODE(0x002,  2),
+	G4_CODE(0x003,  3), G4_CODE(0x003,  4), G4_CODE(0x002,  4), G4_CODE(0x003,  5),
+	G4_CODE(0x005,  6), G4_CODE(0x004,  6), G4_CODE(0x004,  7), G4_CODE(0x005,  7),
+	G4_CODE(0x007,  7), G4_CODE(0x004,  8), G4_CODE(0x007,  8), G4_CODE(0x018,  9),
+	G4_CODE(0x017, 10), G4_CODE(0x018, 10), G4_CODE(0x008, 10), G4_CODE(0x067, 11),
+	G4_CODE(0x068, 11), G4_CODE(0x06c, 11), G4_CODE(0x037, 11), G4_CODE(0x028, 11),
+	G4_CODE(0x017, 11), G4_CODE(0x018, 11), G4_CODE(0x0ca, 12), G4_CODE(0x0cb, 12),
+	G4_CODE(0x0cc, 12), G4_CODE(0x0cd, 12), G4_CODE(0x068, 12), G4_CODE(0x069, 12),
+	G4_CODE(0x06a, 12), G4_CODE(0x06b, 12), G4_CODE(0x0d2, 12), G4_CODE(0x0d3, 12),
+	G4_CODE(0x0d4, 12), G4_CODE(0x0d5, 12), G4_CODE(0x0d6, 12), G4_CODE(0x0d7, 12),
+	G4_CODE(0x06c, 12), G4_CODE(0x06d, 12), G4_CODE(0x0da, 12), G4_CODE(0x0db, 12),
+	G4_CODE(0x054, 12), G4_CODE(0x055, 12), G4_CODE(0x056, 12), G4_CODE(0x057, 12),
+	G4_CODE(0x064, 12), G4_CODE(0x065, 12), G4_CODE(0x052, 12), G4_CODE(0x053, 12),
+	G4_CODE(0x024, 12), G4_CODE(0x037, 12), G4_CODE(0x038, 12), G4_CODE(0x027, 12),
+	G4_CODE(0x028, 12), G4_CODE(0x058, 12), G4_CODE(0x059, 12), G4_CODE(0x02b, 12),
+	G4_CODE(0x02c, 12), G4_CODE(0x05a, 12), G4_CODE(0x066, 12), G4_CODE(0x067, 12),
+}; /* end black_terminating_array */
+
+   /*
+    * In both make up code tables, the codes from index 27 on are colorless
+    * and represent runs from 1792 pixels to 2560 pixels.  In other words,
+    * the longest run length codes have been added onto both the white make
+    * up codes and the black make up codes.  This has been done to make the
+    * procedure "write_run_length()" easier to write and to understand.
+    */
+static const unsigned int white_make_up_code[40] =
+{
+	G4_CODE(0x01b,  5), G4_CODE(0x012,  5), G4_CODE(0x017,  6), G4_CODE(0x037,  7),
+	G4_CODE(0x036,  8), G4_CODE(0x037,  8), G4_CODE(0x064,  8), G4_CODE(0x065,  8),
+	G4_CODE(0x068,  8), G4_CODE(0x067,  8), G4_CODE(0x0cc,  9), G4_CODE(0x0cd,  9),
+	G4_CODE(0x0d2,  9), G4_CODE(0x0d3,  9), G4_CODE(0x0d4,  9), G4_CODE(0x0d5,  9),
+	G4_CODE(0x0d6,  9), G4_CODE(0x0d7,  9), G4_CODE(0x0d8,  9), G4_CODE(0x0d9,  9),
+	G4_CODE(0x0da,  9), G4_CODE(0x0db,  9), G4_CODE(0x098,  9), G4_CODE(0x099,  9),
+	G4_CODE(0x09a,  9), G4_CODE(0x018,  6), G4_CODE(0x09b,  9), G4_CODE(0x008, 11),
+	G4_CODE(0x00c, 11), G4_CODE(0x00d, 11), G4_CODE(0x012, 12), G4_CODE(0x013, 12),
+	G4_CODE(0x014, 12), G4_CODE(0x015, 12), G4_CODE(0x016, 12), G4_CODE(0x017, 12),
+	G4_CODE(0x01c, 12), G4_CODE(0x01d, 12), G4_CODE(0x01e, 12), G4_CODE(0x01f, 12),
+}; /* end case of white makeup code */
+
+static const unsigned int black_make_up_code[40] =
+{
+	G4_CODE(0x00f, 10), G4_CODE(0x0c8, 12), G4_CODE(0x0c9, 12), G4_CODE(0x05b, 12),
+	G4_CODE(0x033, 12), G4_CODE(0x034, 12), G4_CODE(0x035, 12), G4_CODE(0x06c, 13),
+	G4_CODE(0x06d, 13), G4_CODE(0x04a, 13), G4_CODE(0x04b, 13), G4_CODE(0x04c, 13),
+	G4_CODE(0x04d, 13), G4_CODE(0x072, 13), G4_CODE(0x073, 13), G4_CODE(0x074, 13),
+	G4_CODE(0x075, 13), G4_CODE(0x076, 13), G4_CODE(0x077, 13), G4_CODE(0x052, 13),
+	G4_CODE(0x053, 13), G4_CODE(0x054, 13), G4_CODE(0x055, 13), G4_CODE(0x05a, 13),
+	G4_CODE(0x05b, 13), G4_CODE(0x064, 13), G4_CODE(0x065, 13), G4_CODE(0x008, 11),
+	G4_CODE(0x00c, 11), G4_CODE(0x00d, 11), G4_CODE(0x012, 12), G4_CODE(0x013, 12),
+	G4_CODE(0x014, 12), G4_CODE(0x015, 12), G4_CODE(0x016, 12), G4_CODE(0x017, 12),
+	G4_CODE(0x01c, 12), G4_CODE(0x01d, 12), G4_CODE(0x01e, 12), G4_CODE(0x01f, 12),
+}; /* end black makeup code */
 
+#define Largest_colorless_code	G4_CODE(0x01f, 12)	/* 000000011111 */
 
 
 /***********************************************************************
-*   grp4comp is the main routine of this file.  It does pre-           *
-*   liminary setup, calls routines, and does final processing.         *
+*   grp4comp is the main routine of this file.  It encodes the image   *
+*   with a context of its own, into an output buffer the caller has    *
+*   made big enough.  On an error the length returned is 0.            *
 ************************************************************************/
 
 /***********************************************************************
@@ -87,1351 +185,417 @@ unsigned char *indata, int inbytes,
 int  width,int  height,
 unsigned char  *outdata, int  *outbytes)
 {
-   struct uncompressed_descriptor uncompressed;
-   struct compressed_descriptor compressed;
-
-   (void)inbytes; /* FIXME unused */
-       	uncompressed.pixels_per_line = width;
-       	uncompressed.number_of_lines = height;
-        uncompressed.data = indata;
-        comp_alloc_flag = NOALLOC;
-        comp_write_init_flag = True;
-	read_uncompressed_file_into_memory( &uncompressed);
-        compressed.data = outdata;
-	control_compression( &uncompressed, &compressed );
-        *outbytes = compressed.length_in_bytes;
-/*	printf("\ncompressed:lines: %d, pixels:%d, length:%d\n",
-	 compressed.number_of_lines, compressed.pixels_per_line, 
-	 compressed.length_in_bytes); */
+   G4_ENC_CTX *ctx;
+
+   *outbytes = 0;
+   if(alloc_G4_ENC_CTX(&ctx))
+      return;
+   if(grp4comp_ctx(ctx, indata, inbytes, width, height, outdata, INT_MAX,
+                   outbytes))
+      *outbytes = 0;
+   free_G4_ENC_CTX(ctx);
 }
 
 
-/***************************** control_compression **************************
-	
-		calls the functions that compress the image
-			
-*****************************************************************************/
 /***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the uncompressed data.               *
-*	Returned:          					       *
-*  		   compressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the compressed data.                 *
+*   Allocates a Group 4 encoder context with no line buffers.          *
 ************************************************************************/
-void control_compression( struct uncompressed_descriptor *uncompressed,
-		struct compressed_descriptor *compressed)
+int alloc_G4_ENC_CTX(G4_ENC_CTX **octx)
 {
-struct parameters 				 sole_parameters;
-struct parameters 				*params = &sole_parameters;
-
-#ifdef TIME
-  SHORT i;
-            tz.tz_minuteswest = 0;
-            tz.tz_dsttime     = 0;
-            gettimeofday(&t1, &tz); 
-#endif
+   G4_ENC_CTX *ctx;
 
-        
-	prepare_to_compress( uncompressed, compressed, params );
-	compress_image( uncompressed, compressed, params );
-        /* memory deallocation added by Michael D. Garris 2/26/90 */
-        free(params->reference_line);
-        free(params->coding_line);
-#ifdef TIME
-           gettimeofday(&t2, &tz); 
-           printf("\ntime difference: %ld:%ld\n", t2.tv_sec - t1.tv_sec,
-           t2.tv_usec - t1.tv_usec);
-           for(i=0; i<5; i++) printf("%c",'\07');*/
-#endif
+   ctx = (G4_ENC_CTX *)calloc(1, sizeof(G4_ENC_CTX));
+   if(ctx == (G4_ENC_CTX *)NULL){
+      fprintf(stderr, "ERROR : alloc_G4_ENC_CTX : calloc : ctx\n");
+      return(-2);
+   }
 
+   *octx = ctx;
+   return(0);
 }
 
 
-/************************ read_uncompressed_file_into_memory *******************
-	
-		allocates memory for the uncompressed image.		
-			
-*****************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the uncompressed data.               *
-*	Returned:          					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the compressed data.                 *
-************************************************************************/
-void read_uncompressed_file_into_memory( struct uncompressed_descriptor
-		*uncompressed)
-{
-int file_size;
-
-     if(comp_alloc_flag){
-	file_size = uncompressed->pixels_per_line * uncompressed->number_of_lines
-	 / Pixels_per_byte;
-	 
-	if((uncompressed->data = (char *)calloc( file_size,
-                                         sizeof(char) )) == NULL) {
- 	    printf("\nCannot allocate enough memory for uncomp file.\n");
- 	    crash_c();
- 	}
-     }
-     else
-        if(uncompressed->data == NULL){
-           printf("\nNo memory allocated for input data!\n");
-           crash_c();
-        }
-} /* end read_uncompressed_file_into_memory() */
-
-
-
-/*************************** prepare_to_compress ****************************
-	
-		initializes variables in preperation for compression		
-			
-*****************************************************************************/
 /***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the uncompressed data.               *
-*	Returned:          					       *
-*  		   compressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the compressed data.                 *
-*		   params - structure storing information needed for   *
-*		   	    comparison and other tasks.		       *
+*   Deallocates a Group 4 encoder context and its line buffers.        *
 ************************************************************************/
-void prepare_to_compress(
-struct uncompressed_descriptor  *uncompressed,
-struct compressed_descriptor 	*compressed,
-struct parameters 				*params)
+void free_G4_ENC_CTX(G4_ENC_CTX *ctx)
 {
-	        	
-	params->max_pixel   	    = uncompressed->pixels_per_line;
-	compressed->pixels_per_line = uncompressed->pixels_per_line;
-	compressed->number_of_lines = uncompressed->number_of_lines;
-	
-	set_up_first_line_c( params ); 
-	prepare_to_write_bits_c( compressed );	
-	 
-} /* end prepare_to_compress() */
-
-
-
-/****************************** compress_image *******************************
-	
-				compresses the image			
-			
-*****************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the uncompressed data.               *
-*	Returned:          					       *
-*  		   compressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the compressed data.                 *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-************************************************************************/
-void compress_image(
-struct uncompressed_descriptor 	*uncompressed,
-struct compressed_descriptor 	*compressed,
-struct parameters *params)
-{
-SHORT  line;
-
-	for(line = 0; line < uncompressed->number_of_lines; line++) {		
-	     make_array_of_changing_elements( params, uncompressed, line );
-	     set_up_first_and_last_changing_elements_c( params );
-	     compress_line( params );
-	     prepare_to_compress_next_line( params );
-	} /* end for each line loop */
-	
-	write_bits_c("000000000001000000000001");
-	compressed->length_in_bytes = flush_buffer();
+   if(ctx == (G4_ENC_CTX *)NULL)
+      return;
+
+   free(ctx->reference_line);
+   free(ctx->coding_line);
+   free(ctx);
 }
 
 
+/******************************** write_bits_c **********************************
+
+	appends a packed code to the bits not yet written, and writes them out
+	32 at a time.  Bits that do not fit in the output buffer are dropped,
+	the buffer being left marked full.
 
-/************************ make_array_of_changing_elements *********************
-	
-	stores in a list pointed to by "params->coding_line" the pixel numbers
-	of all the changing elements in the coding line
-	 						
 *****************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*  		   uncompressed	- structure containing the # of pixels *
-*				  per line, the number of lines, and   *
-*				  the uncompressed data.               *
-*		   line_number -  the number of the line in the image  *
-*	Returned:          					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-************************************************************************/
-void make_array_of_changing_elements(
-struct parameters *params,
-struct uncompressed_descriptor 	*uncompressed,
-SHORT line_number)
+static void write_bits_c(
+G4_ENC_CTX *ctx,
+const unsigned int bits,
+const int len)
 {
-SHORT 	bytes_per_line;
-int	line_offset;
-SHORT 	byte_offset;
-
-	bytes_per_line = params->max_pixel / Pixels_per_byte;
-	line_offset = bytes_per_line * line_number;
-	for(byte_offset=0; byte_offset < bytes_per_line; byte_offset++) {
-	    process_char(*(uncompressed->data+line_offset+byte_offset),params);
-	} 
-	
-}	/* end make_array_of_changing_elements() */
+unsigned int word;
 
+	ctx->bits = (ctx->bits << len) | bits;
+	ctx->nbits += len;
+	if(ctx->nbits < 32)
+		return;
 
-
-/******************* set_up_first_and_last_changing_elements_c *****************
-	
-	initializes the first and last changing elements in the coding line			
-			
-******************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-*	Returned:          					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-************************************************************************/
-void set_up_first_and_last_changing_elements_c(
-struct parameters *params)
-{
-	*(params->coding_line) = Invalid;
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	
-	/* the previous lines may be necessary if when searching for b1, you
-	skip some elements because you know that they are the wrong color */
+	ctx->nbits -= 32;
+	if(ctx->outleft < 4) {
+		ctx->outleft = -1;
+		return;
+	}
+	word = (unsigned int)(ctx->bits >> ctx->nbits);
+	ctx->outptr[0] = (unsigned char)(word >> 24);
+	ctx->outptr[1] = (unsigned char)(word >> 16);
+	ctx->outptr[2] = (unsigned char)(word >> 8);
+	ctx->outptr[3] = (unsigned char)word;
+	ctx->outptr += 4;
+	ctx->outleft -= 4;
 }
 
+#define write_code_c(ctx, code) \
+	write_bits_c(ctx, G4_CODE_BITS(code), G4_CODE_LEN(code))
 
-/************************ prepare_to_compress_next_line ***********************
-	
-	initializes variables in preperation for compressing another line	
-			
-******************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-*	Returned:          					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-************************************************************************/
-void prepare_to_compress_next_line(
-struct parameters *params)
-{
-SHORT *temp;
 
-	/* swap the reference and unchanged coding lines */
-	
-	temp = params->reference_line;
-	params->reference_line = params->coding_line;
-	params->coding_line = temp;
-	
-	params->pixel = 0;
-	params->index = 0;
-	params->previous_color = White;
-	
-} /* end prepare_to_read_next_line() */
-	
-
-
-/******************************* set_up_first_line_c ***************************
-	
-	initializes variables in preperation for compressing the first line		
-			
-******************************************************************************/
-/***********************************************************************
-*  Arguments          						       *
-*  ---------                					       *
-*	Passed in:         					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-*	Returned:          					       *
-*		   params - structure storing information need for     *
-*		   	    comparison and other tasks.		       *
-************************************************************************/
-void set_up_first_line_c(
-struct parameters *params)
-{
+/******************************** flush_buffer *******************************
+
+	writes to memory whatever bits are left in the bit buffer followed by
+	enough zero-bits to pad the compressed image out to a byte boundary.
 
-	params->reference_line = (SHORT *) malloc( (params->max_pixel +
-                                           Extra_positions) * sizeof(SHORT) );
-	params->coding_line = (SHORT *) malloc( (params->max_pixel +
-                                        Extra_positions) * sizeof(SHORT) );
-	
-	*(params->reference_line + 0) = Invalid;		
-	*(params->reference_line + 1) = params->max_pixel;
-	*(params->reference_line + 2) = params->max_pixel;
-	*(params->reference_line + 3) = params->max_pixel;
-	
-	/* initialize first changing element on coding line (A0 = -1) */
-	*(params->coding_line) = Invalid;
-	
-	params->pixel = 0;
-	params->index = 0;
-	params->previous_color = White;
-	
-} /* end set_up_first_line_c() */
-
-
-
-/*********************************** crash_c ***********************************
-	
-		forces the program to crash and create a core file
-			
 *****************************************************************************/
-void crash_c(void)
+static void flush_buffer(
+G4_ENC_CTX *ctx)
 {
-FILE *crash_program = NULL;
-	fprintf(crash_program,"This will kill the program and create a core file");
-}
+	if(ctx->nbits & 7)
+		write_bits_c(ctx, 0, 8 - (ctx->nbits & 7));
 
+	while(ctx->nbits > 0) {
+		if(ctx->outleft < 1) {
+			ctx->outleft = -1;
+			return;
+		}
+		ctx->nbits -= 8;
+		*ctx->outptr++ = (unsigned char)(ctx->bits >> ctx->nbits);
+		ctx->outleft--;
+	}
+}
 
-/***************************************************************************/
-/* Originally mode.c                                                       */
-/***************************************************************************/
-
-static SHORT	A0,		A0_color,
-				A1,		a2,
-				b1,		b2;
 
+/****************************** write_run_length() *****************************
 
+	writes the code, or series of codes, that represent a given run length
+	of a given color.
 
-/******************************* compress_line ********************************
-	
-			compresses a single line of the image
-			
-*****************************************************************************/
-void compress_line(
-struct parameters *params)
+******************************************************************************/
+static void write_run_length(
+G4_ENC_CTX *ctx,
+SHORT length,
+const SHORT color)
 {
-	
-#if Debug
-	static SHORT line = 0;
-	printf("\nLINE %d.  ",line);
-	line++;
-#endif
-
-	A0 = Invalid; /* set A0 equal to imaginary first array element */
-	A0_color = White; 
-	A1 = 1;
-	initialize_b1(params);
-	b2 = b1 + 1;
-	
-#if Debug
-	printf("\nA0:%d  A1:%d  b1:%d  b2:%d  ",
-     A0, *(params->coding_line+A1), 
-     *(params->reference_line+b1),*(params->reference_line+b2));
-#endif
-		
-	do {	
-			 
-		if (*(params->reference_line + b2) < *(params->coding_line + A1)) {
-			pass_mode_c(params);
-			continue;
-		} else 	
-			if (abs(*(params->coding_line+A1)-*(params->reference_line+b1)) <=3)
-			 	vertical_mode_c(params);
-		    else 
-				horizontal_mode_c(params);				
-#if Debug
-	printf("\nA0:%d  A1:%d  b1:%d  b2:%d  ",
-	 A0, *(params->coding_line+A1), 
-	 *(params->reference_line+b1),*(params->reference_line+b2));
-#endif
-	 
-	} while( A0 < params->max_pixel);
-	
-} 
+	while(length >= Largest_code) {
+		write_code_c(ctx, Largest_colorless_code);
+		length -= Largest_code;
+	}
 
+   /*
+    * length / Size_of_make_up_code_increments is in the range 0 - 39, and
+    * a make up code for 64 times it is written if it is not 0.  The
+    * remainder, in the range 0 - 63, is always written.
+    */
 
-/******************************* initialize_b1 ********************************
-	
-		locates b1's first position in the reference line
-			
-*****************************************************************************/
-void initialize_b1(
-struct parameters *params)
-{
-SHORT last_bit_of_b1;
-
-	b1 = 1;
-	last_bit_of_b1 = b1 & Last_bit_mask;
-		
-	while( ((*(params->reference_line +b1) <=A0) || (A0_color ==last_bit_of_b1))
-	 && (*(params->reference_line + b1) < params->max_pixel) ){
-	 	b1++;
- 		last_bit_of_b1 = b1 & Last_bit_mask;
-	} /* end while loop */
-	
-#if Debug
-	printf("\nb1:%d :%d, A0:%d", b1, 
-	 *(params->reference_line+b1), A0);
-#endif 
-	 
+	if(color == White) {
+		if(length > Max_terminating_length)
+			write_code_c(ctx, white_make_up_code[
+				length / Size_of_make_up_code_increments - 1]);
+		write_code_c(ctx, white_terminating_code[
+			length % Size_of_make_up_code_increments]);
+	}
+	else {
+		if(length > Max_terminating_length)
+			write_code_c(ctx, black_make_up_code[
+				length / Size_of_make_up_code_increments - 1]);
+		write_code_c(ctx, black_terminating_code[
+			length % Size_of_make_up_code_increments]);
+	}
 }
 
 
-/********************************** pass_mode_c ********************************
-	
-				compresses a pass mode
-			
-*****************************************************************************/
-void pass_mode_c(
-struct parameters *params)
-{
-	write_bits_c("0001");
-	
-#if Debug
-	printf(" P ");
-#endif 
-	
-	/*
-	 * Reset the value A0 points to to a'0 (the value that b2 points to).
-	 */
-	 	
-	A0 = *(params->reference_line + b2);
-	
-	/*
-	 * Since A0 is now greater than the pixel b1 points to, both b1 and b2
-	 * must be advanced twice to maintain the color difference between A0 and 
-	 * b1, and the positional requirement that b1 point to a pixel greater than
-	 * the one A0 points to.
-	 */
-	 
-	 b1 += 2;
-	 b2 += 2;
-	 
-	 /* 
-	  * Note that the b's can be advanced by two positions without fear of
-	  * moving them beyond the last changing element because pass_mode cannot
-	  * occur if b2 is already pointing to max_pixel.
-	  */
-	  
-} 
-
-
-/****************************** vertical_mode_c ********************************
-	
-			compresses a vertical mode
-			
-*****************************************************************************/
-void vertical_mode_c(
-struct parameters *params)
-{
-SHORT difference;
-
-	difference = *(params->coding_line + A1) - *(params->reference_line + b1);
-	A0 = *(params->coding_line + A1);
-	A0_color = !A0_color;
-	A1++;
-	
-#if Debug
-				printf(" V%d ", difference);
-#endif
+/*************************** count_leading_zeros ****************************
+
+	returns the number of 0 bits above the highest 1 bit of a word, which
+	must not be 0.
 
-	switch(difference) {
-
-	case 0: 	
-		write_bits_c("1");
-		if(*(params->reference_line + b1) != params->max_pixel ) {
-		    b1++;
-		    b2++;
-		} /* end if b1 is not on the last changing element */
-		break;
-
-	case 1: 		
-		write_bits_c("011");
-		b1++;
-		b2++;
-		if((*(params->reference_line + b1) <= A0)  && 
-		   (*(params->reference_line + b1) != params->max_pixel) ) {
-		    b1 += 2;
-		    b2 += 2;
-		}
-		break;
-
-	case -1: 	
-		write_bits_c("010");
-		if(*(params->reference_line + b1) != params->max_pixel ) {
-		   b1++;
-		   b2++;
-		} /* end if b1 is not on the last changing element */
-		break;
-
-	case 2: 	
-		write_bits_c("000011");
-		b1++;
-		b2++;
-		if((*(params->reference_line + b1) <= A0)  && 
-		   (*(params->reference_line + b1) != params->max_pixel) ) {
-		    b1 += 2;
-		    b2 += 2;
-		}
-		break;
-
-	case -2: 	
-		write_bits_c("000010");
-		if(*(params->reference_line + b1 - 1) > A0 ) {
-		   b1--;
-		   b2--;
-		} else if(*(params->reference_line + b1) != params->max_pixel){
-			  b1++;
-			  b2++;
-			}						
-		break;
-
-	case 3: 	
-		write_bits_c("0000011");
-		b1++;
-		b2++;
-		while ((*(params->reference_line + b1) <= A0)  && 
-		       (*(params->reference_line + b1) != params->max_pixel) ) {
-			b1 += 2;
-			b2 += 2;
-		}
-		break;
-
-	case -3: 	
-		write_bits_c("0000010");
-		if(*(params->reference_line + b1 - 1) > A0 ) {
-		   b1--;
-		   b2--;
-		} else if(*(params->reference_line + b1) != params->max_pixel){
-			  b1++;
-			  b2++;
-			}				
-		break;
-
-	default: 
-		printf("ERROR in vertical_mode_c() ");
-
-	} /* end case of difference */	
-	
-} 
-
-
-/**************************** horizontal_mode_c ********************************
-	
-			compresses a horizontal mode
-			
 *****************************************************************************/
-void horizontal_mode_c(
-struct parameters *params)
+static int count_leading_zeros(
+unsigned long long word)
 {
-SHORT run_length;
-
-#if Debug
-	printf(" a2:%d   H ",*(params->coding_line + a2));
+#if defined(__GNUC__)
+	return(__builtin_clzll(word));
+#else
+int n;
+
+	for(n = 0; !(word & 0x8000000000000000ULL); n++)
+		word <<= 1;
+	return(n);
 #endif
-	
-	a2 = A1 + 1;
-	write_bits_c("001");
-	
-	if(A0 == Invalid) /* on imaginary first pixel */
-	   run_length = *(params->coding_line + A1);		
-	else
-	   run_length = *(params->coding_line + A1) - A0;
-	write_run_length(run_length, A0_color );
-	/* the last bit contains the color of the changing element */
-	
-	run_length = *(params->coding_line + a2) - *(params->coding_line + A1);
-	write_run_length(run_length, !A0_color);
-	
-	/*
-	 *  Must use !A0_color instead of A1 because in cases in which A1 occurs
-	 *  on max_pixel, its color is bogus.
-	 */
-	
-	/* NOTE: is the above statement true? if A1 were on max_pixel, you should
-	not get horizontal mode. */
-	
-	 	
-	A0 = *(params->coding_line + a2);
-	A1 = a2 + 1;
-	
-	while((*(params->reference_line + b1) <= *(params->coding_line + a2)) &&
-	       ( *(params->reference_line + b1) < params->max_pixel)  )
-	{
-   	   b1 += 2; /* must move ahead by 2 to maintain color difference with */
-	   b2 += 2; /* A0, whose color does not change in this mode. */
-	}
-		
-} 
+}
 
 
-/***************************************************************************/
-/* Originally write_bits_c.c                                               */
-/***************************************************************************/
+/************************ make_array_of_changing_elements *********************
 
-static SHORT  bit_place_mark;	
-	
-static int  byte_place_mark;
+	stores in "line" the pixel numbers of all the changing elements in a
+	scan line, after an imaginary first element and followed by three at
+	"max_pixel".  Pixels are taken 64 at a time, and the changes among
+	them found with an exclusive or of the word and itself shifted right
+	by one pixel, so that runs of one color are passed over a word at a
+	time.  Returns the number of changing elements.
 
-static unsigned char  *output_area;
-		
-static char  write_one[Pixels_per_byte] = 
+*****************************************************************************/
+static SHORT make_array_of_changing_elements(
+SHORT *line,
+const unsigned char *data,
+const int nbytes,
+const SHORT max_pixel)
 {
-	(char)0x80,
-	(char)0x40,
-	(char)0x20,
-	(char)0x10,
-	(char)0x8,
-	(char)0x4,
-	(char)0x2,
-	(char)0x1,
-};
+unsigned long long word, changes, last;
+SHORT n, pixel;
+int i, j, nleft;
+
+	line[0] = Invalid;
+	n = 0;
+	last = White;	/* color of the pixel before the word */
+
+	for(i = 0; i < nbytes; i += Bits_per_byte) {
+		nleft = nbytes - i;
+		if(nleft >= Bits_per_byte) {
+			word = ((unsigned long long)data[i] << 56) |
+				   ((unsigned long long)data[i+1] << 48) |
+				   ((unsigned long long)data[i+2] << 40) |
+				   ((unsigned long long)data[i+3] << 32) |
+				   ((unsigned long long)data[i+4] << 24) |
+				   ((unsigned long long)data[i+5] << 16) |
+				   ((unsigned long long)data[i+6] << 8) |
+				   (unsigned long long)data[i+7];
+		}
+		else {
+			word = 0;
+			for(j = 0; j < nleft; j++)
+				word |= (unsigned long long)data[i+j] << (56 - (j << 3));
+			/* pad past the line with its last pixel, making no changes */
+			if(data[nbytes-1] & 1)
+				word |= ~0ULL >> (nleft << 3);
+		}
 
-static char  write_zero[Pixels_per_byte] =
-{
-	(char)0x7F,
-	(char)0xBF,
-	(char)0xDF,
-	(char)0xEF,
-	(char)0xF7,
-	(char)0xFB,
-	(char)0xFD,
-	(char)0xFE,
-};
+		changes = word ^ ((word >> 1) | (last << 63));
+		last = word & 1;
+		pixel = i * Pixels_per_byte;
+		while(changes != 0) {
+			j = count_leading_zeros(changes);
+			line[++n] = pixel + j;
+			changes ^= 0x8000000000000000ULL >> j;
+		}
+	}
 
+	line[n+1] = max_pixel;
+	line[n+2] = max_pixel;
+	line[n+3] = max_pixel;
 
-/*************************** prepare_to_write_bits_c **************************
-	
-	initializes variables in preperation for writing compressed images	
-			
-*****************************************************************************/
-void prepare_to_write_bits_c(
-struct compressed_descriptor *compressed)
-{
-     if(comp_alloc_flag){
-	compressed->data = (char *)calloc( (compressed->pixels_per_line * 
-	 compressed->number_of_lines / Pixels_per_byte), sizeof(char) );
-     }
-   /*
-    *  This allocation is usually very wasteful, but because there is no
-    *  way of knowing how much space is needed, I decided to be generous.
-    */
-    
-    if (compressed->data == NULL){
-        printf("\nMemory allocation error for compressed output data.\n");
-    	crash_c();
-    }
-	output_area = compressed->data;
+	return(n);
 }
 
 
+/******************************* compress_line ********************************
 
-/******************************** write_bits_c **********************************
-	
-	writes a variable length series of bits represented by a string of '1's
-	and '0's, which it receives as a parameter	
-			
-*****************************************************************************/
-void write_bits_c(
-char *string_ptr)
-{
-      /* global switch added by Michael D. Garris 2/26/90 */
-      if(comp_write_init_flag){
-         bit_place_mark = 0;
-         byte_place_mark = 0;
-         comp_write_init_flag = False;
-      }
-      /* EDIT MDG 1/25/99
-	while(*string_ptr != NULL) {
-      */
-	while(*string_ptr != '\0') {
-	      if(*string_ptr == '1')
-	  	 *(output_area + byte_place_mark) |= write_one[bit_place_mark];
-	      else
-		 *(output_area + byte_place_mark) &= write_zero[bit_place_mark];
-	      if(bit_place_mark == Last_bit_in_a_byte) {
-	 	 bit_place_mark = 0;
-		 byte_place_mark++;
-	      } /* end if byte is full */ 
-	      else
-		 bit_place_mark++;
-	      string_ptr++;
-	} /* end while */
-	
-} 
-
+	compresses a single line of the image from the changing elements of
+	the coding and reference lines.  b2 is always the element after b1.
 
-/******************************** flush_buffer *******************************
-	
-	writes to memory whatever bits are left in the bit buffer followed by 
-	enough zero-bits to pad the compressed image out to a byte boundary.	
-			
 *****************************************************************************/
-unsigned int flush_buffer(void)
-{
-SHORT i;
-
-	if (bit_place_mark != 0) {
-       	    for (i=bit_place_mark; i<Pixels_per_byte; i++)
-		*(output_area + byte_place_mark) &= write_zero[i];
-		/*
-		 * pad the rest of the last byte with '0' bits.
-		 */
-		++byte_place_mark;
-	}
-	return byte_place_mark;
-} 
-
-
-/***************************************************************************/
-/* Originally write_run.c                                                  */
-/***************************************************************************/
-
-/******************************************************************************
-	
-	The arrays that follow contain character representations of the binary
-	run length codes written during compression.
-			
-******************************************************************************/
-static char *white_terminating_code[64] =
+static void compress_line(
+G4_ENC_CTX *ctx,
+const SHORT max_pixel)
 {
-	"00110101",
-	"000111",
-	"0111",
-	"1000",
-	"1011",
-	"1100",
-	"1110",
-	"1111",
-	"10011",
-	"10100",
-	"00111",
-	"01000",
-	"001000",
-	"000011",
-	"110100",
-	"110101",
-	"101010",
-	"101011",
-	"0100111",
-	"0001100",
-	"0001000",
-	"0010111",
-	"0000011",
-	"0000100",
-	"0101000",
-	"0101011",
-	"0010011",
-	"0100100",
-	"0011000",
-	"00000010",
-	"00000011",
-	"00011010",
-	"00011011",
-	"00010010",
-	"00010011",
-	"00010100",
-	"00010101",
-	"00010110",
-	"00010111",
-	"00101000",
-	"00101001",
-	"00101010",
-	"00101011",
-	"00101100",
-	"00101101",
-	"00000100",
-	"00000101",
-	"00001010",
-	"00001011",
-	"01010010",
-	"01010011",
-	"01010100",
-	"01010101",
-	"00100100",
-	"00100101",
-	"01011000",
-	"01011001",
-	"01011010",
-	"01011011",
-	"01001010",
-	"01001011",
-	"00110010",
-	"00110011",
-	"00110100",
-};/* end array of white terminating code */
-
+const SHORT *ref = ctx->reference_line;
+const SHORT *coding = ctx->coding_line;
+SHORT a0, a0_color, a1, a2, b1, difference;
+
+	a0 = Invalid; /* set a0 equal to imaginary first array element */
+	a0_color = White;
+	a1 = 1;
+	b1 = 1; /* the first changing element on the reference line is past a0 */
+
+	do {
+
+		if(ref[b1+1] < coding[a1]) {
+			/* pass mode */
+			write_code_c(ctx, Pass_code);
+
+			/*
+			 * a0 moves to b2.  b1 and b2 are advanced by two to keep the
+			 * color difference between a0 and b1; b2 cannot already be on
+			 * the last changing element, or this would not be pass mode.
+			 */
+			a0 = ref[b1+1];
+			b1 += 2;
+			continue;
+		}
 
-static char *black_terminating_code[64] =
-{
-	"0000110111",
-	"010",
-	"11",
-	"10",
-	"011",
-	"0011",
-	"0010",
-	"00011",
-	"000101",
-	"000100",
-	"0000100",
-	"0000101",
-	"0000111",
-	"00000100",
-	"00000111",
-	"000011000",
-	"0000010111",
-	"0000011000",
-	"0000001000",
-	"00001100111",
-	"00001101000",
-	"00001101100",
-	"00000110111",
-	"00000101000",
-	"00000010111",
-	"00000011000",
-	"000011001010",
-	"000011001011",
-	"000011001100",
-	"000011001101",
-	"000001101000",
-	"000001101001",
-	"000001101010",
-	"000001101011",
-	"000011010010",
-	"000011010011",
-	"000011010100",
-	"000011010101",
-	"000011010110",
-	"000011010111",
-	"000001101100",
-	"000001101101",
-	"000011011010",
-	"000011011011",
-	"000001010100",
-	"000001010101",
-	"000001010110",
-	"000001010111",
-	"000001100100",
-	"000001100101",
-	"000001010010",
-	"000001010011",
-	"000000100100",
-	"000000110111",
-	"000000111000",
-	"000000100111",
-	"000000101000",
-	"000001011000",
-	"000001011001",
-	"000000101011",
-	"000000101100",
-	"000001011010",
-	"000001100110",
-	"000001100111",
-}; /* end black_terminating_array */
+		difference = coding[a1] - ref[b1];
+		if(difference >= VL3 && difference <= VR3) {
+			/* vertical mode */
+			write_code_c(ctx, vertical_code[difference - VL3]);
+			a0 = coding[a1];
+			a0_color = !a0_color;
+			a1++;
+
+			switch(difference) {
+			case 0:
+			case -1:
+				if(ref[b1] != max_pixel)
+					b1++;
+				break;
+			case 1:
+			case 2:
+				b1++;
+				if((ref[b1] <= a0) && (ref[b1] != max_pixel))
+					b1 += 2;
+				break;
+			case 3:
+				b1++;
+				while((ref[b1] <= a0) && (ref[b1] != max_pixel))
+					b1 += 2;
+				break;
+			default: /* -2 and -3 */
+				if(ref[b1-1] > a0)
+					b1--;
+				else if(ref[b1] != max_pixel)
+					b1++;
+				break;
+			}
+		}
+		else {
+			/* horizontal mode */
+			a2 = a1 + 1;
+			write_code_c(ctx, Horizontal_code);
+
+			if(a0 == Invalid) /* on imaginary first pixel */
+				write_run_length(ctx, coding[a1], a0_color);
+			else
+				write_run_length(ctx, coding[a1] - a0, a0_color);
+			write_run_length(ctx, coding[a2] - coding[a1], !a0_color);
+
+			a0 = coding[a2];
+			a1 = a2 + 1;
+
+			/* move ahead by 2 to keep the color difference with a0 */
+			while((ref[b1] <= a0) && (ref[b1] < max_pixel))
+				b1 += 2;
+		}
 
+	} while(a0 < max_pixel);
+}
 
-static char *white_make_up_code[40] =
-{
-	"11011",
-	"10010",
-	"010111",
-	"0110111",
-	"00110110",
-	"00110111",
-	"01100100",
-	"01100101",
-	"01101000",
-	"01100111",
-	"011001100",
-	"011001101",
-	"011010010",
-	"011010011",
-	"011010100",
-	"011010101",
-	"011010110",
-	"011010111",
-	"011011000",
-	"011011001",
-	"011011010",
-	"011011011",
-	"010011000",
-	"010011001",
-	"010011010",
-	"011000",
-	"010011011",
-	
-   /*
-    * from this line on, the codes are colorless and represnt runs from
-    * 1792 pixels to 2560 pixels.  In other words, the longest run length 
-    * codes have been added onto both the white make up codes and the black
-    * make up codes.  This has been done to make the procedure 
-    * "write_run_length()" easier to write and to understand.  No other 
-    * procedure in the compression algorithm is affected by this merging of
-    * different types of run length codes, and the compatibility of the
-    * program is in no way effected.
-    */
-    
-	"00000001000",
-	"00000001100",
-	"00000001101",
-	"000000010010",
-	"000000010011",
-	"000000010100",
-	"000000010101",
-	"000000010110",
-	"000000010111",
-	"000000011100",
-	"000000011101",
-	"000000011110",
-	"000000011111",
-}; /* end case of white makeup code */
 
-		
-static char *black_make_up_code[40] =
-{
-	"0000001111",
-	"000011001000",
-	"000011001001",
-	"000001011011",
-	"000000110011",
-	"000000110100",
-	"000000110101",
-	"0000001101100",
-	"0000001101101",
-	"0000001001010",
-	"0000001001011",
-	"0000001001100",
-	"0000001001101",
-	"0000001110010",
-	"0000001110011",
-	"0000001110100",
-	"0000001110101",
-	"0000001110110",
-	"0000001110111",
-	"0000001010010",
-	"0000001010011",
-	"0000001010100",
-	"0000001010101",
-	"0000001011010",
-	"0000001011011",
-	"0000001100100",
-	"0000001100101",
-	
-   /*
-    * from this line on, the codes are colorless and represnt runs from
-    * 1792 pixels to 2560 pixels.  In other words, the longest run length 
-    * codes have been added onto both the white make up codes and the black
-    * make up codes.  This has been done to make the procedure 
-    * "write_run_length()" easier to write and to understand.  No other 
-    * procedure in the compression algorithm is affected by this merging of
-    * different types of run length codes, and the compatibility of the
-    * program is in no way compromised.
-    */
-    
-	"00000001000",
-	"00000001100",
-	"00000001101",
-	"000000010010",
-	"000000010011",
-	"000000010100",
-	"000000010101",
-	"000000010110",
-	"000000010111",
-	"000000011100",
-	"000000011101",
-	"000000011110",
-	"000000011111",
-}; /* end black makeup code */
+/******************************** grp4comp_ctx *********************************
 
+	compresses the image with the line buffers and bit buffer of "ctx".
+	Each scan line of the image is taken to be width / 8 bytes long.
 
-char *largest_colorless_code =
+*****************************************************************************/
+/***********************************************************************
+*  Arguments          						       *
+*  ---------                					       *
+*	Passed in:         					       *
+*		   ctx - encoder context.                              *
+*		   indata - buffer containing the uncompressed data.   *
+*		   inbytes - the number of bytes in indata.            *
+*  		   width - Width in pixels of scan line in indata.     *
+*  		   height - Number of lines in indata.                 *
+*  		   outalloc - the number of bytes in outdata.          *
+*	Returned:          					       *
+*		   outdata - buffer containing the compressed data.    *
+*		   outbytes - the number of bytes of compressed data.  *
+*		   zero on success, negative on error.                 *
+************************************************************************/
+int grp4comp_ctx(
+G4_ENC_CTX *ctx,
+unsigned char *indata, int inbytes,
+int  width,int  height,
+unsigned char  *outdata, int  outalloc, int  *outbytes)
 {
-	"000000011111"
-};
-
-
+SHORT *temp;
+SHORT line;
+int bytes_per_line;
 
-/****************************** write_run_length() *****************************
+	if(width <= 0 || height < 0) {
+		fprintf(stderr, "ERROR : grp4comp_ctx : ");
+		fprintf(stderr, "invalid image size %d x %d\n", width, height);
+		return(-2);
+	}
 
-	writes the code, or series of codes, that represent a given run length
-	of a given color.
-				
-******************************************************************************/
-void write_run_length(
-SHORT length,
-SHORT color)
-{
+	bytes_per_line = width / Pixels_per_byte;
+	if(inbytes < bytes_per_line * height) {
+		fprintf(stderr, "ERROR : grp4comp_ctx : ");
+		fprintf(stderr, "%d bytes is short of a %d x %d image\n",
+		        inbytes, width, height);
+		return(-3);
+	}
 
-SHORT	multiples_of_largest_code,			
-		make_up_code_index,	
-		remainder,
-		i;	
-		
-	multiples_of_largest_code = length / Largest_code;
-	length %= Largest_code;
-	for(i=0 ; i < multiples_of_largest_code ; i++) 
-	    write_bits_c( largest_colorless_code );
-
-	remainder = length % Size_of_make_up_code_increments;
-	
-   /* remainder in the range 0 - 63 */
-   
-	make_up_code_index = length / Size_of_make_up_code_increments;
-	
-   /*
-    * make_up_code_index in the range 0 - 39, and represents a run length 
-    * of 64 times its value (i.e. 0 - 2496).  To translate this value into
-    * an index into the arrays that store the bit sequence that represents
-    * the appropriate run length, 1 must be subtracted from make_up_code_
-    * index.  If this results in the value -1, no make up code should be
-    * written.
-    */
-    
-	make_up_code_index--;
-	
-	if(make_up_code_index != Invalid) {
-	   if(color == White)
-	      write_bits_c(white_make_up_code[make_up_code_index]);
-	   else
-	      write_bits_c(black_make_up_code[make_up_code_index]);
+	if(ctx->line_alloc < width + Extra_positions) {
+		free(ctx->reference_line);
+		free(ctx->coding_line);
+		ctx->line_alloc = 0;
+		ctx->reference_line = (SHORT *)malloc((width + Extra_positions) *
+		                                      sizeof(SHORT));
+		ctx->coding_line = (SHORT *)malloc((width + Extra_positions) *
+		                                   sizeof(SHORT));
+		if(ctx->reference_line == (SHORT *)NULL ||
+		   ctx->coding_line == (SHORT *)NULL) {
+			fprintf(stderr, "ERROR : grp4comp_ctx : malloc : lines\n");
+			return(-4);
+		}
+		ctx->line_alloc = width + Extra_positions;
 	}
-	
-	if(color == White)
-	   write_bits_c(white_terminating_code[remainder]);
-	else
-	   write_bits_c(black_terminating_code[remainder]);
 
-} 	/* end write run length() */
+	ctx->outptr = outdata;
+	ctx->outleft = outalloc;
+	ctx->bits = 0;
+	ctx->nbits = 0;
+
+	/* the line above the first is all white */
+	ctx->reference_line[0] = Invalid;
+	ctx->reference_line[1] = width;
+	ctx->reference_line[2] = width;
+	ctx->reference_line[3] = width;
+
+	for(line = 0; line < height && ctx->outleft >= 0; line++) {
+		make_array_of_changing_elements(ctx->coding_line,
+		        indata + line * bytes_per_line, bytes_per_line, width);
+		compress_line(ctx, width);
+
+		/* swap the reference and coding lines */
+		temp = ctx->reference_line;
+		ctx->reference_line = ctx->coding_line;
+		ctx->coding_line = temp;
+	}
 
+	write_bits_c(ctx, EOFB_bits, EOFB_len);
+	flush_buffer(ctx);
 
-/***************************************************************************/
-/* Originally table.c                                                      */
-/***************************************************************************/
+	if(ctx->outleft < 0) {
+		fprintf(stderr, "ERROR : grp4comp_ctx : ");
+		fprintf(stderr, "compressed data exceeds %d bytes\n", outalloc);
+		return(-5);
+	}
 
-struct byte_descriptor {
-    SHORT pixel[9]; 
-};
-    
-    
-static struct byte_descriptor table[Number_of_different_bytes] =
-{    
-   {{-1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 7,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 6,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 6,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 5,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 5,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 5,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 5,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    5,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    5,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    5,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    5,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 4,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    4,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    5,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    5,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    5,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    5,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 3,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    3,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    4,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    5,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    5,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    5,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    5,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 2,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    6,    7,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    6,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    5,    6,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    5,    6,    7,   -1,   -1}},
-   {{ 1,    2,    3,    4,    5,    7,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    4,    5,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    2,    3,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    3,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    4,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    5,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    5,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    5,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    5,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 1,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    5,    6,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    5,    6,    7,   -1,   -1}},
-   {{ 0,    1,    3,    4,    5,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    4,    5,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    3,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    5,    6,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    5,    6,    7,   -1,   -1}},
-   {{ 0,    1,    2,    3,    5,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    5,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    5,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    5,    7,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    5,    6,    7,   -1}},
-   {{ 0,    1,    2,    3,    4,    5,    6,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    6,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    6,    7,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    3,    4,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    5,    6,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    5,    6,    7,   -1,   -1}},
-   {{ 0,    1,    2,    4,    5,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    4,    5,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    1,    2,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    5,    6,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    5,    6,    7,   -1,   -1}},
-   {{ 0,    2,    3,    4,    5,    7,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    4,    5,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    2,    3,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    5,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    5,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    5,    6,    7,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    5,    6,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    3,    4,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    5,    6,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    5,    6,    7,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    5,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    4,    5,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    5,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    5,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    5,    6,    7,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    5,    6,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    6,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    6,    7,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,    7,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-   {{ 0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
-}; /* end of data for list of byte descriptors */
-
-
-    
-/****************************** process_char *********************************
-
-	writes the pixel number of each changing element within the character
-	being processed to the list "params->coding_line"
-				
-******************************************************************************/
-void process_char(
-unsigned char data_byte,
-struct parameters *params)
-{
-static char color = 0;
-SHORT i = 0;
-
-	color = -(data_byte & Last_bit_mask); 
-	data_byte ^= params->previous_color; 
-	
-/* if the previous color is black - which is contrary to our assumptions -
-* the bits in the byte must all be changed so that the result, when used
-* as an index into the array 'bytes,' yields the correct result.  In the
-* above operation, if the previous color is black (11111111b), all bits
-* are changed; if the previous color is white (00000000b), no bits are
-* changed. */
-	
-	while(table[data_byte].pixel[i] != Invalid) 
-	      *( params->coding_line + ++params->index ) = 
-	      params->pixel + table[data_byte].pixel[i++];
-		
-	params->pixel += Pixels_per_byte;
-	params->previous_color = color;
-	
-	/* 'color' is a temporary holding place for the value of previous color */ 
+	*outbytes = (int)(ctx->outptr - outdata);
+	return(0);
 }
@@ -3,6 +3,9 @@
 /* Originally compression.h                                          */
 /*********************************************************************/
 
+#ifndef _GRP4COMP_H
+#define _GRP4COMP_H
+
 #include <stdio.h>
 
 
@@ -25,7 +28,6 @@
 
 #define True					1
 #define False					0
-#define Debug					False
 
 #define White					0
 #define Black 					1
@@ -33,122 +35,47 @@
 #define Largest_code						2560
 #define Size_of_make_up_code_increments		64
 #define Max_terminating_length				63	/* longest terminating code*/
-#define Number_of_different_bytes			256  
 
-#define Pixels_per_byte			8  
-#define Bits_per_byte			8  
-#define Last_bit_in_a_byte		7		/* assumes bits numbered from 0 - 7 */	
-#define Last_bit_mask 			1		/* masks the last (low magnitude) bit */ 
-#define Default_width_in_pixels	2560 	/* default width of a scan line */
-#define Default_number_of_lines	3300 	/* default length of an image */
+#define Pixels_per_byte			8
+#define Bits_per_byte			8
 
-#define Invalid				   -1 
-#define None					0 
+#define Invalid				   -1
 #define Extra_positions			25		/* ensures extra room in allocations */
-#define Not_done_yet			0
 
 #define VL3 				   -3  		/* Vertical Left 3 mode */
-#define VL2 				   -2  		/* Vertical Left 2 mode */
-#define VL1 				   -1 		/* Vertical Left 1 mode */
-#define V0						0		/* Vertical mode */	  
-#define VR1						1 		/* Vertical Right 1 mode */  
-#define VR2						2  		/* Vertical Right 2 mode */ 
-#define VR3						3  		/* Vertical Right 3 mode */ 
-#define P						4 		/* Pass mode */ 
-#define H						5		/* Horizontal mode */
-#define EOFB					6		/* End Of File Buffer */
-
-#define No_offset				0		/* no offset during fseek() */
-#define End_of_file				2		/* start at EOF during fseek() */
-#define Start_of_file			0		/* start at SOF during fseek() */
-
-/*
-unsigned char 	*calloc();
-SHORT 			*malloc();
-*/
-
-struct parameters {
-	SHORT previous_color;	/* color of last run of pixels */
-	SHORT index;			/* indicates current position in "coding_line" */
-	SHORT max_pixel;		/* the number of pixels in a scan line */
-	SHORT pixel;			/* pixel number of the last changing element */
-	SHORT *reference_line;	/* array of changing elements on reference line */
-	SHORT *coding_line;		/* array of changing elements on coding line */
-};
-
-struct compressed_descriptor {
-	unsigned char  *data;		/* pointer to compressed image */
-	SHORT  pixels_per_line;		/* the number of pixels in a scan line */
-	SHORT  number_of_lines;		/* the number of scan lines in the image */
-	int    length_in_bytes;		/* length of the compressed image in bytes */
-};
-
-struct uncompressed_descriptor {
-	unsigned char  *data;		/* pointer to uncompressed image */
-	SHORT  pixels_per_line;		/* the number of pixels in a scan line */
-	SHORT  number_of_lines;		/* the number of scan lines in the image */
-};
+#define VR3						3  		/* Vertical Right 3 mode */
+
+/* Working state for one Group 4 encode.  The line buffers are kept */
+/* between images and only grown, so a context reused for images of */
+/* the same width allocates nothing.  Each thread that encodes      */
+/* images concurrently must use its own context.                    */
+typedef struct g4_enc_ctx {
+	SHORT *reference_line;	/* changing elements on the line above */
+	SHORT *coding_line;		/* changing elements on the line being coded */
+	int    line_alloc;		/* elements allocated to each line */
+	unsigned char *outptr;	/* next byte of the compressed image */
+	int    outleft;			/* bytes left in it, -1 once overrun */
+	unsigned long long bits;/* bits not yet written, last bit lowest */
+	int    nbits;			/* number of bits in "bits" */
+} G4_ENC_CTX;
 
 
 /*****************************************************************************
 
 	declarations of all the procedures in the group4 compression routines
-	follow.  The names of the files that contain the procedures are enclosed
-	in comments above the declarations.
-	
+	follow.
+
 ******************************************************************************/
 
 void grp4comp(
 		unsigned char *indata, int inbytes,
 		int  width,int  height,
 		unsigned char  *outdata, int  *outbytes);
+int grp4comp_ctx(G4_ENC_CTX *ctx,
+		unsigned char *indata, int inbytes,
+		int  width,int  height,
+		unsigned char  *outdata, int  outalloc, int  *outbytes);
+int alloc_G4_ENC_CTX(G4_ENC_CTX **octx);
+void free_G4_ENC_CTX(G4_ENC_CTX *ctx);
 
-/* compress.c */
-void control_compression(struct uncompressed_descriptor *uncompressed,
-		                struct compressed_descriptor *compressed);
-struct uncompressed_descriptor process_arguments(void);
-void set_up_first_and_last_changing_elements_c(struct parameters *params);
-void set_up_first_and_last_changing_elements_d(void);
-void read_uncompressed_file_into_memory(struct uncompressed_descriptor
-		                *uncompressed);
-void write_compressed_data_into_a_file(void);
-void prepare_to_compress(struct uncompressed_descriptor  *uncompressed,
-		struct compressed_descriptor  *compressed,
-		struct parameters  *params);
-void compress_image(struct uncompressed_descriptor  *uncompressed,
-		struct compressed_descriptor    *compressed,
-		struct parameters *params);
-void make_array_of_changing_elements(struct parameters *params,
-		struct uncompressed_descriptor  *uncompressed,
-		SHORT line_number);
-void prepare_to_compress_next_line(struct parameters *params);
-void set_up_first_line_c(struct parameters *params);
-void set_up_first_line_d(void);
-void crash_c(void);
-
-/* table.c */
-void process_char(unsigned char data_byte,
-		struct parameters *params);
-
-
-/* mode.c */
-void compress_line(struct parameters *params);
-void initialize_b1(struct parameters *params);
-void pass_mode_c(struct parameters *params);
-void pass_mode_d(void);
-void vertical_mode_c(struct parameters *params);
-void vertical_mode_d(void);
-void horizontal_mode_c(struct parameters *params);
-void horizontal_mode_d(void);
-
-
-/* write_run.c */
-void write_run_length(SHORT length, SHORT color);
-
-
-/* write_bits.c */
-void prepare_to_write_bits_c(struct compressed_descriptor *compressed);
-void prepare_to_write_bits_d(void);
-void write_bits_c(char *string_ptr);
-void write_bits_d(void);
-unsigned int flush_buffer(void);
+#endif /* !_GRP4COMP_H */
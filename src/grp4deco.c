@@ -3,15 +3,26 @@
 
       FILE:    GRP4DECO.C
       AUTHORS: CALS Test Network
-               
+
       DATE:    01/25/1990
 
-      Contains routines responsible for CCITT Group 4 encoding
-      a binary image pixel datastream.
+      Contains routines responsible for CCITT Group 4 decoding
+      a binary image pixel datastream.  Mode and run length codes
+      are looked up in tables indexed by the next 8, 12 or 13 bits
+      of the datastream, and the state of a decode is kept in a
+      caller owned context, so that separate contexts may decode
+      images concurrently.
 
       ROUTINES:
 #cat: grp4decomp - decodes and reconstructs a CCITT Group 4 compressed
 #cat:              binary image (bitmap).
+#cat: grp4decomp_ctx - decodes and reconstructs a CCITT Group 4
+#cat:              compressed binary image (bitmap) into a bounded
+#cat:              buffer, using a decoder context.
+#cat: alloc_G4_DEC_CTX - Allocates a Group 4 decoder context.
+#cat:
+#cat: free_G4_DEC_CTX - Deallocates a Group 4 decoder context and the
+#cat:              line buffers it owns.
 
 ***********************************************************************/
 
@@ -21,43 +32,155 @@
 *  Date:       January 25, 1990				    	    *
 *  Package:    CCITT4 compression routines			    *
 *				   				    *
-*  Contents:   ccitt4_decompress()				    *
-*	       read_compressed_file_into_memory()		    *
-*	       control_decompression()				    *
-*	       prepare_to_decompress()				    *
-*	       set_up_first_and_last_changing_elements_d()	    *
-*	       prepare_to_decompress_next_line()		    *
-*	       set_up_first_line_d()				    *
-*	       crash_d()					    * 
+*  Contents:   grp4decomp()					    *
+*	       grp4decomp_ctx()					    *
+*	       alloc_G4_DEC_CTX()				    *
+*	       free_G4_DEC_CTX()				    *
+*	       build_code_tables()				    *
+*	       decompress_line()				    *
+*	       find_run_length_code()				    *
+*	       write_bits_d()					    *
+*	       read_bits()					    *
 ********************************************************************/
 
 #include <grp4deco.h>
 #include <stdlib.h>
 #include <string.h>
-#ifdef TIME
-#include <sys/time.h>
-#endif
-
-#define NOALLOC 0
-#define ALLOC 1
-int decomp_alloc_flag;
-int decomp_write_init_flag;
-int decomp_read_init_flag;
-static char 	*all_white,
-                *output_area,
-		*all_black;
-				
-
-#ifdef TIME
-struct timeval  t1, t2;
-struct timezone tz;
-#endif
+#include <limits.h>
+#include <pthread.h>
 
+/******************************************************************************
 
-/********************************************************************
-* grp4decomp is the main routine of this file.  It does pre-        *
-* liminary setup, calls routines, and does final processing.        *
-********************************************************************/
+	Codes are packed into an integer, the code's bits above its length in
+	bits.  Codes are read most significant bit first.
+
+******************************************************************************/
+#define G4_CODE(bits, len)		(((bits) << 4) | (len))
+#define G4_CODE_BITS(code)		((code) >> 4)
+#define G4_CODE_LEN(code)		((code) & 0xf)
+
+/* two EOL codes, 000000000001 000000000001, end the image */
+#define EOFB_bits				0x001001
+#define EOFB_len				24
+
+/* bits looked up at once for a mode, a white run and a black run code */
+#define Mode_bits				8
+#define White_bits				12
+#define Black_bits				13
+
+/* decompress_line() results */
+#define Line_done				0
+#define End_of_image			1
+#define Bad_code			   -2
+#define Bad_element			   -3
+
+/* mode codes, indexed by mode - VL3 */
+static const unsigned int mode_code[EOFB - VL3 + 1] =
+{
+	G4_CODE(0x02, 7),	/* VL3 0000010 */
+	G4_CODE(0x02, 6),	/* VL2 000010 */
+	G4_CODE(0x02, 3),	/* VL1 010 */
+	G4_CODE(0x01, 1),	/* V0  1 */
+	G4_CODE(0x03, 3),	/* VR1 011 */
+	G4_CODE(0x03, 6),	/* VR2 000011 */
+	G4_CODE(0x03, 7),	/* VR3 0000011 */
+	G4_CODE(0x01, 4),	/* P   0001 */
+	G4_CODE(0x01, 3),	/* H   001 */
+	G4_CODE(0x00, 7),	/* EOFB, whose first 7 bits are 0 */
+};
+
+static const unsigned int white_terminating_code[64] =
+{
+	G4_CODE(0x035,  8), G4_CODE(0x007,  6), G4_CODE(0x007,  4), G4_CODE(0x008,  4),
+	G4_CODE(0x00b,  4), G4_CODE(0x00c,  4), G4_CODE(0x00e,  4), G4_CODE(0x00f,  4),
+	G4_CODE(0x013,  5), G4_CODE(0x014,  5), G4_CODE(0x007,  5), G4_CODE(0x008,  5),
+	G4_CODE(0x008,  6), G4_CODE(0x003,  6), G4_CODE(0x034,  6), G4_CODE(0x035,  6),
+	G4_CODE(0x02a,  6), G4_CODE(0x02b,  6), G4_CODE(0x027,  7), G4_CODE(0x00c,  7),
+	G4_CODE(0x008,  7), G4_CODE(0x017,  7), G4_CODE(0x003,  7), G4_CODE(0x004,  7),
+	G4_CODE(0x028,  7), G4_CODE(0x02b,  7), G4_CODE(0x013,  7), G4_CODE(0x024,  7),
+	G4_CODE(0x018,  7), G4_CODE(0x002,  8), G4_CODE(0x003,  8), G4_CODE(0x01a,  8),
+	G4_CODE(0x01b,  8), G4_CODE(0x012,  8), G4_CODE(0x013,  8), G4_CODE(0x014,  8),
+	G4_CODE(0x015,  8), G4_CODE(0x016,  8), G4_CODE(0x017,  8), G4_CODE(0x028,  8),
+	G4_CODE(0x029,  8), G4_CODE(0x02a,  8), G4_CODE(0x02b,  8), G4_CODE(0x02c,  8),
+	G4_CODE(0x02d,  8), G4_CODE(0x004,  8), G4_CODE(0x005,  8), G4_CODE(0x00a,  8),
+	G4_CODE(0x00b,  8), G4_CODE(0x052,  8), G4_CODE(0x053,  8), G4_CODE(0x054,  8),
+	G4_CODE(0x055,  8), G4_CODE(0x024,  8), G4_CODE(0x025,  8), G4_CODE(0x058,  8),
+	G4_CODE(0x059,  8), G4_CODE(0x05a,  8), G4_CODE(0x05b,  8), G4_CODE(0x04a,  8),
+	G4_CODE(0x04b,  8), G4_CODE(0x032,  8), G4_CODE(0x033,  8), G4_CODE(0x034,  8),
+};
+
+static const unsigned int black_terminating_code[64] =
+{
+	G4_CODE(0x037, 10), G4_CODE(0x002,  3), G4_CODE(0x003,  2), G4_CODE(0x002,  2),
+	G4_CODE(0x003,  3), G4_CODE(0x003,  4), G4_CODE(0x002,  4), G4_CODE(0x003,  5),
+	G4_CODE(0x005,  6), G4_CODE(0x004,  6), G4_CODE(0x004,  7), G4_CODE(0x005,  7),
+	G4_CODE(0x007,  7), G4_CODE(0x004,  8), G4_CODE(0x007,  8), G4_CODE(0x018,  9),
+	G4_CODE(0x017, 10), G4_CODE(0x018, 10), G4_CODE(0x008, 10), G4_CODE(0x067, 11),
+	G4_CODE(0x068, 11), G4_CODE(0x06c, 11), G4_CODE(0x037, 11), G4_CODE(0x028, 11),
+	G4_CODE(0x017, 11), G4_CODE(0x018, 11), G4_CODE(0x0ca, 12), G4_CODE(0x0cb, 12),
+	G4_CODE(0x0cc, 12), G4_CODE(0x0cd, 12), G4_CODE(0x068, 12), G4_CODE(0x069, 12),
+	G4_CODE(0x06a, 12), G4_CODE(0x06b, 12), G4_CODE(0x0d2, 12), G4_CODE(0x0d3, 12),
+	G4_CODE(0x0d4, 12), G4_CODE(0x0d5, 12), G4_CODE(0x0d6, 12), G4_CODE(0x0d7, 12),
+	G4_CODE(0x06c, 12), G4_CODE(0x06d, 12), G4_CODE(0x0da, 12), G4_CODE(0x0db, 12),
+	G4_CODE(0x054, 12), G4_CODE(0x055, 12), G4_CODE(0x056, 12), G4_CODE(0x057, 12),
+	G4_CODE(0x064, 12), G4_CODE(0x065, 12), G4_CODE(0x052, 12), G4_CODE(0x053, 12),
+	G4_CODE(0x024, 12), G4_CODE(0x037, 12), G4_CODE(0x038, 12), G4_CODE(0x027, 12),
+	G4_CODE(0x028, 12), G4_CODE(0x058, 12), G4_CODE(0x059, 12), G4_CODE(0x02b, 12),
+	G4_CODE(0x02c, 12), G4_CODE(0x05a, 12), G4_CODE(0x066, 12), G4_CODE(0x067, 12),
+};
+
+   /*
+    * In both make up code tables, entry i is the code for a run of 64 times
+    * i + 1.  The codes from index 27 on are colorless and represent runs
+    * from 1792 pixels to 2560 pixels.
+    */
+static const unsigned int white_make_up_code[40] =
+{
+	G4_CODE(0x01b,  5), G4_CODE(0x012,  5), G4_CODE(0x017,  6), G4_CODE(0x037,  7),
+	G4_CODE(0x036,  8), G4_CODE(0x037,  8), G4_CODE(0x064,  8), G4_CODE(0x065,  8),
+	G4_CODE(0x068,  8), G4_CODE(0x067,  8), G4_CODE(0x0cc,  9), G4_CODE(0x0cd,  9),
+	G4_CODE(0x0d2,  9), G4_CODE(0x0d3,  9), G4_CODE(0x0d4,  9), G4_CODE(0x0d5,  9),
+	G4_CODE(0x0d6,  9), G4_CODE(0x0d7,  9), G4_CODE(0x0d8,  9), G4_CODE(0x0d9,  9),
+	G4_CODE(0x0da,  9), G4_CODE(0x0db,  9), G4_CODE(0x098,  9), G4_CODE(0x099,  9),
+	G4_CODE(0x09a,  9), G4_CODE(0x018,  6), G4_CODE(0x09b,  9), G4_CODE(0x008, 11),
+	G4_CODE(0x00c, 11), G4_CODE(0x00d, 11), G4_CODE(0x012, 12), G4_CODE(0x013, 12),
+	G4_CODE(0x014, 12), G4_CODE(0x015, 12), G4_CODE(0x016, 12), G4_CODE(0x017, 12),
+	G4_CODE(0x01c, 12), G4_CODE(0x01d, 12), G4_CODE(0x01e, 12), G4_CODE(0x01f, 12),
+};
+
+static const unsigned int black_make_up_code[40] =
+{
+	G4_CODE(0x00f, 10), G4_CODE(0x0c8, 12), G4_CODE(0x0c9, 12), G4_CODE(0x05b, 12),
+	G4_CODE(0x033, 12), G4_CODE(0x034, 12), G4_CODE(0x035, 12), G4_CODE(0x06c, 13),
+	G4_CODE(0x06d, 13), G4_CODE(0x04a, 13), G4_CODE(0x04b, 13), G4_CODE(0x04c, 13),
+	G4_CODE(0x04d, 13), G4_CODE(0x072, 13), G4_CODE(0x073, 13), G4_CODE(0x074, 13),
+	G4_CODE(0x075, 13), G4_CODE(0x076, 13), G4_CODE(0x077, 13), G4_CODE(0x052, 13),
+	G4_CODE(0x053, 13), G4_CODE(0x054, 13), G4_CODE(0x055, 13), G4_CODE(0x05a, 13),
+	G4_CODE(0x05b, 13), G4_CODE(0x064, 13), G4_CODE(0x065, 13), G4_CODE(0x008, 11),
+	G4_CODE(0x00c, 11), G4_CODE(0x00d, 11), G4_CODE(0x012, 12), G4_CODE(0x013, 12),
+	G4_CODE(0x014, 12), G4_CODE(0x015, 12), G4_CODE(0x016, 12), G4_CODE(0x017, 12),
+	G4_CODE(0x01c, 12), G4_CODE(0x01d, 12), G4_CODE(0x01e, 12), G4_CODE(0x01f, 12),
+};
+
+/******************************************************************************
+
+	Lookup tables indexed by the next bits of the datastream.  Each entry
+	holds the mode less VL3, or the run length, above the length of its
+	code in the low 4 bits.  An entry of 0 is not a valid code.  The tables
+	are built once, on the first decode.
+
+******************************************************************************/
+static unsigned short mode_table[1 << Mode_bits];
+static unsigned short white_table[1 << White_bits];
+static unsigned short black_table[1 << Black_bits];
+static pthread_once_t code_tables_once = PTHREAD_ONCE_INIT;
+
+
+/***********************************************************************
+*   grp4decomp is the main routine of this file.  It decodes the image *
+*   with a context of its own, into an output buffer the caller has    *
+*   made big enough.  On an error the length returned is 0.            *
+************************************************************************/
 /********************************************************************
 *  Arguments							    *
 *  ---------							    *
@@ -77,1265 +200,534 @@ int  width,int  height,
 unsigned char  *outdata,
 int  *outbytes)
 {
-struct compressed_descriptor 	compressed;
-struct decompressed_descriptor  decompressed;
-
-	compressed.pixels_per_line = width;
-	compressed.number_of_lines = height;
-	compressed.length_in_bytes = inbytes;
-        compressed.data = (char *)indata;
-        decomp_alloc_flag = NOALLOC;
-        decomp_write_init_flag = True;
-        decomp_read_init_flag = True;
-	read_compressed_file_into_memory(&compressed);
-	decompressed.data = (char *)outdata;
-	control_decompression( &compressed, &decompressed );
-	*outbytes = 
-        (decompressed.pixels_per_line >> 3) * decompressed.number_of_lines;
+   G4_DEC_CTX *ctx;
+
+   *outbytes = 0;
+   if(alloc_G4_DEC_CTX(&ctx))
+      return;
+   if(grp4decomp_ctx(ctx, indata, inbytes, width, height, outdata, INT_MAX,
+                     outbytes))
+      *outbytes = 0;
+   free_G4_DEC_CTX(ctx);
 }
 
 
-/***************************** control_decompression **************************
-	
-	calls the functions that decompress the compressed file
-			
-*****************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   compressed - structure containing the # of       *
-*			        pixels per line, the number of      *
-*				lines, and the compressed data.     *
-*	Returned:						    *
-*		   decompressed - structure containing the # of     *
-*			          pixels per line, the number of    *
-*				  lines, and the compressed data.   *
-********************************************************************/
-void control_decompression(
-struct compressed_descriptor *compressed,
-struct decompressed_descriptor *decompressed)
+/***********************************************************************
+*   Allocates a Group 4 decoder context with no line buffers.          *
+************************************************************************/
+int alloc_G4_DEC_CTX(G4_DEC_CTX **octx)
 {
-struct parameters  sole_parameters;
-struct parameters *params = &sole_parameters;
-
-#ifdef TIME
-  SHORT i;
-	tz.tz_minuteswest = 0;
-	tz.tz_dsttime = 0;
-	gettimeofday(&t1, &tz);
-#endif
-
-	prepare_to_decompress( compressed, decompressed, params );
-	while(decompress_line( params ) != EOFB )  
-	      prepare_to_decompress_next_line( params );
-        /* memory deallocation added by Michael D. Garris 2/23/90 */
-        free(params->reference_line);
-        free(params->coding_line);
-        free(all_white);
-        free(all_black);
-#ifdef TIME
-	gettimeofday(&t2, &tz);
-	printf("\ntime difference: %ld:%ld\n", t2.tv_sec - t1.tv_sec,
-	t2.tv_usec - t1.tv_usec);
-	for(i=0; i<5; i++) printf("%c",'\07');
-#endif
+   G4_DEC_CTX *ctx;
 
-}
+   ctx = (G4_DEC_CTX *)calloc(1, sizeof(G4_DEC_CTX));
+   if(ctx == (G4_DEC_CTX *)NULL){
+      fprintf(stderr, "ERROR : alloc_G4_DEC_CTX : calloc : ctx\n");
+      return(-2);
+   }
 
+   *octx = ctx;
+   return(0);
+}
 
-/************************ read_compressed_file_into_memory *********************
-	
-		allocates memory for the compressed image     		
-			
-*****************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   compressed - structure containing the # of       *
-*			        pixels per line, the number of      *
-*				lines, and the compressed data.     *
-*	Returned:						    *
-*		   compressed - structure containing the # of       *
-*			          pixels per line, the number of    *
-*				  lines, and the compressed data.   *
-********************************************************************/
-void read_compressed_file_into_memory(
-struct compressed_descriptor *compressed)
-{
 
-     if(decomp_alloc_flag){
- 	if((compressed->data = (char *)calloc(compressed->length_in_bytes,
-                                              sizeof(char))) == NULL) {
- 	    printf("\nCannot allocate enough memory for compressed file.\n");
- 	    exit(1);
- 	}
-     }
-     else
-        if(compressed->data == NULL){
-           printf("\nNo memory allocated for input data!\n");
-           exit(1);
-        }
-} /* end read_compressed_file_into_memory() */
-
-	 		
-	
-/*************************** prepare_to_decompress ****************************
-	
-		initializes variables in preperation for decompression		
-			
-*****************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   compressed - structure containing the # of       *
-*			        pixels per line, the number of      *
-*				lines, and the compressed data.     *
-*	Returned:						    *
-*		   decompressed - structure containing the # of     *
-*			          pixels per line, the number of    *
-*				  lines, and the compressed data.   *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-********************************************************************/
-void prepare_to_decompress(
-struct compressed_descriptor 	*compressed,
-struct decompressed_descriptor  *decompressed,
-struct parameters *params)
-{
-	
-	params->max_pixel = compressed->pixels_per_line;
-	decompressed->pixels_per_line = compressed->pixels_per_line;
-	decompressed->number_of_lines = compressed->number_of_lines;
-	
-	set_up_first_line_d( params );
-	prepare_to_read_bits( compressed->data );
-        if(decomp_alloc_flag){
-           decompressed->data = (char *)calloc( 
-           compressed->pixels_per_line *compressed->number_of_lines /Pixels_per_byte, 
-	   sizeof(char) );
-        }
-        else
-           if(decompressed->data == NULL){
-              printf("\nNo memory allocated for decompressed data!\n");
-              exit(1);
-           }
-	prepare_to_write_bits_d( decompressed->data, 
-	 (compressed->pixels_per_line / Pixels_per_byte) );
-				
-} /* end decompress() */
-
-
-
-/******************************* set_up_first_line_d ***************************
-	
-	initializes variables in preperation for decompressing the first line		
-			
-******************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-*	Returned:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-********************************************************************/
-void set_up_first_line_d(
-struct parameters *params)
+/***********************************************************************
+*   Deallocates a Group 4 decoder context and its line buffers.        *
+************************************************************************/
+void free_G4_DEC_CTX(G4_DEC_CTX *ctx)
 {
+   if(ctx == (G4_DEC_CTX *)NULL)
+      return;
 
-	params->reference_line = (SHORT *)malloc( (params->max_pixel + 
-                                          Extra_positions) * sizeof(SHORT) );
-	params->coding_line = (SHORT *)malloc( (params->max_pixel +
-                                       Extra_positions) * sizeof(SHORT) );
-	
-	*(params->reference_line + 0) = Invalid;		
-	*(params->reference_line + 1) = params->max_pixel;
-	*(params->reference_line + 2) = params->max_pixel;
-	*(params->reference_line + 3) = params->max_pixel;
-	
-	/* initialize first changing element on coding line (a0 = -1) */
-	*(params->coding_line) = Invalid;
-	
-	params->index = 0;
-
-} /* end set_up_first_line_d() */
-
-
-
-/******************* set_up_first_and_last_changing_elements_d *****************
-	
-	initializes the first and last changing elements in the coding line			
-			
-******************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-*	Returned:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-********************************************************************/
-void set_up_first_and_last_changing_elements_d(
-struct parameters *params)
-{
-	*(params->coding_line) = Invalid;
-	
-	/*
-	 * set up the imaginary first changing pixel with an illegal value.
-	 */
-	 
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	*(params->coding_line + ++params->index) = params->max_pixel;
-	
-	/* 
-	 * set up three changing pixels at the end of the line, all of which
-	 * contain the end-of-line flag "max_pixel."  It is necessary to create
-	 * three of these flags because the changing elements a0 - b2 are sometimes
-	 * advanced by more than one element at a time (and therefore could skip
-	 * over a single flag).
-	 */
+   free(ctx->reference_line);
+   free(ctx->coding_line);
+   free(ctx);
 }
 
 
+/****************************** add_code ***********************************
 
-/*********************** prepare_to_decompress_next_line *********************
-	
-	initializes variables in preperation for decompressing another line	
-			
-******************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-*	Returned:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-********************************************************************/
-void prepare_to_decompress_next_line(
-struct parameters *params)
-{
-	
-	set_up_first_and_last_changing_elements_d( params );
-	swap_the_reference_and_coding_lines( params );
-	params->index = 0;
-
-} /* end prepare_to_decompress_next_line() */ 
-
-
+	fills the entries of a lookup table of "nbits" bits whose index starts
+	with a code.
 
-/******************** swap_the_reference_and_coding_lines ********************
-	
-	 	      swaps the reference and coding lines	
-			
 *****************************************************************************/
-/********************************************************************
-*  Arguments							    *
-*  ---------							    *
-*	Passed in:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-*	Returned:						    *
-*		   params - structure storing information needed    *
-*			    for comparison and other tasks.         *
-********************************************************************/
-void swap_the_reference_and_coding_lines(
-struct parameters *params)
+static void add_code(
+unsigned short *table,
+const int nbits,
+const unsigned int code,
+const int value)
 {
-SHORT *temp;
-	
-	temp = params->reference_line;
-	params->reference_line 	= params->coding_line;
-	params->coding_line = temp;
-		
-} /* end swap_the_reference_and_coding_lines() */ 
-
+int len, first, n, i;
 
-
-/*********************************** crash_d ***********************************
-	
-		forces the program to crash and create a core file
-			
-******************************************************************************/
-void crash_d(void)
-{
-FILE *crash_program = NULL;
-	fprintf(crash_program,"This will kill the program and create a core file");
+	len = G4_CODE_LEN(code);
+	first = G4_CODE_BITS(code) << (nbits - len);
+	n = 1 << (nbits - len);
+	for(i = 0; i < n; i++)
+		table[first + i] = (unsigned short)((value << 4) | len);
 }
 
 
-/***************************************************************************/
-/* Originally decomp.c                                                     */
-/***************************************************************************/
+/************************* build_code_tables ******************************
 
-static struct changing_element {
-	SHORT color; 					/* the color of the pixel */
-	SHORT pixel; 					/* the position of the pixel on the line */
-} a0, a1; 		 		
+	builds the lookup tables of mode and run length codes.
 
-static SHORT  	b1, b2;				/* an index into reference_line */
-
-
-
-/******************************* decompress_line *****************************
-
-					decompress one line of the compressed image
-			
-******************************************************************************/
-SHORT decompress_line(
-struct parameters *params)
+*****************************************************************************/
+static void build_code_tables(void)
 {
-SHORT mode;
+int i;
 
-#if Debug
-	static SHORT current_line = 0;
-	printf("\n\nLINE: %d\n", current_line);
-	current_line++;
-#endif
+	for(i = 0; i <= EOFB - VL3; i++)
+		add_code(mode_table, Mode_bits, mode_code[i], i);
 
-	b1 = 1; /* this puts b1 on the first black element in the reference line ,
-			 * which is appropriate  because a0 is white and on -1 */
-	a0.pixel = 0;
-	a0.color = White; 
-	do {
-		
-#if Debug
-		printf("a0:%d, a1:%d, b1:%d", a0.pixel, a1.pixel,
-		 *(params->reference_line + b1));
-#endif
-		mode =  get_mode();
-		switch( mode ) {
-
-		case	V0:	
-		
-		case	VR1:
-		
-		case	VL1:
-		
-		case	VR2:
-		
-		case	VL2:
-		
-		case	VR3:
-		
-		case 	VL3:	vertical_mode_d( params, mode );
-						break;
-
-		case	H:		horizontal_mode_d( params );
-						break;
-
-		case	P:		pass_mode_d( params );
-						continue;
-
-		case	EOFB:   return( EOFB );
-
-		default:		crash_d();
-
-		} /* end case of different modes */
-		
-	} while(a0.pixel < params->max_pixel);
-	return( Not_done_yet );
-	
-} 	/* end decompress_line */
-
-
-
-/********************************** get_mode **********************************
-
-					read a mode code from the compressed image
-			
-******************************************************************************/
-SHORT get_mode(void)
-{
-SHORT i;
+	for(i = 0; i <= Max_terminating_length; i++) {
+		add_code(white_table, White_bits, white_terminating_code[i], i);
+		add_code(black_table, Black_bits, black_terminating_code[i], i);
+	}
+	for(i = 0; i < 40; i++) {
+		add_code(white_table, White_bits, white_make_up_code[i],
+		         (i + 1) << 6);
+		add_code(black_table, Black_bits, black_make_up_code[i],
+		         (i + 1) << 6);
+	}
+}
 
-	if (read_bit() == 1)	 
-		return(V0);								/* 1 */
 
-	if (read_bit() == 1) {
-		if (read_bit() == 1)  
-			return(VR1);						/* 011 */
-		else
-		   	return(VL1);						/* 010 */
-	}					
-	else {
-		if (read_bit() == 1)  
-		   	return(H);							/* 001 */
-		if (read_bit() == 1)  
-		   	return(P);							/* 0001 */
-	    if (read_bit() == 1) {
-	    	if (read_bit() == 1)
-	    		return(VR2);					/* 000011 */
-	    	else
-	    		return(VL2);					/* 000010 */
-		}
-		else {
-			if (read_bit() == 1) {
-		    	if (read_bit() == 1)
-		    		return(VR3);				/* 0000011 */
-		    	else
-	    			return(VL3);				/* 0000010 */
-	    	}
-			else {
-			
-				/*
-				 * Have read 6 zero's so far.  The only valid code now
-				 * possible is EOFB: 00000000000100000000001.
-				 */
-				
-				for(i=0;i<5;i++)
- 					if (read_bit() != 0) 
- 						crash_d();
- 		
- 				if (read_bit() != 1) 
- 					crash_d();
- 			
- 				for(i=0;i<11;i++)
- 					if (read_bit() != 0) 
- 						crash_d();
-	
- 				if (read_bit() != 1) 
- 					crash_d();
-		
-				return(EOFB);					/* 00000000000100000000001 */
-			}
-		}
-	}
-	
-} /* end get_mode() */
+/* Bits of a compressed image being read. */
+typedef struct g4_bits {
+	unsigned char *inptr;	/* next byte of the compressed image */
+	unsigned char *inend;	/* end of the compressed image */
+	unsigned long long bits;/* bits read ahead, next bit highest */
+	int    nbits;			/* number of bits in "bits" */
+	int    npad;			/* zero bytes read past the end */
+} G4_BITS;
 
 
-/********************************** pass_mode_d ********************************
+/******************************* read_bits **********************************
 
-							decompress a pass mode code
-			
-******************************************************************************/
-void pass_mode_d(
-struct parameters *params)
-{
-SHORT run_length;
-	
-	b2 = b1 + 1;
-	run_length = *(params->reference_line + b2) - a0.pixel;
-	write_bits_d(run_length, a0.color);
-	
-#if Debug
-	printf(" P   Run:%d,  Color:%d\n", run_length, a0.color);
-#endif
-
-	a0.pixel += run_length;
-	/* a0.color does not change during pass_mode_d() */
-	b1 += 2;
-} /* end pass_mode_d() */
-
-
-/******************************* vertical_mode_d *******************************
-
-			decompress a vertical mode code
-			
-******************************************************************************/
-void vertical_mode_d(
-struct parameters *params,
-SHORT offset)
+	tops up the bits read ahead from the compressed image to more than 56.
+	Past the end of the data, zero bytes are read and counted; no code is
+	all zeros, so a decode that runs off the end fails on a bad code.
+
+*****************************************************************************/
+static void read_bits(
+G4_BITS *in)
 {
-SHORT run_length;
-	
-	a1.pixel = *(params->reference_line + b1) + offset;
-	run_length = a1.pixel - a0.pixel;
-	write_bits_d(run_length, a0.color);
-	
-#if Debug
-	printf(" V%d   Run:%d,  Color:%d\n", offset, run_length, a0.color);
-#endif
-
-	a0.pixel = a1.pixel;
-	a0.color = ! a0.color;
-	*(params->coding_line + ++params->index) = a0.pixel;
-
-	/* 
-	 * The color of a0 changes after each vertical mode coding.
-	 */
-	 
-	if ((offset == -1) || (offset == 0)) {
-		if ( *(params->reference_line + b1) != params->max_pixel ) 
-			b1++;
+unsigned long long word;
+unsigned char *p;
+
+	if(in->inend - in->inptr >= 8) {
+		/* load the next 8 bytes, keeping the whole ones that fit */
+		p = in->inptr;
+		word = ((unsigned long long)p[0] << 56) |
+		       ((unsigned long long)p[1] << 48) |
+		       ((unsigned long long)p[2] << 40) |
+		       ((unsigned long long)p[3] << 32) |
+		       ((unsigned long long)p[4] << 24) |
+		       ((unsigned long long)p[5] << 16) |
+		       ((unsigned long long)p[6] << 8) |
+		       (unsigned long long)p[7];
+		in->bits |= word >> in->nbits;
+		in->inptr += (63 - in->nbits) >> 3;
+		in->nbits |= 56;
+		in->bits &= ~0ULL << (64 - in->nbits);
 		return;
 	}
-	
-	if ((offset == 1) || (offset == 2)) {
-		b1++;
-		if ( (*(params->reference_line + b1) <= a0.pixel)  && 
-		 (*(params->reference_line + b1) != params->max_pixel) ) 
-					b1 += 2;
-		return;
-	}
-	
-	if ((offset == -2) || (offset == -3)) {
-		if ( *(params->reference_line + b1 - 1) > a0.pixel ) 
-			b1--;
-		else { if ( *(params->reference_line + b1) != params->max_pixel ) 
-			b1++;
-		return;
-		}
-	}	
-				 
-	if (offset == 3) {
-		b1++;
-		while ( (*(params->reference_line + b1) <= a0.pixel)  && 
-		 (*(params->reference_line + b1) != params->max_pixel) ) 
-			b1 += 2;
-		return;
+
+	while(in->nbits <= 56) {
+		if(in->inptr < in->inend)
+			in->bits |= (unsigned long long)*in->inptr++ << (56 - in->nbits);
+		else
+			in->npad++;
+		in->nbits += Bits_per_byte;
 	}
-	
-} /* end vertical_mode_d() */
+}
 
-	
+#define peek_bits(in, n)	((unsigned int)((in)->bits >> (64 - (n))))
+#define skip_bits(in, n)	((in)->bits <<= (n), (in)->nbits -= (n))
 
 
-/******************************* horizontal_mode_d *****************************
+/************************* find_run_length_code ******************************
 
-			decompress a horizontal mode code
-			
-******************************************************************************/
-void horizontal_mode_d(
-struct parameters *params)
+	finds the length of the run in the compressed image from its make up
+	and terminating codes.  Returns -1 on a bad code, or a run longer than
+	"max_length".
+
+*****************************************************************************/
+static SHORT find_run_length_code(
+G4_BITS *in,
+const SHORT color,
+const SHORT max_length)
 {
+unsigned int entry;
 SHORT length, total_length = 0;
 
 	do {
-		length = find_run_length_code(a0.color);	
+		if(in->nbits < EOFB_len)
+			read_bits(in);
+		if(color == White)
+			entry = white_table[peek_bits(in, White_bits)];
+		else
+			entry = black_table[peek_bits(in, Black_bits)];
+		if(entry == 0)
+			return(-1);
+		skip_bits(in, entry & 0xf);
+		length = entry >> 4;
 		total_length += length;
-	} while (length > Max_terminating_length);
+		if(total_length > max_length)
+			return(-1);
+	} while(length > Max_terminating_length);
 
 	/*
 	 *  Run lengths greater than 63 are followed by terminating codes.
 	 *  Thus if "length" is greater than 63, the terminating code must
 	 *  also be fetched in order to determine the total run length.
-	 *
 	 */
-	
-	write_bits_d(total_length, a0.color);
 
-#if Debug
-	printf(" H   Run:%d,  Color:%d\n", total_length, a0.color);
-#endif
+	return(total_length);
+}
 
-	a0.pixel += total_length;
-	a0.color = !a0.color;
-	*(params->coding_line + ++params->index) = a0.pixel;
 
-	/*
-	 * a0's color changes after each run color.
-	 */
+/******************************* decompress_line *****************************
 
-	total_length = 0;
-	do {
-		length = find_run_length_code(a0.color);	
-		total_length += length;
-	} while (length > Max_terminating_length);
-
-	write_bits_d(total_length, a0.color);
-	
-#if Debug
-	printf("   Run:%d,  Color:%d\n", total_length, a0.color);
-#endif
-
-	a0.pixel += total_length;
-	a0.color = !a0.color;
-	*(params->coding_line + ++params->index) = a0.pixel;
-	
-	while (  (*(params->reference_line + b1) <= a0.pixel)  && 
-	 ( *(params->reference_line + b1) < params->max_pixel)  )
-		{
-		b1 += 2;   /* must move ahead by 2 to maintain color difference with */
-				   /* a0, whose color does not change in this mode. */
-		}
-		
-} /* end horizontal_mode_d() */
+	decompress one line of the compressed image into the changing
+	elements of "coding", setting the number found, from those of
+	"ref", the line above.  Returns End_of_image on an EOFB in place of
+	the line.  b2 is always the element after b1.  The bits being read
+	are copied in and out, so they are not reloaded after each element
+	is stored.
 
+******************************************************************************/
+static SHORT decompress_line(
+G4_BITS *in,
+const SHORT *ref,
+SHORT *coding,
+const SHORT max_index,
+const SHORT max_pixel,
+SHORT *oindex)
+{
+G4_BITS rd = *in;
+SHORT a0, a0_color, a1, b1, index, mode, length, ret;
+unsigned int entry;
 
-/***************************************************************************/
-/* Originally write.c                                                      */
-/***************************************************************************/
+	b1 = 1; /* this puts b1 on the first black element in the reference line ,
+			 * which is appropriate  because a0 is white and on -1 */
+	a0 = 0;
+	a0_color = White;
+	index = 0;
+	coding[0] = Invalid;
+	ret = Line_done;
 
-static char		write_one[Pixels_per_byte] = 
-{
-	(char)0x80, /* 10000000b: with | operator, it writes a one to bit 0 */
-	(char)0x40, /* 01000000b: with | operator, it writes a one to bit 1 */
-	(char)0x20, /* 00100000b: with | operator, it writes a one to bit 2 */
-	(char)0x10, /* 00010000b: with | operator, it writes a one to bit 3 */
-	(char)0x8,  /* 00001000b: with | operator, it writes a one to bit 4 */
-	(char)0x4,  /* 00000100b: with | operator, it writes a one to bit 5 */
-	(char)0x2,  /* 00000010b: with | operator, it writes a one to bit 6 */
-	(char)0x1,  /* 00000001b: with | operator, it writes a one to bit 7 */
-};
+	do {
+		if(rd.nbits < EOFB_len)
+			read_bits(&rd);
+		entry = mode_table[peek_bits(&rd, Mode_bits)];
+		if(entry == 0) {
+			ret = Bad_code;
+			break;
+		}
+		mode = (SHORT)(entry >> 4) + VL3;
 
-static char 	write_zero[Pixels_per_byte] =
-{
-	(char)0x7F, /* 01111111b: with & operator, it writes a zero to bit 0 */
-	(char)0xBF, /* 10111111b: with & operator, it writes a zero to bit 1 */	
-	(char)0xDF, /* 11011111b: with & operator, it writes a zero to bit 2 */
-	(char)0xEF, /* 11101111b: with & operator, it writes a zero to bit 3 */
-	(char)0xF7, /* 11110111b: with & operator, it writes a zero to bit 4 */
-	(char)0xFB, /* 11111011b: with & operator, it writes a zero to bit 5 */
-	(char)0xFD, /* 11111101b: with & operator, it writes a zero to bit 6 */
-	(char)0xFE, /* 11111110b: with & operator, it writes a zero to bit 7 */
-};
+		switch(mode) {
 
+		case P:
+			skip_bits(&rd, entry & 0xf);
+			a1 = ref[b1 + 1];
+			if(a1 < a0 || a1 > max_pixel) {
+				ret = Bad_element;
+				break;
+			}
+			/* a0's color does not change in pass mode */
+			a0 = a1;
+			b1 += 2;
+			break;
 
+		case H:
+			skip_bits(&rd, entry & 0xf);
+			if(index + 2 > max_index) {
+				ret = Bad_element;
+				break;
+			}
 
-/************************* prepare_to_write_bits_d ******************************
-	
-	initializes variables in preperation for writing decompressed data
-			
-******************************************************************************/	
-void prepare_to_write_bits_d(
-char *output_pointer,
-SHORT bytes_per_line)
-{
-	output_area = output_pointer;
-	
-	all_white = (char *)calloc( bytes_per_line, sizeof(char) );
-	all_black = (char *)calloc( bytes_per_line, sizeof(char) );
-	memset(all_black, Black_byte, bytes_per_line);
-	/* set all the pixels in "all_black" to '1' */
-}
-	
-	
+			length = find_run_length_code(&rd, a0_color, max_pixel - a0);
+			if(length < 0) {
+				ret = Bad_code;
+				break;
+			}
+			a0 += length;
+			coding[++index] = a0;
 
-/******************************* write_bits_d ***********************************
-	
-  writes a number of bits of the same color to the memory buffer that holds
-  the decompressed image.
-  			
-******************************************************************************/
-void write_bits_d(
-unsigned SHORT length,
-unsigned SHORT color)
-{
-static unsigned SHORT	 write_on_this_bit = 0;
-static unsigned int 	 write_on_this_byte = 0;
-unsigned int			 bytes;
-
-        /* global switch added by Michael D. Garris 2/23/90 */
-        if(decomp_write_init_flag){
-           write_on_this_bit = 0;
-           write_on_this_byte = 0;
-           decomp_write_init_flag = False;
-        }
-	if (color == Black) {	
-		while( (length>0) && (write_on_this_bit != 0) ) {
-			*(output_area + write_on_this_byte) |= write_one[write_on_this_bit];
-			length--;
-			if (write_on_this_bit == Last_bit_in_a_byte) {
-				write_on_this_bit = 0;
-				write_on_this_byte++;
+			length = find_run_length_code(&rd, !a0_color, max_pixel - a0);
+			if(length < 0) {
+				ret = Bad_code;
+				break;
 			}
-			else
-				write_on_this_bit++;
-		}
-	
-		memcpy((output_area+write_on_this_byte), all_black, (bytes=(length/8)));
-		write_on_this_byte += bytes;
-		length %= Bits_per_byte;
-	
-		while( length>0 ) {
-			*(output_area + write_on_this_byte) |= write_one[write_on_this_bit];
-			length--;
-			if (write_on_this_bit == Last_bit_in_a_byte) {
-				write_on_this_bit = 0;
-				write_on_this_byte++;
+			a0 += length;
+			coding[++index] = a0;
+
+			/* a0's color changes after each run, so is back as it was */
+			while((ref[b1] <= a0) && (ref[b1] < max_pixel))
+				b1 += 2; /* must move ahead by 2 to maintain color
+				          * difference with a0 */
+			break;
+
+		case EOFB:
+			if(index != 0 || a0 != 0 ||
+			   peek_bits(&rd, EOFB_len) != EOFB_bits) {
+				ret = Bad_code;
+				break;
 			}
-			else
-				write_on_this_bit++;
-		}
-	} 		/* end if color is black */
-	else {	
-		while( (length>0) && (write_on_this_bit != 0) ) {
-			*(output_area + write_on_this_byte) &=write_zero[write_on_this_bit];
-			length--;
-			if (write_on_this_bit == Last_bit_in_a_byte) {
-				write_on_this_bit = 0;
-				write_on_this_byte++;
+			skip_bits(&rd, EOFB_len);
+			ret = End_of_image;
+			break;
+
+		default:
+			/* vertical mode, offset by the mode from b1 */
+			skip_bits(&rd, entry & 0xf);
+			a1 = ref[b1] + mode;
+			if(a1 < a0 || a1 > max_pixel || index + 1 > max_index) {
+				ret = Bad_element;
+				break;
 			}
-			else
-				write_on_this_bit++;
-		}
-	
-		memcpy((output_area+write_on_this_byte), all_white, (bytes=(length/8)));
-		write_on_this_byte += bytes;
-		length %= Bits_per_byte;
-	
-		while( length>0 ) {
-			*(output_area + write_on_this_byte) &=write_zero[write_on_this_bit];
-			length--;
-			if (write_on_this_bit == Last_bit_in_a_byte) {
-				write_on_this_bit = 0;
-				write_on_this_byte++;
+			a0 = a1;
+			a0_color = !a0_color;
+			coding[++index] = a0;
+
+			switch(mode) {
+			case V0:
+			case VL1:
+				if(ref[b1] != max_pixel)
+					b1++;
+				break;
+			case VR1:
+			case VR2:
+				b1++;
+				if((ref[b1] <= a0) && (ref[b1] != max_pixel))
+					b1 += 2;
+				break;
+			case VR3:
+				b1++;
+				while((ref[b1] <= a0) && (ref[b1] != max_pixel))
+					b1 += 2;
+				break;
+			default: /* VL2 and VL3 */
+				if(ref[b1 - 1] > a0)
+					b1--;
+				else if(ref[b1] != max_pixel)
+					b1++;
+				break;
 			}
-			else
-				write_on_this_bit++;
+			break;
 		}
-	} /* end if color is white */
-} /* end write_bits_d() */
 
+	} while(ret == Line_done && a0 < max_pixel);
 
-/***************************************************************************/
-/* Originally read.c                                                       */
-/***************************************************************************/
+	*in = rd;
+	if(ret != Line_done)
+		return(ret);
 
-static char 	*input_area;
+	/*
+	 * set up three changing pixels at the end of the line, all of which
+	 * contain the end-of-line flag "max_pixel."  It is necessary to create
+	 * three of these flags because the changing elements a0 - b2 are
+	 * sometimes advanced by more than one element at a time (and therefore
+	 * could skip over a single flag).
+	 */
+	coding[index + 1] = max_pixel;
+	coding[index + 2] = max_pixel;
+	coding[index + 3] = max_pixel;
 
-static char	read_bit_mask[Pixels_per_byte] = 
-{
-	(char)0x80, /* 10000000b: with & operator, it reads bit 0 */
-	(char)0x40, /* 01000000b: with & operator, it reads bit 1 */
-	(char)0x20, /* 00100000b: with & operator, it reads bit 2 */
-	(char)0x10, /* 00010000b: with & operator, it reads bit 3 */
-	(char)0x8,  /* 00001000b: with & operator, it reads bit 4 */
-	(char)0x4,  /* 00000100b: with & operator, it reads bit 5 */
-	(char)0x2,  /* 00000010b: with & operator, it reads bit 6 */
-	(char)0x1,  /* 00000001b: with & operator, it reads bit 7 */
-};
+	*oindex = index;
+	return(Line_done);
+}
 
 
+/******************************* write_bits_d ***********************************
 
-/************************* prepare_to_read_bits ******************************
+  writes the pixels from bit "from" up to bit "to" of the decompressed image
+  in one color, setting whole bytes at once.
 
-		 initialize a local, static variable, input_area
-	 		
 ******************************************************************************/
-void prepare_to_read_bits( char *input_pointer)
+static void write_bits_d(
+unsigned char *output_area,
+const long from,
+const long to,
+const SHORT color)
 {
-	input_area = input_pointer;
+unsigned char fill, head, tail;
+long first, last;
+
+	if(from >= to)
+		return;
+
+	fill = (color == Black) ? 0xff : 0;
+	first = from >> 3;
+	last = to >> 3;
+	head = (unsigned char)(0xff >> (from & 7));
+	tail = (unsigned char)~(0xff >> (to & 7));
+
+	if(first == last) {
+		head &= tail;
+		output_area[first] = (output_area[first] & ~head) | (fill & head);
+		return;
+	}
+
+	output_area[first] = (output_area[first] & ~head) | (fill & head);
+	memset(output_area + first + 1, fill, last - first - 1);
+	if(to & 7)
+		output_area[last] = (output_area[last] & ~tail) | (fill & tail);
 }
 
 
-/******************************* read_bit *************************************
+/**************************** write_black_bits_d ********************************
+
+  sets the pixels from bit "from" up to bit "to" of the decompressed image
+  black, where they have already been written white.  Most runs are short,
+  so the bytes between the ends are set in a loop rather than a call.
 
-   returns the value of the current bit of the compressed image (e.g. 1 or 0)
-	 		
 ******************************************************************************/
-SHORT read_bit(void)
+static void write_black_bits_d(
+unsigned char *output_area,
+const long from,
+const long to)
 {
-SHORT bit;
-static unsigned SHORT read_this_bit  = 0;	
-static unsigned int   read_this_byte = 0;
-	
-        /* global switch added by Michael D. Garris 2/23/90 */
-        if(decomp_read_init_flag){
-           read_this_bit = 0;
-           read_this_byte = 0;
-           decomp_read_init_flag = False;
-        }
-	/*
-	 * read_bits gets one bit from the compressed data file,
-	 * and returns it as an integer value of 0 or 1.
-	 */
-	
-	bit = *(input_area + read_this_byte) & read_bit_mask[read_this_bit];
-	if(read_this_bit == Last_bit_in_a_byte) {
-	   read_this_bit = 0;
-	   read_this_byte++;
-	} /* end if current byte completely read */
-	else
-	   read_this_bit++;
-	
-	/*
-	 * NOTE: bit contains 0 if the bit read was 0,
-	 * or a non-zero number if the bit was 1.
-	 */
-	 	
-	return( !(bit == 0) );
-	
-	/*
-	 * the above operation returns a zero if bit is equal to zero, or a 
-	 * one if bit is not equal to zero.
-	 */
+unsigned char head, tail;
+long first, last, i;
 
-} /* end read_bit() */
+	if(from >= to)
+		return;
 
+	first = from >> 3;
+	last = to >> 3;
+	head = (unsigned char)(0xff >> (from & 7));
+	tail = (unsigned char)~(0xff >> (to & 7));
 
-/***************************************************************************/
-/* Originally tree.c                                                       */
-/***************************************************************************/
+	if(first == last) {
+		output_area[first] |= head & tail;
+		return;
+	}
 
-struct node {
-	SHORT value;
-	struct node *child_zero;
-	struct node *child_one;
-}; /* end node struct */
+	output_area[first] |= head;
+	for(i = first + 1; i < last; i++)
+		output_area[i] = 0xff;
+	if(to & 7)
+		output_area[last] |= tail;
+}
 
-static struct node *node_ptr;
 
+/******************************** grp4decomp_ctx *******************************
 
-/*****************************************************************************
-	
-The following declarations create two ordered, unbalanced, binary trees.
-The trees contain run length values, and are ordered by the Huffman codes
-that correspond to those values. 
-	
-******************************************************************************/
+	decompresses the image with the line buffers and bit buffer of "ctx".
+	The lines of the image are written one after the other with no
+	padding between them.  An EOFB in place of a line ends the image
+	early, the lines left being made white.
 
-struct node black_tree[]  = {
-	{  -1,    &black_tree[  2],    &black_tree[  1]},
-	{  -1,    &black_tree[  4],    &black_tree[  3]},
-	{  -1,    &black_tree[  6],    &black_tree[  5]},
-	{   2,    NULL,                NULL},
-	{   3,    NULL,                NULL},
-	{  -1,    &black_tree[  8],    &black_tree[  7]},
-	{  -1,    &black_tree[ 10],    &black_tree[  9]},
-	{   4,    NULL,                NULL},
-	{   1,    NULL,                NULL},
-	{  -1,    &black_tree[ 12],    &black_tree[ 11]},
-	{  -1,    &black_tree[ 14],    &black_tree[ 13]},
-	{   5,    NULL,                NULL},
-	{   6,    NULL,                NULL},
-	{  -1,    &black_tree[ 16],    &black_tree[ 15]},
-	{  -1,    &black_tree[ 18],    &black_tree[ 17]},
-	{   7,    NULL,                NULL},
-	{  -1,    &black_tree[ 20],    &black_tree[ 19]},
-	{  -1,    &black_tree[ 22],    &black_tree[ 21]},
-	{  -1,    &black_tree[ 24],    &black_tree[ 23]},
-	{   8,    NULL,                NULL},
-	{   9,    NULL,                NULL},
-	{  -1,    &black_tree[ 26],    &black_tree[ 25]},
-	{  -1,    &black_tree[ 28],    &black_tree[ 27]},
-	{  -1,    &black_tree[ 30],    &black_tree[ 29]},
-	{  -1,    &black_tree[ 32],    &black_tree[ 31]},
-	{  12,    NULL,                NULL},
-	{  -1,    &black_tree[ 34],    &black_tree[ 33]},
-	{  11,    NULL,                NULL},
-	{  10,    NULL,                NULL},
-	{  -1,    &black_tree[ 36],    &black_tree[ 35]},
-	{  -1,    &black_tree[ 38],    &black_tree[ 37]},
-	{  -1,    &black_tree[ 40],    &black_tree[ 39]},
-	{  -1,    NULL,                &black_tree[ 41]},
-	{  -1,    &black_tree[ 43],    &black_tree[ 42]},
-	{  -1,    &black_tree[ 45],    &black_tree[ 44]},
-	{  14,    NULL,                NULL},
-	{  -1,    &black_tree[ 47],    &black_tree[ 46]},
-	{  -1,    &black_tree[ 49],    &black_tree[ 48]},
-	{  13,    NULL,                NULL},
-	{  -1,    &black_tree[ 51],    &black_tree[ 50]},
-	{  -1,    &black_tree[ 53],    &black_tree[ 52]},
-	{  -1,    &black_tree[ 55],    &black_tree[ 54]},
-	{  -1,    &black_tree[ 57],    &black_tree[ 56]},
-	{  -1,    &black_tree[ 59],    &black_tree[ 58]},
-	{  -1,    &black_tree[ 61],    &black_tree[ 60]},
-	{  15,    NULL,                NULL},
-	{  -1,    &black_tree[ 63],    &black_tree[ 62]},
-	{  -1,    &black_tree[ 65],    &black_tree[ 64]},
-	{  -1,    &black_tree[ 67],    &black_tree[ 66]},
-	{  -1,    &black_tree[ 69],    &black_tree[ 68]},
-	{  -1,    &black_tree[ 71],    &black_tree[ 70]},
-	{  -1,    &black_tree[ 73],    &black_tree[ 72]},
-	{  -1,    &black_tree[ 75],    &black_tree[ 74]},
-	{  -1,    &black_tree[ 77],    &black_tree[ 76]},
-	{  -1,    &black_tree[ 79],    &black_tree[ 78]},
-	{  -1,    &black_tree[ 81],    &black_tree[ 80]},
-	{   0,    NULL,                NULL},
-	{  -1,    &black_tree[ 83],    &black_tree[ 82]},
-	{  -1,    &black_tree[ 85],    &black_tree[ 84]},
-	{  -1,    &black_tree[ 87],    &black_tree[ 86]},
-	{  -1,    &black_tree[ 89],    &black_tree[ 88]},
-	{  -1,    &black_tree[ 91],    &black_tree[ 90]},
-	{  -1,    &black_tree[ 93],    &black_tree[ 92]},
-	{  -1,    &black_tree[ 95],    &black_tree[ 94]},
-	{  -1,    &black_tree[ 97],    &black_tree[ 96]},
-	{  17,    NULL,                NULL},
-	{  16,    NULL,                NULL},
-	{  -1,    &black_tree[ 99],    &black_tree[ 98]},
-	{  -1,    &black_tree[101],    &black_tree[100]},
-	{  -1,    &black_tree[103],    &black_tree[102]},
-	{  64,    NULL,                NULL},
-	{  -1,    &black_tree[105],    &black_tree[104]},
-	{  -1,    &black_tree[107],    &black_tree[106]},
-	{  -1,    &black_tree[109],    &black_tree[108]},
-	{  -1,    &black_tree[111],    &black_tree[110]},
-	{  -1,    &black_tree[113],    &black_tree[112]},
-	{  -1,    &black_tree[115],    &black_tree[114]},
-	{  18,    NULL,                NULL},
-	{  -1,    &black_tree[117],    &black_tree[116]},
-	{  -1,    &black_tree[119],    &black_tree[118]},
-	{  -1,    &black_tree[121],    &black_tree[120]},
-	{  -1,    &black_tree[123],    &black_tree[122]},
-	{  -1,    &black_tree[125],    &black_tree[124]},
-	{  21,    NULL,                NULL},
-	{  -1,    &black_tree[127],    &black_tree[126]},
-	{  -1,    &black_tree[129],    &black_tree[128]},
-	{  -1,    &black_tree[131],    &black_tree[130]},
-	{  20,    NULL,                NULL},
-	{  19,    NULL,                NULL},
-	{  -1,    &black_tree[133],    &black_tree[132]},
-	{  -1,    &black_tree[135],    &black_tree[134]},
-	{  -1,    &black_tree[137],    &black_tree[136]},
-	{  22,    NULL,                NULL},
-	{  -1,    &black_tree[139],    &black_tree[138]},
-	{  -1,    &black_tree[141],    &black_tree[140]},
-	{  -1,    &black_tree[143],    &black_tree[142]},
-	{  -1,    &black_tree[145],    &black_tree[144]},
-	{  -1,    &black_tree[147],    &black_tree[146]},
-	{  -1,    &black_tree[149],    &black_tree[148]},
-	{  -1,    &black_tree[151],    &black_tree[150]},
-	{  -1,    &black_tree[153],    &black_tree[152]},
-	{  -1,    &black_tree[155],    &black_tree[154]},
-	{  -1,    &black_tree[157],    &black_tree[156]},
-	{  23,    NULL,                NULL},
-	{  -1,    &black_tree[159],    &black_tree[158]},
-	{  -1,    &black_tree[161],    &black_tree[160]},
-	{  -1,    &black_tree[163],    &black_tree[162]},
-	{  -1,    &black_tree[165],    &black_tree[164]},
-	{  -1,    &black_tree[167],    &black_tree[166]},
-	{  25,    NULL,                NULL},
-	{  24,    NULL,                NULL},
-	{  -1,    &black_tree[169],    &black_tree[168]},
-	{  -1,    &black_tree[171],    &black_tree[170]},
-	{  -1,    &black_tree[173],    &black_tree[172]},
-	{  -1,    &black_tree[175],    &black_tree[174]},
-	{  -1,    &black_tree[177],    &black_tree[176]},
-	{  -1,    &black_tree[179],    &black_tree[178]},
-	{  -1,    &black_tree[181],    &black_tree[180]},
-	{1920,    NULL,                NULL},
-	{1856,    NULL,                NULL},
-	{  -1,    &black_tree[183],    &black_tree[182]},
-	{  -1,    &black_tree[185],    &black_tree[184]},
-	{  -1,    &black_tree[187],    &black_tree[186]},
-	{1792,    NULL,                NULL},
-	{  43,    NULL,                NULL},
-	{  42,    NULL,                NULL},
-	{  39,    NULL,                NULL},
-	{  38,    NULL,                NULL},
-	{  37,    NULL,                NULL},
-	{  36,    NULL,                NULL},
-	{  35,    NULL,                NULL},
-	{  34,    NULL,                NULL},
-	{  29,    NULL,                NULL},
-	{  28,    NULL,                NULL},
-	{  27,    NULL,                NULL},
-	{  26,    NULL,                NULL},
-	{ 192,    NULL,                NULL},
-	{ 128,    NULL,                NULL},
-	{  41,    NULL,                NULL},
-	{  40,    NULL,                NULL},
-	{  33,    NULL,                NULL},
-	{  32,    NULL,                NULL},
-	{  31,    NULL,                NULL},
-	{  30,    NULL,                NULL},
-	{  63,    NULL,                NULL},
-	{  62,    NULL,                NULL},
-	{  49,    NULL,                NULL},
-	{  48,    NULL,                NULL},
-	{ 256,    NULL,                NULL},
-	{  61,    NULL,                NULL},
-	{  58,    NULL,                NULL},
-	{  57,    NULL,                NULL},
-	{  47,    NULL,                NULL},
-	{  46,    NULL,                NULL},
-	{  45,    NULL,                NULL},
-	{  44,    NULL,                NULL},
-	{  51,    NULL,                NULL},
-	{  50,    NULL,                NULL},
-	{  -1,    &black_tree[189],    &black_tree[188]},
-	{  -1,    &black_tree[191],    &black_tree[190]},
-	{  -1,    &black_tree[193],    &black_tree[192]},
-	{  54,    NULL,                NULL},
-	{  53,    NULL,                NULL},
-	{  -1,    &black_tree[195],    &black_tree[194]},
-	{ 448,    NULL,                NULL},
-	{ 384,    NULL,                NULL},
-	{ 320,    NULL,                NULL},
-	{  -1,    &black_tree[197],    &black_tree[196]},
-	{  -1,    &black_tree[199],    &black_tree[198]},
-	{  60,    NULL,                NULL},
-	{  59,    NULL,                NULL},
-	{  -1,    &black_tree[201],    &black_tree[200]},
-	{  -1,    &black_tree[203],    &black_tree[202]},
-	{  56,    NULL,                NULL},
-	{  55,    NULL,                NULL},
-	{  -1,    &black_tree[205],    &black_tree[204]},
-	{  -1,    &black_tree[207],    &black_tree[206]},
-	{  52,    NULL,                NULL},
-	{2560,    NULL,                NULL},
-	{2496,    NULL,                NULL},
-	{2432,    NULL,                NULL},
-	{2368,    NULL,                NULL},
-	{2304,    NULL,                NULL},
-	{2240,    NULL,                NULL},
-	{2176,    NULL,                NULL},
-	{2112,    NULL,                NULL},
-	{2048,    NULL,                NULL},
-	{1984,    NULL,                NULL},
-	{1216,    NULL,                NULL},
-	{1152,    NULL,                NULL},
-	{1088,    NULL,                NULL},
-	{1024,    NULL,                NULL},
-	{ 960,    NULL,                NULL},
-	{ 896,    NULL,                NULL},
-	{ 576,    NULL,                NULL},
-	{ 512,    NULL,                NULL},
-	{1728,    NULL,                NULL},
-	{1664,    NULL,                NULL},
-	{1600,    NULL,                NULL},
-	{1536,    NULL,                NULL},
-	{1472,    NULL,                NULL},
-	{1408,    NULL,                NULL},
-	{1344,    NULL,                NULL},
-	{1280,    NULL,                NULL},
-	{ 832,    NULL,                NULL},
-	{ 768,    NULL,                NULL},
-	{ 704,    NULL,                NULL},
-	{ 640,    NULL,                NULL}
-}; /* end black_tree */
-	
-	 
-	 
-struct node white_tree[] = {
-	{  -1,    &white_tree[  2],    &white_tree[  1]},
-	{  -1,    &white_tree[  4],    &white_tree[  3]},
-	{  -1,    &white_tree[  6],    &white_tree[  5]},
-	{  -1,    &white_tree[  8],    &white_tree[  7]},
-	{  -1,    &white_tree[ 10],    &white_tree[  9]},
-	{  -1,    &white_tree[ 12],    &white_tree[ 11]},
-	{  -1,    &white_tree[ 14],    &white_tree[ 13]},
-	{  -1,    &white_tree[ 16],    &white_tree[ 15]},
-	{  -1,    &white_tree[ 18],    &white_tree[ 17]},
-	{  -1,    &white_tree[ 20],    &white_tree[ 19]},
-	{  -1,    &white_tree[ 22],    &white_tree[ 21]},
-	{  -1,    &white_tree[ 24],    &white_tree[ 23]},
-	{  -1,    &white_tree[ 26],    &white_tree[ 25]},
-	{  -1,    &white_tree[ 28],    &white_tree[ 27]},
-	{  -1,    &white_tree[ 30],    &white_tree[ 29]},
-	{   7,    NULL,                NULL},
-	{   6,    NULL,                NULL},
-	{  -1,    &white_tree[ 32],    &white_tree[ 31]},
-	{   5,    NULL,                NULL},
-	{   4,    NULL,                NULL},
-	{  -1,    &white_tree[ 34],    &white_tree[ 33]},
-	{  -1,    &white_tree[ 36],    &white_tree[ 35]},
-	{   3,    NULL,                NULL},
-	{   2,    NULL,                NULL},
-	{  -1,    &white_tree[ 38],    &white_tree[ 37]},
-	{  -1,    &white_tree[ 40],    &white_tree[ 39]},
-	{  -1,    &white_tree[ 42],    &white_tree[ 41]},
-	{  -1,    &white_tree[ 44],    &white_tree[ 43]},
-	{  -1,    &white_tree[ 46],    &white_tree[ 45]},
-	{  -1,    &white_tree[ 48],    &white_tree[ 47]},
-	{  -1,    &white_tree[ 50],    &white_tree[ 49]},
-	{  64,    NULL,                NULL},
-	{  -1,    &white_tree[ 52],    &white_tree[ 51]},
-	{  -1,    &white_tree[ 54],    &white_tree[ 53]},
-	{   9,    NULL,                NULL},
-	{   8,    NULL,                NULL},
-	{ 128,    NULL,                NULL},
-	{  -1,    &white_tree[ 56],    &white_tree[ 55]},
-	{  -1,    &white_tree[ 58],    &white_tree[ 57]},
-	{  -1,    &white_tree[ 60],    &white_tree[ 59]},
-	{  -1,    &white_tree[ 62],    &white_tree[ 61]},
-	{  -1,    &white_tree[ 64],    &white_tree[ 63]},
-	{  11,    NULL,                NULL},
-	{  10,    NULL,                NULL},
-	{  -1,    &white_tree[ 66],    &white_tree[ 65]},
-	{  -1,    &white_tree[ 68],    &white_tree[ 67]},
-	{  -1,    &white_tree[ 70],    &white_tree[ 69]},
-	{  -1,    &white_tree[ 72],    &white_tree[ 71]},
-	{  -1,    &white_tree[ 74],    &white_tree[ 73]},
-	{  -1,    &white_tree[ 76],    &white_tree[ 75]},
-	{  -1,    &white_tree[ 78],    &white_tree[ 77]},
-	{  15,    NULL,                NULL},
-	{  14,    NULL,                NULL},
-	{  17,    NULL,                NULL},
-	{  16,    NULL,                NULL},
-	{  -1,    &white_tree[ 80],    &white_tree[ 79]},
-	{  -1,    &white_tree[ 82],    &white_tree[ 81]},
-	{  -1,    &white_tree[ 84],    &white_tree[ 83]},
-	{1664,    NULL,                NULL},
-	{ 192,    NULL,                NULL},
-	{  -1,    &white_tree[ 86],    &white_tree[ 85]},
-	{  -1,    &white_tree[ 88],    &white_tree[ 87]},
-	{  -1,    &white_tree[ 90],    &white_tree[ 89]},
-	{  -1,    &white_tree[ 92],    &white_tree[ 91]},
-	{  -1,    &white_tree[ 94],    &white_tree[ 93]},
-	{  -1,    &white_tree[ 96],    &white_tree[ 95]},
-	{  -1,    &white_tree[ 98],    &white_tree[ 97]},
-	{  -1,    &white_tree[100],    &white_tree[ 99]},
-	{  -1,    &white_tree[102],    &white_tree[101]},
-	{  -1,    &white_tree[104],    &white_tree[103]},
-	{  12,    NULL,                NULL},
-	{   1,    NULL,                NULL},
-	{  -1,    &white_tree[106],    &white_tree[105]},
-	{  -1,    &white_tree[108],    &white_tree[107]},
-	{  -1,    &white_tree[110],    &white_tree[109]},
-	{  13,    NULL,                NULL},
-	{  -1,    &white_tree[112],    &white_tree[111]},
-	{  -1,    &white_tree[114],    &white_tree[113]},
-	{  -1,    &white_tree[116],    &white_tree[115]},
-	{ 256,    NULL,                NULL},
-	{  -1,    &white_tree[118],    &white_tree[117]},
-	{  -1,    &white_tree[120],    &white_tree[119]},
-	{  -1,    &white_tree[122],    &white_tree[121]},
-	{  -1,    &white_tree[124],    &white_tree[123]},
-	{  -1,    &white_tree[126],    &white_tree[125]},
-	{  -1,    &white_tree[128],    &white_tree[127]},
-	{  -1,    &white_tree[130],    &white_tree[129]},
-	{  25,    NULL,                NULL},
-	{  -1,    &white_tree[132],    &white_tree[131]},
-	{  -1,    &white_tree[134],    &white_tree[133]},
-	{  24,    NULL,                NULL},
-	{  18,    NULL,                NULL},
-	{  -1,    &white_tree[136],    &white_tree[135]},
-	{  -1,    &white_tree[138],    &white_tree[137]},
-	{  27,    NULL,                NULL},
-	{  -1,    &white_tree[140],    &white_tree[139]},
-	{  -1,    &white_tree[142],    &white_tree[141]},
-	{  -1,    &white_tree[144],    &white_tree[143]},
-	{  28,    NULL,                NULL},
-	{  21,    NULL,                NULL},
-	{  -1,    &white_tree[146],    &white_tree[145]},
-	{  -1,    &white_tree[148],    &white_tree[147]},
-	{  -1,    &white_tree[150],    &white_tree[149]},
-	{  26,    NULL,                NULL},
-	{  -1,    &white_tree[152],    &white_tree[151]},
-	{  -1,    &white_tree[154],    &white_tree[153]},
-	{  19,    NULL,                NULL},
-	{  -1,    &white_tree[156],    &white_tree[155]},
-	{  -1,    &white_tree[158],    &white_tree[157]},
-	{  -1,    &white_tree[160],    &white_tree[159]},
-	{  20,    NULL,                NULL},
-	{  -1,    &white_tree[162],    &white_tree[161]},
-	{  23,    NULL,                NULL},
-	{  22,    NULL,                NULL},
-	{  -1,    &white_tree[164],    &white_tree[163]},
-	{  -1,    &white_tree[166],    &white_tree[165]},
-	{  -1,    NULL,                &white_tree[167]},
-	{  -1,    &white_tree[169],    &white_tree[168]},
-	{  -1,    &white_tree[171],    &white_tree[170]},
-	{  -1,    &white_tree[173],    &white_tree[172]},
-	{  -1,    &white_tree[175],    &white_tree[174]},
-	{  -1,    &white_tree[177],    &white_tree[176]},
-	{ 576,    NULL,                NULL},
-	{ 640,    NULL,                NULL},
-	{  -1,    &white_tree[179],    &white_tree[178]},
-	{ 512,    NULL,                NULL},
-	{ 448,    NULL,                NULL},
-	{  58,    NULL,                NULL},
-	{  57,    NULL,                NULL},
-	{  56,    NULL,                NULL},
-	{  55,    NULL,                NULL},
-	{  52,    NULL,                NULL},
-	{  51,    NULL,                NULL},
-	{  50,    NULL,                NULL},
-	{  49,    NULL,                NULL},
-	{  -1,    &white_tree[181],    &white_tree[180]},
-	{  -1,    &white_tree[183],    &white_tree[182]},
-	{  60,    NULL,                NULL},
-	{  59,    NULL,                NULL},
-	{ 384,    NULL,                NULL},
-	{ 320,    NULL,                NULL},
-	{   0,    NULL,                NULL},
-	{  63,    NULL,                NULL},
-	{  62,    NULL,                NULL},
-	{  61,    NULL,                NULL},
-	{  44,    NULL,                NULL},
-	{  43,    NULL,                NULL},
-	{  42,    NULL,                NULL},
-	{  41,    NULL,                NULL},
-	{  40,    NULL,                NULL},
-	{  39,    NULL,                NULL},
-	{  54,    NULL,                NULL},
-	{  53,    NULL,                NULL},
-	{  32,    NULL,                NULL},
-	{  31,    NULL,                NULL},
-	{  38,    NULL,                NULL},
-	{  37,    NULL,                NULL},
-	{  36,    NULL,                NULL},
-	{  35,    NULL,                NULL},
-	{  34,    NULL,                NULL},
-	{  33,    NULL,                NULL},
-	{  48,    NULL,                NULL},
-	{  47,    NULL,                NULL},
-	{  46,    NULL,                NULL},
-	{  45,    NULL,                NULL},
-	{  30,    NULL,                NULL},
-	{  29,    NULL,                NULL},
-	{  -1,    &white_tree[185],    &white_tree[184]},
-	{1408,    NULL,                NULL},
-	{1344,    NULL,                NULL},
-	{1280,    NULL,                NULL},
-	{1216,    NULL,                NULL},
-	{1152,    NULL,                NULL},
-	{1088,    NULL,                NULL},
-	{1024,    NULL,                NULL},
-	{ 960,    NULL,                NULL},
-	{ 896,    NULL,                NULL},
-	{ 832,    NULL,                NULL},
-	{ 768,    NULL,                NULL},
-	{ 704,    NULL,                NULL},
-	{1728,    NULL,                NULL},
-	{1600,    NULL,                NULL},
-	{1536,    NULL,                NULL},
-	{1472,    NULL,                NULL},
-	{  -1,    &white_tree[187],    &white_tree[186]},
-	{  -1,    &white_tree[189],    &white_tree[188]},
-	{  -1,    &white_tree[191],    &white_tree[190]},
-	{  -1,    &white_tree[193],    &white_tree[192]},
-	{  -1,    &white_tree[195],    &white_tree[194]},
-	{  -1,    &white_tree[197],    &white_tree[196]},
-	{  -1,    &white_tree[199],    &white_tree[198]},
-	{  -1,    &white_tree[201],    &white_tree[200]},
-	{1920,    NULL,                NULL},
-	{1856,    NULL,                NULL},
-	{  -1,    &white_tree[203],    &white_tree[202]},
-	{  -1,    &white_tree[205],    &white_tree[204]},
-	{  -1,    &white_tree[207],    &white_tree[206]},
-	{1792,    NULL,                NULL},
-	{2560,    NULL,                NULL},
-	{2496,    NULL,                NULL},
-	{2432,    NULL,                NULL},
-	{2368,    NULL,                NULL},
-	{2304,    NULL,                NULL},
-	{2240,    NULL,                NULL},
-	{2176,    NULL,                NULL},
-	{2112,    NULL,                NULL},
-	{2048,    NULL,                NULL},
-	{1984,    NULL,                NULL}
-}; /* end white_tree */
+*****************************************************************************/
+/********************************************************************
+*  Arguments							    *
+*  ---------							    *
+*	Passed in:         					    *
+*		   ctx - decoder context.                           *
+*		   indata - buffer containing the compressed data.  *
+*		   inbytes - the number of bytes in indata.         *
+*  		   width - Width in pixels of uncompressed data.    *
+*  		   height - Number of lines of uncompressed data.   *
+*  		   outalloc - the number of bytes in outdata.       *
+*	Returned:          					    *
+*		   outdata - buffer containing the decompressed data*
+*		   outbytes - the number of bytes in outdata.       *
+*		   zero on success, negative on error.              *
+********************************************************************/
+int grp4decomp_ctx(
+G4_DEC_CTX *ctx,
+unsigned char *indata,
+int inbytes,
+int  width,int  height,
+unsigned char  *outdata,
+int  outalloc,
+int  *outbytes)
+{
+SHORT *temp;
+SHORT line, index, i, ret;
+long outlen, row;
+G4_BITS in;
+
+	if(width <= 0 || height < 0) {
+		fprintf(stderr, "ERROR : grp4decomp_ctx : ");
+		fprintf(stderr, "invalid image size %d x %d\n", width, height);
+		return(-2);
+	}
 
+	outlen = ((long)width * height + Bits_per_byte - 1) / Bits_per_byte;
+	if(outlen > outalloc) {
+		fprintf(stderr, "ERROR : grp4decomp_ctx : ");
+		fprintf(stderr, "%d x %d image exceeds %d bytes\n",
+		        width, height, outalloc);
+		return(-3);
+	}
 
-/************************* find_run_length_code ******************************
+	if(ctx->line_alloc < width + Extra_positions) {
+		free(ctx->reference_line);
+		free(ctx->coding_line);
+		ctx->line_alloc = 0;
+		ctx->reference_line = (SHORT *)calloc(width + Extra_positions,
+		                                      sizeof(SHORT));
+		ctx->coding_line = (SHORT *)calloc(width + Extra_positions,
+		                                   sizeof(SHORT));
+		if(ctx->reference_line == (SHORT *)NULL ||
+		   ctx->coding_line == (SHORT *)NULL) {
+			fprintf(stderr, "ERROR : grp4decomp_ctx : calloc : lines\n");
+			return(-4);
+		}
+		ctx->line_alloc = width + Extra_positions;
+	}
 
-		finds the length of the run in the compressed image
-		by traversing the above declared tree of run length codes.
-	 		
-******************************************************************************/
-SHORT find_run_length_code( SHORT unsigned color)
-{
-	if(color == White)
-	   node_ptr = white_tree; /* point to root node */
-	else
-	    node_ptr = black_tree; /* point to root node */
-
-	while(node_ptr->value == Invalid) {  /* -1 */		
-	      if((read_bit()) == 0)
-	  	  node_ptr = node_ptr->child_zero;
-	      else
-	 	   node_ptr = node_ptr->child_one;
-	} /* end while node does not contain a run length value */
-	
-	/*
-	 *  When this line is reached, node_ptr points to a node that contains
-	 *  the run length code: return that value.
-	 */
-	 
-	return(node_ptr->value);
+	pthread_once(&code_tables_once, build_code_tables);
+
+	in.inptr = indata;
+	in.inend = indata + inbytes;
+	in.bits = 0;
+	in.nbits = 0;
+	in.npad = 0;
+
+	/* the line above the first is all white */
+	ctx->reference_line[0] = Invalid;
+	ctx->reference_line[1] = width;
+	ctx->reference_line[2] = width;
+	ctx->reference_line[3] = width;
+
+	for(line = 0; line < height; line++) {
+		row = (long)line * width;
+
+		ret = decompress_line(&in, ctx->reference_line, ctx->coding_line,
+		                      ctx->line_alloc - 4, width, &index);
+		if(ret == Line_done && in.npad * Bits_per_byte > in.nbits)
+			ret = Bad_code;	/* read past the end of the data */
+		if(ret == End_of_image) {
+			write_bits_d(outdata, row, (long)height * width, White);
+			break;
+		}
+		if(ret != Line_done) {
+			fprintf(stderr, "ERROR : grp4decomp_ctx : ");
+			fprintf(stderr, "%s on line %d\n", (ret == Bad_code) ?
+			        "invalid code" : "changing element out of place", line);
+			return(-5);
+		}
 
-} /* end find_run_length_code */
+		/* the line starts white, and each odd element starts a black */
+		/* run ending at the next element or the end of the line      */
+		write_bits_d(outdata, row, row + width, White);
+		for(i = 1; i < index; i += 2)
+			write_black_bits_d(outdata, row + ctx->coding_line[i],
+			                   row + ctx->coding_line[i + 1]);
+		if(i == index)
+			write_black_bits_d(outdata, row + ctx->coding_line[i],
+			                   row + width);
+
+		/* swap the reference and coding lines */
+		temp = ctx->reference_line;
+		ctx->reference_line = ctx->coding_line;
+		ctx->coding_line = temp;
+	}
+
+	*outbytes = (int)outlen;
+	return(0);
+}
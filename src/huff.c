@@ -18,7 +18,7 @@
 #cat: putc_huffman_table - Writes a huffman table to a memory buffer.
 #cat:
 #cat: find_huff_sizes - Optimizes code sizes by the frequency of
-#cat:                   pixel difference values.
+#cat:                   pixel difference values, merging from a heap.
 #cat: find_least_freq - Finds the larges pixel difference with the
 #cat:                   least frequency.
 #cat: find_num_huff_sizes - Determines the number of codes for each size.
@@ -387,16 +387,79 @@ int putc_huffman_table(
    return(0);
 }
 
+/*******************************************************************/
+/* Orders the nodes of a huffman tree as find_least_freq does:      */
+/* least frequency first and, among equal frequencies, the largest */
+/* difference value first.                                         */
+/*******************************************************************/
+#define HUFF_NODE_BEFORE(a, b) \
+   ((weight[a] < weight[b]) || \
+    (weight[a] == weight[b] && value[a] > value[b]))
+
+/*******************************************************************/
+/* Removes the first node from the binary heap "heap" of "n" nodes. */
+/*******************************************************************/
+static int pop_huff_node(int *heap, int n, const int *weight,
+                         const int *value)
+{
+   int first, node, i, child;
+
+   first = heap[0];
+   node = heap[--n];
+   i = 0;
+   while((child = (i << 1) + 1) < n){
+      if(child + 1 < n && HUFF_NODE_BEFORE(heap[child+1], heap[child]))
+         child++;
+      if(!HUFF_NODE_BEFORE(heap[child], node))
+         break;
+      heap[i] = heap[child];
+      i = child;
+   }
+   heap[i] = node;
+
+   return(first);
+}
+
+/*******************************************************************/
+/* Adds "node" to the binary heap "heap" of "n" nodes.              */
+/*******************************************************************/
+static void push_huff_node(int *heap, int n, const int node,
+                           const int *weight, const int *value)
+{
+   int i, parent;
+
+   i = n;
+   while(i > 0){
+      parent = (i - 1) >> 1;
+      if(!HUFF_NODE_BEFORE(node, heap[parent]))
+         break;
+      heap[i] = heap[parent];
+      i = parent;
+   }
+   heap[i] = node;
+}
+
 /******************************************************************/
 /*routine to optimize code sizes by frequency of difference values*/
 /******************************************************************/
+/* The two least frequent values are merged over and over, as in  */
+/* Annex K.2 of the JPEG standard, but they are taken from a heap */
+/* instead of by a scan of all of "freq" for every merge.  Ties   */
+/* are broken as by find_least_freq, so the merges, and the code  */
+/* sizes, are exactly those of the scan.  "freq" is left as is.   */
+/******************************************************************/
 int find_huff_sizes(int **ocodesize, int *freq, const int max_huffcounts)
 {
    int *codesize;       /*codesizes for each category*/
-   int *others;         /*pointer used to generate codesizes*/
+   int *work;           /*the tree and heap below*/
+   int *weight;         /*frequency of each leaf and merged node*/
+   int *value;          /*difference value a node is merged into*/
+   int *parent;         /*node each node is merged under*/
+   int *heap;           /*nodes not yet merged, least frequent first*/
+   int nleaves;         /*leaves 0..max_huffcounts, then merged nodes*/
+   int nnodes, nheap;
    int value1;          /*smallest and next smallest frequency*/
-   int value2;          /*of difference occurrence in the largest
-			  difference category*/
+   int value2;          /*of difference occurrence*/
    int i;               /*increment variable*/
 
 
@@ -405,43 +468,54 @@ int find_huff_sizes(int **ocodesize, int *freq, const int max_huffcounts)
       fprintf(stderr, "ERROR : find_huff_sizes : calloc : codesize\n");
       return(-2);
    }
-   others = (int *)malloc((max_huffcounts+1) * sizeof(int));
-   if(others == (int *)NULL){
-      fprintf(stderr, "ERROR : find_huff_sizes : malloc : others\n");
+   nleaves = max_huffcounts+1;
+   work = (int *)malloc(7 * nleaves * sizeof(int));
+   if(work == (int *)NULL){
+      fprintf(stderr, "ERROR : find_huff_sizes : malloc : work\n");
+      free(codesize);
       return(-3);
    }
-
-   for (i = 0; i <= max_huffcounts; i++) 
-      others[i] = -1;
-
-   while(1) {
-
-      find_least_freq(&value1, &value2, freq, max_huffcounts);
-
-      if(value2 == -1) {
-	 free(others);
-	 if(debug > 2){
-	    for (i = 0; i <= max_huffcounts; i++) 
-	       fprintf(stdout, "codesize[%d] = %d\n", i, codesize[i]);
-	 }
-         break;
+   weight = work;
+   value = weight + (nleaves << 1);
+   parent = value + (nleaves << 1);
+   heap = parent + (nleaves << 1);
+
+   nheap = 0;
+   for(i = 0; i < nleaves; i++){
+      weight[i] = freq[i];
+      value[i] = i;
+      parent[i] = -1;
+      if(freq[i] != 0){
+         push_huff_node(heap, nheap, i, weight, value);
+         nheap++;
       }
+   }
 
-      freq[value1] += freq[value2];
-      freq[value2] = 0;
+   nnodes = nleaves;
+   while(nheap > 1){
+      value1 = pop_huff_node(heap, nheap--, weight, value);
+      value2 = pop_huff_node(heap, nheap--, weight, value);
 
-      codesize[value1]++;
-      while(others[value1] != -1) {
-	 value1 = others[value1];
-	 codesize[value1]++;
-      }
-      others[value1] = value2;
-      codesize[value2]++;
+      weight[nnodes] = weight[value1] + weight[value2];
+      value[nnodes] = value[value1];
+      parent[nnodes] = -1;
+      parent[value1] = nnodes;
+      parent[value2] = nnodes;
+      push_huff_node(heap, nheap++, nnodes, weight, value);
+      nnodes++;
+   }
 
-      while(others[value2] != -1) {
-	 value2 = others[value2];
-	 codesize[value2]++;
-      }
+   /* Merged nodes come after the nodes under them, so a walk down */
+   /* from the last gives each node one more than its parent.      */
+   for(i = nnodes - 1; i >= 0; i--)
+      weight[i] = (parent[i] == -1) ? 0 : weight[parent[i]] + 1;
+   for(i = 0; i < nleaves; i++)
+      codesize[i] = weight[i];
+   free(work);
+
+   if(debug > 2){
+      for (i = 0; i <= max_huffcounts; i++)
+         fprintf(stdout, "codesize[%d] = %d\n", i, codesize[i]);
    }
 
    *ocodesize = codesize;
@@ -607,7 +681,8 @@ int sort_code_sizes(unsigned char **ovalues, int *codesize,
 {
    unsigned char *values;      /*defines order of huffman codelengths in
                          relation to the code sizes*/
-   int i, i2 = 0, i3;  /*increment variables*/
+   int i, i3;          /*increment variables*/
+   int start[(MAX_HUFFBITS<<1)+2];  /*first slot of each code size*/
 
 
    values = (unsigned char *)calloc(max_huffcounts+1, sizeof(unsigned char));
@@ -616,14 +691,18 @@ int sort_code_sizes(unsigned char **ovalues, int *codesize,
       return(-2);
    }
 
-   for(i = 1; i <= (MAX_HUFFBITS<<1); i++) {
-      for(i3 = 0; i3 < max_huffcounts; i3++) {
-	 if(codesize[i3] == i) {
-	    values[i2] = i3;
-	    i2++;
-	 }
-      }
-   }
+   /* Counting sort by code size, keeping values of one size in */
+   /* increasing order.  Sizes of 0 or over 32 are left out.    */
+   for(i = 0; i < (MAX_HUFFBITS<<1)+2; i++)
+      start[i] = 0;
+   for(i3 = 0; i3 < max_huffcounts; i3++)
+      if(codesize[i3] >= 1 && codesize[i3] <= (MAX_HUFFBITS<<1))
+         start[codesize[i3]+1]++;
+   for(i = 2; i < (MAX_HUFFBITS<<1)+2; i++)
+      start[i] += start[i-1];
+   for(i3 = 0; i3 < max_huffcounts; i3++)
+      if(codesize[i3] >= 1 && codesize[i3] <= (MAX_HUFFBITS<<1))
+         values[start[codesize[i3]]++] = i3;
 
    if(debug > 2){
       for(i = 0; i <= max_huffcounts; i++)
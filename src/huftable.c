@@ -12,6 +12,8 @@
       ROUTINES:
 #cat: gen_huff_tables - Given frequency of difference categories, generates
 #cat:                   huffman tables for use with JPEGL compression.
+#cat: gen_huff_table - Generates the huffman table of one component.
+#cat:
 #cat: read_huffman_table_jpegl - Reads the next huffman table from an
 #cat:                   open JPEGL compressed file.
 #cat: getc_huffman_table_jpegl - Reads the next huffman table from a
@@ -27,66 +29,80 @@
 #include <stdlib.h>
 #include <jpegl.h>
 #include <dataio.h>
+#include <codecmem.h>
 
 /*****************************************************/
 /* for encoder                                       */
 int gen_huff_tables(HUF_TABLE **huf_table, const int N)
 {
-   int i, ret, adjust; 
-   HUFFCODE *thuffcode_table;
+   int i, ret;
 
    for(i = 0; i < N; i++) {
-
-      huf_table[i]->table_id = MIN_HUFFTABLE_ID + i;
-
-      ret = find_huff_sizes(&(huf_table[i]->codesize), huf_table[i]->freq,
-		      MAX_HUFFCOUNTS_JPEGL);
+      ret = gen_huff_table(huf_table[i], MIN_HUFFTABLE_ID + i);
       if(ret){
          return(ret);
       }
+   }
 
-      ret = find_num_huff_sizes(&(huf_table[i]->bits), &adjust,
-		      huf_table[i]->codesize, MAX_HUFFCOUNTS_JPEGL);
-      if(ret){
-         return(ret);
-      }
+   return(0);
+}
 
-      if(adjust){
-         ret = sort_huffbits(huf_table[i]->bits);
-         if(ret){
-            return(ret);
-         }
-      }
+/*****************************************************/
+/* Generates the huffman table "table_id" from the   */
+/* difference category frequencies of a component.   */
+int gen_huff_table(HUF_TABLE *huf_table, const int table_id)
+{
+   int ret, adjust;
+   HUFFCODE *thuffcode_table;
 
-      ret = sort_code_sizes(&(huf_table[i]->values), huf_table[i]->codesize,
-		      MAX_HUFFCOUNTS_JPEGL);
-      if(ret){
-         return(ret);
-      }
+   huf_table->table_id = table_id;
 
-      ret = build_huffsizes(&thuffcode_table, &(huf_table[i]->last_size),
-		      huf_table[i]->bits, MAX_HUFFCOUNTS_JPEGL);
-      if(ret){
-         return(ret);
-      }
+   ret = find_huff_sizes(&(huf_table->codesize), huf_table->freq,
+		   MAX_HUFFCOUNTS_JPEGL);
+   if(ret){
+      return(ret);
+   }
 
-      build_huffcodes(thuffcode_table);
+   ret = find_num_huff_sizes(&(huf_table->bits), &adjust,
+		   huf_table->codesize, MAX_HUFFCOUNTS_JPEGL);
+   if(ret){
+      return(ret);
+   }
 
-      ret = build_huffcode_table(&(huf_table[i]->huffcode_table),
-		      thuffcode_table, huf_table[i]->last_size,
-		      huf_table[i]->values, MAX_HUFFCOUNTS_JPEGL);
+   if(adjust){
+      ret = sort_huffbits(huf_table->bits);
       if(ret){
-         free(thuffcode_table);
          return(ret);
       }
+   }
 
+   ret = sort_code_sizes(&(huf_table->values), huf_table->codesize,
+		   MAX_HUFFCOUNTS_JPEGL);
+   if(ret){
+      return(ret);
+   }
+
+   ret = build_huffsizes(&thuffcode_table, &(huf_table->last_size),
+		   huf_table->bits, MAX_HUFFCOUNTS_JPEGL);
+   if(ret){
+      return(ret);
+   }
+
+   build_huffcodes(thuffcode_table);
+
+   ret = build_huffcode_table(&(huf_table->huffcode_table),
+		   thuffcode_table, huf_table->last_size,
+		   huf_table->values, MAX_HUFFCOUNTS_JPEGL);
+   if(ret){
       free(thuffcode_table);
+      return(ret);
    }
 
+   free(thuffcode_table);
+
    return(0);
 }
 
-
 /***************************************************/
 /* for decoder                                     */
 int read_huffman_table_jpegl(HUF_TABLE **huf_table, FILE *infp)
@@ -95,7 +111,7 @@ int read_huffman_table_jpegl(HUF_TABLE **huf_table, FILE *infp)
    unsigned char table_id;
    HUF_TABLE *thuf_table;
 
-   thuf_table = (HUF_TABLE *)calloc(1, sizeof(HUF_TABLE));
+   thuf_table = (HUF_TABLE *)codec_calloc(1, sizeof(HUF_TABLE));
    if(thuf_table == (HUF_TABLE *)NULL){
       fprintf(stderr, "ERROR : read_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : thuf_table\n");
@@ -161,8 +177,8 @@ int read_huffman_table_jpegl(HUF_TABLE **huf_table, FILE *infp)
 
    /* Build rest of table. */
 
-   thuf_table->maxcode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->maxcode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->maxcode == (int *)NULL){
       fprintf(stderr, "ERROR : read_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : maxcode\n");
@@ -170,8 +186,8 @@ int read_huffman_table_jpegl(HUF_TABLE **huf_table, FILE *infp)
       return(-6);
    }
 
-   thuf_table->mincode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->mincode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->mincode == (int *)NULL){
       fprintf(stderr, "ERROR : read_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : mincode\n");
@@ -179,7 +195,8 @@ int read_huffman_table_jpegl(HUF_TABLE **huf_table, FILE *infp)
       return(-7);
    }
 
-   thuf_table->valptr = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1, sizeof(int));
+   thuf_table->valptr = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                sizeof(int));
    if(thuf_table->valptr == (int *)NULL){
       fprintf(stderr, "ERROR : read_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : valptr\n");
@@ -220,7 +237,7 @@ int getc_huffman_table_jpegl(HUF_TABLE **huf_table,
    unsigned char table_id;
    HUF_TABLE *thuf_table;
 
-   thuf_table = (HUF_TABLE *)calloc(1, sizeof(HUF_TABLE));
+   thuf_table = (HUF_TABLE *)codec_calloc(1, sizeof(HUF_TABLE));
    if(thuf_table == (HUF_TABLE *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : thuf_table\n");
@@ -286,8 +303,8 @@ int getc_huffman_table_jpegl(HUF_TABLE **huf_table,
 
    /* Build rest of table. */
 
-   thuf_table->maxcode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->maxcode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->maxcode == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : maxcode\n");
@@ -295,8 +312,8 @@ int getc_huffman_table_jpegl(HUF_TABLE **huf_table,
       return(-6);
    }
 
-   thuf_table->mincode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->mincode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->mincode == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : mincode\n");
@@ -304,7 +321,8 @@ int getc_huffman_table_jpegl(HUF_TABLE **huf_table,
       return(-7);
    }
 
-   thuf_table->valptr = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1, sizeof(int));
+   thuf_table->valptr = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                sizeof(int));
    if(thuf_table->valptr == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl : ");
       fprintf(stderr, "calloc : valptr\n");
@@ -352,6 +370,8 @@ void free_HUFF_TABLES(HUF_TABLE **huf_table, const int N)
 
 /************** ********************************/
 /* Deallocate a JPEGL huffman table structure. */
+/* The structure and its decode tables come    */
+/* from the codec allocator.                   */
 /***********************************************/
 void free_HUFF_TABLE(HUF_TABLE *huf_table)
 {
@@ -371,13 +391,13 @@ void free_HUFF_TABLE(HUF_TABLE *huf_table)
       free(huf_table->huffcode_table);
 
    if(huf_table->maxcode != (int *)NULL)
-      free(huf_table->maxcode);
+      codec_free(huf_table->maxcode);
 
    if(huf_table->mincode != (int *)NULL)
-      free(huf_table->mincode);
+      codec_free(huf_table->mincode);
 
    if(huf_table->valptr != (int *)NULL)
-      free(huf_table->valptr);
+      codec_free(huf_table->valptr);
 
-   free(huf_table);
+   codec_free(huf_table);
 }
@@ -52,6 +52,7 @@ int read_raw_from_filesize(char *ifile, unsigned char **odata, int *ofsize)
    idata = (unsigned char *)malloc(fsize * sizeof(unsigned char));
    if(idata == (unsigned char *)NULL){
       fprintf(stderr, "ERORR : read_raw_from_filesize : malloc : idata\n");
+      fclose(infp);
       return(-3);
    }
 
@@ -60,6 +61,8 @@ int read_raw_from_filesize(char *ifile, unsigned char **odata, int *ofsize)
       fprintf(stderr, "ERORR : main : read_raw_from_filesize : ");
       fprintf(stderr, "%d of %d bytes read from %s\n",
               n, fsize, ifile);
+      free(idata);
+      fclose(infp);
       return(-4);
    }
 
@@ -149,6 +152,7 @@ int read_raw_or_ihead(const int iheadflag, char *ifile, IHEAD **ohead,
       }
       /* Open the input image file for reading ... */
       if((infp = fopen(ifile, "rb")) == (FILE *)NULL) {
+         free(idata);
          fprintf(stderr, "ERROR: read_raw_or_ihead : %s\n", ifile);
          return(-5);
       }
@@ -157,6 +161,7 @@ int read_raw_or_ihead(const int iheadflag, char *ifile, IHEAD **ohead,
       /* If anticipated number of pixels not read, then ERROR. */
       if(img_siz != num_pix) {
          free(idata);
+         fclose(infp);
          fprintf(stderr, "ERROR : read_raw_or_ihead : fread : ");
          fprintf(stderr, "only read %d of %d bytes\n",
                  img_siz, num_pix);
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <math.h>
 #include <jpegl.h>
+#include <codecmem.h>
 
 /**************************************/
 /* Extract image from image structure */
@@ -224,6 +225,9 @@ int update_IMG_DAT_decode(IMG_DAT *img_dat, SCN_HEADER *scn_header,
       }
       img_dat->point_trans[cmpnt_i] = scn_header->Ahl;
       img_dat->predict[cmpnt_i] = scn_header->Ss;
+      /* Planes already set, as by a caller supplied buffer, are kept. */
+      if(img_dat->image[cmpnt_i] != (unsigned char *)NULL)
+         continue;
       img_dat->image[cmpnt_i] =
                (unsigned char *)malloc(img_dat->samp_width[cmpnt_i] *
                                        img_dat->samp_height[cmpnt_i]);
@@ -328,7 +332,7 @@ void free_IMG_DAT(IMG_DAT *img_dat, const int img_flag)
 
    for(i = 0; i < img_dat->n_cmpnts; i++){
       if(img_dat->diff[i] != (short *)NULL)
-         free(img_dat->diff[i]);
+         codec_free(img_dat->diff[i]);
    }
 
    if(img_flag){
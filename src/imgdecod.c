@@ -19,12 +19,24 @@
 #cat:          potentially compressed datastream of image pixels.
 #cat: ihead_decode_mem - decodes (if necessary) a datastream of
 #cat:          IHead formatted pixels from a memory buffer.
+#cat: probe_image_mem - identifies a datastream of image pixels and
+#cat:          reads its attributes and output buffer size from its
+#cat:          header alone.
+#cat: decode_image_mem_into - identifies and reconstructs a datastream
+#cat:          of image pixels into a caller supplied buffer.
+#cat: image_header_len - finds the bytes a datastream of image pixels
+#cat:          holds ahead of its compressed image data.
+#cat: read_image_header - reads just the headers of an image file, up
+#cat:          to its compressed image data.
+#cat: getc_nistcom_image - gets the NISTCOM of a WSQ, JPEGL or JPEGB
+#cat:          datastream from its headers.
 
 ***********************************************************************/
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <img_io.h>
 #include <imgtype.h>
 #include <wsq.h>
@@ -287,8 +299,9 @@ int ihead_decode_mem(unsigned char **oodata, int *ow, int *oh, int *od,
 {
    IHEAD *ihead;
    unsigned char *odata, *iptr;
-   int olen, obytes, w, h, d, ppi;
+   int ret, olen, obytes, w, h, d, ppi;
    int compcode, complen=0;
+   G4_DEC_CTX *g4ctx;
 
    (void)ilen; /* FIXME unused */
    /* Skip first fized length size field. */
@@ -315,7 +328,11 @@ int ihead_decode_mem(unsigned char **oodata, int *ow, int *oh, int *od,
 
    switch (compcode) {
       case RL:
-         rldecomp(iptr, complen, odata, &obytes, olen);
+         ret = rldecomp_mem(iptr, complen, odata, olen, &obytes);
+         if(ret){
+            free(odata);
+            return(ret);
+         }
          set_compression(ihead, UNCOMP);
          set_complen(ihead, 0);
          break;
@@ -325,7 +342,16 @@ int ihead_decode_mem(unsigned char **oodata, int *ow, int *oh, int *od,
            ihead->sigbit = MSBF;
            ihead->byte_order = HILOW;
          }
-         grp4decomp(iptr, complen, w, h, odata, &obytes);
+         ret = alloc_G4_DEC_CTX(&g4ctx);
+         if(!ret){
+            ret = grp4decomp_ctx(g4ctx, iptr, complen, w, h, odata, olen,
+                                 &obytes);
+            free_G4_DEC_CTX(g4ctx);
+         }
+         if(ret){
+            free(odata);
+            return(ret);
+         }
          set_compression(ihead, UNCOMP);
          set_complen(ihead, 0);
          break;
@@ -348,3 +374,306 @@ int ihead_decode_mem(unsigned char **oodata, int *ow, int *oh, int *od,
 
    return(0);
 }
+
+/*******************************************************************/
+/* Reads the attributes of an IHead datastream from its header,   */
+/* returning the bytes in each row of its pixmap.                 */
+/*******************************************************************/
+static int ihead_probe_mem(int *ow, int *oh, int *od, int *oppi,
+                           int *orowbytes, unsigned char *idata,
+                           const int ilen)
+{
+   IHEAD *ihead;
+
+   if(ilen < SHORT_CHARS + (int)sizeof(IHEAD)){
+      fprintf(stderr, "ERROR : ihead_probe_mem : ");
+      fprintf(stderr, "%d bytes too short for an IHead header\n", ilen);
+      return(-2);
+   }
+   ihead = (IHEAD *)(idata + SHORT_CHARS);
+
+   *ow = get_width(ihead);
+   *oh = get_height(ihead);
+   *od = get_depth(ihead);
+   *oppi = get_density(ihead);
+   *orowbytes = SizeFromDepth(*ow, 1, *od);
+
+   return(0);
+}
+
+/*******************************************************************/
+/* Identifies the datastream in "idata" and reads its attributes  */
+/* from its headers, without decoding any pixels.  "osize" is set */
+/* to the bytes a buffer passed to decode_image_mem_into with the */
+/* same "ostride" must hold.                                      */
+/*******************************************************************/
+int probe_image_mem(int *oimg_type, int *ow, int *oh, int *od, int *oppi,
+                    int *osize, const int ostride, unsigned char *idata,
+                    const int ilen)
+{
+   int ret, img_type, rowbytes;
+
+   ret = image_type(&img_type, idata, ilen);
+   if(ret)
+      return(ret);
+
+   switch(img_type){
+      case WSQ_IMG:
+           ret = wsq_probe_mem(ow, oh, od, oppi, osize, ostride,
+                               idata, ilen);
+           break;
+      case JPEGL_IMG:
+           ret = jpegl_probe_mem(ow, oh, od, oppi, osize, ostride,
+                                 idata, ilen);
+           break;
+      case JPEGB_IMG:
+#if jpegb_SUPPORTED
+           ret = jpegb_probe_mem(ow, oh, od, oppi, osize, ostride,
+                                 idata, ilen);
+           break;
+#else
+	   return -2;
+#endif
+      case IHEAD_IMG:
+           ret = ihead_probe_mem(ow, oh, od, oppi, &rowbytes, idata, ilen);
+           if(ret)
+              return(ret);
+           if(ostride > 0 && ostride < rowbytes){
+              fprintf(stderr, "ERROR : probe_image_mem : ");
+              fprintf(stderr, "row stride %d less than %d bytes per row\n",
+                      ostride, rowbytes);
+              return(-4);
+           }
+           *osize = ((ostride > 0) ? ostride : rowbytes) * *oh;
+           break;
+      default:
+           fprintf(stderr, "ERROR : probe_image_mem : ");
+           fprintf(stderr, "illegal image type = %d\n", img_type);
+           return(-3);
+   }
+   if(ret)
+      return(ret);
+
+   *oimg_type = img_type;
+   return(0);
+}
+
+/*******************************************************************/
+/* Finds the length of the headers at the start of "idata", up to */
+/* the compressed image data.  For WSQ and JPEG datastreams this  */
+/* runs through the segment of the first Start Of Block or Scan,  */
+/* found by stepping from marker to marker by segment lengths, so */
+/* none of the image data is looked at.  If the headers run past  */
+/* "ilen", "ohlen" is set to a length that must be read to carry  */
+/* on, so the caller can read more and try again.                 */
+/*******************************************************************/
+int image_header_len(int *ohlen, unsigned char *idata, const int ilen)
+{
+   int pos;
+   unsigned short soi, marker, data_marker;
+   unsigned char *mptr;
+
+   if(ilen < 2){
+      *ohlen = SHORT_CHARS + (int)sizeof(IHEAD);
+      return(0);
+   }
+
+   soi = (idata[0] << 8) | idata[1];
+   if(soi == SOI_WSQ)
+      data_marker = SOB_WSQ;
+   else if(soi == SOI)
+      data_marker = SOS;
+   else{
+      /* Otherwise take it to be an IHead file, whose header is fixed. */
+      *ohlen = SHORT_CHARS + (int)sizeof(IHEAD);
+      return(0);
+   }
+
+   pos = 2;
+   while(1){
+      /* Marker, possibly after fill bytes, and segment length. */
+      while(pos < ilen && idata[pos] == 0xFF &&
+            pos + 1 < ilen && idata[pos+1] == 0xFF)
+         pos++;
+      if(pos + 4 > ilen){
+         *ohlen = pos + 4;
+         return(0);
+      }
+      mptr = idata + pos;
+      marker = (mptr[0] << 8) | mptr[1];
+      if(mptr[0] != 0xFF || marker == soi || marker == EOI ||
+         marker == EOI_WSQ){
+         fprintf(stderr, "ERROR : image_header_len : ");
+         fprintf(stderr, "no marker segment at byte %d\n", pos);
+         return(-2);
+      }
+      pos += 2 + ((mptr[2] << 8) | mptr[3]);
+      if(marker == data_marker){
+         *ohlen = pos;
+         return(0);
+      }
+   }
+}
+
+/*******************************************************************/
+/* Reads the headers of image file "ifile" into a buffer, reading */
+/* only as far as image_header_len asks, so the compressed image  */
+/* data of a large file is mostly left unread.  If the file ends  */
+/* first, all of it is returned, for the probe routines to judge. */
+/*******************************************************************/
+int read_image_header(char *ifile, unsigned char **odata, int *olen)
+{
+   FILE *fp;
+   unsigned char *idata, *ndata;
+   int ret, ilen, alloc, need, n;
+
+   if((fp = fopen(ifile, "rb")) == (FILE *)NULL){
+      fprintf(stderr, "ERROR : read_image_header : fopen : %s\n", ifile);
+      return(-2);
+   }
+
+   idata = (unsigned char *)NULL;
+   ilen = 0;
+   alloc = 0;
+   need = IMG_HEADER_READ;
+   while(ilen < need){
+      if(need > alloc){
+         alloc = (need > 2 * alloc) ? need : 2 * alloc;
+         ndata = (unsigned char *)realloc(idata, alloc);
+         if(ndata == (unsigned char *)NULL){
+            fprintf(stderr, "ERROR : read_image_header : realloc : idata\n");
+            free(idata);
+            fclose(fp);
+            return(-3);
+         }
+         idata = ndata;
+      }
+
+      /* Read ahead of the headers found so far, to save reads. */
+      n = fread(idata + ilen, 1, alloc - ilen, fp);
+      if(n == 0){
+         if(ferror(fp)){
+            fprintf(stderr, "ERROR : read_image_header : fread : %s : %s\n",
+                    ifile, strerror(errno));
+            free(idata);
+            fclose(fp);
+            return(-4);
+         }
+         break;
+      }
+      ilen += n;
+
+      ret = image_header_len(&need, idata, ilen);
+      if(ret){
+         free(idata);
+         fclose(fp);
+         return(ret);
+      }
+   }
+   fclose(fp);
+
+   *odata = idata;
+   *olen = ilen;
+   return(0);
+}
+
+/*******************************************************************/
+/* Gets the NISTCOM from the headers of a datastream of image     */
+/* type "img_type", or NULL if it has none.  IHead files carry    */
+/* none.                                                          */
+/*******************************************************************/
+int getc_nistcom_image(NISTCOM **onistcom, const int img_type,
+                       unsigned char *idata, const int ilen)
+{
+   switch(img_type){
+      case WSQ_IMG:
+           return(getc_nistcom_wsq(onistcom, idata, ilen));
+      case JPEGL_IMG:
+           return(getc_nistcom_jpegl(onistcom, idata, ilen));
+      case JPEGB_IMG:
+#if jpegb_SUPPORTED
+           return(getc_nistcom_jpegb(onistcom, idata, ilen));
+#else
+	   return -2;
+#endif
+      default:
+           *onistcom = (NISTCOM *)NULL;
+           return(0);
+   }
+}
+
+/*******************************************************************/
+/* Identifies and decodes the datastream in "idata" straight into */
+/* the "osize" byte buffer "obuf", which is not reallocated, with */
+/* rows "ostride" bytes apart, or packed if "ostride" is 0.       */
+/* JPEGL component planes follow one another as jpegl_decode_mem_ */
+/* into lays them out.  IHead pixels are decoded as by            */
+/* ihead_decode_mem and then copied in.                           */
+/*******************************************************************/
+int decode_image_mem_into(int *oimg_type, unsigned char *obuf,
+                    const int ostride, const int osize, int *ow, int *oh,
+                    int *od, int *oppi, int *lossyflag,
+                    unsigned char *idata, const int ilen)
+{
+   int ret, img_type, i;
+   int w, h, d, ppi, rowbytes, stride;
+   unsigned char *ndata;
+
+   ret = image_type(&img_type, idata, ilen);
+   if(ret)
+      return(ret);
+
+   switch(img_type){
+      case WSQ_IMG:
+           ret = wsq_decode_mem_into(obuf, ostride, osize, ow, oh, od, oppi,
+                                     lossyflag, idata, ilen);
+           break;
+      case JPEGL_IMG:
+           ret = jpegl_decode_mem_into(obuf, ostride, osize, ow, oh, od,
+                                       oppi, lossyflag, idata, ilen);
+           break;
+      case JPEGB_IMG:
+#if jpegb_SUPPORTED
+           ret = jpegb_decode_mem_into(obuf, ostride, osize, ow, oh, od,
+                                       oppi, lossyflag, idata, ilen);
+           break;
+#else
+	   return -2;
+#endif
+      case IHEAD_IMG:
+           /* Check the buffer before decoding into a temporary pixmap. */
+           ret = ihead_probe_mem(&w, &h, &d, &ppi, &rowbytes, idata, ilen);
+           if(ret)
+              return(ret);
+           stride = (ostride > 0) ? ostride : rowbytes;
+           if(stride < rowbytes){
+              fprintf(stderr, "ERROR : decode_image_mem_into : ");
+              fprintf(stderr, "row stride %d less than %d bytes per row\n",
+                      stride, rowbytes);
+              return(-4);
+           }
+           if(osize < stride * h){
+              fprintf(stderr, "ERROR : decode_image_mem_into : ");
+              fprintf(stderr, "buffer of %d bytes less than the %d needed\n",
+                      osize, stride * h);
+              return(-5);
+           }
+           ret = ihead_decode_mem(&ndata, ow, oh, od, oppi, lossyflag,
+                                  idata, ilen);
+           if(ret)
+              return(ret);
+           for(i = 0; i < h; i++)
+              memcpy(obuf + (i * stride), ndata + (i * rowbytes), rowbytes);
+           free(ndata);
+           break;
+      default:
+           fprintf(stderr, "ERROR : decode_image_mem_into : ");
+           fprintf(stderr, "illegal image type = %d\n", img_type);
+           return(-3);
+   }
+   if(ret)
+      return(ret);
+
+   *oimg_type = img_type;
+   return(0);
+}
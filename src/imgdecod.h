@@ -1,8 +1,16 @@
 #ifndef _IMGDECOD_H
 #define _IMGDECOD_H
 
+#include <stdio.h>
+#ifndef _NISTCOM_H
+#include <nistcom.h>
+#endif
+
 #define IMG_IGNORE  2
 
+/* Bytes of an image file first read for its headers. */
+#define IMG_HEADER_READ  4096
+
 extern int read_and_decode_dpyimage(char *, int *, unsigned char **, int *,
                                     int *, int *, int *, int *);
 
@@ -12,11 +20,50 @@ extern int read_and_decode_image(char *, int *, unsigned char **, int *,
 
 extern int ihead_decode_mem(unsigned char **, int *, int *, int *,
                             int *, int *, unsigned char *, const int);
+extern int probe_image_mem(int *, int *, int *, int *, int *, int *,
+                           const int, unsigned char *, const int);
+extern int decode_image_mem_into(int *, unsigned char *, const int,
+                           const int, int *, int *, int *, int *, int *,
+                           unsigned char *, const int);
+extern int image_header_len(int *, unsigned char *, const int);
+extern int read_image_header(char *, unsigned char **, int *);
+extern int getc_nistcom_image(NISTCOM **, const int, unsigned char *,
+                           const int);
+
+/* Largest run length coding of n bytes, as every ESCAPE byte in the */
+/* data takes two, plus the run a stream chunk carries to the next.  */
+#define RL_MAX_COMPLEN(n)  (2 * (n) + 3)
+
+/* Run length coding state carried from one chunk of a stream to the */
+/* next, so that streams may be coded concurrently.                  */
+typedef struct rl_enc_ctx {
+   int lastchar;     /* byte of the open run */
+   long count;       /* length of the open run, not yet written */
+} RL_ENC_CTX;
+
+typedef struct rl_dec_ctx {
+   int lastchar;     /* last literal byte, repeated by a run */
+   int escape;       /* chunk ended with an ESCAPE, count to come */
+} RL_DEC_CTX;
+
 void rldecomp(unsigned char *indata,int inbytes,unsigned char *outdata,
 		                int *outbytes, int outsize);
 void rlcomp( unsigned char *indata,
 		int inbytes,
 		unsigned char  *outdata,
 		int *outbytes,int outsize);
+extern void init_RL_ENC_CTX(RL_ENC_CTX *);
+extern void init_RL_DEC_CTX(RL_DEC_CTX *);
+extern int rlcomp_chunk(RL_ENC_CTX *, unsigned char *, const int, const int,
+                        unsigned char *, const int, int *);
+extern int rlcomp_mem(unsigned char *, const int, unsigned char *,
+                      const int, int *);
+extern int rlcomp_file(FILE *, unsigned char *, const int, int *);
+extern int rldecomp_chunk(RL_DEC_CTX *, unsigned char *, const int,
+                          unsigned char *, const int, int *);
+extern int rldecomp_mem(unsigned char *, const int, unsigned char *,
+                        const int, int *);
+extern int rldecomp_file(FILE *, const int, unsigned char *, const int,
+                         int *);
 
 #endif /* !_IMGDECOD_H */
@@ -0,0 +1,282 @@
+/************************************************************************
+
+      PACKAGE:  IMAGE ENCODER/DECODER TOOLS
+
+      FILE:     IMGPROBE.C
+
+#cat: imgprobe - Takes a WSQ, JPEGL, JPEGB or IHead image file and
+#cat:            prints its type, dimensions, pixel depth, PPI and
+#cat:            NISTCOM as a line of JSON, reading only the headers
+#cat:            of the file and decoding none of its pixels.
+#cat:            Given "-batch n", the image file names a list file or
+#cat:            a directory whose images are all probed by n workers,
+#cat:            printing a line for each.
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <imgtype.h>
+#include <imgdecod.h>
+#include <batch.h>
+
+/* A line of JSON being built. */
+typedef struct json_line {
+   char *buf;
+   int len;
+   int alloc;
+} JSON_LINE;
+
+void procargs(int, char **, char **, int *);
+void print_usage(const char *);
+int probe_image_file(char *, int *, int *);
+int load_probe_item(BATCH_ITEM *, void *);
+int run_probe_item(BATCH_ITEM *, const int, void *);
+
+int debug = 0;
+
+/******************/
+/*Start of Program*/
+/******************/
+
+int main(int argc, char *argv[])
+{
+   int ret, ilen, olen;
+   char *ifile;
+   int nworkers;                  /* batch workers, 0 for a single image */
+   char **files;
+   int nfiles;
+   BATCH_STATS stats;
+
+   procargs(argc, argv, &ifile, &nworkers);
+
+   if(nworkers == 0)
+      exit(probe_image_file(ifile, &ilen, &olen));
+
+   ret = read_batch_list(&files, &nfiles, ifile);
+   if(ret)
+      exit(ret);
+
+   ret = run_batch(files, nfiles, nworkers, load_probe_item,
+                   run_probe_item, (void *)NULL, &stats);
+   if(!ret){
+      /* Standard output holds the JSON, so report to standard error. */
+      print_batch_stats(stderr, &stats);
+      if(stats.nfailed)
+         ret = -1;
+   }
+   free_batch_list(files, nfiles);
+
+   exit(ret);
+}
+
+/*****************************************************************/
+/* Appends printf style text to a JSON line.                     */
+/*****************************************************************/
+static int add_json(JSON_LINE *line, const char *fmt, ...)
+{
+   va_list ap;
+   int n, nalloc;
+   char *nbuf;
+
+   while(1){
+      va_start(ap, fmt);
+      n = vsnprintf(line->buf + line->len, line->alloc - line->len, fmt, ap);
+      va_end(ap);
+      if(n < 0){
+         fprintf(stderr, "ERROR : add_json : vsnprintf\n");
+         return(-2);
+      }
+      if(line->len + n < line->alloc){
+         line->len += n;
+         return(0);
+      }
+      nalloc = 2 * (line->len + n + 1);
+      nbuf = (char *)realloc(line->buf, nalloc);
+      if(nbuf == (char *)NULL){
+         fprintf(stderr, "ERROR : add_json : realloc : buf\n");
+         return(-3);
+      }
+      line->buf = nbuf;
+      line->alloc = nalloc;
+   }
+}
+
+/*****************************************************************/
+/* Appends a string to a JSON line as a quoted JSON string.      */
+/*****************************************************************/
+static int add_json_string(JSON_LINE *line, const char *str)
+{
+   int ret;
+   const unsigned char *sptr;
+
+   ret = add_json(line, "\"");
+   for(sptr = (const unsigned char *)str; !ret && *sptr; sptr++){
+      if(*sptr == '"' || *sptr == '\\')
+         ret = add_json(line, "\\%c", *sptr);
+      else if(*sptr == '\n')
+         ret = add_json(line, "\\n");
+      else if(*sptr == '\t')
+         ret = add_json(line, "\\t");
+      else if(*sptr < 0x20)
+         ret = add_json(line, "\\u%04x", *sptr);
+      else
+         ret = add_json(line, "%c", *sptr);
+   }
+   if(ret)
+      return(ret);
+   return(add_json(line, "\""));
+}
+
+/*****************************************************************/
+/* Reads the headers of "ifile" and prints its attributes as one */
+/* line of JSON on standard output, setting the bytes read and   */
+/* written.  A file that cannot be read or probed still gets a   */
+/* line, giving the error.  The line is written in one call, so  */
+/* lines from parallel workers do not interleave.                */
+/*****************************************************************/
+int probe_image_file(char *ifile, int *oilen, int *olen)
+{
+   int ret, ilen, i;
+   int img_type, w, h, d, ppi, size;
+   unsigned char *idata;
+   NISTCOM *nistcom;
+   char *type_name;
+   JSON_LINE line;
+
+   line.buf = (char *)NULL;
+   line.len = 0;
+   line.alloc = 0;
+   nistcom = (NISTCOM *)NULL;
+   *oilen = 0;
+   *olen = 0;
+
+   ret = read_image_header(ifile, &idata, &ilen);
+   if(!ret){
+      *oilen = ilen;
+      ret = probe_image_mem(&img_type, &w, &h, &d, &ppi, &size, 0,
+                            idata, ilen);
+      if(!ret)
+         ret = getc_nistcom_image(&nistcom, img_type, idata, ilen);
+      free(idata);
+   }
+
+   if(add_json(&line, "{\"file\": ") || add_json_string(&line, ifile)){
+      free(line.buf);
+      if(nistcom != (NISTCOM *)NULL)
+         freefet(nistcom);
+      return(-2);
+   }
+
+   if(ret)
+      ret = add_json(&line, ", \"error\": %d}\n", ret) ? -2 : ret;
+   else{
+      switch(img_type){
+         case WSQ_IMG:
+              type_name = "WSQ";
+              break;
+         case JPEGL_IMG:
+              type_name = "JPEGL";
+              break;
+         case JPEGB_IMG:
+              type_name = "JPEGB";
+              break;
+         default:
+              type_name = "IHEAD";
+              break;
+      }
+      ret = add_json(&line, ", \"type\": \"%s\", \"width\": %d, "
+                     "\"height\": %d, \"depth\": %d, \"ppi\": %d",
+                     type_name, w, h, d, ppi);
+      if(!ret && nistcom != (NISTCOM *)NULL){
+         ret = add_json(&line, ", \"nistcom\": {");
+         for(i = 0; !ret && i < nistcom->num; i++){
+            ret = add_json(&line, (i > 0) ? ", " : "");
+            if(!ret)
+               ret = add_json_string(&line, nistcom->names[i]);
+            if(!ret)
+               ret = add_json(&line, ": ");
+            if(!ret)
+               ret = add_json_string(&line, (nistcom->values[i] != NULL) ?
+                                            nistcom->values[i] : "");
+         }
+         if(!ret)
+            ret = add_json(&line, "}");
+      }
+      if(!ret)
+         ret = add_json(&line, "}\n");
+   }
+   if(nistcom != (NISTCOM *)NULL)
+      freefet(nistcom);
+
+   /* Only whole lines are written. */
+   if(line.len > 0 && line.buf[line.len-1] == '\n'){
+      fwrite(line.buf, 1, line.len, stdout);
+      *olen = line.len;
+   }
+   free(line.buf);
+
+   return(ret);
+}
+
+/*****************************************************************/
+/* Batch read-ahead does nothing, as only the headers of each    */
+/* file are read, and those reads are better spread over the     */
+/* workers so that their waits on the disk overlap.              */
+/*****************************************************************/
+int load_probe_item(BATCH_ITEM *item, void *arg)
+{
+   (void)arg;
+   item->data = NULL;
+   item->ilen = 0;
+   return(0);
+}
+
+/*****************************************************************/
+/* Batch probe of one file.                                      */
+/*****************************************************************/
+int run_probe_item(BATCH_ITEM *item, const int worker, void *arg)
+{
+   (void)worker;
+   (void)arg;
+   return(probe_image_file(item->ifile, &item->ilen, &item->olen));
+}
+
+/*****************************************************************/
+void procargs(int argc, char **argv, char **ifile, int *nworkers)
+{
+   long ncpus;
+
+   /* A trailing "-batch n" probes a list file or directory of */
+   /* images with n workers, where 0 uses every processor.     */
+   *nworkers = 0;
+   if((argc > 3) && (strncmp(argv[argc-2], "-b", 2) == 0)){
+      if(sscanf(argv[argc-1], "%d", nworkers) != 1 || *nworkers < 0){
+         print_usage(argv[0]);
+         fprintf(stderr, "       invalid worker count \"%s\"\n",
+                 argv[argc-1]);
+         exit(-1);
+      }
+      if(*nworkers == 0){
+         ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+         *nworkers = (ncpus > 0) ? (int)ncpus : 1;
+      }
+      argc -= 2;
+   }
+
+   if(argc != 2){
+      print_usage(argv[0]);
+      exit(-1);
+   }
+
+   *ifile = argv[1];
+}
+
+/*****************************************************************/
+void print_usage(const char *arg0)
+{
+   fprintf(stderr, "Usage: %s <image file> [-batch n]\n", arg0);
+}
@@ -30,6 +30,11 @@ extern int jpegb_decode_mem(unsigned char **, int *, int *, int *, int *,
                             int *, unsigned char *, const int);
 extern int jpegb_decode_file(unsigned char **, int *, int *, int *, int *,
                              int *, FILE *);
+extern int jpegb_decode_mem_into(unsigned char *, const int, const int,
+                            int *, int *, int *, int *, int *,
+                            unsigned char *, const int);
+extern int jpegb_probe_mem(int *, int *, int *, int *, int *, const int,
+                           unsigned char *, const int);
 
 /* marker.c */
 extern int read_marker_jpegb(unsigned short *, const int, FILE *);
@@ -18,6 +18,10 @@
 #cat: jpegb_decode_mem - Decodes a datastream of JPEGB compressed bytes
 #cat:                    from a memory buffer, returning a lossy
 #cat:                    reconstructed pixmap.
+#cat: jpegb_decode_mem_into - Decodes a datastream of JPEGB compressed
+#cat:                    bytes into a caller supplied buffer.
+#cat: jpegb_probe_mem - Reads the image attributes and output buffer
+#cat:                    size of a JPEGB datastream from its headers.
 #cat: jpegb_decode_file - Decodes a datastream of JPEGB compressed bytes
 #cat:                    from an open file, returning a lossy
 #cat:                    reconstructed pixmap.
@@ -47,7 +51,6 @@ int jpegb_decode_mem(unsigned char **oout_buffer,
   struct jpeg_error_mgr jerr;
   unsigned char *out_buffer;
   unsigned char *bptr;
-  unsigned char **tbuffer;	/* Output buffer */
   int row_stride;		/* physical row width in output buffer */
   int ret;
 
@@ -104,20 +107,17 @@ int jpegb_decode_mem(unsigned char **oout_buffer,
 
   /* JSAMPLEs per row in output buffer */
   row_stride = cinfo.output_width * cinfo.output_components;
-  /* Make a one-row-high sample array that will go away when done with image */
-  tbuffer = (*cinfo.mem->alloc_sarray)
-		((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 
   /* Step 6: while (scan lines remain to be read) */
   /*           jpeg_read_scanlines(...); */
 
   /* Here we use the library's state variable cinfo.output_scanline as the
-   * loop counter, so that we don't have to keep track ourselves.
+   * loop counter, so that we don't have to keep track ourselves.  Each
+   * scanline is decoded straight into its row of the output buffer.
    */
   bptr = out_buffer;
   while (cinfo.output_scanline < cinfo.output_height) {
-    (void) jpeg_read_scanlines(&cinfo, tbuffer, 1);
-    memcpy(bptr, tbuffer[0], row_stride);
+    (void) jpeg_read_scanlines(&cinfo, &bptr, 1);
     bptr += row_stride;
   }
 
@@ -154,6 +154,129 @@ int jpegb_decode_mem(unsigned char **oout_buffer,
   return(0);
 }
 
+/*********************************************************************/
+/* JPEGB Decoder routine.  Decodes a Baseline JPEG compressed memory */
+/* buffer straight into the "osize" byte buffer "obuf", which is not */
+/* reallocated, with rows "ostride" bytes apart, or packed if        */
+/* "ostride" is 0.  The size needed may be found beforehand with     */
+/* jpegb_probe_mem.                                                  */
+/*********************************************************************/
+int jpegb_decode_mem_into(unsigned char *obuf, const int ostride,
+                     const int osize, int *ow, int *oh, int *od, int *oppi,
+                     int *lossy_flag, unsigned char *in_buffer,
+                     const int in_buffer_size)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  unsigned char *bptr;
+  int row_stride;		/* physical row width in output buffer */
+  int rowbytes;		/* bytes of pixels in each output row */
+  int ret;
+
+  if(obuf == (unsigned char *)NULL){
+     fprintf(stderr, "ERROR : jpegb_decode_mem_into : NULL buffer\n");
+     return(-3);
+  }
+
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_membuf_src(&cinfo, (JOCTET *)in_buffer, (size_t)in_buffer_size);
+  (void) jpeg_read_header(&cinfo, TRUE);
+
+  /* Check the caller's buffer against the output dimensions before */
+  /* any of the image is decoded.                                   */
+  jpeg_calc_output_dimensions(&cinfo);
+  rowbytes = (int)(cinfo.output_width * cinfo.output_components);
+  row_stride = (ostride > 0) ? ostride : rowbytes;
+  if(row_stride < rowbytes){
+     fprintf(stderr, "ERROR : jpegb_decode_mem_into : ");
+     fprintf(stderr, "row stride %d less than %d bytes per row\n",
+             row_stride, rowbytes);
+     jpeg_destroy_decompress(&cinfo);
+     return(-4);
+  }
+  if(osize < row_stride * (int)cinfo.output_height){
+     fprintf(stderr, "ERROR : jpegb_decode_mem_into : ");
+     fprintf(stderr, "buffer of %d bytes less than the %d needed\n",
+             osize, row_stride * (int)cinfo.output_height);
+     jpeg_destroy_decompress(&cinfo);
+     return(-5);
+  }
+
+  ret = get_ppi_jpegb(oppi, &cinfo);
+  if(ret){
+     jpeg_destroy_decompress(&cinfo);
+     return(ret);
+  }
+
+  jpeg_start_decompress(&cinfo);
+
+  bptr = obuf;
+  while (cinfo.output_scanline < cinfo.output_height) {
+    (void) jpeg_read_scanlines(&cinfo, &bptr, 1);
+    bptr += row_stride;
+  }
+
+  *ow = cinfo.output_width;
+  *oh = cinfo.output_height;
+  *od = cinfo.output_components<<3;
+
+  (void) jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+
+  *lossy_flag = TRUE;
+
+  return(0);
+}
+
+/*********************************************************************/
+/* Reads only the headers of a Baseline JPEG compressed memory       */
+/* buffer, returning the image attributes and, in "osize", the bytes */
+/* a buffer passed to jpegb_decode_mem_into with the same "ostride"  */
+/* must hold.                                                        */
+/*********************************************************************/
+int jpegb_probe_mem(int *ow, int *oh, int *od, int *oppi, int *osize,
+                    const int ostride, unsigned char *in_buffer,
+                    const int in_buffer_size)
+{
+  struct jpeg_decompress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  int row_stride;
+  int rowbytes;
+  int ret;
+
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_membuf_src(&cinfo, (JOCTET *)in_buffer, (size_t)in_buffer_size);
+  (void) jpeg_read_header(&cinfo, TRUE);
+  jpeg_calc_output_dimensions(&cinfo);
+
+  rowbytes = (int)(cinfo.output_width * cinfo.output_components);
+  row_stride = (ostride > 0) ? ostride : rowbytes;
+  if(row_stride < rowbytes){
+     fprintf(stderr, "ERROR : jpegb_probe_mem : ");
+     fprintf(stderr, "row stride %d less than %d bytes per row\n",
+             row_stride, rowbytes);
+     jpeg_destroy_decompress(&cinfo);
+     return(-4);
+  }
+
+  ret = get_ppi_jpegb(oppi, &cinfo);
+  if(ret){
+     jpeg_destroy_decompress(&cinfo);
+     return(ret);
+  }
+
+  *ow = cinfo.output_width;
+  *oh = cinfo.output_height;
+  *od = cinfo.output_components<<3;
+  *osize = row_stride * cinfo.output_height;
+
+  jpeg_destroy_decompress(&cinfo);
+
+  return(0);
+}
+
 /*********************************************************************/
 int jpegb_decode_file(unsigned char **oout_buffer,
                       int *ow, int *oh, int *od, int *oppi, int *lossy_flag,
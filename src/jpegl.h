@@ -128,6 +128,34 @@ typedef struct htable {
    HUFFCODE *huffcode_table;
 } HUF_TABLE;
 
+/* Huffman decode table for lossless differences.  Codes of up to   */
+/* JPEGL_HUFF_LOOKAHEAD bits are resolved with a single lookup, and  */
+/* where the extra bits of the difference also fit in the lookahead  */
+/* the difference itself is resolved with it.  Longer codes fall     */
+/* back to the maxcode/mincode/valptr search.                        */
+#define JPEGL_HUFF_LOOKAHEAD  10
+
+typedef struct table_hdec_jpegl {
+   unsigned char look_size[1 << JPEGL_HUFF_LOOKAHEAD]; /* 0 if not resolved */
+   unsigned char look_cat[1 << JPEGL_HUFF_LOOKAHEAD];
+   unsigned char look_nbits[1 << JPEGL_HUFF_LOOKAHEAD]; /* code and extra */
+                                                         /* bits, or 0     */
+   short look_diff[1 << JPEGL_HUFF_LOOKAHEAD];
+   int *maxcode;
+   int *mincode;
+   int *valptr;
+   unsigned char *huffvalues;
+} HDEC_TABLE_JPEGL;
+
+/* Bit reservoir for reading entropy coded data.  Stuffed zero bytes */
+/* are dropped as bytes are loaded, and loading stops in front of    */
+/* the first marker, which is left unread.                           */
+typedef struct bitbuf_jpegl {
+   unsigned long long bits;  /* buffered bits, most significant first */
+   int nbits;                /* number of buffered bits */
+   int marker;               /* whether a marker ends the data */
+} BITBUF_JPEGL;
+
 typedef struct fheader {
    unsigned char prec;
    unsigned short x;
@@ -155,21 +183,43 @@ extern int debug;
 //extern int jpgl_encode_mem(unsigned char **, int *, IMG_DAT *, char *);
 extern int jpegl_encode_mem(unsigned char **odata, int *olen, IMG_DAT *img_dat,
 		                     char *comment_text);
+extern int jpegl_encode_mem_mt(unsigned char **, int *, IMG_DAT *, char *,
+                    const int);
+extern int jpegl_encode_mem_restart(unsigned char **, int *, IMG_DAT *,
+                    char *, const int, const int);
 extern int gen_diff_freqs(IMG_DAT *, HUF_TABLE **);
+extern int gen_cmpnt_diff_freqs(IMG_DAT *, HUF_TABLE **, const int,
+                    const int);
 extern int compress_image_intrlv(IMG_DAT *, HUF_TABLE **,
                     unsigned char *, const int, int *);
 extern int compress_image_non_intrlv(IMG_DAT *, HUF_TABLE **,
                     unsigned char *, const int, int *);
+extern int compress_cmpnt_non_intrlv(IMG_DAT *, HUF_TABLE **, const int,
+                    const int, unsigned char *, const int, int *);
 extern int code_diff(HUFFCODE *, HUFFCODE *, int *, unsigned int *, short *);
 
 /* decoder.c */
 extern int jpegl_decode_mem(IMG_DAT **, int *, unsigned char *, const int);
+extern int jpegl_decode_mem_mt(IMG_DAT **, int *, unsigned char *, const int,
+                 const int);
+extern int jpegl_decode_mem_into(unsigned char *, const int, const int,
+                 int *, int *, int *, int *, int *, unsigned char *,
+                 const int);
+extern int jpegl_probe_mem(int *, int *, int *, int *, int *, const int,
+                 unsigned char *, const int);
 extern void build_huff_decode_table(int [MAX_CATEGORY][LARGESTDIFF+1]);
 extern int decode_data(int *, int *, int *, int *, unsigned char *,
                     unsigned char **, unsigned char *, int *);
 extern int nextbits_jpegl(unsigned short *, FILE *, int *, const int);
 extern int getc_nextbits_jpegl(unsigned short *, unsigned char **,
                     unsigned char *, int *, const int);
+extern void gen_hdec_table_jpegl(HDEC_TABLE_JPEGL *, HUF_TABLE *);
+extern void fill_bitbuf_jpegl(BITBUF_JPEGL *, unsigned char **,
+                    unsigned char *);
+extern void unget_bitbuf_jpegl(BITBUF_JPEGL *, unsigned char **,
+                    unsigned char *);
+extern int getc_diff_row_jpegl(short *, const int, HDEC_TABLE_JPEGL *,
+                    BITBUF_JPEGL *, unsigned char **, unsigned char *);
 
 /* huff.c */
 extern int read_huffman_table(unsigned char *, unsigned char **,
@@ -195,6 +245,7 @@ extern void gen_decode_table(HUFFCODE *, int *, int *, int *, unsigned char *);
 
 /* huftable.c */
 extern int gen_huff_tables(HUF_TABLE **, const int);
+extern int gen_huff_table(HUF_TABLE *, const int);
 extern int read_huffman_table_jpegl(HUF_TABLE **, FILE *);
 extern int getc_huffman_table_jpegl(HUF_TABLE **, unsigned char **,
                    unsigned char *);
@@ -241,6 +292,8 @@ extern int read_scan_header(SCN_HEADER **, FILE *);
 extern int getc_scan_header(SCN_HEADER **, unsigned char **, unsigned char *);
 extern int write_scan_header(SCN_HEADER *, FILE *);
 extern int putc_scan_header(SCN_HEADER *, unsigned char *, const int, int *);
+extern int getc_restart_interval(int *, unsigned char **, unsigned char *);
+extern int putc_restart_interval(const int, unsigned char *, const int, int *);
 extern int read_comment(unsigned char **, FILE *);
 extern int getc_comment(unsigned char **, unsigned char **, unsigned char *);
 extern int write_comment(const unsigned short, unsigned char *, const int,
@@ -259,6 +312,12 @@ extern int putc_nistcom_jpegl(char *comment_text, const int w, const int h,
 /* util.c */
 extern int predict(short *, unsigned char *, const int, const int, const int,
                    const int, const int);
+extern int predict_pitch(short *, unsigned char *, const int, const int,
+                   const int, const int, const int, const int);
+extern int predict_diff_row(short *, unsigned char *, const int, const int,
+                 const int, const int, const int, const int);
+extern int undo_predict_row(unsigned char *, short *, const int, const int,
+                 const int, const int, const int, const int);
 extern short categorize(const short);
 
 /* HERE: ioutil.c to be removed */
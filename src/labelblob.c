@@ -0,0 +1,444 @@
+/***********************************************************************
+      LIBRARY: IMAGE - Image Manipulation and Processing Routines
+
+      FILE:    LABELBLOB.C
+
+      Labels every blob of a binary character image in one pass.
+      Each row is cut into runs of true pixels, and runs that touch
+      a run on the row above are joined with a union-find forest.
+      Tall rasters are cut into stripes of rows that are labeled on
+      their own threads; the runs that meet across a stripe boundary
+      are joined afterwards.  All state lives in the call, and the
+      input raster is not changed.
+
+      ROUTINES:
+#cat: label_blobs - finds all 4- or 8-connected blobs of true pixels in
+#cat:               a binary character image, returning the bounding
+#cat:               box, pixel count and runs of each.
+#cat: free_BLOB_LIST - deallocates the blobs returned by label_blobs.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <findblob.h>
+
+#define ONES_WORD   0x0101010101010101ULL
+#define HIGHS_WORD  0x8080808080808080ULL
+/* Nonzero if some byte of the word is zero.  The lowest bit set */
+/* is always in the lowest zero byte.                            */
+#define HAS_ZERO_BYTE(v)  (((v) - ONES_WORD) & ~(v) & HIGHS_WORD)
+
+/* Where the first byte in memory is the low byte of a word, the */
+/* first byte a mask flags can be counted straight to.           */
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define FIRST_FLAGGED_BYTE(m)  (__builtin_ctzll(m) >> 3)
+#else
+#define FIRST_FLAGGED_BYTE(m)  0
+#endif
+
+/* The rows y0 through y1-1, labeled by one thread.  Run indices and */
+/* parents are local to the stripe until the stripes are merged.     */
+typedef struct label_stripe {
+   unsigned char *ras;
+   int w;
+   int y0, y1;
+   int slack;          /* 1 if runs touching at a corner connect */
+   BLOB_RUN *runs;
+   int *parent;        /* union-find parent of each run */
+   int nruns;
+   int nalloc;
+   int njoins;         /* trees merged, so nruns-njoins blobs */
+   int first_end;      /* runs on row y0 */
+   int last_start;     /* first run on row y1-1 */
+   int ret;
+} LABEL_STRIPE;
+
+/*********************************************************************/
+/* Follows a run to the root of its tree, halving the path.  A run's  */
+/* parent always has a smaller index, so the root of a tree is its    */
+/* first run in raster order.                                         */
+/*********************************************************************/
+static int find_root(int *parent, int i)
+{
+   while(parent[i] != i){
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+   }
+   return(i);
+}
+
+static int join_runs(int *parent, int a, int b)
+{
+   a = find_root(parent, a);
+   b = find_root(parent, b);
+   if(a < b)
+      parent[b] = a;
+   else if(b < a)
+      parent[a] = b;
+   else
+      return(0);
+   return(1);
+}
+
+/*********************************************************************/
+/* Joins the runs above, p0 through p1-1, with the runs below, c0     */
+/* through c1-1, that they touch, and returns how many trees were     */
+/* merged.  Both rows are sorted on x, so one merge-like sweep visits */
+/* each touching pair.  A run below that is still a root can be hung  */
+/* straight from the root above, which has the smaller index.         */
+/*********************************************************************/
+static int join_rows(BLOB_RUN *runs, int *parent, int p0, const int p1,
+                     int c0, const int c1, const int slack)
+{
+   int njoins = 0;
+
+   while(p0 < p1 && c0 < c1){
+      if(runs[p0].x_off + slack <= runs[c0].x_on)
+         p0++;
+      else if(runs[c0].x_off + slack <= runs[p0].x_on)
+         c0++;
+      else{
+         if(parent[c0] == c0){
+            parent[c0] = find_root(parent, p0);
+            njoins++;
+         }
+         else
+            njoins += join_runs(parent, p0, c0);
+         if(runs[p0].x_off < runs[c0].x_off)
+            p0++;
+         else
+            c0++;
+      }
+   }
+
+   return(njoins);
+}
+
+/*********************************************************************/
+/* Appends the runs of one row to the stripe.  Pixels are tested      */
+/* eight at a time, and the byte loops only finish off a row's tail   */
+/* (or every edge where the first byte cannot be counted to).         */
+/*********************************************************************/
+static int scan_row(LABEL_STRIPE *stripe, const int y)
+{
+   unsigned char *row = stripe->ras + (size_t)y * stripe->w;
+   const int w = stripe->w;
+   unsigned long long word;
+   BLOB_RUN *runs;
+   int *parent;
+   int x, x_on, nalloc;
+
+   x = 0;
+   while(x < w){
+      while(x + 8 <= w){
+         memcpy(&word, row + x, 8);
+         if(word){
+            x += FIRST_FLAGGED_BYTE(word);
+            break;
+         }
+         x += 8;
+      }
+      while(x < w && !row[x])
+         x++;
+      if(x == w)
+         break;
+
+      x_on = x;
+      while(x + 8 <= w){
+         memcpy(&word, row + x, 8);
+         if((word = HAS_ZERO_BYTE(word))){
+            x += FIRST_FLAGGED_BYTE(word);
+            break;
+         }
+         x += 8;
+      }
+      while(x < w && row[x])
+         x++;
+
+      if(stripe->nruns == stripe->nalloc){
+         nalloc = stripe->nalloc * 2;
+         runs = (BLOB_RUN *)realloc(stripe->runs, nalloc * sizeof(BLOB_RUN));
+         if(runs == (BLOB_RUN *)NULL){
+            fprintf(stderr, "ERROR : scan_row : realloc : runs\n");
+            return(-3);
+         }
+         stripe->runs = runs;
+         parent = (int *)realloc(stripe->parent, nalloc * sizeof(int));
+         if(parent == (int *)NULL){
+            fprintf(stderr, "ERROR : scan_row : realloc : parent\n");
+            return(-3);
+         }
+         stripe->parent = parent;
+         stripe->nalloc = nalloc;
+      }
+      stripe->runs[stripe->nruns].y = y;
+      stripe->runs[stripe->nruns].x_on = x_on;
+      stripe->runs[stripe->nruns].x_off = x;
+      stripe->parent[stripe->nruns] = stripe->nruns;
+      stripe->nruns++;
+   }
+
+   return(0);
+}
+
+/*********************************************************************/
+/* Cuts a stripe into runs and joins the runs of each row with those  */
+/* of the row above.                                                  */
+/*********************************************************************/
+static int label_stripe(LABEL_STRIPE *stripe)
+{
+   int y, ret, prev_start, cur_start;
+
+   stripe->nalloc = stripe->w;
+   if(stripe->nalloc < 256)
+      stripe->nalloc = 256;
+   stripe->runs = (BLOB_RUN *)malloc(stripe->nalloc * sizeof(BLOB_RUN));
+   stripe->parent = (int *)malloc(stripe->nalloc * sizeof(int));
+   if(stripe->runs == (BLOB_RUN *)NULL || stripe->parent == (int *)NULL){
+      fprintf(stderr, "ERROR : label_stripe : malloc : runs\n");
+      return(-3);
+   }
+
+   prev_start = 0;
+   cur_start = 0;
+   for(y = stripe->y0; y < stripe->y1; y++){
+      if((ret = scan_row(stripe, y)))
+         return(ret);
+      if(y == stripe->y0)
+         stripe->first_end = stripe->nruns;
+      else
+         stripe->njoins += join_rows(stripe->runs, stripe->parent,
+                                     prev_start, cur_start, cur_start,
+                                     stripe->nruns, stripe->slack);
+      prev_start = cur_start;
+      cur_start = stripe->nruns;
+   }
+   stripe->last_start = prev_start;
+
+   return(0);
+}
+
+static void *label_stripe_thread(void *varg)
+{
+   LABEL_STRIPE *stripe = (LABEL_STRIPE *)varg;
+
+   stripe->ret = label_stripe(stripe);
+   return((void *)NULL);
+}
+
+/*********************************************************************/
+/* Gathers the joined runs into nblobs blobs.  Blobs are numbered in  */
+/* the order of their root runs, and each blob's runs are copied out  */
+/* in raster order.                                                   */
+/*********************************************************************/
+static int collect_blobs(BLOB_LIST **oblist, BLOB_RUN *runs, int *parent,
+                         const int nruns, const int nblobs)
+{
+   BLOB_LIST *blist;
+   BLOB *blob;
+   int i, n, *next;
+
+   blist = (BLOB_LIST *)calloc(1, sizeof(BLOB_LIST));
+   if(blist == (BLOB_LIST *)NULL){
+      fprintf(stderr, "ERROR : collect_blobs : calloc : blist\n");
+      return(-3);
+   }
+   blist->nblobs = nblobs;
+   blist->nruns = nruns;
+   blist->blobs = (BLOB *)calloc(nblobs + 1, sizeof(BLOB));
+   blist->runs = (BLOB_RUN *)malloc((nruns + 1) * sizeof(BLOB_RUN));
+   next = (int *)malloc((nblobs + 1) * sizeof(int));
+   if(blist->blobs == (BLOB *)NULL || blist->runs == (BLOB_RUN *)NULL ||
+      next == (int *)NULL){
+      fprintf(stderr, "ERROR : collect_blobs : malloc : blobs\n");
+      if(next != (int *)NULL)
+         free(next);
+      free_BLOB_LIST(blist);
+      return(-3);
+   }
+
+   /* A parent comes before its child, so a run can take its blob     */
+   /* number from its parent, overwriting the parent in place.  Runs  */
+   /* arrive top to bottom, so the first run of a blob gives its top  */
+   /* and the last its bottom.  box_w holds the right edge and box_h  */
+   /* the bottom row until the end.                                   */
+   n = 0;
+   for(i = 0; i < nruns; i++){
+      if(parent[i] == i){
+         parent[i] = n;
+         blob = blist->blobs + n++;
+         blob->box_x = runs[i].x_on;
+         blob->box_y = runs[i].y;
+         blob->box_w = runs[i].x_off;
+      }
+      else{
+         parent[i] = parent[parent[i]];
+         blob = blist->blobs + parent[i];
+         if(runs[i].x_on < blob->box_x)
+            blob->box_x = runs[i].x_on;
+         if(runs[i].x_off > blob->box_w)
+            blob->box_w = runs[i].x_off;
+      }
+      blob->box_h = runs[i].y;
+      blob->npixels += runs[i].x_off - runs[i].x_on;
+      blob->nruns++;
+   }
+
+   next[0] = 0;
+   for(i = 0; i < nblobs; i++){
+      blob = blist->blobs + i;
+      blob->box_w -= blob->box_x;
+      blob->box_h -= blob->box_y - 1;
+      blob->runs = blist->runs + next[i];
+      next[i+1] = next[i] + blob->nruns;
+   }
+   for(i = 0; i < nruns; i++)
+      blist->runs[next[parent[i]]++] = runs[i];
+
+   free(next);
+   *oblist = blist;
+   return(0);
+}
+
+/************************************************************************/
+/* label_blobs - finds every connected blob of true (nonzero) pixels in */
+/* a one byte per pixel raster, in a single pass that leaves the raster */
+/* unchanged.  Connectivity is CONNECT4 or CONNECT8.  When nthreads is  */
+/* more than one, stripes of at least BLOB_MIN_STRIPE_ROWS rows are     */
+/* labeled concurrently; the result does not depend on the number of    */
+/* threads.  The caller frees the result with free_BLOB_LIST().         */
+/************************************************************************/
+int label_blobs(BLOB_LIST **oblist, unsigned char *ras, const int w,
+                const int h, const int connectivity, const int nthreads)
+{
+   LABEL_STRIPE *stripes;
+   pthread_t *threads;
+   char *started;
+   BLOB_RUN *runs;
+   int *parent;
+   int i, j, ret, nstripes, nruns, njoins, off, prev_off;
+
+   if(w < 0 || h < 0 ||
+      (connectivity != CONNECT4 && connectivity != CONNECT8)){
+      fprintf(stderr, "ERROR : label_blobs : ");
+      fprintf(stderr, "bad dimensions %dx%d or connectivity %d\n",
+              w, h, connectivity);
+      return(-2);
+   }
+
+   nstripes = h / BLOB_MIN_STRIPE_ROWS;
+   if(nstripes > nthreads)
+      nstripes = nthreads;
+   if(nstripes < 1)
+      nstripes = 1;
+
+   stripes = (LABEL_STRIPE *)calloc(nstripes, sizeof(LABEL_STRIPE));
+   threads = (pthread_t *)malloc(nstripes * sizeof(pthread_t));
+   started = (char *)calloc(nstripes, sizeof(char));
+   if(stripes == (LABEL_STRIPE *)NULL || threads == (pthread_t *)NULL ||
+      started == (char *)NULL){
+      fprintf(stderr, "ERROR : label_blobs : malloc : stripes\n");
+      ret = -3;
+      goto done;
+   }
+   for(i = 0; i < nstripes; i++){
+      stripes[i].ras = ras;
+      stripes[i].w = w;
+      stripes[i].y0 = (int)((long)h * i / nstripes);
+      stripes[i].y1 = (int)((long)h * (i+1) / nstripes);
+      stripes[i].slack = (connectivity == CONNECT8);
+   }
+
+   /* The calling thread labels the first stripe, and any stripe */
+   /* whose thread could not be started.                         */
+   for(i = 1; i < nstripes; i++)
+      if(pthread_create(&threads[i], NULL, label_stripe_thread, &stripes[i])
+         == 0)
+         started[i] = 1;
+   for(i = 0; i < nstripes; i++)
+      if(!started[i])
+         stripes[i].ret = label_stripe(&stripes[i]);
+   for(i = 1; i < nstripes; i++)
+      if(started[i])
+         pthread_join(threads[i], NULL);
+
+   ret = 0;
+   for(i = 0; i < nstripes && !ret; i++)
+      ret = stripes[i].ret;
+   if(ret)
+      goto done;
+
+   if(nstripes == 1){
+      ret = collect_blobs(oblist, stripes[0].runs, stripes[0].parent,
+                          stripes[0].nruns,
+                          stripes[0].nruns - stripes[0].njoins);
+      goto done;
+   }
+
+   /* Lay the stripes end to end, offsetting their run indices, and */
+   /* join the runs that meet across each boundary.                 */
+   nruns = 0;
+   njoins = 0;
+   for(i = 0; i < nstripes; i++){
+      nruns += stripes[i].nruns;
+      njoins += stripes[i].njoins;
+   }
+   runs = (BLOB_RUN *)malloc((nruns + 1) * sizeof(BLOB_RUN));
+   parent = (int *)malloc((nruns + 1) * sizeof(int));
+   if(runs == (BLOB_RUN *)NULL || parent == (int *)NULL){
+      fprintf(stderr, "ERROR : label_blobs : malloc : runs\n");
+      if(runs != (BLOB_RUN *)NULL)
+         free(runs);
+      if(parent != (int *)NULL)
+         free(parent);
+      ret = -3;
+      goto done;
+   }
+   off = 0;
+   prev_off = 0;
+   for(i = 0; i < nstripes; i++){
+      memcpy(runs + off, stripes[i].runs, stripes[i].nruns * sizeof(BLOB_RUN));
+      for(j = 0; j < stripes[i].nruns; j++)
+         parent[off + j] = off + stripes[i].parent[j];
+      if(i > 0)
+         njoins += join_rows(runs, parent, prev_off + stripes[i-1].last_start,
+                             off, off, off + stripes[i].first_end,
+                             stripes[i].slack);
+      prev_off = off;
+      off += stripes[i].nruns;
+   }
+
+   ret = collect_blobs(oblist, runs, parent, nruns, nruns - njoins);
+   free(runs);
+   free(parent);
+
+done:
+   if(stripes != (LABEL_STRIPE *)NULL){
+      for(i = 0; i < nstripes; i++){
+         if(stripes[i].runs != (BLOB_RUN *)NULL)
+            free(stripes[i].runs);
+         if(stripes[i].parent != (int *)NULL)
+            free(stripes[i].parent);
+      }
+      free(stripes);
+   }
+   if(threads != (pthread_t *)NULL)
+      free(threads);
+   if(started != (char *)NULL)
+      free(started);
+   return(ret);
+}
+
+/************************************************************************/
+void free_BLOB_LIST(BLOB_LIST *blist)
+{
+   if(blist->blobs != (BLOB *)NULL)
+      free(blist->blobs);
+   if(blist->runs != (BLOB_RUN *)NULL)
+      free(blist->runs);
+   free(blist);
+}
@@ -152,7 +152,7 @@ int *bpi,int *width,int *height)
 		file,n,filesize);
          exit(1);
       } /* IF */
-   } else {
+   } else if(comp != RL) {
       malloc_uchar(&indata, complen, "ReadBinaryRaster : indata");
       n = fread(indata,1,complen,fp); /* file compressed */
       if (n != complen) {
@@ -164,10 +164,11 @@ int *bpi,int *width,int *height)
 
    switch (comp) {
       case RL:
-	 rldecomp(indata,complen,outdata,&outbytes,filesize);
+         /* compressed data is read and decoded a chunk at a time */
+         if(rldecomp_file(fp,complen,outdata,filesize,&outbytes))
+            fatalerr("ReadBinaryRaster",file,"RL decompression failed");
          set_compression(ihead, UNCOMP);
          set_complen(ihead, 0);
-         free((char *)indata);
          break;
       case CCITT_G4:
          if((*head)->sigbit == LSBF) {
@@ -256,7 +257,7 @@ int *width,int *height,int *depth)
 		file,n,filesize);
          exit(1);
       } /* IF */
-   } else {
+   } else if(comp != RL) {
       malloc_uchar(&indata, complen, "ReadIheadRaster : indata");
       n = fread(indata,1,complen,fp); /* file compressed */
       if (n != complen) {
@@ -269,13 +270,14 @@ int *width,int *height,int *depth)
 
    switch (comp) {
       case RL:
-	rldecomp(indata,complen,outdata,&outbytes,filesize);
+        /* compressed data is read and decoded a chunk at a time */
+        if(rldecomp_file(fp,complen,outdata,filesize,&outbytes))
+           fatalerr("ReadIheadRaster",file,"RL decompression failed");
 	memset((*head)->complen,0,SHORT_CHARS);
 	memset((*head)->compress,0,SHORT_CHARS);
         (void) sprintf((*head)->complen,"%d",0);
         (void) sprintf((*head)->compress,"%d",UNCOMP);
         *data = outdata;
-        free((char *)indata);
       break;
       case CCITT_G4:
         if((*head)->sigbit == LSBF) {
@@ -3,7 +3,7 @@
 
       FILE:    RL.C
       AUTHOR:  Darlene E. Frederick
-               
+
       DATE:    12/28/1989
 
       Contains routines responsible for Run-Length encoding
@@ -12,110 +12,213 @@
       ROUTINES:
 #cat: rlcomp - run length compresses an image.
 #cat:
-#cat: PutNchar - generates the next run length code.
+#cat: rlcomp_mem - run length compresses an image into a buffer of
+#cat:              a given size, returning an error if it is too small.
+#cat:
+#cat: rlcomp_chunk - run length compresses the next chunk of a stream,
+#cat:                carrying the unfinished run in a context.
+#cat:
+#cat: rlcomp_file - run length compresses an image to an open file a
+#cat:               chunk at a time.
 #cat:
 #cat: rldecomp - decompresses a run length encoded image.
 #cat:
-#cat: RLL_putc - expands a given run length code.
+#cat: rldecomp_mem - decompresses a run length encoded image into a
+#cat:                buffer of a given size, returning an error if it is
+#cat:                too small or the data is corrupt.
+#cat:
+#cat: rldecomp_chunk - decompresses the next chunk of a stream, carrying
+#cat:                  the decoder state in a context.
+#cat:
+#cat: rldecomp_file - decompresses a run length encoded image read from
+#cat:                 an open file a chunk at a time.
 #cat:
 
 ***********************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "imgdecod.h"
 
-#define DLE 0x90			/* repeat sequence marker */
-#define NOHIST	0			/* don't consider previous input*/
-#define INREP 1 			/* sending a repeated value */
-#define SENTCHAR 1			/* lastchar set, no lookahead yet */
-#define SENDNEWC 2			/* run over, send new char next */
-#define SENDCNT 3			/* newchar set, send count next */
-#define BUFFSIZE	80
-#define  ESCAPE		0x90
+#define  ESCAPE		0x90		/* repeat sequence marker */
+#define  MAX_REPEAT	255		/* longest run in one sequence */
+#define  MIN_REPEAT	4		/* shortest run sent as a sequence */
+#define  RL_CHUNK	65536		/* bytes coded per chunk of a stream */
 #define min(a, b)    ((a) < (b) ? (a) : (b))
-#define TRUE	1
-#define FALSE	0
 
 /*********************************************************************
-*	Routine:  putNchar()					     *
-*  	Author:   Darlene E. Frederick				     *
-*  	Date:     12/28/89					     *
+* init_RL_ENC_CTX() and init_RL_DEC_CTX() start a new stream.        *
+*********************************************************************/
+void init_RL_ENC_CTX(RL_ENC_CTX *ctx)
+{
+    ctx->lastchar = 0;
+    ctx->count = 0;
+}
+
+void init_RL_DEC_CTX(RL_DEC_CTX *ctx)
+{
+    ctx->lastchar = 0;
+    ctx->escape = 0;
+}
+
+/*********************************************************************
+* run_length() returns the number of bytes from "iptr", short of     *
+* "iend", equal to "ch".  Bytes are compared 8 at a time against a   *
+* word holding "ch" in every byte, and only the word in which the    *
+* run ends is looked at a byte at a time.                            *
+*********************************************************************/
+static int run_length(const unsigned char *iptr, const unsigned char *iend,
+                      const int ch)
+{
+    const unsigned char *ptr;
+    unsigned long long pattern, word;
+
+    ptr = iptr;
+    /* Most runs in gray or noisy data end at once. */
+    if (ptr < iend && *ptr != ch)
+        return(0);
+
+    pattern = 0x0101010101010101ULL * (unsigned char)ch;
+    while (iend - ptr >= 8) {
+        memcpy(&word, ptr, 8);
+        if (word != pattern)
+            break;
+        ptr += 8;
+    }
+    while (ptr < iend && *ptr == ch)
+        ptr++;
+    return((int)(ptr - iptr));
+}
+
+/*********************************************************************
+* put_run() outputs "count" copies of "ch" at "*optr", short of      *
+* "oend", as the run length code: a run of the ESCAPE byte is sent   *
+* as ESCAPE 0 pairs, a run of at least MIN_REPEAT other bytes as     *
+* sequences of the byte, ESCAPE and a count of up to MAX_REPEAT,     *
+* and any shorter remainder as literal bytes.  Returns -1 if the     *
+* output does not fit.                                               *
 *********************************************************************/
+static int put_run(const int ch, long count, unsigned char **optr,
+                   unsigned char *oend)
+{
+    unsigned char *ptr;
+    int n;
+
+    ptr = *optr;
+    if (ch == ESCAPE) {
+        if (oend - ptr < 2 * count)
+            return(-1);
+        while (count-- > 0) {
+            *ptr++ = ESCAPE;
+            *ptr++ = 0;
+        }
+        *optr = ptr;
+        return(0);
+    }
+
+    while (count >= MIN_REPEAT) {
+        if (oend - ptr < 3)
+            return(-1);
+        n = (int)min(count, MAX_REPEAT);
+        *ptr++ = ch;
+        *ptr++ = ESCAPE;
+        *ptr++ = n;
+        count -= n;
+    }
+    if (oend - ptr < count)
+        return(-1);
+    while (count-- > 0)
+        *ptr++ = ch;
+    *optr = ptr;
+    return(0);
+}
+
 /*********************************************************************
-* putNchar() outputs the compressed data which consists of a         *
-* particular sequence of bytes based on how many of the same         *
-* characters are found sequentially in the file                      *
+* rlcomp_chunk() compresses the next "inbytes" of a stream into      *
+* "outdata", which must hold at least RL_MAX_COMPLEN(inbytes)        *
+* bytes.  The run still open at the end of the chunk is kept in the  *
+* context, less any whole MAX_REPEAT sequences, so a chunk never     *
+* owes more than one sequence to the next.  "last" is set on the     *
+* final chunk of the stream to output the open run.                  *
 *								     *
 * Arguments  							     *
 * ---------							     *
 *	passed in:						     *
-*		   n - number of the same characters found           *
-*		       sequentially in the buffer  		     *
-*		   ch - last character read from the  input buffer   *
-*		   outptr - pointer to the output buffer             *
-*		   outsize - size of outdata                         *
-*	returned: 						     *
-*		   outbytes - number of bytes in outdata after       *
-*			      compression			     *
+*		   ctx - stream state from init_RL_ENC_CTX()         *
+*		   indata - next bytes to be compressed              *
+*		   inbytes - number of bytes in indata               *
+*		   last - nonzero on the final chunk                 *
+*		   outsize - number of allocated bytes in outdata    *
+*	returned:						     *
+*		   outdata - buffer containing compressed data       *
+*		   outbytes - number of bytes in outdata             *
+*	return value:						     *
+*		   0 on success, negative if outdata is too small    *
 *********************************************************************/
-static void
-PutNchar (long n, int ch, unsigned char **outptr, int *outbytes, int outsize)
+int rlcomp_chunk(RL_ENC_CTX *ctx, unsigned char *indata, const int inbytes,
+                 const int last, unsigned char *outdata, const int outsize,
+                 int *outbytes)
 {
-    int   count, tmpbytes;
-    if (ch == ESCAPE) {
-	while (n-- > 0){
-          if((tmpbytes = *outbytes + 2) > outsize)
-          {
-              fprintf(stderr,"Output buffer Overflow in PutNchar().\n");
-              exit(-1);
-          }
-          else
-          {
-              **outptr = ESCAPE;
-              (*outptr)++;
-	      **outptr = 0;
-              (*outptr)++;
-              *outbytes += 2;
-         }
-       }
-       return;
-    }
+    unsigned char *iptr, *iend, *optr, *oend;
+    int ch, n;
+    long count;
 
-    while (n >= 4) {
-      if((tmpbytes = *outbytes + 3) > outsize)
-      {
-          fprintf(stderr,"Output buffer Overflow in PutNchar().\n");
-          exit(-1);
-      }
-      else
-      {
-	   count = min(n, 255);
-	   **outptr = ch;
-           (*outptr)++;
-	   **outptr = ESCAPE;
-           (*outptr)++;
-	   **outptr = count;
-           (*outptr)++;
-           *outbytes += 3;
-	   n -= count;
-      }
+    iptr = indata;
+    iend = indata + inbytes;
+    optr = outdata;
+    oend = outdata + outsize;
+    ch = ctx->lastchar;
+    count = ctx->count;
+    *outbytes = 0;
+
+    while (iptr < iend) {
+        if (count == 0) {
+            ch = *iptr++;
+            count = 1;
+        }
+        /* Bytes unlike the next, the most of gray or noisy data, */
+        /* are copied straight out.                               */
+        if (count == 1 && ch != ESCAPE) {
+            while (iptr < iend && *iptr != ch && *iptr != ESCAPE &&
+                   optr < oend) {
+                *optr++ = ch;
+                ch = *iptr++;
+            }
+        }
+        n = run_length(iptr, iend, ch);
+        iptr += n;
+        count += n;
+        if (iptr < iend) {
+            if (put_run(ch, count, &optr, oend)) {
+                fprintf(stderr, "ERROR : rlcomp_chunk : ");
+                fprintf(stderr, "output buffer overflow\n");
+                return(-2);
+            }
+            count = 0;
+        }
     }
 
-    while (n-- > 0){
-      if((tmpbytes = *outbytes + 1) > outsize)
-      {
-          fprintf(stderr,"Output buffer Overflow in PutNchar().\n");
-          exit(-1);
-      }
-      else
-      {
-	   **outptr = ch;
-           (*outptr)++;
-           *outbytes += 1;
-      }
+    if (last || ch == ESCAPE) {
+        n = put_run(ch, count, &optr, oend);
+        count = 0;
+    }
+    else if (count > MAX_REPEAT) {
+        /* Leading whole sequences are the same however the run ends. */
+        n = put_run(ch, (count - 1) / MAX_REPEAT * MAX_REPEAT, &optr, oend);
+        count = (count - 1) % MAX_REPEAT + 1;
+    }
+    else
+        n = 0;
+    if (n) {
+        fprintf(stderr, "ERROR : rlcomp_chunk : output buffer overflow\n");
+        return(-2);
     }
-}
 
+    ctx->lastchar = ch;
+    ctx->count = count;
+    *outbytes = (int)(optr - outdata);
+    return(0);
+}
 
 /*********************************************************************
 *	Routine:  rlcomp()					     *
@@ -123,7 +226,7 @@ PutNchar (long n, int ch, unsigned char **outptr, int *outbytes, int outsize)
 *  	Date:     12/28/89					     *
 *********************************************************************/
 /*********************************************************************
-* rlcomp() compresses a file                                      *
+* rlcomp_mem() compresses a buffer                                   *
 *								     *
 * Arguments  							     *
 * ---------							     *
@@ -135,6 +238,21 @@ PutNchar (long n, int ch, unsigned char **outptr, int *outbytes, int outsize)
 *		   outdata - buffer containing compressed data       *
 *		   outbytes - number of bytes in outdata after       *
 *			      compression			     *
+*	return value:						     *
+*		   0 on success, negative if outdata is too small    *
+*********************************************************************/
+int rlcomp_mem(unsigned char *indata, const int inbytes,
+               unsigned char *outdata, const int outsize, int *outbytes)
+{
+    RL_ENC_CTX ctx;
+
+    init_RL_ENC_CTX(&ctx);
+    return(rlcomp_chunk(&ctx, indata, inbytes, 1, outdata, outsize,
+                        outbytes));
+}
+
+/*********************************************************************
+* rlcomp() compresses a buffer, exiting if outdata is too small.     *
 *********************************************************************/
 void rlcomp(
 unsigned char *indata,
@@ -142,109 +260,151 @@ int inbytes,
 unsigned char  *outdata,
 int *outbytes,int outsize)
 {
-    int ch, last, in_count;
-    long count;
-    unsigned char *outptr;
+    if (rlcomp_mem(indata, inbytes, outdata, outsize, outbytes))
+        exit(-1);
+}
 
+/*********************************************************************
+* rlcomp_file() compresses a buffer to an open file RL_CHUNK bytes   *
+* at a time, so only one chunk of the compressed data is ever held   *
+* in memory and the output is not limited to any buffer size.        *
+*								     *
+* Arguments  							     *
+* ---------							     *
+*	passed in:						     *
+*		   fp - file written from its current position       *
+*		   indata - buffer containing data to be compressed  *
+*		   inbytes - number of bytes to be compressed        *
+*       returned:  						     *
+*		   outbytes - number of bytes written to fp          *
+*	return value:						     *
+*		   0 on success, negative on error                   *
+*********************************************************************/
+int rlcomp_file(FILE *fp, unsigned char *indata, const int inbytes,
+                int *outbytes)
+{
+    RL_ENC_CTX ctx;
+    unsigned char *buf;
+    int ret, done, n, nout;
 
-    outptr = outdata;
-    last  = *indata;
-    in_count = 1;
-    count = 1;
     *outbytes = 0;
-
-    while (in_count < inbytes) {
-        ch = *(++indata);
-        in_count++;
-	if (ch == last) 
-	    count++;
-        else
-        {
-	    PutNchar (count, last, &outptr, outbytes, outsize);
-	    last  = ch;
-	    count = 1;
-	}
+    buf = (unsigned char *)malloc(RL_MAX_COMPLEN(RL_CHUNK));
+    if (buf == (unsigned char *)NULL) {
+        fprintf(stderr, "ERROR : rlcomp_file : malloc : buf\n");
+        return(-3);
     }
-    PutNchar (count, last, &outptr, outbytes, outsize);
-}
 
-static int lastchar;		/* last output character */
-static int escape = FALSE;	/* last char was ESCAPE code */
+    init_RL_ENC_CTX(&ctx);
+    done = 0;
+    do {
+        n = min(inbytes - done, RL_CHUNK);
+        ret = rlcomp_chunk(&ctx, indata + done, n, done + n == inbytes,
+                           buf, RL_MAX_COMPLEN(RL_CHUNK), &nout);
+        if (ret)
+            break;
+        if (fwrite(buf, 1, nout, fp) != (size_t)nout) {
+            fprintf(stderr, "ERROR : rlcomp_file : fwrite\n");
+            ret = -4;
+            break;
+        }
+        *outbytes += nout;
+        done += n;
+    } while (done < inbytes);
+
+    free(buf);
+    return(ret);
+}
 
 /*********************************************************************
-*	Routine:  RLL_putc()					     *
+*	Routine:  rldecomp()					     *
 *  	Author:   Darlene E. Frederick				     *
 *  	Date:     12/28/89					     *
 *********************************************************************/
 /*********************************************************************
-* RLL_putc() outputs the decompressed data                           *
+* rldecomp_chunk() decompresses the next "inbytes" of a stream.      *
+* Literal bytes are copied up to the next ESCAPE in one go, and      *
+* runs filled with memset.  The last literal byte and an ESCAPE      *
+* ending the chunk are kept in the context for the next chunk.       *
 *								     *
 * Arguments  							     *
 * ---------							     *
 *	passed in:						     *
-*		   outptr - pointer to the output buffer             *
-*		   code - byte to be decompressed		     *
-*		   outsize - size of output buffer                  *
+*		   ctx - stream state from init_RL_DEC_CTX()         *
+*		   indata - next bytes to be decompressed            *
+*		   inbytes - number of bytes in indata               *
+*		   outsize - number of bytes left in outdata         *
 *	returned:						     *
-*		   outcount - number of bytes output                 *
+*		   outdata - buffer containing uncompressed data     *
+*		   outbytes - number of bytes in outdata             *
+*	return value:						     *
+*		   0 on success, negative if outdata is too small    *
 *********************************************************************/
-static void RLL_putc (
-unsigned char **outptr,
-unsigned char  code,
-int outsize,int  *out_count)
+int rldecomp_chunk(RL_DEC_CTX *ctx, unsigned char *indata,
+                   const int inbytes, unsigned char *outdata,
+                   const int outsize, int *outbytes)
 {
- int tmpbytes;
-	if(escape) {
-	    escape = FALSE;
-	    if(code)  
-	       while (--code)  
-               {
-	          if((tmpbytes = *out_count + 1) > outsize)
-		  {
-                      fprintf(stderr,"Output Buffer Overflow in RLL_putc.\n");
-		      exit(-1);
-		  }
-		  **outptr = lastchar;
-                  (*outptr)++;
-		  (*out_count)++;
-               }
-	    else
-            {
-	       if((tmpbytes = *out_count + 1) > outsize)
-	       {
-                   fprintf(stderr,"Output Buffer Overflow in RLL_putc.\n");
-	           exit(-1);
-	       }
-	       **outptr = ESCAPE;
-               (*outptr)++;
-	       (*out_count)++;
-            }
-	    return;
-	}
-
-	if (code == ESCAPE) {
-	    escape = TRUE;
-	    return;
-	}
-
-        if((tmpbytes = *out_count + 1) > outsize)
-        {
-          fprintf(stderr,"Output Buffer Overflow in RLL_putc.\n");
-          exit(-1);
-	}
-        **outptr = code;
-        (*outptr)++;
-        (*out_count)++;
-	lastchar = code;
+    unsigned char *iptr, *iend, *optr, *oend, *eptr;
+    int lastchar, escape, code, n, overflow;
+
+    iptr = indata;
+    iend = indata + inbytes;
+    optr = outdata;
+    oend = outdata + outsize;
+    lastchar = ctx->lastchar;
+    escape = ctx->escape;
+    overflow = 0;
+    *outbytes = 0;
+
+    while (iptr < iend) {
+        if (escape) {
+            escape = 0;
+            code = *iptr++;
+            /* A count of n repeats the last literal n-1 more times, */
+            /* and a count of 0 stands for the ESCAPE byte itself.   */
+            n = code ? code - 1 : 1;
+            overflow = (oend - optr < n);
+            if (overflow)
+                break;
+            if (code)
+                memset(optr, lastchar, n);
+            else
+                *optr = ESCAPE;
+            optr += n;
+            continue;
+        }
+
+        eptr = (unsigned char *)memchr(iptr, ESCAPE, iend - iptr);
+        if (eptr == (unsigned char *)NULL)
+            eptr = iend;
+        n = (int)(eptr - iptr);
+        if (n > 0) {
+            overflow = (oend - optr < n);
+            if (overflow)
+                break;
+            memcpy(optr, iptr, n);
+            optr += n;
+            lastchar = eptr[-1];
+        }
+        iptr = eptr;
+        if (iptr < iend) {
+            escape = 1;
+            iptr++;
+        }
+    }
+
+    if (overflow) {
+        fprintf(stderr, "ERROR : rldecomp_chunk : output buffer overflow\n");
+        return(-2);
+    }
+
+    ctx->lastchar = lastchar;
+    ctx->escape = escape;
+    *outbytes = (int)(optr - outdata);
+    return(0);
 }
 
 /*********************************************************************
-*	Routine:  rldecomp()					     *
-*  	Author:   Darlene E. Frederick				     *
-*  	Date:     12/28/89					     *
-*********************************************************************/
-/*********************************************************************
-* rldecomp() decompresses a file                                     *
+* rldecomp_mem() decompresses a buffer                               *
 *								     *
 * Arguments  							     *
 * ---------							     *
@@ -256,27 +416,92 @@ int outsize,int  *out_count)
 *		   outdata - buffer containing uncompressed data     *
 *		   outbytes - number of bytes in outdata after       *
 *			      decompression			     *
+*	return value:						     *
+*		   0 on success, negative if outdata is too small    *
+*		   or the data ends within a run                     *
+*********************************************************************/
+int rldecomp_mem(unsigned char *indata, const int inbytes,
+                 unsigned char *outdata, const int outsize, int *outbytes)
+{
+    RL_DEC_CTX ctx;
+    int ret;
+
+    init_RL_DEC_CTX(&ctx);
+    ret = rldecomp_chunk(&ctx, indata, inbytes, outdata, outsize, outbytes);
+    if (ret)
+        return(ret);
+    if (ctx.escape) {
+        fprintf(stderr, "ERROR : rldecomp_mem : data ends within a run\n");
+        return(-5);
+    }
+    return(0);
+}
+
+/*********************************************************************
+* rldecomp() decompresses a buffer, exiting if outdata is too small  *
+* or the data is corrupt.                                            *
 *********************************************************************/
 void rldecomp(
 		unsigned char *indata,int inbytes,unsigned char *outdata,
 		int *outbytes, int outsize
 		)
 {
-	int  ch;
-        unsigned char  *outptr;
-        int incount;
-
-        outptr = outdata;
-        *outbytes = 0;
-        ch = *indata;
-        incount = 1;
-	RLL_putc (&outptr,ch,outsize,outbytes);
-	while (incount < inbytes)
-        {
-                indata++;
-                ch = *indata;
-                incount++;
-		RLL_putc (&outptr,ch,outsize,outbytes);
-	}
+    if (rldecomp_mem(indata, inbytes, outdata, outsize, outbytes))
+        exit(-1);
 }
 
+/*********************************************************************
+* rldecomp_file() decompresses "inbytes" of run length coded data    *
+* read from an open file RL_CHUNK bytes at a time, so the            *
+* compressed data is never held in memory as a whole.                *
+*								     *
+* Arguments  							     *
+* ---------							     *
+*	passed in:						     *
+*		   fp - file read from its current position          *
+*		   inbytes - number of compressed bytes to read      *
+*                  outsize - number of allocated bytes in outdata.   *
+*       returned:  						     *
+*		   outdata - buffer containing uncompressed data     *
+*		   outbytes - number of bytes in outdata after       *
+*			      decompression			     *
+*	return value:						     *
+*		   0 on success, negative on error                   *
+*********************************************************************/
+int rldecomp_file(FILE *fp, const int inbytes, unsigned char *outdata,
+                  const int outsize, int *outbytes)
+{
+    RL_DEC_CTX ctx;
+    unsigned char *buf;
+    int ret, done, n, nout;
+
+    *outbytes = 0;
+    buf = (unsigned char *)malloc(RL_CHUNK);
+    if (buf == (unsigned char *)NULL) {
+        fprintf(stderr, "ERROR : rldecomp_file : malloc : buf\n");
+        return(-3);
+    }
+
+    init_RL_DEC_CTX(&ctx);
+    ret = 0;
+    for (done = 0; done < inbytes; done += n) {
+        n = min(inbytes - done, RL_CHUNK);
+        if (fread(buf, 1, n, fp) != (size_t)n) {
+            fprintf(stderr, "ERROR : rldecomp_file : fread\n");
+            ret = -4;
+            break;
+        }
+        ret = rldecomp_chunk(&ctx, buf, n, outdata + *outbytes,
+                             outsize - *outbytes, &nout);
+        if (ret)
+            break;
+        *outbytes += nout;
+    }
+    free(buf);
+
+    if (!ret && ctx.escape) {
+        fprintf(stderr, "ERROR : rldecomp_file : data ends within a run\n");
+        ret = -5;
+    }
+    return(ret);
+}
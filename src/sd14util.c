@@ -148,8 +148,8 @@ int wsq14_decode_file(unsigned char **odata, int *owidth, int *oheight,
          "Quantized WSQ subband data blocks read and Huffman decoded\n\n");
 
    /* Decode the quantize wavelet subband data. */
-   ret = unquantize(&fdata, &dqt_table, q_tree,
-		   Q_TREELEN, qdata, width, height);
+   ret = unquantize_arena(&fdata, &dqt_table, q_tree,
+		   Q_TREELEN, qdata, width, height, (CODEC_ARENA *)NULL);
    if(ret){
       free(qdata);
       return(ret);
@@ -161,9 +161,10 @@ int wsq14_decode_file(unsigned char **odata, int *owidth, int *oheight,
    /* Done with quantized wavelet subband data. */
    free(qdata);
 
-   ret = wsq_reconstruct(fdata, width, height, w_tree, W_TREELEN, &dtt_table);
+   ret = wsq_reconstruct_arena(fdata, width, height, w_tree, W_TREELEN,
+		   &dtt_table, (CODEC_ARENA *)NULL);
    if(ret){
-      free(fdata);
+      codec_free(fdata);
       return(ret);
    }
 
@@ -172,7 +173,7 @@ int wsq14_decode_file(unsigned char **odata, int *owidth, int *oheight,
 
    cdata = (unsigned char *)malloc(num_pix * sizeof(unsigned char));
    if(cdata == (unsigned char *)NULL) {
-      free(fdata);
+      codec_free(fdata);
       fprintf(stderr,"ERROR: wsq_decode_1 : malloc : cdata\n");
       return(-21);
    }
@@ -182,7 +183,7 @@ int wsq14_decode_file(unsigned char **odata, int *owidth, int *oheight,
                       frm_header_wsq.m_shift, frm_header_wsq.r_scale);
 
    /* Done with floating point pixels. */
-   free(fdata);
+   codec_free(fdata);
 
    if(debug > 0)
       fprintf(stderr, "Doubleing point pixels converted to unsigned char\n\n");
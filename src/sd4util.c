@@ -28,6 +28,7 @@ static int decode_data_jpegl_sd4(int *, int *, int *, int *,
 static int getc_nextbits_jpegl_sd4(unsigned short *, unsigned char **,
                  unsigned char *, int *, const int);
 #include <dataio.h>
+#include <codecmem.h>
 
 /************************************************************************/
 /*                        Algorithms coded from:                        */
@@ -185,7 +186,7 @@ static int getc_huffman_table_jpegl_sd4(HUF_TABLE **huf_table,
          fprintf(stdout, "values[%d] = %d\n", i, huffvalues[i]);
 
 
-   thuf_table = (HUF_TABLE *)calloc(1, sizeof(HUF_TABLE));
+   thuf_table = (HUF_TABLE *)codec_calloc(1, sizeof(HUF_TABLE));
    if(thuf_table == (HUF_TABLE *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl_sd4 : ");
       fprintf(stderr, "calloc : thuf_table\n");
@@ -201,8 +202,8 @@ static int getc_huffman_table_jpegl_sd4(HUF_TABLE **huf_table,
 
    /* Build rest of table. */
 
-   thuf_table->maxcode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->maxcode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->maxcode == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl_sd4 : ");
       fprintf(stderr, "calloc : maxcode\n");
@@ -210,8 +211,8 @@ static int getc_huffman_table_jpegl_sd4(HUF_TABLE **huf_table,
       return(-5);
    }
 
-   thuf_table->mincode = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1,
-                                          sizeof(int));
+   thuf_table->mincode = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                 sizeof(int));
    if(thuf_table->mincode == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl_sd4 : ");
       fprintf(stderr, "calloc : mincode\n");
@@ -219,7 +220,8 @@ static int getc_huffman_table_jpegl_sd4(HUF_TABLE **huf_table,
       return(-6);
    }
 
-   thuf_table->valptr = (int *)calloc(MAX_HUFFCOUNTS_JPEGL+1, sizeof(int));
+   thuf_table->valptr = (int *)codec_calloc(MAX_HUFFCOUNTS_JPEGL+1,
+                                                sizeof(int));
    if(thuf_table->valptr == (int *)NULL){
       fprintf(stderr, "ERROR : getc_huffman_table_jpegl_sd4 : ");
       fprintf(stderr, "calloc : valptr\n");
@@ -49,6 +49,10 @@
 #cat:
 #cat: putc_scan_header - Writes a JPEGL SCN Header to a memory buffer.
 #cat:
+#cat: getc_restart_interval - Reads a Define Restart Interval segment from
+#cat:                    a JPEGL compressed memory buffer.
+#cat: putc_restart_interval - Writes a Define Restart Interval segment to
+#cat:                    a memory buffer.
 #cat: read_comment - Reads the contents of a JPEGL comment block from
 #cat:                    an open file, returning the comment text as a
 #cat:                    null-terminated string.
@@ -169,16 +173,18 @@ int getc_marker_jpegl(unsigned short *omarker, const int type,
       }
       break;
    case TBLS_N_SOF:
-      if(marker != DHT && marker != COM && marker != SOF3 ) {
+      if(marker != DHT && marker != COM && marker != DRI &&
+         marker != SOF3 ) {
          fprintf(stderr, "ERROR : getc_marker_jpegl : ");
-         fprintf(stderr, "No DHT, COM, or SOF3 markers.\n");
+         fprintf(stderr, "No DHT, COM, DRI, or SOF3 markers.\n");
          return(-4);
       }
       break;
    case TBLS_N_SOS:
-      if(marker != DHT && marker != COM && marker != SOS ) {
+      if(marker != DHT && marker != COM && marker != DRI &&
+         marker != SOS ) {
          fprintf(stderr, "ERROR : getc_marker_jpegl : ");
-         fprintf(stderr, "No DHT, COM, or SOS markers.\n");
+         fprintf(stderr, "No DHT, COM, DRI, or SOS markers.\n");
          return(-5);
       }
       break;
@@ -1294,6 +1300,71 @@ int write_scan_header(SCN_HEADER *scn_header, FILE *outfp)
    return(0);
 }
 
+/************************************************************************/
+/* Reads the restart interval, in samples, from the Define Restart      */
+/* Interval segment following a DRI marker.  0 disables restarts.       */
+/************************************************************************/
+int getc_restart_interval(int *ointerval, unsigned char **cbufptr,
+         unsigned char *ebufptr)
+{
+   int ret;
+   unsigned short Lr, Ri;
+
+   /* Lr */
+   ret = getc_ushort(&Lr, cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   if(Lr != 4){
+      fprintf(stderr, "ERROR : getc_restart_interval : ");
+      fprintf(stderr, "segment length %d not 4\n", Lr);
+      return(-2);
+   }
+   /* Ri */
+   ret = getc_ushort(&Ri, cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+
+   if(debug > 1)
+      fprintf(stdout, "Ri = %d\n", Ri);
+
+   *ointerval = Ri;
+   return(0);
+}
+
+/************************************************************************/
+/* Writes a Define Restart Interval segment giving the number of        */
+/* samples coded between restart markers.                               */
+/************************************************************************/
+int putc_restart_interval(const int interval, unsigned char *outbuf,
+                     const int outalloc, int *outlen)
+{
+   int ret;
+
+   if((interval < 0) || (interval > 0xffff)){
+      fprintf(stderr, "ERROR : putc_restart_interval : ");
+      fprintf(stderr, "interval %d not in range [0..65535]\n", interval);
+      return(-2);
+   }
+
+   if(debug > 1)
+      fprintf(stdout, "Ri = %d\n", interval);
+
+   /* DRI */
+   ret = putc_ushort(DRI, outbuf, outalloc, outlen);
+   if(ret)
+      return(ret);
+   /* Lr */
+   ret = putc_ushort(4, outbuf, outalloc, outlen);
+   if(ret)
+      return(ret);
+   /* Ri */
+   ret = putc_ushort((unsigned short)interval, outbuf, outalloc, outlen);
+   if(ret)
+      return(ret);
+
+   return(0);
+}
+
 /******************************************************/
 /* Writes scan header to the compressed memory buffer */
 /******************************************************/
@@ -12,6 +12,12 @@
       ROUTINES:
 #cat: predict - Used to predict the pixel values in an image.
 #cat:
+#cat: predict_pitch - Predicts pixel values in an image whose rows are
+#cat:                 padded in memory.
+#cat: predict_diff_row - Computes the differences from prediction of a
+#cat:                 whole row of pixels.
+#cat: undo_predict_row - Reconstructs a whole row of pixels from their
+#cat:                 differences from prediction.
 #cat: categorize - Determines the category for a given difference value.
 #cat:
 
@@ -26,6 +32,19 @@
 int predict(short *odata_pred, unsigned char *indata, const int width,
             const int pixel_num, const int cmpnt_depth, const int pred_type,
             const int Pt)
+{
+   return(predict_pitch(odata_pred, indata, width, width, pixel_num,
+                        cmpnt_depth, pred_type, Pt));
+}
+
+/**************************************************************/
+/*Predicts a pixel value as predict does, for a component whose*/
+/*rows are "pitch" bytes apart in memory.  "pixel_num" still  */
+/*counts pixels over rows "width" long.                       */
+/**************************************************************/
+int predict_pitch(short *odata_pred, unsigned char *indata, const int width,
+            const int pitch, const int pixel_num, const int cmpnt_depth,
+            const int pred_type, const int Pt)
 {
    short data_pred;                     /*pixel prediction*/
 
@@ -48,7 +67,7 @@ int predict(short *odata_pred, unsigned char *indata, const int width,
    else if(pixel_num > (width - 1))  {
       if((pixel_num % width) == 0)      /*predictor if pixel is at the
                                           beginning of a line*/
-	 data_pred = *(indata - width);
+	 data_pred = *(indata - pitch);
       else{ 
          switch(pred_type) {            /*various predictor types defined
                                           in the standard*/
@@ -56,28 +75,28 @@ int predict(short *odata_pred, unsigned char *indata, const int width,
                data_pred = *(indata - 1);
                break;
             case PRED2:
-               data_pred = *(indata - width);
+               data_pred = *(indata - pitch);
                break;
             case PRED3:
-               data_pred = *(indata -(width + 1));
+               data_pred = *(indata -(pitch + 1));
                break;
             case PRED4:
                data_pred = *(indata - 1) + 
-                           *(indata - width) -
-                           *(indata -(width + 1));
+                           *(indata - pitch) -
+                           *(indata -(pitch + 1));
                break;
             case PRED5:
                data_pred = *(indata - 1) + 
-                           ((*(indata - width) >> 1) - 
-                           (*(indata -(width + 1)) >> 1));
+                           ((*(indata - pitch) >> 1) - 
+                           (*(indata -(pitch + 1)) >> 1));
                break;
             case PRED6:
-               data_pred = *(indata - width) + 
+               data_pred = *(indata - pitch) + 
                            ((*(indata - 1) >> 1) - 
-                           (*(indata -(width + 1)) >> 1));
+                           (*(indata -(pitch + 1)) >> 1));
                break;
             case PRED7:
-               data_pred = (*(indata -1) + *(indata - width)) / 2;
+               data_pred = (*(indata -1) + *(indata - pitch)) / 2;
                break;
             default:
                fprintf(stderr, "ERORR : predict : invalid prediction type ");
@@ -93,26 +112,172 @@ int predict(short *odata_pred, unsigned char *indata, const int width,
    return(0);
 }
 
+/**************************************************************/
+/*Computes the differences between row "row_num" of a         */
+/*component and its prediction, giving the same values as     */
+/*predict does pixel by pixel.  Rows are "pitch" bytes apart  */
+/*and must already be point transformed.  The first row and   */
+/*column are handled apart, leaving a branch free loop over   */
+/*the rest of the row for each predictor.                     */
+/**************************************************************/
+int predict_diff_row(short *odiff, unsigned char *row, const int width,
+            const int pitch, const int row_num, const int cmpnt_depth,
+            const int pred_type, const int Pt)
+{
+   unsigned char *a, *b, *c;            /*left, above, above left*/
+   int x;
+
+   if(width <= 0)
+      return(0);
+
+   a = row - 1;
+   if(row_num == 0) {
+      odiff[0] = (short)(row[0] - (1 << (cmpnt_depth-Pt-1)));
+      for(x = 1; x < width; x++)
+         odiff[x] = (short)(row[x] - a[x]);
+      return(0);
+   }
+
+   b = row - pitch;
+   c = b - 1;
+   odiff[0] = (short)(row[0] - b[0]);
+   if(width == 1)
+      return(0);
+
+   switch(pred_type) {
+      case PRED1:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - a[x]);
+         break;
+      case PRED2:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - b[x]);
+         break;
+      case PRED3:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - c[x]);
+         break;
+      case PRED4:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - (a[x] + b[x] - c[x]));
+         break;
+      case PRED5:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - (a[x] + ((b[x] >> 1) - (c[x] >> 1))));
+         break;
+      case PRED6:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - (b[x] + ((a[x] >> 1) - (c[x] >> 1))));
+         break;
+      case PRED7:
+         for(x = 1; x < width; x++)
+            odiff[x] = (short)(row[x] - ((a[x] + b[x]) >> 1));
+         break;
+      default:
+         fprintf(stderr, "ERROR : predict_diff_row : ");
+         fprintf(stderr, "invalid prediction type ");
+         fprintf(stderr, "%d not in range [%d..%d]\n",
+                          pred_type, PRED1, PRED7);
+         return(-2);
+   }
+
+   return(0);
+}
+
+/**************************************************************/
+/*Reverses predict_diff_row, reconstructing row "row_num" of  */
+/*a component from its differences "idiff" as predict_pitch   */
+/*would pixel by pixel.  Each pixel depends on the one to its */
+/*left, so the loops run in order, one per predictor.         */
+/**************************************************************/
+int undo_predict_row(unsigned char *row, short *idiff, const int width,
+            const int pitch, const int row_num, const int cmpnt_depth,
+            const int pred_type, const int Pt)
+{
+   unsigned char *b, *c;                /*above, above left*/
+   int x, a;                            /*a is the pixel to the left*/
+
+   if(width <= 0)
+      return(0);
+
+   if(row_num == 0) {
+      a = (unsigned char)(idiff[0] + (1 << (cmpnt_depth-Pt-1)));
+      row[0] = a;
+      for(x = 1; x < width; x++)
+         row[x] = a = (unsigned char)(idiff[x] + a);
+      return(0);
+   }
+
+   b = row - pitch;
+   c = b - 1;
+   a = (unsigned char)(idiff[0] + b[0]);
+   row[0] = a;
+   if(width == 1)
+      return(0);
+
+   switch(pred_type) {
+      case PRED1:
+         for(x = 1; x < width; x++)
+            row[x] = a = (unsigned char)(idiff[x] + a);
+         break;
+      case PRED2:
+         for(x = 1; x < width; x++)
+            row[x] = (unsigned char)(idiff[x] + b[x]);
+         break;
+      case PRED3:
+         for(x = 1; x < width; x++)
+            row[x] = (unsigned char)(idiff[x] + c[x]);
+         break;
+      case PRED4:
+         for(x = 1; x < width; x++)
+            row[x] = a = (unsigned char)(idiff[x] + a + b[x] - c[x]);
+         break;
+      case PRED5:
+         for(x = 1; x < width; x++)
+            row[x] = a = (unsigned char)(idiff[x] + a +
+                                         ((b[x] >> 1) - (c[x] >> 1)));
+         break;
+      case PRED6:
+         for(x = 1; x < width; x++)
+            row[x] = a = (unsigned char)(idiff[x] + b[x] +
+                                         ((a >> 1) - (c[x] >> 1)));
+         break;
+      case PRED7:
+         for(x = 1; x < width; x++)
+            row[x] = a = (unsigned char)(idiff[x] + ((a + b[x]) >> 1));
+         break;
+      default:
+         fprintf(stderr, "ERROR : undo_predict_row : ");
+         fprintf(stderr, "invalid prediction type ");
+         fprintf(stderr, "%d not in range [%d..%d]\n",
+                          pred_type, PRED1, PRED7);
+         return(-2);
+   }
+
+   return(0);
+}
+
 /********************************************************************/
 /*This function determines the category for a given difference value*/
+/*which is the number of bits in its magnitude.                     */
 /********************************************************************/
 short categorize(const short idiff)
 {
-   int bit;                     /*bit pointer to difference value*/
-   short diff;
-
-   diff = idiff;
+   unsigned int diff;
+#if !defined(__GNUC__)
+   short cat;
+#endif
 
-   if(diff == 0)
+   if(idiff == 0)
       return (0);               /*difference category zero*/
 
-   if (diff < 0)
-      diff *= -1;
-   
-   for (bit = 0; bit < MAX_HUFFBITS; bit++) {
-      if ((diff & CATMASK) != 0)
-	 return ((short)(MAX_HUFFBITS - bit));
-      diff <<= 1;
-   }
-   return(-1);
+   diff = (idiff < 0) ? -(int)idiff : idiff;
+
+#if defined(__GNUC__)
+   return((short)((sizeof(unsigned int) * 8) - __builtin_clz(diff)));
+#else
+   for(cat = 0; diff != 0; cat++)
+      diff >>= 1;
+   return(cat);
+#endif
 }
@@ -95,6 +95,7 @@ unsigned char *data)
    FILE *fp;
    int width,height,depth,code,filesize,n, compbytes;
    unsigned char *compdata;
+   G4_ENC_CTX *g4ctx;
 
    /* reopen the image file for writing */
    fp = fopen(file,"wb");
@@ -128,6 +129,17 @@ unsigned char *data)
       if (n != filesize)
          syserr("writeihdrfile", "fwrite", file);
    }
+   else if(code == RL){
+      /* The run length coding is streamed to the file, and the header */
+      /* written again once the compressed length is known.           */
+      writeihdr(fp,head);
+      if(rlcomp_file(fp, data, filesize, &compbytes))
+         fatalerr("writeihdrfile", "RL compression failed", NULL);
+      sprintf(head->complen, "%d", compbytes);
+      if(fseek(fp, 0L, SEEK_SET))
+         syserr("writeihdrfile", "fseek", file);
+      writeihdr(fp,head);
+   }
    else{
       malloc_uchar(&compdata, filesize, "writeihdrfile : compdata");
       switch(code){
@@ -138,10 +150,13 @@ unsigned char *data)
          if(depth != 1)
             fatalerr("writeihdrfile",
                      "G4 compression requires a binary image.", NULL);
-         grp4comp(data, filesize, width, height, compdata, &compbytes);
-         break;
-      case RL:
-         rlcomp(data, filesize, compdata, &compbytes, filesize);
+         if(alloc_G4_ENC_CTX(&g4ctx))
+            fatalerr("writeihdrfile", "alloc_G4_ENC_CTX failed", NULL);
+         n = grp4comp_ctx(g4ctx, data, SizeFromDepth(width,height,depth),
+                          width, height, compdata, filesize, &compbytes);
+         free_G4_ENC_CTX(g4ctx);
+         if(n)
+            fatalerr("writeihdrfile", "G4 compression failed", NULL);
          break;
       default:
          fatalerr("writeihdrfile","Unknown compression",NULL);
@@ -13,6 +13,10 @@
 #include <jpegl.h>
 #endif
 
+#ifndef _CODECMEM_H
+#include <codecmem.h>
+#endif
+
 #ifndef TRUE
 #define TRUE  1
 #define FALSE 0
@@ -129,6 +133,57 @@ typedef struct table_dht {
    unsigned char huffvalues[MAX_HUFFCOUNTS_WSQ+1];
 } DHT_TABLE;
 
+/* Huffman coded symbols of a quantized block, kept in place of its    */
+/* coefficients.  Each byte holds a huffman category; the categories   */
+/* of 8 and 16 bit escapes are followed by 1 or 2 bytes of their value, */
+/* most significant first.                                             */
+typedef struct wsq_syms {
+   unsigned char *syms;
+   int nsyms;       /* bytes used */
+   int alloc;       /* bytes allocated */
+   int ncoeffs;     /* quantized coefficients coded */
+   CODEC_ARENA *arena;  /* memory for "syms" and the counts, or NULL */
+} WSQ_SYMS;
+
+/* Huffman decode table.  Codes of up to WSQ_HUFF_LOOKAHEAD bits are */
+/* resolved with a single lookup; longer codes fall back to the      */
+/* maxcode/mincode/valptr search.                                    */
+#define WSQ_HUFF_LOOKAHEAD  10
+
+typedef struct table_hdec {
+   unsigned char look_size[1 << WSQ_HUFF_LOOKAHEAD]; /* 0 if not resolved */
+   unsigned char look_value[1 << WSQ_HUFF_LOOKAHEAD];
+   int maxcode[MAX_HUFFBITS+1];
+   int mincode[MAX_HUFFBITS+1];
+   int valptr[MAX_HUFFBITS+1];
+   unsigned char *huffvalues;
+} HDEC_TABLE_WSQ;
+
+/* Bit reservoir for reading entropy coded data.  Stuffed zero bytes */
+/* are dropped as bytes are loaded, and loading stops at the first   */
+/* marker, which is held in "marker" until the reservoir is drained. */
+typedef struct bitbuf_wsq {
+   unsigned long long bits;  /* buffered bits, most significant first */
+   int nbits;                /* number of buffered bits */
+   unsigned short marker;    /* marker ending the data, or 0 */
+} BITBUF_WSQ;
+
+/* Source of a WSQ datastream being decoded.  Files and descriptors   */
+/* are read into "buf" WSQ_STREAM_BLOCK bytes at a time; a memory     */
+/* buffer is decoded in place.                                        */
+#define WSQ_STREAM_BLOCK  65536
+
+typedef struct wsq_stream {
+   FILE *fp;                 /* file read from, or NULL */
+   int fd;                   /* descriptor read from, or -1 */
+   unsigned char *buf;
+   int alloc;                /* allocated size of "buf", 0 if not owned */
+   unsigned char *cptr;      /* next byte to decode */
+   unsigned char *eptr;      /* end of the bytes read */
+   unsigned char *keep;      /* bytes from here on are kept, or NULL */
+   int eof;                  /* nothing more can be read */
+} WSQ_STREAM;
+
 typedef struct header_frm {
    unsigned char black;
    unsigned char white;
@@ -140,7 +195,96 @@ typedef struct header_frm {
    unsigned short software;
 } FRM_HEADER_WSQ;
 
+/* Huffman coded blocks of a datastream, and the most times a scaled */
+/* decode may halve the image size.                                  */
+#define WSQ_NUM_BLOCKS       3
+#define WSQ_MAX_SCALE_LEVEL  2
+
+/* Working state for one WSQ encode or decode.  Each thread that codes */
+/* images concurrently must use its own context.                       */
+typedef struct wsq_ctx {
+   QUANT_VALS quant_vals;
+   W_TREE w_tree[W_TREELEN];
+   Q_TREE q_tree[Q_TREELEN];
+   DTT_TABLE dtt_table;
+   DQT_TABLE dqt_table;
+   DHT_TABLE dht_table[MAX_DHT_TABLES];
+   FRM_HEADER_WSQ frm_header_wsq;
+   int nthreads;    /* encoder worker threads, 0 or 1 for none */
+   int fixed;       /* decode with the fixed point reconstruction */
+   int use_arena;   /* take image planes from "arena", reset per image */
+   CODEC_ARENA arena;
+   /* Symbols, counts and coded bytes of each block, filled on */
+   /* separate threads, when "use_arena" is set.               */
+   CODEC_ARENA block_arena[WSQ_NUM_BLOCKS];
+} WSQ_CTX;
+
+/* Size limited encoding: the bitrates searched, the most candidates */
+/* quantized and codings tried, and how far under the limit a        */
+/* candidate may fall and still end the search.                      */
+#define WSQ_MIN_BITRATE      0.05
+#define WSQ_MAX_BITRATE      8.0
+#define WSQ_SIZE_ITERS       12
+#define WSQ_SIZE_PASSES      3
+#define WSQ_SIZE_TOLERANCE   0.01
+/* Room for a header, less any comment text. */
+#define WSQ_HEADER_ALLOC     4096
+
+/* Number of image sizes whose trees are cached by get_wsq_trees. */
+#define WSQ_TREE_CACHE_SIZE  16
+
+/* Fixed point reconstruction: fraction bits of the samples and of */
+/* the filter constants.                                           */
+#define WSQ_FIX_FRAC  14
+#define WSQ_FIX_COEF  24
+
+/* Upper limit on the number of threads used to code one image. */
+#define WSQ_MAX_THREADS  64
+
+/* One job of a parallel stage; returns 0 or a negative error code. */
+typedef int (*WSQ_JOB)(void *, const int);
+
+/* Separable filtering plan.  Output samples along a scanline are     */
+/* grouped in runs; every output of a run is the ordered sum of the    */
+/* same coefficients times input samples (as indices along the         */
+/* scanline) that move by "sstep" from one output to the next.         */
+typedef struct lets_run {
+   int pos;        /* first output sample */
+   int pstep;      /* step between output samples */
+   int count;      /* number of output samples */
+   int sstep;      /* step of the input samples between outputs */
+   int nterms;     /* terms summed for each output */
+   int *src;       /* input samples of the first output */
+   float *coef;    /* coefficients */
+} LETS_RUN;
+
+typedef struct lets_plan {
+   int nout;       /* number of output samples */
+   int nruns;
+   int maxcount;   /* largest run count */
+   LETS_RUN *runs;
+   int *src;       /* storage for the runs' samples */
+   float *coef;    /* storage for the runs' coefficients */
+   CODEC_ARENA *arena;  /* memory the tables came from, or NULL */
+} LETS_PLAN;
+
+/* Image being decoded a band of rows at a time.  All synthesis but    */
+/* the row pass of the final level is done when it is opened; that     */
+/* pass is run on the rows as they are read.                           */
+typedef struct wsq_rows {
+   float *fdata;      /* reconstructed rows, and scratch for the rest */
+   float *fdata1;     /* column pass of the final level */
+   LETS_PLAN plan;    /* row pass of the final level */
+   int width;
+   int height;
+   int next;          /* next row to return */
+   float m_shift;
+   float r_scale;
+} WSQ_ROWS;
+
 /* External global variables. */
+/* The tables below are used by the WSQ14 (SD14) routines; the WSQ */
+/* encoder and decoder keep their state in a WSQ_CTX.              */
 extern int debug;
 extern QUANT_VALS quant_vals;
 extern W_TREE w_tree[];
@@ -149,6 +293,7 @@ extern DTT_TABLE dtt_table;
 extern DQT_TABLE dqt_table;
 extern DHT_TABLE dht_table[];
 extern FRM_HEADER_WSQ frm_header_wsq;
+extern WSQ_CTX wsq_default_ctx;
 extern float hifilt[];
 extern float lofilt[];
 
@@ -158,20 +303,65 @@ extern float lofilt[];
 /* encoder.c */
 extern int wsq_encode_mem(unsigned char **, int *, const float, unsigned char *,
                  const int, const int, const int, const int, char *);
+extern int wsq_encode_mem_ctx(WSQ_CTX *, unsigned char **, int *, const float,
+                 unsigned char *, const int, const int, const int, const int,
+                 char *);
+extern int wsq_encode_mem_size(unsigned char **, int *, const int,
+                 unsigned char *, const int, const int, const int, const int,
+                 char *);
+extern int wsq_encode_mem_size_ctx(WSQ_CTX *, unsigned char **, int *,
+                 const int, unsigned char *, const int, const int,
+                 const int, const int, char *);
 extern int gen_hufftable_wsq(HUFFCODE **, unsigned char **, unsigned char **,
                  short *, const int *, const int);
 extern int compress_block(unsigned char *, int *, short *,
                  const int, const int, const int, HUFFCODE *);
 extern int count_block(int **, const int, short *,
                  const int, const int, const int);
+extern int gen_hufftable_counts_wsq(HUFFCODE **, unsigned char **,
+                 unsigned char **, int *);
+extern int quantize_block(WSQ_SYMS *, int **, const int, QUANT_VALS *,
+                 Q_TREE q_tree[], const int, const int, float *, const int,
+                 const int, const int);
+extern int compress_block_syms(unsigned char *, int *, WSQ_SYMS *,
+                 HUFFCODE *);
 
 /* decode.c */
 extern int wsq_decode_mem(unsigned char **, int *, int *, int *, int *, int *,
                  unsigned char *, const int);
+extern int wsq_decode_mem_ctx(WSQ_CTX *, unsigned char **, int *, int *, int *,
+                 int *, int *, unsigned char *, const int);
 extern int wsq_decode_file(unsigned char **, int *, int *, int *, int *,
                  int *, FILE *);
+extern int wsq_decode_file_ctx(WSQ_CTX *, unsigned char **, int *, int *,
+                 int *, int *, int *, FILE *);
+extern int wsq_decode_fd_ctx(WSQ_CTX *, unsigned char **, int *, int *,
+                 int *, int *, int *, const int);
+extern int wsq_decode_stream_ctx(WSQ_CTX *, unsigned char **, int *, int *,
+                 int *, int *, int *, WSQ_STREAM *);
+extern int wsq_decode_mem_scaled(unsigned char **, int *, int *, int *,
+                 int *, int *, unsigned char *, const int, const int);
+extern int wsq_decode_mem_scaled_ctx(WSQ_CTX *, unsigned char **, int *,
+                 int *, int *, int *, int *, unsigned char *, const int,
+                 const int);
+extern int wsq_decode_stream_scaled_ctx(WSQ_CTX *, unsigned char **, int *,
+                 int *, int *, int *, int *, WSQ_STREAM *, const int);
+extern int wsq_decode_mem_into(unsigned char *, const int, const int,
+                 int *, int *, int *, int *, int *, unsigned char *,
+                 const int);
+extern int wsq_decode_mem_into_ctx(WSQ_CTX *, unsigned char *, const int,
+                 const int, int *, int *, int *, int *, int *,
+                 unsigned char *, const int);
+extern int wsq_probe_mem(int *, int *, int *, int *, int *, const int,
+                 unsigned char *, const int);
+extern int wsq_open_rows_ctx(WSQ_ROWS **, WSQ_CTX *, WSQ_STREAM *, int *,
+                 int *, int *);
+extern int wsq_read_rows(WSQ_ROWS *, unsigned char *, const int, int *);
+extern void free_WSQ_ROWS(WSQ_ROWS *);
 extern int huffman_decode_data_mem(short *, DTT_TABLE *, DQT_TABLE *,
                  DHT_TABLE *, unsigned char **, unsigned char *);
+extern int huffman_decode_data_stream(short *, DTT_TABLE *, DQT_TABLE *,
+                 DHT_TABLE *, WSQ_STREAM *, const int);
 extern int huffman_decode_data_file(short *, DTT_TABLE *, DQT_TABLE *,
                  DHT_TABLE *, FILE *);
 extern int decode_data_mem(int *, int *, int *, int *, unsigned char *,
@@ -182,6 +372,31 @@ extern int nextbits_wsq(unsigned short *, unsigned short *, FILE *, int *,
                  const int);
 extern int getc_nextbits_wsq(unsigned short *, unsigned short *,
                  unsigned char **, unsigned char *, int *, const int);
+extern void gen_hdec_table_wsq(HDEC_TABLE_WSQ *, HUFFCODE *, const int,
+                 unsigned char *, unsigned char *);
+extern void fill_bitbuf_wsq(BITBUF_WSQ *, unsigned char **, unsigned char *);
+extern int getc_huffsym_wsq(int *, HDEC_TABLE_WSQ *, BITBUF_WSQ *,
+                 unsigned char **, unsigned char *);
+extern int getc_bitbuf_wsq(unsigned short *, BITBUF_WSQ *, unsigned char **,
+                 unsigned char *, const int);
+
+/* ctx.c */
+extern int alloc_WSQ_CTX(WSQ_CTX **);
+extern void free_WSQ_CTX(WSQ_CTX *);
+extern void reset_WSQ_CTX(WSQ_CTX *);
+extern CODEC_ARENA *wsq_ctx_arena(WSQ_CTX *);
+
+/* fixed.c */
+extern int wsq_fixed_filters(const DTT_TABLE *);
+extern int unquantize_fixed(int **, const DQT_TABLE *, Q_TREE q_tree[],
+                 const int, short *, const int, const int, CODEC_ARENA *);
+extern int join_lets_fixed(int *, int *, const int, const int, const int,
+                 const int, const DTT_TABLE *, const int, CODEC_ARENA *);
+extern int wsq_reconstruct_fixed(int *, const int, const int,
+                 W_TREE w_tree[], const int, const DTT_TABLE *, const int,
+                 CODEC_ARENA *);
+extern void conv_img_2_uchar_fixed(unsigned char *, int *, const int,
+                 const int, const float, const float);
 
 /* huff.c */
 extern int check_huffcodes_wsq(HUFFCODE *, int);
@@ -237,6 +452,11 @@ extern int print_comments_wsq(FILE *, unsigned char *, const int);
 /* tree.c */
 extern void build_wsq_trees(W_TREE w_tree[], const int,
                  Q_TREE q_tree[], const int, const int, const int);
+extern void get_wsq_trees(W_TREE w_tree[], const int,
+                 Q_TREE q_tree[], const int, const int, const int);
+extern void preload_wsq_trees(const int *, const int);
+extern void get_wsq_tree_cache_stats(long *, long *, int *);
+extern void clear_wsq_tree_cache(void);
 extern void build_w_tree(W_TREE w_tree[], const int, const int);
 extern void w_tree4(W_TREE w_tree[], const int, const int,
                  const int, const int, const int, const int, const int);
@@ -246,6 +466,40 @@ extern void q_tree16(Q_TREE q_tree[], const int, const int, const int,
 extern void q_tree4(Q_TREE q_tree[], const int, const int, const int,
                  const int, const int);
 
+/* lets.c */
+extern int build_get_lets_plan(LETS_PLAN *, const int, float *, const int,
+                 float *, const int, const int, CODEC_ARENA *);
+extern int build_join_lets_plan(LETS_PLAN *, const int, float *, const int,
+                 float *, const int, const int, CODEC_ARENA *);
+extern void free_LETS_PLAN(LETS_PLAN *);
+extern int apply_lets_plan(float *, float *, const int, const int, const int,
+                 const LETS_PLAN *);
+extern int apply_lets_plan_mt(float *, float *, const int, const int,
+                 const int, const LETS_PLAN *, const int);
+extern int get_lets_vec(float *, float *, const int, const int, const int,
+                 const int, float *, const int, float *, const int, const int,
+                 const int, CODEC_ARENA *);
+extern int join_lets_vec(float *, float *, const int, const int, const int,
+                 const int, float *, const int, float *, const int, const int,
+                 const int, CODEC_ARENA *);
+
+/* stream.c */
+extern void init_wsq_stream_mem(WSQ_STREAM *, unsigned char *, const int);
+extern int open_wsq_stream_file(WSQ_STREAM *, FILE *);
+extern int open_wsq_stream_fd(WSQ_STREAM *, const int);
+extern void close_wsq_stream(WSQ_STREAM *);
+extern int fill_wsq_stream(WSQ_STREAM *, const int);
+extern int fill_wsq_segment(WSQ_STREAM *);
+extern int getc_marker_wsq_stream(unsigned short *, const int, WSQ_STREAM *);
+extern int getc_table_wsq_stream(unsigned short, DTT_TABLE *, DQT_TABLE *,
+                 DHT_TABLE *, WSQ_STREAM *);
+extern int getc_frame_header_wsq_stream(FRM_HEADER_WSQ *, WSQ_STREAM *);
+extern int getc_block_header_stream(unsigned char *, WSQ_STREAM *);
+extern int getc_ppi_wsq_stream(int *, WSQ_STREAM *);
+
+/* thread.c */
+extern int wsq_run_jobs(const int, const int, WSQ_JOB, void *);
+
 /* wsq_utils.c */
 extern void conv_img_flt_new(float *, float *, float *,
                  unsigned char *, const int);
@@ -255,6 +509,9 @@ extern void conv_img_2_uchar(unsigned char *, float *, const int, const int,
                  const float, const float);
 extern void variance( QUANT_VALS *quant_vals, Q_TREE q_tree[], const int,
                  float *, const int, const int);
+extern void variance_mt(QUANT_VALS *, Q_TREE q_tree[], const int,
+                 float *, const int, const int, const int);
+extern void quant_bin_widths(QUANT_VALS *);
 extern int quantize(short **, int *, QUANT_VALS *, Q_TREE qtree[], const int,
                  float *, const int, const int);
 extern void quant_block_sizes(int *, int *, int *,
@@ -262,13 +519,26 @@ extern void quant_block_sizes(int *, int *, int *,
                  Q_TREE q_tree[], const int);
 extern int unquantize(float **, const DQT_TABLE *,
                  Q_TREE q_tree[], const int, short *, const int, const int);
+extern int unquantize_arena(float **, const DQT_TABLE *,
+                 Q_TREE q_tree[], const int, short *, const int, const int,
+                 CODEC_ARENA *);
 extern int wsq_decompose(float *, const int, const int,
                  W_TREE w_tree[], const int, float *, const int,
                  float *, const int);
+extern int wsq_decompose_mt(float *, const int, const int,
+                 W_TREE w_tree[], const int, float *, const int,
+                 float *, const int, const int, CODEC_ARENA *);
 extern void get_lets(float *, float *, const int, const int, const int,
                  const int, float *, const int, float *, const int, const int);
 extern int wsq_reconstruct(float *, const int, const int,
                  W_TREE w_tree[], const int, const DTT_TABLE *);
+extern int wsq_reconstruct_arena(float *, const int, const int,
+                 W_TREE w_tree[], const int, const DTT_TABLE *, CODEC_ARENA *);
+extern int wsq_reconstruct_levels(float *, float *, const int,
+                 W_TREE w_tree[], const int, const DTT_TABLE *, CODEC_ARENA *);
+extern int wsq_reconstruct_node(float *, const int, const int,
+                 W_TREE w_tree[], const int, const DTT_TABLE *, const int,
+                 CODEC_ARENA *);
 extern void  join_lets(float *, float *, const int, const int,
                  const int, const int, float *, const int,
                  float *, const int, const int);
@@ -0,0 +1,96 @@
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    WSQ_CTX.C
+
+      Contains routines responsible for managing WSQ codec contexts.
+      A context owns all of the working state (trees, tables, and
+      quantization parameters) used while encoding or decoding an
+      image, so that separate contexts may be used concurrently.
+
+      ROUTINES:
+#cat: alloc_WSQ_CTX - Allocates and initializes a WSQ codec context.
+#cat:
+#cat: free_WSQ_CTX - Deallocates a WSQ codec context and the tables
+#cat:                it owns.
+#cat: reset_WSQ_CTX - Releases any tables read into a WSQ codec
+#cat:                context and marks them undefined.
+#cat: wsq_ctx_arena - Gets the arena a WSQ codec context takes its
+#cat:                image planes from, if it uses one.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wsq.h>
+
+/************************************************************************/
+/* Allocates a WSQ codec context with all tables marked undefined.      */
+/************************************************************************/
+int alloc_WSQ_CTX(WSQ_CTX **octx)
+{
+   WSQ_CTX *ctx;
+
+   ctx = (WSQ_CTX *)calloc(1, sizeof(WSQ_CTX));
+   if(ctx == (WSQ_CTX *)NULL){
+      fprintf(stderr, "ERROR : alloc_WSQ_CTX : calloc : ctx\n");
+      return(-2);
+   }
+
+   *octx = ctx;
+   return(0);
+}
+
+/************************************************************************/
+/* Deallocates a WSQ codec context along with any filter coefficients   */
+/* read into its transform table and the memory of its arenas.          */
+/************************************************************************/
+void free_WSQ_CTX(WSQ_CTX *ctx)
+{
+   int i;
+
+   if(ctx == (WSQ_CTX *)NULL)
+      return;
+
+   reset_WSQ_CTX(ctx);
+   free_codec_arena(&ctx->arena);
+   for(i = 0; i < WSQ_NUM_BLOCKS; i++)
+      free_codec_arena(&ctx->block_arena[i]);
+   free(ctx);
+}
+
+/************************************************************************/
+/* Releases tables held from a previous decode so the context may be    */
+/* reused on a new datastream.                                          */
+/************************************************************************/
+void reset_WSQ_CTX(WSQ_CTX *ctx)
+{
+   int i;
+
+   if(ctx->dtt_table.lofilt != (float *)NULL)
+      free(ctx->dtt_table.lofilt);
+   if(ctx->dtt_table.hifilt != (float *)NULL)
+      free(ctx->dtt_table.hifilt);
+   ctx->dtt_table.lofilt = (float *)NULL;
+   ctx->dtt_table.hifilt = (float *)NULL;
+   ctx->dtt_table.lodef = 0;
+   ctx->dtt_table.hidef = 0;
+
+   ctx->dqt_table.dqt_def = 0;
+
+   for(i = 0; i < MAX_DHT_TABLES; i++)
+      ctx->dht_table[i].tabdef = 0;
+}
+
+/************************************************************************/
+/* Returns the arena the image sized planes of an encode or decode are  */
+/* taken from, or NULL if "ctx" does not use one.  The arena is reset   */
+/* as each image is started, so its memory is reused once it has grown  */
+/* to fit the largest image.                                            */
+/************************************************************************/
+CODEC_ARENA *wsq_ctx_arena(WSQ_CTX *ctx)
+{
+   if(!ctx->use_arena)
+      return((CODEC_ARENA *)NULL);
+   return(&ctx->arena);
+}
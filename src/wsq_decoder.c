@@ -1,824 +1,1444 @@
-/***********************************************************************
-      LIBRARY: WSQ - Grayscale Image Compression
-
-      FILE:    DECODER.C
-      AUTHORS: Craig Watson
-               Michael Garris
-      DATE:    12/02/1999
-
-      Contains routines responsible for decoding a WSQ compressed
-      datastream.
-
-      ROUTINES:
-#cat: wsq_decode_mem - Decodes a datastream of WSQ compressed bytes
-#cat:                  from a memory buffer, returning a lossy
-#cat:                  reconstructed pixmap.
-#cat: wsq_decode_file - Decodes a datastream of WSQ compressed bytes
-#cat:                  from an open file, returning a lossy
-#cat:                  reconstructed pixmap.
-#cat: huffman_decode_data_mem - Decodes a block of huffman encoded
-#cat:                  data from a memory buffer.
-#cat: huffman_decode_data_file - Decodes a block of huffman encoded
-#cat:                  data from an open file.
-#cat: decode_data_mem - Decodes huffman encoded data from a memory buffer.
-#cat:
-#cat: decode_data_file - Decodes huffman encoded data from an open file.
-#cat:
-#cat: nextbits_wsq - Gets next sequence of bits for data decoding from
-#cat:                    an open file.
-#cat: getc_nextbits_wsq - Gets next sequence of bits for data decoding
-#cat:                    from a memory buffer.
-
-***********************************************************************/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <wsq.h>
-#include <dataio.h>
-
-/************************************************************************/
-/*              This is an implementation based on the Crinimal         */
-/*              Justice Information Services (CJIS) document            */
-/*              "WSQ Gray-scale Fingerprint Compression                 */
-/*              Specification", Dec. 1997.                              */
-/***************************************************************************/
-/* WSQ Decoder routine.  Takes an WSQ compressed memory buffer and decodes */
-/* it, returning the reconstructed pixmap.                                 */
-/***************************************************************************/
-int wsq_decode_mem(unsigned char **odata, int *ow, int *oh, int *od, int *oppi,
-                   int *lossyflag, unsigned char *idata, const int ilen)
-{
-   int ret, i;
-   unsigned short marker;         /* WSQ marker */
-   int num_pix;                   /* image size and counter */
-   int width, height, ppi;        /* image parameters */
-   unsigned char *cdata;          /* image pointer */
-   float *fdata;                  /* image pointers */
-   short *qdata;                  /* image pointers */
-   unsigned char *cbufptr;        /* points to current byte in buffer */
-   unsigned char *ebufptr;        /* points to end of buffer */
-
-   /* Set memory buffer pointers. */
-   cbufptr = idata;
-   ebufptr = idata + ilen;
-
-   /* Init DHT Tables to 0. */
-   for(i = 0; i < MAX_DHT_TABLES; i++)
-      (dht_table + i)->tabdef = 0;
-
-   /* Read the SOI marker. */
-   ret = getc_marker_wsq(&marker, SOI_WSQ, &cbufptr, ebufptr);
-   if(ret){
-      return(ret);
-   }
-
-   /* Read in supporting tables up to the SOF marker. */
-   ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
-   if(ret){
-      return(ret);
-   }
-   while(marker != SOF_WSQ) {
-      ret = getc_table_wsq(marker, &dtt_table, &dqt_table, dht_table,
-		      &cbufptr, ebufptr);
-      if(ret){
-         return(ret);
-      }
-      ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
-      if(ret){
-         return(ret);
-      }
-   }
-
-   /* Read in the Frame Header. */
-   ret = getc_frame_header_wsq(&frm_header_wsq, &cbufptr, ebufptr);
-   if(ret){
-      return(ret);
-   }
-   width = frm_header_wsq.width;
-   height = frm_header_wsq.height;
-   num_pix = width * height;
-
-   ret = getc_ppi_wsq(&ppi, idata, ilen);
-   if(ret)
-      return(ret);
-
-   if(debug > 0)
-      fprintf(stderr, "SOI, tables, and frame header read\n\n");
-
-   /* Build WSQ decomposition trees. */
-   build_wsq_trees(w_tree, W_TREELEN, q_tree, Q_TREELEN, width, height);
-
-   if(debug > 0)
-      fprintf(stderr, "Tables for wavelet decomposition finished\n\n");
-
-   /* Allocate working memory. */
-   qdata = (short *) malloc(num_pix * sizeof(short));
-   if(qdata == (short *)NULL) {
-      fprintf(stderr,"ERROR: wsq_decode_mem : malloc : qdata1\n");
-      return(-20);
-   }
-
-   /* Decode the Huffman encoded data blocks. */
-   ret = huffman_decode_data_mem(qdata, &dtt_table, &dqt_table,
-		   dht_table, &cbufptr, ebufptr);
-   if(ret){
-      free(qdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr,
-         "Quantized WSQ subband data blocks read and Huffman decoded\n\n");
-
-   /* Decode the quantize wavelet subband data. */
-   ret = unquantize(&fdata, &dqt_table, q_tree, Q_TREELEN,
-		   qdata, width, height);
-   if(ret){
-      free(qdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr, "WSQ subband data blocks unquantized\n\n");
-
-   /* Done with quantized wavelet subband data. */
-   free(qdata);
-
-   ret = wsq_reconstruct(fdata, width, height, w_tree, W_TREELEN, &dtt_table);
-   if(ret){
-      free(fdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr, "WSQ reconstruction of image finished\n\n");
-
-   cdata = (unsigned char *)malloc(num_pix * sizeof(unsigned char));
-   if(cdata == (unsigned char *)NULL) {
-      free(fdata);
-      fprintf(stderr,"ERROR: wsq_decode_mem : malloc : cdata\n");
-      return(-21);
-   }
-
-   /* Convert floating point pixels to unsigned char pixels. */
-   conv_img_2_uchar(cdata, fdata, width, height,
-                      frm_header_wsq.m_shift, frm_header_wsq.r_scale);
-
-   /* Done with floating point pixels. */
-   free(fdata);
-
-   if(debug > 0)
-      fprintf(stderr, "Doubleing point pixels converted to unsigned char\n\n");
-
-
-   /* Assign reconstructed pixmap and attributes to output pointers. */
-   *odata = cdata;
-   *ow = width;
-   *oh = height;
-   *od = 8;
-   *oppi = ppi;
-   *lossyflag = 1;
-
-   /* Return normally. */
-   return(0);
-}
-
-/**************************************************************************/
-/* WSQ File Decoder routine.  Takes an open WSQ compressed file and reads */
-/* in the WSQ encoded data, returning a decoded reconstructed pixmap.     */
-/**************************************************************************/
-int wsq_decode_file(unsigned char **odata, int *ow, int *oh, int *od, int *oppi,
-                    int *lossyflag, FILE *infp)
-{
-   int ret;
-   unsigned short marker;         /* WSQ marker */
-   int num_pix;                   /* image size and counter */
-   int width, height, ppi;        /* image parameters */
-   unsigned char *cdata;          /* image pointer */
-   float *fdata;                  /* image pointers */
-   short *qdata;                  /* image pointers */
-
-   /* Read the SOI marker. */
-   ret = read_marker_wsq(&marker, SOI_WSQ, infp);
-   if(ret){
-      return(ret);
-   }
-
-   /* Read in supporting tables up to the SOF marker. */
-   ret = read_marker_wsq(&marker, TBLS_N_SOF, infp);
-   if(ret){
-      return(ret);
-   }
-   while(marker != SOF_WSQ) {
-      ret = read_table_wsq(marker, &dtt_table, &dqt_table, dht_table, infp);
-      if(ret){
-         return(ret);
-      }
-      ret = read_marker_wsq(&marker, TBLS_N_SOF, infp);
-      if(ret){
-         return(ret);
-      }
-   }
-
-   /* Read in the Frame Header. */
-   ret = read_frame_header_wsq(&frm_header_wsq, infp);
-   if(ret){
-      return(ret);
-   }
-   width = frm_header_wsq.width;
-   height = frm_header_wsq.height;
-   num_pix = width * height;
-
-   ret = read_ppi_wsq(&ppi, infp);
-   if(ret)
-      return(ret);
-
-   if(debug > 0)
-      fprintf(stderr, "SOI, tables, and frame header read\n\n");
-
-   /* Build WSQ decomposition trees. */
-   build_wsq_trees(w_tree, W_TREELEN, q_tree, Q_TREELEN, width, height);
-
-   if(debug > 0)
-      fprintf(stderr, "Tables for wavelet decomposition finished\n\n");
-
-   /* Allocate working memory. */
-   qdata = (short *) malloc(num_pix * sizeof(short));
-   if(qdata == (short *)NULL) {
-      fprintf(stderr,"ERROR: wsq_decode_file : malloc : qdata1\n");
-      return(-20);
-   }
-
-   /* Decode the Huffman encoded data blocks. */
-   ret = huffman_decode_data_file(qdata, &dtt_table,
-		   &dqt_table, dht_table, infp);
-   if(ret){
-      free(qdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr,
-         "Quantized WSQ subband data blocks read and Huffman decoded\n\n");
-
-   /* Decode the quantize wavelet subband data. */
-   ret = unquantize(&fdata, &dqt_table, q_tree,
-		   Q_TREELEN, qdata, width, height);
-   if(ret){
-      free(qdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr, "WSQ subband data blocks unquantized\n\n");
-
-   /* Done with quantized wavelet subband data. */
-   free(qdata);
-
-   ret = wsq_reconstruct(fdata, width, height, w_tree, W_TREELEN, &dtt_table);
-   if(ret){
-      free(fdata);
-      return(ret);
-   }
-
-   if(debug > 0)
-      fprintf(stderr, "WSQ reconstruction of image finished\n\n");
-
-   cdata = (unsigned char *)malloc(num_pix * sizeof(unsigned char));
-   if(cdata == (unsigned char *)NULL) {
-      free(fdata);
-      fprintf(stderr,"ERROR: wsq_decode_file : malloc : cdata\n");
-      return(-21);
-   }
-
-   /* Convert floating point pixels to unsigned char pixels. */
-   conv_img_2_uchar(cdata, fdata, width, height,
-                      frm_header_wsq.m_shift, frm_header_wsq.r_scale);
-
-   /* Done with floating point pixels. */
-   free(fdata);
-
-   if(debug > 0)
-      fprintf(stderr, "Doubleing point pixels converted to unsigned char\n\n");
-
-
-   /* Assign reconstructed pixmap and attributes to output pointers. */
-   *odata = cdata;
-   *ow = width;
-   *oh = height;
-   *od = 8;
-   *oppi = ppi;
-   *lossyflag = 1;
-
-   /* Return normally. */
-   return(0);
-}
-
-/***************************************************************************/
-/* Routine to decode an entire "block" of encoded data from memory buffer. */
-/***************************************************************************/
-int huffman_decode_data_mem(
-   short *ip,               /* image pointer */
-   DTT_TABLE *dtt_table,    /*transform table pointer */
-   DQT_TABLE *dqt_table,    /* quantization table */
-   DHT_TABLE *dht_table,    /* huffman table */
-   unsigned char **cbufptr, /* points to current byte in input buffer */
-   unsigned char *ebufptr)  /* points to end of input buffer */
-{
-   int ret;
-   int blk = 0;           /* block number */
-   unsigned short marker; /* WSQ markers */
-   int bit_count;         /* bit count for getc_nextbits_wsq routine */
-   int n;                 /* zero run count */
-   int nodeptr;           /* pointers for decoding */
-   int last_size;         /* last huffvalue */
-   unsigned char hufftable_id;    /* huffman table number */
-   HUFFCODE *hufftable;   /* huffman code structure */
-   int maxcode[MAX_HUFFBITS+1]; /* used in decoding data */
-   int mincode[MAX_HUFFBITS+1]; /* used in decoding data */
-   int valptr[MAX_HUFFBITS+1];     /* used in decoding data */
-   unsigned short tbits;
-
-
-   ret = getc_marker_wsq(&marker, TBLS_N_SOB, cbufptr, ebufptr);
-   if(ret)
-      return(ret);
-
-   bit_count = 0;
-
-   while(marker != EOI_WSQ) {
-
-      if(marker != 0) {
-         blk++;
-         while(marker != SOB_WSQ) {
-            ret = getc_table_wsq(marker, dtt_table, dqt_table,
-			    dht_table, cbufptr, ebufptr);
-            if(ret)
-               return(ret);
-	    ret = getc_marker_wsq(&marker, TBLS_N_SOB, cbufptr, ebufptr);
-            if(ret)
-               return(ret);
-         }
-	 ret = getc_block_header(&hufftable_id, cbufptr, ebufptr);
-         if(ret)
-            return(ret);
-
-         if((dht_table+hufftable_id)->tabdef != 1) {
-            fprintf(stderr, "ERROR : huffman_decode_data_mem : ");
-            fprintf(stderr, "huffman table {%d} undefined.\n", hufftable_id);
-            return(-51);
-         }
-
-         /* the next two routines reconstruct the huffman tables */
-	 ret = build_huffsizes(&hufftable, &last_size,
-			 (dht_table+hufftable_id)->huffbits,
-			 MAX_HUFFCOUNTS_WSQ);
-         if(ret)
-            return(ret);
-
-         build_huffcodes(hufftable);
-	 ret = check_huffcodes_wsq(hufftable, last_size);
-         if(ret)
-            fprintf(stderr, "         hufftable_id = %d\n", hufftable_id);
-
-         /* this routine builds a set of three tables used in decoding */
-         /* the compressed data*/
-         gen_decode_table(hufftable, maxcode, mincode, valptr,
-                          (dht_table+hufftable_id)->huffbits);
-         free(hufftable);
-         bit_count = 0;
-         marker = 0;
-      }
-
-      /* get next huffman category code from compressed input data stream */
-      ret = decode_data_mem(&nodeptr, mincode, maxcode, valptr,
-		      (dht_table+hufftable_id)->huffvalues, cbufptr,
-		      ebufptr, &bit_count, &marker);
-      if(ret)
-         return(ret);
-
-      if(nodeptr == -1)
-         continue;
-
-      if(nodeptr > 0 && nodeptr <= 100)
-         for(n = 0; n < nodeptr; n++) {
-            *ip++ = 0; /* z run */
-         }
-      else if(nodeptr > 106 && nodeptr < 0xff)
-         *ip++ = nodeptr - 180;
-      else if(nodeptr == 101){
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 8);
-         if(ret)
-            return(ret);
-         *ip++ = tbits;
-      }
-      else if(nodeptr == 102){
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 8);
-         if(ret)
-            return(ret);
-         *ip++ = -tbits;
-      }
-      else if(nodeptr == 103){
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 16);
-         if(ret)
-            return(ret);
-         *ip++ = tbits;
-      }
-      else if(nodeptr == 104){
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 16);
-         if(ret)
-            return(ret);
-         *ip++ = -tbits;
-      }
-      else if(nodeptr == 105) {
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 8);
-         if(ret)
-            return(ret);
-         n = tbits;
-         while(n--)
-            *ip++ = 0;
-      }
-      else if(nodeptr == 106) {
-         ret = getc_nextbits_wsq(&tbits, &marker, cbufptr,
-			 ebufptr, &bit_count, 16);
-         if(ret)
-            return(ret);
-         n = tbits;
-         while(n--)
-            *ip++ = 0;
-      }
-      else {
-         fprintf(stderr, 
-                "ERROR: huffman_decode_data_mem : Invalid code %d (%x).\n",
-                nodeptr, nodeptr);
-         return(-52);
-      }
-
-   }
-
-   return(0);
-}
-
-/********************************************************************/
-/* Routine to decode an entire "block" of encoded data from a file. */
-/********************************************************************/
-int huffman_decode_data_file(
-   short *ip,             /* image pointer */
-   DTT_TABLE *dtt_table,  /*transform table pointer */
-   DQT_TABLE *dqt_table,  /* quantization table */
-   DHT_TABLE *dht_table,  /* huffman table */
-   FILE *infp)            /* input file */
-{
-   int ret;
-   int blk = 0;           /* block number */
-   unsigned short marker; /* WSQ markers */
-   int bit_count;         /* bit count for nextbits_wsq routine */
-   int n;                 /* zero run count */
-   int nodeptr;           /* pointers for decoding */
-   int last_size;         /* last huffvalue */
-   unsigned char hufftable_id;    /* huffman table number */
-   HUFFCODE *hufftable;   /* huffman code structure */
-   int maxcode[MAX_HUFFBITS+1]; /* used in decoding data */
-   int mincode[MAX_HUFFBITS+1]; /* used in decoding data */
-   int valptr[MAX_HUFFBITS+1];  /* used in decoding data */
-   unsigned short tbits;
-
-
-   ret = read_marker_wsq(&marker, TBLS_N_SOB, infp);
-   if(ret)
-      return(ret);
-
-   bit_count = 0;
-
-   while(marker != EOI_WSQ) {
-
-      if(marker != 0) {
-         blk++;
-         while(marker != SOB_WSQ) {
-            ret = read_table_wsq(marker, dtt_table,
-			    dqt_table, dht_table, infp);
-            if(ret)
-               return(ret);
-	    ret = read_marker_wsq(&marker, TBLS_N_SOB, infp);
-            if(ret)
-               return(ret);
-         }
-	 ret = read_block_header(&hufftable_id, infp);
-         if(ret)
-            return(ret);
-
-         if((dht_table+hufftable_id)->tabdef != 1) {
-            fprintf(stderr, "ERROR : huffman_decode_data_file : ");
-            fprintf(stderr, "huffman table {%d} undefined.\n", hufftable_id);
-            return(-53);
-         }
-
-         /* the next two routines reconstruct the huffman tables */
-	 ret = build_huffsizes(&hufftable, &last_size,
-			 (dht_table+hufftable_id)->huffbits,
-			 MAX_HUFFCOUNTS_WSQ);
-         if(ret)
-            return(ret);
-         build_huffcodes(hufftable);
-	 ret = check_huffcodes_wsq(hufftable, last_size);
-         if(ret)
-            fprintf(stderr, "         hufftable_id = %d\n", hufftable_id);
-
-         /* this routine builds a set of three tables used in decoding */
-         /* the compressed data*/
-         gen_decode_table(hufftable, maxcode, mincode, valptr,
-                          (dht_table+hufftable_id)->huffbits);
-         free(hufftable);
-         bit_count = 0;
-         marker = 0;
-      }
-
-      /* get next huffman category code from compressed input data stream */
-      ret = decode_data_file(&nodeptr, mincode, maxcode, valptr,
-		      (dht_table+hufftable_id)->huffvalues, infp,
-		      &bit_count, &marker);
-      if(ret)
-         return(ret);
-
-      if(nodeptr == -1)
-         continue;
-
-      if(nodeptr > 0 && nodeptr <= 100)
-         for(n = 0; n < nodeptr; n++) {
-            *ip++ = 0; /* z run */
-         }
-      else if(nodeptr == 101){
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
-         if(ret)
-            return(ret);
-         *ip++ = tbits;
-      }
-      else if(nodeptr == 102){
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
-         if(ret)
-            return(ret);
-         *ip++ = -tbits;
-      }
-      else if(nodeptr == 103){
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
-         if(ret)
-            return(ret);
-         *ip++ = tbits;
-      }
-      else if(nodeptr == 104){
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
-         if(ret)
-            return(ret);
-         *ip++ = -tbits;
-      }
-      else if(nodeptr == 105) {
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
-         if(ret)
-            return(ret);
-         n = tbits;
-         while(n--)
-            *ip++ = 0;
-      }
-      else if(nodeptr == 106) {
-         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
-         if(ret)
-            return(ret);
-         n = tbits;
-         while(n--)
-            *ip++ = 0;
-      }
-      else if(nodeptr < 0xff)
-         *ip++ = nodeptr - 180;
-      else {
-         fprintf(stderr, 
-                "ERROR: huffman_decode_data_file : Invalid code %d (%x).\n",
-                nodeptr, nodeptr);
-         return(-54);
-      }
-   }
-
-   return(0);
-}
-
-/**********************************************************/
-/* Routine to decode the encoded data from memory buffer. */
-/**********************************************************/
-int decode_data_mem(
-   int *onodeptr,       /* returned huffman code category        */
-   int *mincode,        /* points to minimum code value for      */
-                        /*    a given code length                */
-   int *maxcode,        /* points to maximum code value for      */
-                        /*    a given code length                */
-   int *valptr,         /* points to first code in the huffman   */
-                        /*    code table for a given code length */
-   unsigned char *huffvalues,   /* defines order of huffman code          */
-                                /*    lengths in relation to code sizes   */
-   unsigned char **cbufptr,     /* points to current byte in input buffer */
-   unsigned char *ebufptr,      /* points to end of input buffer          */
-   int *bit_count,      /* marks the bit to receive from the input byte */
-   unsigned short *marker)
-{
-   int ret;
-   int inx, inx2;       /*increment variables*/
-   unsigned short code, tbits;  /* becomes a huffman code word
-                                   (one bit at a time)*/
-
-   ret = getc_nextbits_wsq(&code, marker, cbufptr, ebufptr, bit_count, 1);
-   if(ret)
-      return(ret);
-
-   if(*marker != 0){
-      *onodeptr = -1;
-      return(0);
-   }
-
-   for(inx = 1; (int)code > maxcode[inx]; inx++) {
-      ret = getc_nextbits_wsq(&tbits, marker, cbufptr, ebufptr, bit_count, 1);
-      if(ret)
-         return(ret);
-
-      code = (code << 1) + tbits;
-      if(*marker != 0){
-         *onodeptr = -1;
-         return(0);
-      }
-   }
-   inx2 = valptr[inx];
-   inx2 = inx2 + code - mincode[inx];
-
-   *onodeptr = huffvalues[inx2];
-   return(0);
-}
-
-/*************************************************/
-/* Routine to decode the encoded data from file. */
-/*************************************************/
-int decode_data_file(
-   int *onodeptr,       /* returned huffman code category        */
-   int *mincode,        /* points to minimum code value for      */
-                        /*    a given code length                */
-   int *maxcode,        /* points to maximum code value for      */
-                        /*    a given code length                */
-   int *valptr,         /* points to first code in the huffman   */
-                        /*    code table for a given code length */
-   unsigned char *huffvalues,   /* defines order of huffman code         */
-                        /*    lengths in relation to code sizes  */
-   FILE *infp,          /* compressed input data file            */
-   int *bit_count,      /* marks the bit to receive from the input byte */
-   unsigned short *marker)
-{
-   int ret;
-   int inx, inx2;               /*increment variables*/
-   unsigned short code, tbits;  /*becomes a huffman code word
-                                  (one bit at a time)*/
-
-   ret = nextbits_wsq(&code, marker, infp, bit_count, 1);
-   if(ret)
-      return(ret);
-
-   if(*marker != 0){
-      *onodeptr = -1;
-      return(0);
-   }
-
-   for(inx = 1; (int)code > maxcode[inx]; inx++) {
-      ret = nextbits_wsq(&tbits, marker, infp, bit_count, 1);
-      if(ret)
-         return(ret);
-
-      code = (code << 1) + tbits;
-      if(*marker != 0){
-         *onodeptr = -1;
-         return(0);
-      }
-   }
-   inx2 = valptr[inx];
-   inx2 = inx2 + code - mincode[inx];
-
-   *onodeptr = huffvalues[inx2];
-   return(0);
-}
-
-/*********************************************/
-/* Routine to get nextbit(s) of data stream. */
-/*********************************************/
-int nextbits_wsq(
-   unsigned short *obits,  /* returned bits */
-   unsigned short *marker, /* returned marker */
-   FILE *file,          /* compressed input data file */
-   int *bit_count,      /* marks the bit to receive from the input byte */
-   const int bits_req)  /* number of bits requested */
-{
-   int ret;
-   static unsigned char code;   /*next byte of data*/
-   static unsigned char code2;  /*stuffed byte of data*/
-   unsigned short bits, tbits;  /*bits of current data byte requested*/
-   int bits_needed;     /*additional bits required to finish request*/
-
-                              /*used to "mask out" n number of
-                                bits from data stream*/
-   static unsigned char bit_mask[9] = {0x00,0x01,0x03,0x07,0x0f,
-                                       0x1f,0x3f,0x7f,0xff};
-   if(*bit_count == 0) {
-      code = (unsigned char)getc(file);
-      *bit_count = 8;
-      if(code == 0xFF) {
-         code2 = (unsigned char)getc(file);
-         if(code2 != 0x00 && bits_req == 1) {
-            *marker = (code << 8) | code2;
-            *obits = 1;
-            return(0);
-         }
-         if(code2 != 0x00) {
-            fprintf(stderr, "ERROR: nextbits_wsq : No stuffed zeros\n");
-            return(-38);
-         }
-      }
-   }
-   if(bits_req <= *bit_count) {
-      bits = (code >>(*bit_count - bits_req)) & (bit_mask[bits_req]);
-      *bit_count -= bits_req;
-      code &= bit_mask[*bit_count];
-   }
-   else {
-      bits_needed = bits_req - *bit_count;
-      bits = code << bits_needed;
-      *bit_count = 0;
-      ret = nextbits_wsq(&tbits, (unsigned short *)NULL, file,
-		      bit_count, bits_needed);
-      if(ret)
-         return(ret);
-      bits |= tbits;
-   }
-
-   *obits = bits;
-   return(0);
-}
-
-/****************************************************************/
-/* Routine to get nextbit(s) of data stream from memory buffer. */
-/****************************************************************/
-int getc_nextbits_wsq(
-   unsigned short *obits,       /* returned bits */
-   unsigned short *marker,      /* returned marker */
-   unsigned char **cbufptr,     /* points to current byte in input buffer */
-   unsigned char *ebufptr,      /* points to end of input buffer */
-   int *bit_count,      /* marks the bit to receive from the input byte */
-   const int bits_req)  /* number of bits requested */
-{
-   int ret;
-   static unsigned char code;   /*next byte of data*/
-   static unsigned char code2;  /*stuffed byte of data*/
-   unsigned short bits, tbits;  /*bits of current data byte requested*/
-   int bits_needed;     /*additional bits required to finish request*/
-
-                              /*used to "mask out" n number of
-                                bits from data stream*/
-   static unsigned char bit_mask[9] = {0x00,0x01,0x03,0x07,0x0f,
-                                       0x1f,0x3f,0x7f,0xff};
-   if(*bit_count == 0) {
-      ret = getc_byte(&code, cbufptr, ebufptr);
-      if(ret){
-         return(ret);
-      }
-      *bit_count = 8;
-      if(code == 0xFF) {
-         ret = getc_byte(&code2, cbufptr, ebufptr);
-         if(ret){
-            return(ret);
-         }
-         if(code2 != 0x00 && bits_req == 1) {
-            *marker = (code << 8) | code2;
-            *obits = 1;
-            return(0);
-         }
-         if(code2 != 0x00) {
-            fprintf(stderr, "ERROR: getc_nextbits_wsq : No stuffed zeros\n");
-            return(-41);
-         }
-      }
-   }
-   if(bits_req <= *bit_count) {
-      bits = (code >>(*bit_count - bits_req)) & (bit_mask[bits_req]);
-      *bit_count -= bits_req;
-      code &= bit_mask[*bit_count];
-   }
-   else {
-      bits_needed = bits_req - *bit_count;
-      bits = code << bits_needed;
-      *bit_count = 0;
-      ret = getc_nextbits_wsq(&tbits, (unsigned short *)NULL,
-		      cbufptr, ebufptr, bit_count, bits_needed);
-      if(ret)
-         return(ret);
-      bits |= tbits;
-   }
-
-   *obits = bits;
-   return(0);
-}
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    DECODER.C
+      AUTHORS: Craig Watson
+               Michael Garris
+      DATE:    12/02/1999
+
+      Contains routines responsible for decoding a WSQ compressed
+      datastream.
+
+      ROUTINES:
+#cat: wsq_decode_mem - Decodes a datastream of WSQ compressed bytes
+#cat:                  from a memory buffer, returning a lossy
+#cat:                  reconstructed pixmap.
+#cat: wsq_decode_mem_ctx - Decodes a datastream of WSQ compressed bytes
+#cat:                  from a memory buffer using the working state
+#cat:                  held in a caller supplied context.
+#cat: wsq_decode_file - Decodes a datastream of WSQ compressed bytes
+#cat:                  from an open file, returning a lossy
+#cat:                  reconstructed pixmap.
+#cat: wsq_decode_file_ctx - Decodes a datastream of WSQ compressed bytes
+#cat:                  read in blocks from an open file.
+#cat: wsq_decode_fd_ctx - Decodes a datastream of WSQ compressed bytes
+#cat:                  read from a file descriptor, pipe or socket.
+#cat: wsq_decode_stream_ctx - Decodes a datastream of WSQ compressed
+#cat:                  bytes from a stream.
+#cat: wsq_decode_mem_scaled - Decodes a datastream of WSQ compressed bytes
+#cat:                  from a memory buffer at a reduced resolution.
+#cat: wsq_decode_mem_scaled_ctx - Decodes a datastream of WSQ compressed
+#cat:                  bytes from a memory buffer at a reduced resolution
+#cat:                  using a caller supplied context.
+#cat: wsq_decode_stream_scaled_ctx - Decodes a datastream of WSQ
+#cat:                  compressed bytes from a stream at a reduced
+#cat:                  resolution.
+#cat: wsq_decode_mem_into - Decodes a datastream of WSQ compressed bytes
+#cat:                  from a memory buffer into a caller supplied buffer.
+#cat: wsq_decode_mem_into_ctx - Decodes a datastream of WSQ compressed
+#cat:                  bytes into a caller supplied buffer using a caller
+#cat:                  supplied context.
+#cat: wsq_probe_mem - Reads the image attributes and output buffer size
+#cat:                  of a WSQ datastream from its headers alone.
+#cat: wsq_open_rows_ctx - Starts decoding a datastream a band of rows
+#cat:                  at a time.
+#cat: wsq_read_rows - Returns the next band of decoded rows.
+#cat:
+#cat: free_WSQ_ROWS - Deallocates a row by row decode.
+#cat:
+#cat: huffman_decode_data_mem - Decodes a block of huffman encoded
+#cat:                  data from a memory buffer.
+#cat: huffman_decode_data_stream - Decodes a block of huffman encoded
+#cat:                  data from a stream.
+#cat: huffman_decode_data_file - Decodes a block of huffman encoded
+#cat:                  data from an open file.
+#cat: decode_data_mem - Decodes huffman encoded data from a memory buffer.
+#cat:
+#cat: decode_data_file - Decodes huffman encoded data from an open file.
+#cat:
+#cat: nextbits_wsq - Gets next sequence of bits for data decoding from
+#cat:                    an open file.
+#cat: getc_nextbits_wsq - Gets next sequence of bits for data decoding
+#cat:                    from a memory buffer.
+#cat: gen_hdec_table_wsq - Builds the lookup table used to decode
+#cat:                    huffman codes several bits at a time.
+#cat: fill_bitbuf_wsq - Loads bytes from a memory buffer into a bit
+#cat:                    reservoir, removing stuffed zeros.
+#cat: getc_huffsym_wsq - Decodes the next huffman code from a bit
+#cat:                    reservoir using the lookup table.
+#cat: getc_bitbuf_wsq - Gets next sequence of bits from a bit reservoir.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wsq.h>
+#include <dataio.h>
+
+/************************************************************************/
+/*              This is an implementation based on the Crinimal         */
+/*              Justice Information Services (CJIS) document            */
+/*              "WSQ Gray-scale Fingerprint Compression                 */
+/*              Specification", Dec. 1997.                              */
+/***************************************************************************/
+/* WSQ Decoder routine.  Takes an WSQ compressed memory buffer and decodes */
+/* it using the default context, returning the reconstructed pixmap.       */
+/***************************************************************************/
+int wsq_decode_mem(unsigned char **odata, int *ow, int *oh, int *od, int *oppi,
+                   int *lossyflag, unsigned char *idata, const int ilen)
+{
+   return(wsq_decode_mem_ctx(&wsq_default_ctx, odata, ow, oh, od, oppi,
+                             lossyflag, idata, ilen));
+}
+
+/***************************************************************************/
+/* WSQ Decoder routine.  Takes an WSQ compressed memory buffer and decodes */
+/* it, returning the reconstructed pixmap.  All working state is kept in   */
+/* "ctx", so concurrent calls are safe given distinct contexts.            */
+/***************************************************************************/
+int wsq_decode_mem_ctx(WSQ_CTX *ctx, unsigned char **odata, int *ow, int *oh,
+                   int *od, int *oppi, int *lossyflag, unsigned char *idata,
+                   const int ilen)
+{
+   WSQ_STREAM stream;
+
+   init_wsq_stream_mem(&stream, idata, ilen);
+   return(wsq_decode_stream_ctx(ctx, odata, ow, oh, od, oppi, lossyflag,
+                                &stream));
+}
+
+/***************************************************************************/
+/* WSQ Decoder routine.  Decodes a WSQ compressed memory buffer at a       */
+/* reduced resolution using the default context; see                      */
+/* wsq_decode_stream_scaled_ctx.                                           */
+/***************************************************************************/
+int wsq_decode_mem_scaled(unsigned char **odata, int *ow, int *oh, int *od,
+                   int *oppi, int *lossyflag, unsigned char *idata,
+                   const int ilen, const int level)
+{
+   return(wsq_decode_mem_scaled_ctx(&wsq_default_ctx, odata, ow, oh, od,
+                                    oppi, lossyflag, idata, ilen, level));
+}
+
+/***************************************************************************/
+int wsq_decode_mem_scaled_ctx(WSQ_CTX *ctx, unsigned char **odata, int *ow,
+                   int *oh, int *od, int *oppi, int *lossyflag,
+                   unsigned char *idata, const int ilen, const int level)
+{
+   WSQ_STREAM stream;
+
+   init_wsq_stream_mem(&stream, idata, ilen);
+   return(wsq_decode_stream_scaled_ctx(ctx, odata, ow, oh, od, oppi,
+                                       lossyflag, &stream, level));
+}
+
+/**************************************************************************/
+/* WSQ File Decoder routine.  Takes an open WSQ compressed file and reads */
+/* in the WSQ encoded data, returning a decoded reconstructed pixmap.     */
+/* This routine works in the default context and is not reentrant.       */
+/**************************************************************************/
+int wsq_decode_file(unsigned char **odata, int *ow, int *oh, int *od, int *oppi,
+                    int *lossyflag, FILE *infp)
+{
+   return(wsq_decode_file_ctx(&wsq_default_ctx, odata, ow, oh, od, oppi,
+                              lossyflag, infp));
+}
+
+/**************************************************************************/
+/* WSQ File Decoder routine.  Reads the WSQ encoded data from an open     */
+/* file in blocks, leaving the file positioned just past the datastream   */
+/* when it can be seeked.                                                 */
+/**************************************************************************/
+int wsq_decode_file_ctx(WSQ_CTX *ctx, unsigned char **odata, int *ow,
+                    int *oh, int *od, int *oppi, int *lossyflag, FILE *infp)
+{
+   int ret;
+   WSQ_STREAM stream;
+
+   ret = open_wsq_stream_file(&stream, infp);
+   if(ret)
+      return(ret);
+   ret = wsq_decode_stream_ctx(ctx, odata, ow, oh, od, oppi, lossyflag,
+                               &stream);
+   close_wsq_stream(&stream);
+   return(ret);
+}
+
+/**************************************************************************/
+/* WSQ Descriptor Decoder routine.  Reads the WSQ encoded data from a     */
+/* file descriptor, which may be a pipe or socket.  No more is read than  */
+/* the decoder needs at each point, up to a block at a time.              */
+/**************************************************************************/
+int wsq_decode_fd_ctx(WSQ_CTX *ctx, unsigned char **odata, int *ow,
+                    int *oh, int *od, int *oppi, int *lossyflag, const int fd)
+{
+   int ret;
+   WSQ_STREAM stream;
+
+   ret = open_wsq_stream_fd(&stream, fd);
+   if(ret)
+      return(ret);
+   ret = wsq_decode_stream_ctx(ctx, odata, ow, oh, od, oppi, lossyflag,
+                               &stream);
+   close_wsq_stream(&stream);
+   return(ret);
+}
+
+/***************************************************************************/
+/* Reads the tables, frame header and first "nblks" coded blocks of a     */
+/* datastream, and returns the quantized wavelet subband data.  Subbands   */
+/* of the blocks not read are left undefined.                              */
+/***************************************************************************/
+static int decode_wsq_blocks(WSQ_CTX *ctx, short **oqdata, int *ow, int *oh,
+                   int *oppi, WSQ_STREAM *stream, const int nblks)
+{
+   int ret;
+   unsigned short marker;         /* WSQ marker */
+   int num_pix;                   /* image size and counter */
+   int width, height, ppi;        /* image parameters */
+   short *qdata;                  /* image pointers */
+
+   /* Release tables and working memory left from any previous */
+   /* datastream.                                               */
+   reset_WSQ_CTX(ctx);
+   reset_codec_arena(wsq_ctx_arena(ctx));
+
+   /* Keep the headers buffered for the NISTCOM search below. */
+   stream->keep = stream->cptr;
+
+   /* Read the SOI marker. */
+   ret = getc_marker_wsq_stream(&marker, SOI_WSQ, stream);
+   if(ret){
+      return(ret);
+   }
+
+   /* Read in supporting tables up to the SOF marker. */
+   ret = getc_marker_wsq_stream(&marker, TBLS_N_SOF, stream);
+   if(ret){
+      return(ret);
+   }
+   while(marker != SOF_WSQ) {
+      ret = getc_table_wsq_stream(marker, &ctx->dtt_table, &ctx->dqt_table,
+		      ctx->dht_table, stream);
+      if(ret){
+         return(ret);
+      }
+      ret = getc_marker_wsq_stream(&marker, TBLS_N_SOF, stream);
+      if(ret){
+         return(ret);
+      }
+   }
+
+   /* Read in the Frame Header. */
+   ret = getc_frame_header_wsq_stream(&ctx->frm_header_wsq, stream);
+   if(ret){
+      return(ret);
+   }
+   width = ctx->frm_header_wsq.width;
+   height = ctx->frm_header_wsq.height;
+   num_pix = width * height;
+
+   ret = getc_ppi_wsq_stream(&ppi, stream);
+   if(ret)
+      return(ret);
+   stream->keep = (unsigned char *)NULL;
+
+   if(debug > 0)
+      fprintf(stderr, "SOI, tables, and frame header read\n\n");
+
+   /* Build WSQ decomposition trees. */
+   get_wsq_trees(ctx->w_tree, W_TREELEN, ctx->q_tree, Q_TREELEN,
+                   width, height);
+
+   if(debug > 0)
+      fprintf(stderr, "Tables for wavelet decomposition finished\n\n");
+
+   /* Allocate working memory. */
+   qdata = (short *) codec_arena_alloc(wsq_ctx_arena(ctx),
+                                       num_pix * sizeof(short));
+   if(qdata == (short *)NULL) {
+      fprintf(stderr,"ERROR: decode_wsq_blocks : malloc : qdata1\n");
+      return(-20);
+   }
+
+   /* Decode the Huffman encoded data blocks. */
+   ret = huffman_decode_data_stream(qdata, &ctx->dtt_table, &ctx->dqt_table,
+		   ctx->dht_table, stream, nblks);
+   if(ret){
+      codec_arena_free(wsq_ctx_arena(ctx), qdata);
+      return(ret);
+   }
+
+   if(debug > 0)
+      fprintf(stderr,
+         "Quantized WSQ subband data blocks read and Huffman decoded\n\n");
+
+   *oqdata = qdata;
+   *ow = width;
+   *oh = height;
+   *oppi = ppi;
+
+   return(0);
+}
+
+/* Wavelet tree node holding the low pass image, and subbands coded in   */
+/* the blocks that precede it, for each level of a scaled decode.         */
+static const int wsq_scale_roots[WSQ_MAX_SCALE_LEVEL+1] = {0, 1, 14};
+static const int wsq_scale_subbands[WSQ_MAX_SCALE_LEVEL+1] =
+                   {NUM_SUBBANDS, STRT_SUBBAND_3, STRT_SUBBAND_2};
+
+/***************************************************************************/
+/* Unquantizes and reconstructs the subband data in floating point, down   */
+/* to the low pass image of the given level, which is returned in "cdata"  */
+/* at the size of its tree node, with rows "stride" bytes apart.  The      */
+/* quantized data is freed.  Working planes come from the context's arena  */
+/* if it has one.                                                          */
+/***************************************************************************/
+static int reconstruct_wsq_float(WSQ_CTX *ctx, unsigned char *cdata,
+                   const int stride, short *qdata, const int width, const int height,
+                   const int level)
+{
+   int ret, cnt, row;
+   float *fdata;                  /* image pointers */
+   DQT_TABLE dqt_table;
+   W_TREE *rt;
+   CODEC_ARENA *arena;
+
+   /* Leave out the subbands of blocks that were not decoded. */
+   dqt_table = ctx->dqt_table;
+   for(cnt = wsq_scale_subbands[level]; cnt < NUM_SUBBANDS; cnt++)
+      dqt_table.q_bin[cnt] = 0.0;
+
+   /* Decode the quantize wavelet subband data. */
+   arena = wsq_ctx_arena(ctx);
+   ret = unquantize_arena(&fdata, &dqt_table, ctx->q_tree, Q_TREELEN,
+		   qdata, width, height, arena);
+   codec_arena_free(arena, qdata);
+   if(ret)
+      return(ret);
+
+   if(debug > 0)
+      fprintf(stderr, "WSQ subband data blocks unquantized\n\n");
+
+   rt = &ctx->w_tree[wsq_scale_roots[level]];
+   if(level == 0)
+      ret = wsq_reconstruct_arena(fdata, width, height, ctx->w_tree,
+		   W_TREELEN, &ctx->dtt_table, arena);
+   else
+      ret = wsq_reconstruct_node(fdata, width, height, ctx->w_tree,
+		   W_TREELEN, &ctx->dtt_table, wsq_scale_roots[level], arena);
+   if(ret){
+      codec_arena_free(arena, fdata);
+      return(ret);
+   }
+
+   if(debug > 0)
+      fprintf(stderr, "WSQ reconstruction of image finished\n\n");
+
+   /* Convert floating point pixels to unsigned char pixels, row by   */
+   /* row into "cdata" at "stride".  A low pass image gains 2 per level. */
+   if(stride == width && rt->lenx == width)
+      conv_img_2_uchar(cdata, fdata, rt->lenx, rt->leny,
+                    ctx->frm_header_wsq.m_shift,
+                    ctx->frm_header_wsq.r_scale / (float)(1 << level));
+   else
+      for(row = 0; row < rt->leny; row++)
+         conv_img_2_uchar(cdata + (row * stride), fdata + (row * width),
+                    rt->lenx, 1, ctx->frm_header_wsq.m_shift,
+                    ctx->frm_header_wsq.r_scale / (float)(1 << level));
+
+   /* Done with floating point pixels. */
+   codec_arena_free(arena, fdata);
+
+   if(debug > 0)
+      fprintf(stderr, "Doubleing point pixels converted to unsigned char\n\n");
+
+   return(0);
+}
+
+/***************************************************************************/
+/* Unquantizes and reconstructs the subband data in fixed point, as        */
+/* reconstruct_wsq_float does.  The quantized data is freed.               */
+/***************************************************************************/
+static int reconstruct_wsq_fixed(WSQ_CTX *ctx, unsigned char *cdata,
+                   const int stride, short *qdata, const int width, const int height,
+                   const int level)
+{
+   int ret, cnt, row;
+   int *idata;                    /* image pointers */
+   DQT_TABLE dqt_table;
+   W_TREE *rt;
+   CODEC_ARENA *arena;
+
+   dqt_table = ctx->dqt_table;
+   for(cnt = wsq_scale_subbands[level]; cnt < NUM_SUBBANDS; cnt++)
+      dqt_table.q_bin[cnt] = 0.0;
+
+   arena = wsq_ctx_arena(ctx);
+   ret = unquantize_fixed(&idata, &dqt_table, ctx->q_tree, Q_TREELEN,
+		   qdata, width, height, arena);
+   codec_arena_free(arena, qdata);
+   if(ret)
+      return(ret);
+
+   rt = &ctx->w_tree[wsq_scale_roots[level]];
+   ret = wsq_reconstruct_fixed(idata, width, height, ctx->w_tree, W_TREELEN,
+		   &ctx->dtt_table, wsq_scale_roots[level], arena);
+   if(ret){
+      codec_arena_free(arena, idata);
+      return(ret);
+   }
+
+   if(debug > 0)
+      fprintf(stderr, "WSQ fixed point reconstruction of image finished\n\n");
+
+   if(stride == width && rt->lenx == width)
+      conv_img_2_uchar_fixed(cdata, idata, rt->lenx, rt->leny,
+                    ctx->frm_header_wsq.m_shift,
+                    ctx->frm_header_wsq.r_scale / (float)(1 << level));
+   else
+      for(row = 0; row < rt->leny; row++)
+         conv_img_2_uchar_fixed(cdata + (row * stride), idata + (row * width),
+                    rt->lenx, 1, ctx->frm_header_wsq.m_shift,
+                    ctx->frm_header_wsq.r_scale / (float)(1 << level));
+   codec_arena_free(arena, idata);
+
+   return(0);
+}
+
+/***************************************************************************/
+/* WSQ Decoder routine.  Decodes a WSQ datastream from a memory buffer,    */
+/* file or descriptor set up as "stream", returning the reconstructed      */
+/* pixmap.  If "ctx" asks for it and the datastream uses the standard      */
+/* filters, the image is reconstructed in fixed point.                     */
+/***************************************************************************/
+int wsq_decode_stream_ctx(WSQ_CTX *ctx, unsigned char **odata, int *ow,
+                   int *oh, int *od, int *oppi, int *lossyflag,
+                   WSQ_STREAM *stream)
+{
+   return(wsq_decode_stream_scaled_ctx(ctx, odata, ow, oh, od, oppi,
+                                       lossyflag, stream, 0));
+}
+
+/***************************************************************************/
+/* Decodes the datastream in "stream" at the given scale level.  If        */
+/* "*odata" is NULL the pixmap is allocated and returned there; otherwise  */
+/* it is written into the "osize" byte buffer "*odata" with rows "ostride" */
+/* bytes apart, or packed if "ostride" is 0.                               */
+/***************************************************************************/
+static int decode_wsq_image(WSQ_CTX *ctx, unsigned char **odata,
+                   const int ostride, const int osize, int *ow, int *oh,
+                   int *od, int *oppi, int *lossyflag, WSQ_STREAM *stream,
+                   const int level)
+{
+   int ret;
+   int width, height, ppi;        /* image parameters */
+   int stride;                    /* bytes between output rows */
+   unsigned char *cdata;          /* image pointer */
+   short *qdata;                  /* image pointers */
+   W_TREE *rt;
+
+   if(level < 0 || level > WSQ_MAX_SCALE_LEVEL){
+      fprintf(stderr, "ERROR: decode_wsq_image : ");
+      fprintf(stderr, "scale level %d not in 0..%d\n",
+              level, WSQ_MAX_SCALE_LEVEL);
+      return(-24);
+   }
+
+   ret = decode_wsq_blocks(ctx, &qdata, &width, &height, &ppi, stream,
+                   WSQ_NUM_BLOCKS - level);
+   if(ret)
+      return(ret);
+   rt = &ctx->w_tree[wsq_scale_roots[level]];
+   stride = (ostride > 0) ? ostride : rt->lenx;
+
+   if(*odata == (unsigned char *)NULL){
+      cdata = (unsigned char *)malloc(rt->lenx * rt->leny *
+                                      sizeof(unsigned char));
+      if(cdata == (unsigned char *)NULL) {
+         codec_arena_free(wsq_ctx_arena(ctx), qdata);
+         fprintf(stderr,"ERROR: decode_wsq_image : malloc : cdata\n");
+         return(-21);
+      }
+   }
+   else{
+      if(stride < rt->lenx){
+         codec_arena_free(wsq_ctx_arena(ctx), qdata);
+         fprintf(stderr, "ERROR: decode_wsq_image : ");
+         fprintf(stderr, "row stride %d less than width %d\n",
+                 stride, rt->lenx);
+         return(-25);
+      }
+      if(osize < stride * rt->leny){
+         codec_arena_free(wsq_ctx_arena(ctx), qdata);
+         fprintf(stderr, "ERROR: decode_wsq_image : ");
+         fprintf(stderr, "buffer of %d bytes less than the %d needed\n",
+                 osize, stride * rt->leny);
+         return(-26);
+      }
+      cdata = *odata;
+   }
+
+   if(ctx->fixed && wsq_fixed_filters(&ctx->dtt_table))
+      ret = reconstruct_wsq_fixed(ctx, cdata, stride, qdata, width, height,
+                                  level);
+   else
+      ret = reconstruct_wsq_float(ctx, cdata, stride, qdata, width, height,
+                                  level);
+   if(ret){
+      if(cdata != *odata)
+         free(cdata);
+      return(ret);
+   }
+
+   /* Assign reconstructed pixmap and attributes to output pointers. */
+   *odata = cdata;
+   *ow = rt->lenx;
+   *oh = rt->leny;
+   *od = 8;
+   *oppi = (ppi > 0) ? (ppi >> level) : ppi;
+   *lossyflag = 1;
+
+   /* Return normally. */
+   return(0);
+}
+
+/***************************************************************************/
+/* Reduced resolution WSQ Decoder routine.  Decodes a WSQ datastream at    */
+/* 1/2^"level" of its width and height, rounded up, for levels up to       */
+/* WSQ_MAX_SCALE_LEVEL.  The image returned is the low pass image of the   */
+/* wavelet decomposition at that level, so only the huffman blocks coding  */
+/* it are read, and synthesis stops there.  Reading a file or descriptor   */
+/* stops after the last block needed.  Level 0 is a full decode.           */
+/***************************************************************************/
+int wsq_decode_stream_scaled_ctx(WSQ_CTX *ctx, unsigned char **odata,
+                   int *ow, int *oh, int *od, int *oppi, int *lossyflag,
+                   WSQ_STREAM *stream, const int level)
+{
+   *odata = (unsigned char *)NULL;
+   return(decode_wsq_image(ctx, odata, 0, 0, ow, oh, od, oppi, lossyflag,
+                           stream, level));
+}
+
+/***************************************************************************/
+/* WSQ Decoder routine.  Decodes a WSQ compressed memory buffer using the  */
+/* default context into a caller supplied buffer; see                     */
+/* wsq_decode_mem_into_ctx.                                                */
+/***************************************************************************/
+int wsq_decode_mem_into(unsigned char *obuf, const int ostride,
+                   const int osize, int *ow, int *oh, int *od, int *oppi,
+                   int *lossyflag, unsigned char *idata, const int ilen)
+{
+   return(wsq_decode_mem_into_ctx(&wsq_default_ctx, obuf, ostride, osize,
+                   ow, oh, od, oppi, lossyflag, idata, ilen));
+}
+
+/***************************************************************************/
+/* WSQ Decoder routine.  Decodes a WSQ compressed memory buffer straight   */
+/* into the "osize" byte buffer "obuf", which is not reallocated, with     */
+/* rows "ostride" bytes apart, or packed if "ostride" is 0.  Bytes past    */
+/* the end of each row are left untouched.  The size needed may be found  */
+/* beforehand with wsq_probe_mem.                                          */
+/***************************************************************************/
+int wsq_decode_mem_into_ctx(WSQ_CTX *ctx, unsigned char *obuf,
+                   const int ostride, const int osize, int *ow, int *oh,
+                   int *od, int *oppi, int *lossyflag, unsigned char *idata,
+                   const int ilen)
+{
+   WSQ_STREAM stream;
+
+   if(obuf == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR: wsq_decode_mem_into_ctx : NULL buffer\n");
+      return(-27);
+   }
+   init_wsq_stream_mem(&stream, idata, ilen);
+   return(decode_wsq_image(ctx, &obuf, ostride, osize, ow, oh, od, oppi,
+                           lossyflag, &stream, 0));
+}
+
+/***************************************************************************/
+/* Reads only the headers of a WSQ compressed memory buffer, returning     */
+/* the image attributes and, in "osize", the bytes a buffer passed to      */
+/* wsq_decode_mem_into with the same "ostride" must hold.  Tables are      */
+/* stepped over by their lengths and no huffman data is read.              */
+/***************************************************************************/
+int wsq_probe_mem(int *ow, int *oh, int *od, int *oppi, int *osize,
+                   const int ostride, unsigned char *idata, const int ilen)
+{
+   int ret, ppi, stride;
+   unsigned short marker, len;
+   unsigned char *cbufptr, *ebufptr;
+   FRM_HEADER_WSQ frm_header;
+
+   cbufptr = idata;
+   ebufptr = idata + ilen;
+
+   ret = getc_marker_wsq(&marker, SOI_WSQ, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   while(marker != SOF_WSQ){
+      ret = getc_ushort(&len, &cbufptr, ebufptr);
+      if(ret)
+         return(ret);
+      if(len < 2 || len - 2 > ebufptr - cbufptr){
+         fprintf(stderr, "ERROR : wsq_probe_mem : ");
+         fprintf(stderr, "table segment of length %d runs past data\n", len);
+         return(-28);
+      }
+      cbufptr += len - 2;
+      ret = getc_marker_wsq(&marker, TBLS_N_SOF, &cbufptr, ebufptr);
+      if(ret)
+         return(ret);
+   }
+
+   ret = getc_frame_header_wsq(&frm_header, &cbufptr, ebufptr);
+   if(ret)
+      return(ret);
+   ret = getc_ppi_wsq(&ppi, idata, ilen);
+   if(ret)
+      return(ret);
+
+   stride = (ostride > 0) ? ostride : frm_header.width;
+   if(stride < frm_header.width){
+      fprintf(stderr, "ERROR : wsq_probe_mem : ");
+      fprintf(stderr, "row stride %d less than width %d\n",
+              stride, frm_header.width);
+      return(-25);
+   }
+
+   *ow = frm_header.width;
+   *oh = frm_header.height;
+   *od = 8;
+   *oppi = ppi;
+   *osize = stride * frm_header.height;
+
+   return(0);
+}
+
+/***************************************************************************/
+/* Starts a row by row decode of the datastream in "stream".  The whole    */
+/* datastream is read and all synthesis but the final row pass is done     */
+/* here; wsq_read_rows then finishes and returns the rows in bands, so     */
+/* the 8 bit pixmap is never held in full.  The reconstruction is always  */
+/* done in floating point.                                                 */
+/***************************************************************************/
+int wsq_open_rows_ctx(WSQ_ROWS **orows, WSQ_CTX *ctx, WSQ_STREAM *stream,
+                   int *ow, int *oh, int *oppi)
+{
+   int ret;
+   int width, height, ppi;        /* image parameters */
+   float *fdata;                  /* image pointers */
+   short *qdata;
+   WSQ_ROWS *rows;
+
+   ret = decode_wsq_blocks(ctx, &qdata, &width, &height, &ppi, stream,
+                   WSQ_NUM_BLOCKS);
+   if(ret)
+      return(ret);
+   /* The planes outlive this call, so they are not taken from the arena. */
+   ret = unquantize_arena(&fdata, &ctx->dqt_table, ctx->q_tree, Q_TREELEN,
+		   qdata, width, height, (CODEC_ARENA *)NULL);
+   codec_arena_free(wsq_ctx_arena(ctx), qdata);
+   if(ret)
+      return(ret);
+
+   rows = (WSQ_ROWS *)calloc(1, sizeof(WSQ_ROWS));
+   if(rows == (WSQ_ROWS *)NULL){
+      codec_free(fdata);
+      fprintf(stderr,"ERROR: wsq_open_rows_ctx : calloc : rows\n");
+      return(-22);
+   }
+   rows->fdata = fdata;
+   rows->width = width;
+   rows->height = height;
+   rows->next = 0;
+   rows->m_shift = ctx->frm_header_wsq.m_shift;
+   rows->r_scale = ctx->frm_header_wsq.r_scale;
+
+   rows->fdata1 = (float *)codec_malloc(width * height * sizeof(float));
+   if(rows->fdata1 == (float *)NULL){
+      free_WSQ_ROWS(rows);
+      fprintf(stderr,"ERROR: wsq_open_rows_ctx : malloc : fdata1\n");
+      return(-23);
+   }
+
+   ret = wsq_reconstruct_levels(fdata, rows->fdata1, width,
+                   ctx->w_tree, W_TREELEN, &ctx->dtt_table,
+                   wsq_ctx_arena(ctx));
+   if(!ret)
+      ret = build_join_lets_plan(&rows->plan, width,
+                   ctx->dtt_table.hifilt, ctx->dtt_table.hisz,
+                   ctx->dtt_table.lofilt, ctx->dtt_table.losz,
+                   ctx->w_tree[0].inv_rw, (CODEC_ARENA *)NULL);
+   if(ret){
+      free_WSQ_ROWS(rows);
+      return(ret);
+   }
+
+   *orows = rows;
+   *ow = width;
+   *oh = height;
+   *oppi = ppi;
+
+   return(0);
+}
+
+/***************************************************************************/
+/* Returns up to "maxrows" more rows of 8 bit pixels in "obuf", which must */
+/* hold that many rows.  The number of rows returned is 0 once all rows    */
+/* have been read.                                                         */
+/***************************************************************************/
+int wsq_read_rows(WSQ_ROWS *rows, unsigned char *obuf, const int maxrows,
+                  int *onrows)
+{
+   int ret, nrows;
+   float *fptr;
+
+   nrows = rows->height - rows->next;
+   if(nrows > maxrows)
+      nrows = maxrows;
+   if(nrows <= 0){
+      *onrows = 0;
+      return(0);
+   }
+
+   fptr = rows->fdata + (rows->next * rows->width);
+   ret = apply_lets_plan(fptr, rows->fdata1 + (rows->next * rows->width),
+                         nrows, rows->width, 1, &rows->plan);
+   if(ret)
+      return(ret);
+   conv_img_2_uchar(obuf, fptr, rows->width, nrows,
+                    rows->m_shift, rows->r_scale);
+
+   rows->next += nrows;
+   *onrows = nrows;
+   return(0);
+}
+
+/***************************************************************************/
+void free_WSQ_ROWS(WSQ_ROWS *rows)
+{
+   if(rows == (WSQ_ROWS *)NULL)
+      return;
+   codec_free(rows->fdata);
+   if(rows->fdata1 != (float *)NULL)
+      codec_free(rows->fdata1);
+   free_LETS_PLAN(&rows->plan);
+   free(rows);
+}
+
+/***************************************************************************/
+/* Routine to decode an entire "block" of encoded data from memory buffer. */
+/***************************************************************************/
+int huffman_decode_data_mem(
+   short *ip,               /* image pointer */
+   DTT_TABLE *dtt_table,    /*transform table pointer */
+   DQT_TABLE *dqt_table,    /* quantization table */
+   DHT_TABLE *dht_table,    /* huffman table */
+   unsigned char **cbufptr, /* points to current byte in input buffer */
+   unsigned char *ebufptr)  /* points to end of input buffer */
+{
+   int ret;
+   WSQ_STREAM stream;
+
+   init_wsq_stream_mem(&stream, *cbufptr, ebufptr - *cbufptr);
+   ret = huffman_decode_data_stream(ip, dtt_table, dqt_table, dht_table,
+                                    &stream, WSQ_NUM_BLOCKS);
+   *cbufptr = stream.cptr;
+   return(ret);
+}
+
+/***************************************************************************/
+/* Routine to decode an entire "block" of encoded data from a stream.      */
+/* Coded data is buffered only as the bit reservoir needs it.  Decoding    */
+/* stops at the end of the "nblks"th block, leaving the rest unread.       */
+/***************************************************************************/
+int huffman_decode_data_stream(
+   short *ip,               /* image pointer */
+   DTT_TABLE *dtt_table,    /*transform table pointer */
+   DQT_TABLE *dqt_table,    /* quantization table */
+   DHT_TABLE *dht_table,    /* huffman table */
+   WSQ_STREAM *stream,      /* input stream */
+   const int nblks)         /* number of blocks to decode */
+{
+   int ret;
+   int blk = 0;           /* block number */
+   unsigned short marker; /* WSQ markers */
+   BITBUF_WSQ bitbuf;     /* bits read ahead from the input buffer */
+   int n;                 /* zero run count */
+   int nodeptr;           /* pointers for decoding */
+   int last_size;         /* last huffvalue */
+   unsigned char hufftable_id;    /* huffman table number */
+   HUFFCODE *hufftable;   /* huffman code structure */
+   HDEC_TABLE_WSQ hdec;   /* used in decoding data */
+   unsigned short tbits;
+
+
+   ret = getc_marker_wsq_stream(&marker, TBLS_N_SOB, stream);
+   if(ret)
+      return(ret);
+
+   bitbuf.bits = 0;
+   bitbuf.nbits = 0;
+   bitbuf.marker = 0;
+
+   while(marker != EOI_WSQ) {
+
+      if(marker != 0) {
+         if(blk == nblks)
+            break;
+         blk++;
+         while(marker != SOB_WSQ) {
+            ret = getc_table_wsq_stream(marker, dtt_table, dqt_table,
+			    dht_table, stream);
+            if(ret)
+               return(ret);
+	    ret = getc_marker_wsq_stream(&marker, TBLS_N_SOB, stream);
+            if(ret)
+               return(ret);
+         }
+	 ret = getc_block_header_stream(&hufftable_id, stream);
+         if(ret)
+            return(ret);
+
+         if((dht_table+hufftable_id)->tabdef != 1) {
+            fprintf(stderr, "ERROR : huffman_decode_data_stream : ");
+            fprintf(stderr, "huffman table {%d} undefined.\n", hufftable_id);
+            return(-51);
+         }
+
+         /* the next two routines reconstruct the huffman tables */
+	 ret = build_huffsizes(&hufftable, &last_size,
+			 (dht_table+hufftable_id)->huffbits,
+			 MAX_HUFFCOUNTS_WSQ);
+         if(ret)
+            return(ret);
+
+         build_huffcodes(hufftable);
+	 ret = check_huffcodes_wsq(hufftable, last_size);
+         if(ret)
+            fprintf(stderr, "         hufftable_id = %d\n", hufftable_id);
+
+         /* this routine builds the lookup and search tables used in */
+         /* decoding the compressed data */
+         gen_hdec_table_wsq(&hdec, hufftable, last_size,
+                            (dht_table+hufftable_id)->huffbits,
+                            (dht_table+hufftable_id)->huffvalues);
+         free(hufftable);
+         bitbuf.bits = 0;
+         bitbuf.nbits = 0;
+         bitbuf.marker = 0;
+         marker = 0;
+      }
+
+      /* Keep 32 bits in the reservoir, enough for a code and its extra */
+      /* bits, reading more of the stream only when the buffer is out.  */
+      while(bitbuf.nbits < 32 && bitbuf.marker == 0) {
+         fill_bitbuf_wsq(&bitbuf, &stream->cptr, stream->eptr);
+         if(bitbuf.nbits >= 32 || bitbuf.marker != 0 || stream->eof)
+            break;
+         ret = fill_wsq_stream(stream, (stream->eptr - stream->cptr) + 1);
+         if(ret)
+            return(ret);
+      }
+
+      /* get next huffman category code from compressed input data stream */
+      ret = getc_huffsym_wsq(&nodeptr, &hdec, &bitbuf,
+                             &stream->cptr, stream->eptr);
+      if(ret)
+         return(ret);
+
+      if(nodeptr == -1){
+         marker = bitbuf.marker;
+         continue;
+      }
+
+      if(nodeptr > 0 && nodeptr <= 100)
+         for(n = 0; n < nodeptr; n++) {
+            *ip++ = 0; /* z run */
+         }
+      else if(nodeptr > 106 && nodeptr < 0xff)
+         *ip++ = nodeptr - 180;
+      else if(nodeptr == 101){
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 8);
+         if(ret)
+            return(ret);
+         *ip++ = tbits;
+      }
+      else if(nodeptr == 102){
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 8);
+         if(ret)
+            return(ret);
+         *ip++ = -tbits;
+      }
+      else if(nodeptr == 103){
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 16);
+         if(ret)
+            return(ret);
+         *ip++ = tbits;
+      }
+      else if(nodeptr == 104){
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 16);
+         if(ret)
+            return(ret);
+         *ip++ = -tbits;
+      }
+      else if(nodeptr == 105) {
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 8);
+         if(ret)
+            return(ret);
+         n = tbits;
+         while(n--)
+            *ip++ = 0;
+      }
+      else if(nodeptr == 106) {
+         ret = getc_bitbuf_wsq(&tbits, &bitbuf, &stream->cptr,
+                               stream->eptr, 16);
+         if(ret)
+            return(ret);
+         n = tbits;
+         while(n--)
+            *ip++ = 0;
+      }
+      else {
+         fprintf(stderr, 
+                "ERROR: huffman_decode_data_stream : Invalid code %d (%x).\n",
+                nodeptr, nodeptr);
+         return(-52);
+      }
+
+   }
+
+   return(0);
+}
+
+/********************************************************************/
+/* Routine to decode an entire "block" of encoded data from a file. */
+/********************************************************************/
+int huffman_decode_data_file(
+   short *ip,             /* image pointer */
+   DTT_TABLE *dtt_table,  /*transform table pointer */
+   DQT_TABLE *dqt_table,  /* quantization table */
+   DHT_TABLE *dht_table,  /* huffman table */
+   FILE *infp)            /* input file */
+{
+   int ret;
+   int blk = 0;           /* block number */
+   unsigned short marker; /* WSQ markers */
+   int bit_count;         /* bit count for nextbits_wsq routine */
+   int n;                 /* zero run count */
+   int nodeptr;           /* pointers for decoding */
+   int last_size;         /* last huffvalue */
+   unsigned char hufftable_id;    /* huffman table number */
+   HUFFCODE *hufftable;   /* huffman code structure */
+   int maxcode[MAX_HUFFBITS+1]; /* used in decoding data */
+   int mincode[MAX_HUFFBITS+1]; /* used in decoding data */
+   int valptr[MAX_HUFFBITS+1];  /* used in decoding data */
+   unsigned short tbits;
+
+
+   ret = read_marker_wsq(&marker, TBLS_N_SOB, infp);
+   if(ret)
+      return(ret);
+
+   bit_count = 0;
+
+   while(marker != EOI_WSQ) {
+
+      if(marker != 0) {
+         blk++;
+         while(marker != SOB_WSQ) {
+            ret = read_table_wsq(marker, dtt_table,
+			    dqt_table, dht_table, infp);
+            if(ret)
+               return(ret);
+	    ret = read_marker_wsq(&marker, TBLS_N_SOB, infp);
+            if(ret)
+               return(ret);
+         }
+	 ret = read_block_header(&hufftable_id, infp);
+         if(ret)
+            return(ret);
+
+         if((dht_table+hufftable_id)->tabdef != 1) {
+            fprintf(stderr, "ERROR : huffman_decode_data_file : ");
+            fprintf(stderr, "huffman table {%d} undefined.\n", hufftable_id);
+            return(-53);
+         }
+
+         /* the next two routines reconstruct the huffman tables */
+	 ret = build_huffsizes(&hufftable, &last_size,
+			 (dht_table+hufftable_id)->huffbits,
+			 MAX_HUFFCOUNTS_WSQ);
+         if(ret)
+            return(ret);
+         build_huffcodes(hufftable);
+	 ret = check_huffcodes_wsq(hufftable, last_size);
+         if(ret)
+            fprintf(stderr, "         hufftable_id = %d\n", hufftable_id);
+
+         /* this routine builds a set of three tables used in decoding */
+         /* the compressed data*/
+         gen_decode_table(hufftable, maxcode, mincode, valptr,
+                          (dht_table+hufftable_id)->huffbits);
+         free(hufftable);
+         bit_count = 0;
+         marker = 0;
+      }
+
+      /* get next huffman category code from compressed input data stream */
+      ret = decode_data_file(&nodeptr, mincode, maxcode, valptr,
+		      (dht_table+hufftable_id)->huffvalues, infp,
+		      &bit_count, &marker);
+      if(ret)
+         return(ret);
+
+      if(nodeptr == -1)
+         continue;
+
+      if(nodeptr > 0 && nodeptr <= 100)
+         for(n = 0; n < nodeptr; n++) {
+            *ip++ = 0; /* z run */
+         }
+      else if(nodeptr == 101){
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
+         if(ret)
+            return(ret);
+         *ip++ = tbits;
+      }
+      else if(nodeptr == 102){
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
+         if(ret)
+            return(ret);
+         *ip++ = -tbits;
+      }
+      else if(nodeptr == 103){
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
+         if(ret)
+            return(ret);
+         *ip++ = tbits;
+      }
+      else if(nodeptr == 104){
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
+         if(ret)
+            return(ret);
+         *ip++ = -tbits;
+      }
+      else if(nodeptr == 105) {
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 8);
+         if(ret)
+            return(ret);
+         n = tbits;
+         while(n--)
+            *ip++ = 0;
+      }
+      else if(nodeptr == 106) {
+         ret = nextbits_wsq(&tbits, &marker, infp, &bit_count, 16);
+         if(ret)
+            return(ret);
+         n = tbits;
+         while(n--)
+            *ip++ = 0;
+      }
+      else if(nodeptr < 0xff)
+         *ip++ = nodeptr - 180;
+      else {
+         fprintf(stderr, 
+                "ERROR: huffman_decode_data_file : Invalid code %d (%x).\n",
+                nodeptr, nodeptr);
+         return(-54);
+      }
+   }
+
+   return(0);
+}
+
+/**********************************************************/
+/* Routine to decode the encoded data from memory buffer. */
+/**********************************************************/
+int decode_data_mem(
+   int *onodeptr,       /* returned huffman code category        */
+   int *mincode,        /* points to minimum code value for      */
+                        /*    a given code length                */
+   int *maxcode,        /* points to maximum code value for      */
+                        /*    a given code length                */
+   int *valptr,         /* points to first code in the huffman   */
+                        /*    code table for a given code length */
+   unsigned char *huffvalues,   /* defines order of huffman code          */
+                                /*    lengths in relation to code sizes   */
+   unsigned char **cbufptr,     /* points to current byte in input buffer */
+   unsigned char *ebufptr,      /* points to end of input buffer          */
+   int *bit_count,      /* marks the bit to receive from the input byte */
+   unsigned short *marker)
+{
+   int ret;
+   int inx, inx2;       /*increment variables*/
+   unsigned short code, tbits;  /* becomes a huffman code word
+                                   (one bit at a time)*/
+
+   ret = getc_nextbits_wsq(&code, marker, cbufptr, ebufptr, bit_count, 1);
+   if(ret)
+      return(ret);
+
+   if(*marker != 0){
+      *onodeptr = -1;
+      return(0);
+   }
+
+   for(inx = 1; (int)code > maxcode[inx]; inx++) {
+      ret = getc_nextbits_wsq(&tbits, marker, cbufptr, ebufptr, bit_count, 1);
+      if(ret)
+         return(ret);
+
+      code = (code << 1) + tbits;
+      if(*marker != 0){
+         *onodeptr = -1;
+         return(0);
+      }
+   }
+   inx2 = valptr[inx];
+   inx2 = inx2 + code - mincode[inx];
+
+   *onodeptr = huffvalues[inx2];
+   return(0);
+}
+
+/*************************************************/
+/* Routine to decode the encoded data from file. */
+/*************************************************/
+int decode_data_file(
+   int *onodeptr,       /* returned huffman code category        */
+   int *mincode,        /* points to minimum code value for      */
+                        /*    a given code length                */
+   int *maxcode,        /* points to maximum code value for      */
+                        /*    a given code length                */
+   int *valptr,         /* points to first code in the huffman   */
+                        /*    code table for a given code length */
+   unsigned char *huffvalues,   /* defines order of huffman code         */
+                        /*    lengths in relation to code sizes  */
+   FILE *infp,          /* compressed input data file            */
+   int *bit_count,      /* marks the bit to receive from the input byte */
+   unsigned short *marker)
+{
+   int ret;
+   int inx, inx2;               /*increment variables*/
+   unsigned short code, tbits;  /*becomes a huffman code word
+                                  (one bit at a time)*/
+
+   ret = nextbits_wsq(&code, marker, infp, bit_count, 1);
+   if(ret)
+      return(ret);
+
+   if(*marker != 0){
+      *onodeptr = -1;
+      return(0);
+   }
+
+   for(inx = 1; (int)code > maxcode[inx]; inx++) {
+      ret = nextbits_wsq(&tbits, marker, infp, bit_count, 1);
+      if(ret)
+         return(ret);
+
+      code = (code << 1) + tbits;
+      if(*marker != 0){
+         *onodeptr = -1;
+         return(0);
+      }
+   }
+   inx2 = valptr[inx];
+   inx2 = inx2 + code - mincode[inx];
+
+   *onodeptr = huffvalues[inx2];
+   return(0);
+}
+
+/*********************************************/
+/* Routine to get nextbit(s) of data stream. */
+/*********************************************/
+int nextbits_wsq(
+   unsigned short *obits,  /* returned bits */
+   unsigned short *marker, /* returned marker */
+   FILE *file,          /* compressed input data file */
+   int *bit_count,      /* marks the bit to receive from the input byte */
+   const int bits_req)  /* number of bits requested */
+{
+   int ret;
+   static unsigned char code;   /*next byte of data*/
+   static unsigned char code2;  /*stuffed byte of data*/
+   unsigned short bits, tbits;  /*bits of current data byte requested*/
+   int bits_needed;     /*additional bits required to finish request*/
+
+                              /*used to "mask out" n number of
+                                bits from data stream*/
+   static unsigned char bit_mask[9] = {0x00,0x01,0x03,0x07,0x0f,
+                                       0x1f,0x3f,0x7f,0xff};
+   if(*bit_count == 0) {
+      code = (unsigned char)getc(file);
+      *bit_count = 8;
+      if(code == 0xFF) {
+         code2 = (unsigned char)getc(file);
+         if(code2 != 0x00 && bits_req == 1) {
+            *marker = (code << 8) | code2;
+            *obits = 1;
+            return(0);
+         }
+         if(code2 != 0x00) {
+            fprintf(stderr, "ERROR: nextbits_wsq : No stuffed zeros\n");
+            return(-38);
+         }
+      }
+   }
+   if(bits_req <= *bit_count) {
+      bits = (code >>(*bit_count - bits_req)) & (bit_mask[bits_req]);
+      *bit_count -= bits_req;
+      code &= bit_mask[*bit_count];
+   }
+   else {
+      bits_needed = bits_req - *bit_count;
+      bits = code << bits_needed;
+      *bit_count = 0;
+      ret = nextbits_wsq(&tbits, (unsigned short *)NULL, file,
+		      bit_count, bits_needed);
+      if(ret)
+         return(ret);
+      bits |= tbits;
+   }
+
+   *obits = bits;
+   return(0);
+}
+
+/****************************************************************/
+/* Routine to get nextbit(s) of data stream from memory buffer. */
+/* No state is kept between calls: while bits of a data byte    */
+/* remain, that byte is re-read from just behind "*cbufptr".    */
+/****************************************************************/
+int getc_nextbits_wsq(
+   unsigned short *obits,       /* returned bits */
+   unsigned short *marker,      /* returned marker */
+   unsigned char **cbufptr,     /* points to current byte in input buffer */
+   unsigned char *ebufptr,      /* points to end of input buffer */
+   int *bit_count,      /* marks the bit to receive from the input byte */
+   const int bits_req)  /* number of bits requested */
+{
+   int ret;
+   unsigned char code;          /*current byte of data*/
+   unsigned char code2;         /*stuffed byte of data*/
+   unsigned short bits, tbits;  /*bits of current data byte requested*/
+   int bits_needed;     /*additional bits required to finish request*/
+
+                              /*used to "mask out" n number of
+                                bits from data stream*/
+   static const unsigned char bit_mask[9] = {0x00,0x01,0x03,0x07,0x0f,
+                                             0x1f,0x3f,0x7f,0xff};
+   if(*bit_count == 0) {
+      ret = getc_byte(&code, cbufptr, ebufptr);
+      if(ret){
+         return(ret);
+      }
+      *bit_count = 8;
+      if(code == 0xFF) {
+         ret = getc_byte(&code2, cbufptr, ebufptr);
+         if(ret){
+            return(ret);
+         }
+         if(code2 != 0x00 && bits_req == 1) {
+            *marker = (code << 8) | code2;
+            *obits = 1;
+            return(0);
+         }
+         if(code2 != 0x00) {
+            fprintf(stderr, "ERROR: getc_nextbits_wsq : No stuffed zeros\n");
+            return(-41);
+         }
+      }
+   }
+   else {
+      /* A data byte of 0xFF is always followed by a stuffed 0x00. */
+      code = *(*cbufptr - 1);
+      if(code == 0x00 && *(*cbufptr - 2) == 0xFF)
+         code = 0xFF;
+   }
+   code &= bit_mask[*bit_count];
+
+   if(bits_req <= *bit_count) {
+      bits = (code >>(*bit_count - bits_req)) & (bit_mask[bits_req]);
+      *bit_count -= bits_req;
+   }
+   else {
+      bits_needed = bits_req - *bit_count;
+      bits = code << bits_needed;
+      *bit_count = 0;
+      ret = getc_nextbits_wsq(&tbits, (unsigned short *)NULL,
+		      cbufptr, ebufptr, bit_count, bits_needed);
+      if(ret)
+         return(ret);
+      bits |= tbits;
+   }
+
+   *obits = bits;
+   return(0);
+}
+
+/*****************************************************************/
+/* Routine to build the table used by getc_huffsym_wsq.  Every   */
+/* lookahead index whose leading bits hold a complete code of    */
+/* WSQ_HUFF_LOOKAHEAD bits or less is filled with that code's    */
+/* size and value.                                               */
+/*****************************************************************/
+void gen_hdec_table_wsq(
+   HDEC_TABLE_WSQ *hdec,        /* decode table to fill */
+   HUFFCODE *hufftable,         /* huffman code sizes and codes */
+   const int last_size,         /* number of codes in hufftable */
+   unsigned char *huffbits,     /* number of codes of each size */
+   unsigned char *huffvalues)   /* values in code order */
+{
+   int i, j, size, shift, first, count;
+
+   gen_decode_table(hufftable, hdec->maxcode, hdec->mincode, hdec->valptr,
+                    huffbits);
+   hdec->huffvalues = huffvalues;
+
+   for(i = 0; i < (1 << WSQ_HUFF_LOOKAHEAD); i++)
+      hdec->look_size[i] = 0;
+
+   for(i = 0; i < last_size; i++) {
+      size = (hufftable+i)->size;
+      if(size > WSQ_HUFF_LOOKAHEAD)
+         break;
+      shift = WSQ_HUFF_LOOKAHEAD - size;
+      first = (hufftable+i)->code << shift;
+      count = 1 << shift;
+      for(j = first; j < first + count; j++) {
+         hdec->look_size[j] = (unsigned char)size;
+         hdec->look_value[j] = huffvalues[i];
+      }
+   }
+}
+
+/*****************************************************************/
+/* Routine to load bytes from a memory buffer into a bit         */
+/* reservoir until it holds more than 56 bits, the buffer is     */
+/* exhausted, or a marker is found.                              */
+/*****************************************************************/
+void fill_bitbuf_wsq(
+   BITBUF_WSQ *bitbuf,          /* bit reservoir */
+   unsigned char **cbufptr,     /* points to current byte in input buffer */
+   unsigned char *ebufptr)      /* points to end of input buffer */
+{
+   unsigned char *cptr;
+   unsigned int code;
+
+   cptr = *cbufptr;
+   while(bitbuf->nbits <= 56 && bitbuf->marker == 0 && cptr < ebufptr) {
+      code = *cptr;
+      if(code == 0xFF) {
+         if(cptr + 1 >= ebufptr)
+            break;
+         if(*(cptr+1) != 0x00) {
+            bitbuf->marker = (unsigned short)((code << 8) | *(cptr+1));
+            cptr += 2;
+            break;
+         }
+         /* Skip the stuffed zero. */
+         cptr += 2;
+      }
+      else
+         cptr++;
+      bitbuf->bits |= (unsigned long long)code << (56 - bitbuf->nbits);
+      bitbuf->nbits += 8;
+   }
+   *cbufptr = cptr;
+}
+
+/*****************************************************************/
+/* Routine to decode the next huffman code from a bit reservoir. */
+/* Returns a code category of -1 once the data ends at a marker; */
+/* any bits left in front of the marker are padding.             */
+/*****************************************************************/
+int getc_huffsym_wsq(
+   int *onodeptr,               /* returned huffman code category */
+   HDEC_TABLE_WSQ *hdec,        /* huffman decode table */
+   BITBUF_WSQ *bitbuf,          /* bit reservoir */
+   unsigned char **cbufptr,     /* points to current byte in input buffer */
+   unsigned char *ebufptr)      /* points to end of input buffer */
+{
+   int look, size, code;
+
+   if(bitbuf->nbits < MAX_HUFFBITS)
+      fill_bitbuf_wsq(bitbuf, cbufptr, ebufptr);
+
+   look = (int)(bitbuf->bits >> (64 - WSQ_HUFF_LOOKAHEAD));
+   size = hdec->look_size[look];
+   if(size != 0 && size <= bitbuf->nbits) {
+      bitbuf->bits <<= size;
+      bitbuf->nbits -= size;
+      *onodeptr = hdec->look_value[look];
+      return(0);
+   }
+
+   /* Long code, or fewer bits remain than the lookahead. */
+   for(size = 1; size <= MAX_HUFFBITS; size++) {
+      if(size > bitbuf->nbits) {
+         if(bitbuf->marker != 0) {
+            bitbuf->bits = 0;
+            bitbuf->nbits = 0;
+            *onodeptr = -1;
+            return(0);
+         }
+         fprintf(stderr, "ERROR : getc_huffsym_wsq : ");
+         fprintf(stderr, "premature end of buffer\n");
+         return(-55);
+      }
+      code = (int)(bitbuf->bits >> (64 - size));
+      if(code <= hdec->maxcode[size]) {
+         bitbuf->bits <<= size;
+         bitbuf->nbits -= size;
+         *onodeptr = hdec->huffvalues[hdec->valptr[size] + code -
+                                      hdec->mincode[size]];
+         return(0);
+      }
+   }
+
+   fprintf(stderr, "ERROR : getc_huffsym_wsq : invalid huffman code\n");
+   return(-56);
+}
+
+/*****************************************************************/
+/* Routine to get the next bits_req (at most 16) data bits from  */
+/* a bit reservoir.                                              */
+/*****************************************************************/
+int getc_bitbuf_wsq(
+   unsigned short *obits,       /* returned bits */
+   BITBUF_WSQ *bitbuf,          /* bit reservoir */
+   unsigned char **cbufptr,     /* points to current byte in input buffer */
+   unsigned char *ebufptr,      /* points to end of input buffer */
+   const int bits_req)          /* number of bits requested */
+{
+   if(bitbuf->nbits < bits_req) {
+      fill_bitbuf_wsq(bitbuf, cbufptr, ebufptr);
+      if(bitbuf->nbits < bits_req) {
+         if(bitbuf->marker != 0) {
+            fprintf(stderr, "ERROR: getc_bitbuf_wsq : No stuffed zeros\n");
+            return(-41);
+         }
+         fprintf(stderr, "ERROR : getc_bitbuf_wsq : ");
+         fprintf(stderr, "premature end of buffer\n");
+         return(-55);
+      }
+   }
+
+   *obits = (unsigned short)(bitbuf->bits >> (64 - bits_req));
+   bitbuf->bits <<= bits_req;
+   bitbuf->nbits -= bits_req;
+   return(0);
+}
@@ -12,10 +12,22 @@
       ROUTINES:
 #cat: wsq_encode_mem - WSQ encodes image data storing the compressed
 #cat:                   bytes to a memory buffer.
+#cat: wsq_encode_mem_ctx - WSQ encodes image data using the working
+#cat:                   state held in a caller supplied context.
+#cat: wsq_encode_mem_size - WSQ encodes image data to at most a given
+#cat:                   number of bytes.
+#cat: wsq_encode_mem_size_ctx - WSQ encodes image data to at most a given
+#cat:                   number of bytes using a caller supplied context.
 #cat: gen_hufftable_wsq - Generates a huffman table for a quantized
 #cat:                   data block.
+#cat: gen_hufftable_counts_wsq - Generates a huffman table from the
+#cat:                   category counts of one or more blocks.
 #cat: compress_block - Codes a quantized image using huffman tables.
 #cat:
+#cat: quantize_block - Quantizes the subbands of a block straight into
+#cat:                   huffman symbols, counting their categories.
+#cat: compress_block_syms - Codes the huffman symbols of a block.
+#cat:
 #cat: count_block - Counts the number of occurrences of each category
 #cat:                   in a huffman table.
 
@@ -23,60 +35,307 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <wsq.h>
 #include <dataio.h>
 
+/* The three huffman coded WSQ blocks of an image.  Block 1 is coded  */
+/* with table 0, blocks 2 and 3 share table 1.                        */
+typedef struct wsq_blocks {
+   QUANT_VALS *quant_vals;
+   Q_TREE *q_tree;
+   float *fdata;                 /* wavelet subbands               */
+   int width;
+   WSQ_SYMS syms[3];             /* huffman symbols of each block  */
+   int *counts[3];               /* huffman category counts        */
+   HUFFCODE *hufftable[2];
+   unsigned char *huffbits[2];
+   unsigned char *huffvalues[2];
+   unsigned char *huff_buf[3];   /* huffman encoded data           */
+   int hsize[3];
+} WSQ_BLOCKS;
+
+static int decompose_wsq_image(WSQ_CTX *, float **, float *, float *,
+                   unsigned char *, const int, const int);
+static int quantize_wsq_blocks(WSQ_CTX *, WSQ_BLOCKS *, const float,
+                   float *, const int, CODEC_ARENA *);
+static void report_wsq_blocks(WSQ_CTX *, WSQ_BLOCKS *, const int);
+static int write_wsq_blocks(WSQ_CTX *, WSQ_BLOCKS *, unsigned char **, int *,
+                   const int, const int, const int, const int, const float,
+                   const float, char *);
+static int put_wsq_header(WSQ_CTX *, const int, const int, const int,
+                   const int, const float, const float, char *,
+                   unsigned char *, const int, int *);
+static int wsq_header_size(WSQ_CTX *, int *, const int, const int,
+                   const int, const int, const float, const float, char *);
+static int wsq_bin_widths_fit(QUANT_VALS *);
+static int estimate_wsq_blocks(WSQ_BLOCKS *, int *);
+static void init_wsq_blocks(WSQ_BLOCKS *, CODEC_ARENA *);
+static int quantize_block_job(void *, const int);
+static int huffman_code_blocks_wsq(WSQ_BLOCKS *, const int, const int);
+static void free_wsq_blocks(WSQ_BLOCKS *);
+
+/* Subbands held by each huffman coded block. */
+static const int wsq_block_subbands[4] = {
+   0, STRT_SUBBAND_2, STRT_SUBBAND_3, STRT_SUBBAND_DEL };
+
 /************************************************************************/
 /*              This is an implementation based on the Crinimal         */
 /*              Justice Information Services (CJIS) document            */
 /*              "WSQ Gray-scale Fingerprint Compression                 */
 /*              Specification", Dec. 1997.                              */
 /************************************************************************/
-/* WSQ encodes/compresses an image pixmap.                              */
+/* WSQ encodes/compresses an image pixmap using the default context.    */
 /************************************************************************/
 int wsq_encode_mem(unsigned char **odata, int *olen, const float r_bitrate,
                    unsigned char *idata, const int w, const int h,
                    const int d, const int ppi, char *comment_text)
 {
-   int ret, num_pix;
+   return(wsq_encode_mem_ctx(&wsq_default_ctx, odata, olen, r_bitrate,
+                             idata, w, h, d, ppi, comment_text));
+}
+
+/************************************************************************/
+/* WSQ encodes/compresses an image pixmap.  All working state is kept   */
+/* in "ctx", so concurrent calls are safe given distinct contexts.      */
+/************************************************************************/
+int wsq_encode_mem_ctx(WSQ_CTX *ctx, unsigned char **odata, int *olen,
+                   const float r_bitrate, unsigned char *idata,
+                   const int w, const int h, const int d, const int ppi,
+                   char *comment_text)
+{
+   int ret, i;
    float *fdata;                 /* floating point pixel image  */
    float m_shift, r_scale;       /* shift/scale parameters      */
-   short *qdata;                 /* quantized image pointer     */
-   int qsize, qsize1, qsize2, qsize3;  /* quantized block sizes */
-   unsigned char *huffbits, *huffvalues; /* huffman code parameters     */
-   HUFFCODE *hufftable;          /* huffcode table              */
-   unsigned char *huff_buf;      /* huffman encoded buffer      */
-   int hsize, hsize1, hsize2, hsize3; /* Huffman coded blocks sizes */
-   unsigned char *wsq_data;      /* compressed data buffer      */
-   int wsq_alloc, wsq_len;       /* number of bytes in buffer   */
-   int block_sizes[2];
+   WSQ_BLOCKS blocks;            /* huffman coded blocks        */
+   CODEC_ARENA *block_arena;     /* memory of each block, or NULL */
+
+   ret = decompose_wsq_image(ctx, &fdata, &m_shift, &r_scale, idata, w, h);
+   if(ret)
+      return(ret);
+
+   block_arena = (CODEC_ARENA *)NULL;
+   if(ctx->use_arena){
+      block_arena = ctx->block_arena;
+      for(i = 0; i < WSQ_NUM_BLOCKS; i++)
+         reset_codec_arena(&block_arena[i]);
+   }
+   ret = quantize_wsq_blocks(ctx, &blocks, r_bitrate, fdata, w, block_arena);
+
+   /* Done with floating point wsq subband data. */
+   codec_arena_free(wsq_ctx_arena(ctx), fdata);
+   if(ret)
+      return(ret);
+
+   ret = write_wsq_blocks(ctx, &blocks, odata, olen, w, h, d, ppi,
+                          m_shift, r_scale, comment_text);
+   if(!ret)
+      report_wsq_blocks(ctx, &blocks, w * h);
+   free_wsq_blocks(&blocks);
+   return(ret);
+}
+
+/************************************************************************/
+/* WSQ encodes an image pixmap to at most "max_len" bytes using the     */
+/* default context.                                                     */
+/************************************************************************/
+int wsq_encode_mem_size(unsigned char **odata, int *olen, const int max_len,
+                   unsigned char *idata, const int w, const int h,
+                   const int d, const int ppi, char *comment_text)
+{
+   return(wsq_encode_mem_size_ctx(&wsq_default_ctx, odata, olen, max_len,
+                                  idata, w, h, d, ppi, comment_text));
+}
+
+/************************************************************************/
+/* WSQ encodes an image pixmap at the highest bitrate whose datastream  */
+/* fits in "max_len" bytes, as for a fixed storage budget.  The image   */
+/* is decomposed once.  Candidate bitrates, searched within             */
+/* WSQ_MIN_BITRATE to WSQ_MAX_BITRATE, are only quantized, and their    */
+/* coded size estimated from the symbol counts and the huffman tables   */
+/* they give; the symbols of the one chosen are then coded.  Should     */
+/* byte stuffing push that past "max_len", the search is narrowed and   */
+/* the coding repeated.  Fails if no bitrate in the range fits.         */
+/************************************************************************/
+int wsq_encode_mem_size_ctx(WSQ_CTX *ctx, unsigned char **odata, int *olen,
+                   const int max_len, unsigned char *idata,
+                   const int w, const int h, const int d, const int ppi,
+                   char *comment_text)
+{
+   int ret, iter, pass;
+   float *fdata;                 /* floating point pixel image  */
+   float m_shift, r_scale;       /* shift/scale parameters      */
+   WSQ_BLOCKS blocks, best;      /* candidate and chosen blocks */
+   QUANT_VALS best_vals;         /* quantization of "best"      */
+   float r, lo, hi, nr, prev_r;  /* candidate and bracketing bitrates */
+   int target, aim, hdr_len;     /* byte budget and size aimed for */
+   int est, prev_est, nprev;     /* estimated sizes */
+   unsigned char *wsq_data;
+   int wsq_len;
+
+   if(max_len <= 0){
+      fprintf(stderr, "ERROR : wsq_encode_mem_size_ctx : ");
+      fprintf(stderr, "invalid size limit %d\n", max_len);
+      return(-14);
+   }
+
+   ret = decompose_wsq_image(ctx, &fdata, &m_shift, &r_scale, idata, w, h);
+   if(ret)
+      return(ret);
+
+   ret = wsq_header_size(ctx, &hdr_len, w, h, d, ppi, m_shift, r_scale,
+                         comment_text);
+   if(ret){
+      codec_arena_free(wsq_ctx_arena(ctx), fdata);
+      return(ret);
+   }
+
+   target = max_len;
+   lo = WSQ_MIN_BITRATE;
+   hi = WSQ_MAX_BITRATE;
+   /* Start from the bitrate that just fills the budget. */
+   r = 8.0 * (float)target / (float)(w * h);
+   for(pass = 0; pass < WSQ_SIZE_PASSES; pass++){
+      init_wsq_blocks(&best, (CODEC_ARENA *)NULL);
+      /* Aim inside the tolerance so the search can stop there. */
+      aim = target - (int)(target * WSQ_SIZE_TOLERANCE / 2.0);
+      nprev = 0;
+      for(iter = 0; iter < WSQ_SIZE_ITERS; iter++){
+         if(iter == WSQ_SIZE_ITERS - 1 && best.counts[0] == (int *)NULL)
+            r = lo;
+         else if(r <= lo || r >= hi)
+            r = (lo + hi) / 2.0;
+         ret = quantize_wsq_blocks(ctx, &blocks, r, fdata, w,
+                                   (CODEC_ARENA *)NULL);
+         if(!ret && (ret = estimate_wsq_blocks(&blocks, &est)))
+            free_wsq_blocks(&blocks);
+         if(ret){
+            free_wsq_blocks(&best);
+            codec_arena_free(wsq_ctx_arena(ctx), fdata);
+            return(ret);
+         }
+         est += hdr_len;
+
+         if(debug > 0)
+            fprintf(stderr, "r = %.4f :: estimated complen = %d\n", r, est);
+
+         /* Bin widths too wide for the table need a higher bitrate. */
+         if(!wsq_bin_widths_fit(&ctx->quant_vals)){
+            free_wsq_blocks(&blocks);
+            lo = r;
+            continue;
+         }
+         if(est > target){
+            free_wsq_blocks(&blocks);
+            hi = r;
+         }
+         else{
+            /* Each fitting candidate has a higher bitrate than the last. */
+            free_wsq_blocks(&best);
+            best = blocks;
+            best_vals = ctx->quant_vals;
+            lo = r;
+            if(est >= target - (int)(target * WSQ_SIZE_TOLERANCE))
+               break;
+         }
+
+         /* Coded size is close to linear in the bitrate, so step to */
+         /* where the line through the last two candidates meets the */
+         /* aim, or scale the first by it.                           */
+         if(nprev && est != prev_est)
+            nr = r + ((float)(aim - est) * (r - prev_r) /
+                      (float)(est - prev_est));
+         else
+            nr = r * (float)aim / (float)est;
+         prev_r = r;
+         prev_est = est;
+         nprev = 1;
+         r = nr;
+      }
+
+      if(best.counts[0] == (int *)NULL){
+         fprintf(stderr, "ERROR : wsq_encode_mem_size_ctx : ");
+         fprintf(stderr, "no bitrate fits %d bytes\n", max_len);
+         codec_arena_free(wsq_ctx_arena(ctx), fdata);
+         return(-15);
+      }
+
+      ctx->quant_vals = best_vals;
+      ret = write_wsq_blocks(ctx, &best, &wsq_data, &wsq_len, w, h, d, ppi,
+                             m_shift, r_scale, comment_text);
+      if(!ret && wsq_len <= max_len)
+         report_wsq_blocks(ctx, &best, w * h);
+      free_wsq_blocks(&best);
+      if(ret){
+         codec_arena_free(wsq_ctx_arena(ctx), fdata);
+         return(ret);
+      }
+      if(wsq_len <= max_len){
+         codec_arena_free(wsq_ctx_arena(ctx), fdata);
+         *odata = wsq_data;
+         *olen = wsq_len;
+         return(0);
+      }
+
+      /* Aim lower by what the estimate missed, below the bitrate */
+      /* just coded.                                              */
+      free(wsq_data);
+      target -= wsq_len - max_len;
+      hi = best_vals.r;
+      lo = WSQ_MIN_BITRATE;
+      r = hi * (float)target / (float)max_len;
+   }
+
+   codec_arena_free(wsq_ctx_arena(ctx), fdata);
+   fprintf(stderr, "ERROR : wsq_encode_mem_size_ctx : ");
+   fprintf(stderr, "coded size did not converge on %d bytes\n", max_len);
+   return(-16);
+}
+
+/************************************************************************/
+/* Converts an image to floating point, builds its trees, decomposes    */
+/* it, and computes the subband variances into "ctx".                   */
+/************************************************************************/
+static int decompose_wsq_image(WSQ_CTX *ctx, float **ofdata, float *om_shift,
+                   float *or_scale, unsigned char *idata,
+                   const int w, const int h)
+{
+   int ret, num_pix;
+   float *fdata;                 /* floating point pixel image  */
+   CODEC_ARENA *arena;           /* memory for "fdata", if any  */
 
    /* Compute the total number of pixels in image. */
    num_pix = w * h;
 
+   /* Working memory of any previous image is no longer in use. */
+   arena = wsq_ctx_arena(ctx);
+   reset_codec_arena(arena);
+
    /* Allocate floating point pixmap. */
-   if((fdata = (float *) malloc(num_pix*sizeof(float))) == NULL) {
+   if((fdata = (float *) codec_arena_alloc(arena,
+                                    num_pix*sizeof(float))) == NULL) {
       fprintf(stderr,"ERROR : wsq_encode_1 : malloc : fdata\n");
       return(-10);
    }
 
    /* Convert image pixels to floating point. */
-   conv_img_2_flt(fdata, &m_shift, &r_scale, idata, num_pix);
+   conv_img_2_flt(fdata, om_shift, or_scale, idata, num_pix);
 
    if(debug > 0)
       fprintf(stderr, "Input image pixels converted to floating point\n\n");
 
    /* Build WSQ decomposition trees */
-   build_wsq_trees(w_tree, W_TREELEN, q_tree, Q_TREELEN, w, h);
+   get_wsq_trees(ctx->w_tree, W_TREELEN, ctx->q_tree, Q_TREELEN, w, h);
 
    if(debug > 0)
       fprintf(stderr, "Tables for wavelet decomposition finished\n\n");
 
    /* WSQ decompose the image */
-   ret = wsq_decompose(fdata, w, h, w_tree, W_TREELEN, hifilt,
-		   MAX_HIFILT, lofilt, MAX_LOFILT);
+   ret = wsq_decompose_mt(fdata, w, h, ctx->w_tree, W_TREELEN, hifilt,
+		   MAX_HIFILT, lofilt, MAX_LOFILT, ctx->nthreads, arena);
    if(ret){
-      free(fdata);
+      codec_arena_free(arena, fdata);
       return(ret);
    }
 
@@ -84,34 +343,100 @@ int wsq_encode_mem(unsigned char **odata, int *olen, const float r_bitrate,
       fprintf(stderr, "WSQ decomposition of image finished\n\n");
 
    /* Set compression ratio and 'q' to zero. */
-   quant_vals.cr = 0;
-   quant_vals.q = 0.0;
-   /* Assign specified r-bitrate into quantization structure. */
-   quant_vals.r = r_bitrate;
+   ctx->quant_vals.cr = 0;
+   ctx->quant_vals.q = 0.0;
    /* Compute subband variances. */
-   variance(&quant_vals, q_tree, Q_TREELEN, fdata, w, h);
+   variance_mt(&ctx->quant_vals, ctx->q_tree, Q_TREELEN, fdata, w, h,
+               ctx->nthreads);
 
    if(debug > 0)
       fprintf(stderr, "Subband variances computed\n\n");
 
-   /* Quantize the floating point pixmap. */
-   ret = quantize(&qdata, &qsize, &quant_vals, q_tree, Q_TREELEN, fdata, w, h);
+   *ofdata = fdata;
+   return(0);
+}
+
+/************************************************************************/
+/* Sets the bin widths for "r_bitrate" and quantizes the decomposed     */
+/* image straight into the huffman symbols of the three blocks,         */
+/* counting them on the way.  Given "arenas", each block takes its      */
+/* memory from its own arena.                                           */
+/************************************************************************/
+static int quantize_wsq_blocks(WSQ_CTX *ctx, WSQ_BLOCKS *blocks,
+                   const float r_bitrate, float *fdata, const int w,
+                   CODEC_ARENA *arenas)
+{
+   int ret;
+
+   /* Assign specified r-bitrate into quantization structure. */
+   ctx->quant_vals.r = r_bitrate;
+   quant_bin_widths(&ctx->quant_vals);
+
+   init_wsq_blocks(blocks, arenas);
+   blocks->quant_vals = &ctx->quant_vals;
+   blocks->q_tree = ctx->q_tree;
+   blocks->fdata = fdata;
+   blocks->width = w;
+   ret = wsq_run_jobs(ctx->nthreads, 3, quantize_block_job, blocks);
    if(ret){
-      free(fdata);
+      free_wsq_blocks(blocks);
       return(ret);
    }
 
-   /* Done with floating point wsq subband data. */
-   free(fdata);
-
    if(debug > 0)
       fprintf(stderr, "WSQ subband decomposition data quantized\n\n");
 
+   return(0);
+}
+
+/************************************************************************/
+/* Reports the zero bin widths and the coded block sizes of the blocks  */
+/* finally written, once per encoded image.                             */
+/************************************************************************/
+static void report_wsq_blocks(WSQ_CTX *ctx, WSQ_BLOCKS *blocks,
+                              const int num_pix)
+{
+   int i, hsize;
+
+   if(debug < 0)
+      return;
+
+   for(i = 0; i < NUM_SUBBANDS; i++)
+      if(ctx->quant_vals.qbss[i] == 0.0)
+         fprintf(stderr, "%d -> %3.6f\n", i, ctx->quant_vals.qbss[i]);
+
+   hsize = blocks->hsize[0] + blocks->hsize[1] + blocks->hsize[2];
+   fprintf(stderr, "hsize1 = %d :: hsize2 = %d :: hsize3 = %d\n",
+           blocks->hsize[0], blocks->hsize[1], blocks->hsize[2]);
+   fprintf(stderr,"@ r = %.3f :: complen = %d :: ratio = %.1f\n",
+           ctx->quant_vals.r, hsize, (float)(num_pix)/(float)hsize);
+}
+
+/************************************************************************/
+/* Writes the datastream of the quantized blocks, huffman coding them.  */
+/* The quantization in "ctx" must be the one the blocks were made with. */
+/************************************************************************/
+static int write_wsq_blocks(WSQ_CTX *ctx, WSQ_BLOCKS *blocks,
+                   unsigned char **odata, int *olen,
+                   const int w, const int h, const int d, const int ppi,
+                   const float m_shift, const float r_scale,
+                   char *comment_text)
+{
+   int ret, num_pix;
+   int qsize1, qsize2, qsize3;   /* quantized block sizes       */
+   unsigned char *wsq_data;      /* compressed data buffer      */
+   int wsq_alloc, wsq_len;       /* number of bytes in buffer   */
+   int i;
+
+   num_pix = w * h;
+
    /* Compute quantized WSQ subband block sizes */
-   quant_block_sizes(&qsize1, &qsize2, &qsize3, &quant_vals,
-                           w_tree, W_TREELEN, q_tree, Q_TREELEN);
+   quant_block_sizes(&qsize1, &qsize2, &qsize3, &ctx->quant_vals,
+                     ctx->w_tree, W_TREELEN, ctx->q_tree, Q_TREELEN);
 
-   if(qsize != qsize1+qsize2+qsize3){
+   if(blocks->syms[0].ncoeffs != qsize1 ||
+      blocks->syms[1].ncoeffs != qsize2 ||
+      blocks->syms[2].ncoeffs != qsize3){
       fprintf(stderr,
               "ERROR : wsq_encode_1 : problem w/quantization block sizes\n");
       return(-11);
@@ -124,271 +449,337 @@ int wsq_encode_mem(unsigned char **odata, int *olen, const float r_bitrate,
    /* image data.                                                 */
    wsq_data = (unsigned char *)malloc(num_pix);
    if(wsq_data == (unsigned char *)NULL){
-      free(qdata);
       fprintf(stderr, "ERROR : wsq_encode_1 : malloc : wsq_data\n");
       return(-12);
    }
    wsq_alloc = num_pix;
    wsq_len = 0;
 
-   /* Add a Start Of Image (SOI) marker to the WSQ buffer. */
-   ret = putc_ushort(SOI_WSQ, wsq_data, wsq_alloc, &wsq_len);
+   /* Store the SOI marker, comments, tables and frame header. */
+   ret = put_wsq_header(ctx, w, h, d, ppi, m_shift, r_scale, comment_text,
+                        wsq_data, wsq_alloc, &wsq_len);
    if(ret){
-      free(qdata);
       free(wsq_data);
       return(ret);
    }
 
-   ret = putc_nistcom_wsq(comment_text, w, h, d, ppi, 1 /* lossy */,
-		   r_bitrate, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      return(ret);
-   }
+   if(debug > 0)
+      fprintf(stderr, "SOI, tables, and frame header written\n\n");
 
-   /* Store the Wavelet filter taps to the WSQ buffer. */
-   ret = putc_transform_table(lofilt, MAX_LOFILT, hifilt,
-		   MAX_HIFILT, wsq_data, wsq_alloc, &wsq_len);
+   /* Build tables for and huffman code the three blocks. */
+   ret = huffman_code_blocks_wsq(blocks, num_pix, ctx->nthreads);
    if(ret){
-      free(qdata);
       free(wsq_data);
       return(ret);
    }
 
-   /* Store the quantization parameters to the WSQ buffer. */
-   ret = putc_quantization_table(&quant_vals, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      return(ret);
-   }
+   if(debug > 0)
+      fprintf(stderr, "Huffman code Tables generated and blocks compressed\n\n");
+
+   for(i = 0; i < 3; i++){
+      /* Store the Huffman table ahead of the first block using it. */
+      if(i < 2){
+         ret = putc_huffman_table(DHT_WSQ, i, blocks->huffbits[i],
+                  blocks->huffvalues[i], wsq_data, wsq_alloc, &wsq_len);
+         if(ret){
+            free(wsq_data);
+            return(ret);
+         }
+      }
 
-   /* Store a frame header to the WSQ buffer. */
-   ret = putc_frame_header_wsq(w, h, m_shift, r_scale, wsq_data,
-		   wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      return(ret);
-   }
+      /* Store the block's header to WSQ buffer. */
+      ret = putc_block_header(i ? 1 : 0, wsq_data, wsq_alloc, &wsq_len);
+      if(ret){
+         free(wsq_data);
+         return(ret);
+      }
 
-   if(debug > 0)
-      fprintf(stderr, "SOI, tables, and frame header written\n\n");
+      /* Store the block's compressed data to WSQ buffer. */
+      ret = putc_bytes(blocks->huff_buf[i], blocks->hsize[i],
+                       wsq_data, wsq_alloc, &wsq_len);
+      if(ret){
+         free(wsq_data);
+         return(ret);
+      }
 
-   /* Allocate a temporary buffer for holding compressed block data.    */
-   /* This buffer is allocated to the size of the original input image, */
-   /* and it is "assumed" that the compressed blocks will not exceed    */
-   /* this buffer size.                                                 */
-   huff_buf = (unsigned char *)malloc(num_pix);
-   if(huff_buf == (unsigned char *)NULL) {
-      free(qdata);
-      free(wsq_data);
-      fprintf(stderr, "ERROR : wsq_encode_1 : malloc : huff_buf\n");
-      return(-13);
+      if(debug > 0)
+         fprintf(stderr, "Block %d written\n\n", i+1);
    }
 
-   /******************/
-   /* ENCODE Block 1 */
-   /******************/
-   /* Compute Huffman table for Block 1. */
-   ret = gen_hufftable_wsq(&hufftable, &huffbits, &huffvalues,
-		   qdata, &qsize1, 1);
+   /* Add a End Of Image (EOI) marker to the WSQ buffer. */
+   ret = putc_ushort(EOI_WSQ, wsq_data, wsq_alloc, &wsq_len);
    if(ret){
-      free(qdata);
       free(wsq_data);
-      free(huff_buf);
       return(ret);
    }
 
-   /* Store Huffman table for Block 1 to WSQ buffer. */
-   ret = putc_huffman_table(DHT_WSQ, 0, huffbits, huffvalues,
-		   wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(huffbits);
-      free(huffvalues);
-      free(hufftable);
-      return(ret);
-   }
-   free(huffbits);
-   free(huffvalues);
+   *odata = wsq_data;
+   *olen = wsq_len;
 
-   if(debug > 0)
-      fprintf(stderr, "Huffman code Table 1 generated and written\n\n");
+   /* Return normally. */
+   return(0);
+}
 
-   /* Compress Block 1 data. */
-   ret = compress_block(huff_buf, &hsize1, qdata, qsize1,
-		   MAX_HUFFCOEFF, MAX_HUFFZRUN, hufftable);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(hufftable);
-      return(ret);
-   }
-   /* Done with current Huffman table. */
-   free(hufftable);
+/************************************************************************/
+/* Stores the SOI marker, comments, transform and quantization tables,  */
+/* and frame header that precede the coded blocks.                      */
+/************************************************************************/
+static int put_wsq_header(WSQ_CTX *ctx, const int w, const int h,
+                   const int d, const int ppi, const float m_shift,
+                   const float r_scale, char *comment_text,
+                   unsigned char *wsq_data, const int wsq_alloc,
+                   int *wsq_len)
+{
+   int ret;
 
-   /* Accumulate number of bytes compressed. */
-   hsize = hsize1;
+   /* Add a Start Of Image (SOI) marker to the WSQ buffer. */
+   ret = putc_ushort(SOI_WSQ, wsq_data, wsq_alloc, wsq_len);
+   if(ret)
+      return(ret);
 
-   /* Store Block 1's header to WSQ buffer. */
-   ret = putc_block_header(0, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
+   ret = putc_nistcom_wsq(comment_text, w, h, d, ppi, 1 /* lossy */,
+		   ctx->quant_vals.r, wsq_data, wsq_alloc, wsq_len);
+   if(ret)
       return(ret);
-   }
 
-   /* Store Block 1's compressed data to WSQ buffer. */
-   ret = putc_bytes(huff_buf, hsize1, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
+   /* Store the Wavelet filter taps to the WSQ buffer. */
+   ret = putc_transform_table(lofilt, MAX_LOFILT, hifilt,
+		   MAX_HIFILT, wsq_data, wsq_alloc, wsq_len);
+   if(ret)
       return(ret);
-   }
 
-   if(debug > 0)
-      fprintf(stderr, "Block 1 compressed and written\n\n");
-
-   /******************/
-   /* ENCODE Block 2 */
-   /******************/
-   /* Compute  Huffman table for Blocks 2 & 3. */
-   block_sizes[0] = qsize2;
-   block_sizes[1] = qsize3;
-   ret = gen_hufftable_wsq(&hufftable, &huffbits, &huffvalues,
-		   qdata+qsize1, block_sizes, 2);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
+   /* Store the quantization parameters to the WSQ buffer. */
+   ret = putc_quantization_table(&ctx->quant_vals, wsq_data, wsq_alloc,
+                                 wsq_len);
+   if(ret)
       return(ret);
+
+   /* Store a frame header to the WSQ buffer. */
+   return(putc_frame_header_wsq(w, h, m_shift, r_scale, wsq_data,
+		   wsq_alloc, wsq_len));
+}
+
+/************************************************************************/
+/* Gets the number of bytes of a datastream besides the coded data of   */
+/* its blocks and its huffman tables: the header, the block headers and */
+/* the EOI marker.  None of these change in size with the bitrate.      */
+/************************************************************************/
+static int wsq_header_size(WSQ_CTX *ctx, int *osize, const int w,
+                   const int h, const int d, const int ppi,
+                   const float m_shift, const float r_scale,
+                   char *comment_text)
+{
+   int ret, alloc, len;
+   unsigned char *buf;
+
+   alloc = WSQ_HEADER_ALLOC;
+   if(comment_text != (char *)NULL)
+      alloc += 2 * strlen(comment_text);
+   buf = (unsigned char *)malloc(alloc);
+   if(buf == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : wsq_header_size : malloc : buf\n");
+      return(-17);
    }
 
-   /* Store Huffman table for Blocks 2 & 3 to WSQ buffer. */
-   ret = putc_huffman_table(DHT_WSQ, 1, huffbits, huffvalues, wsq_data,
-		   wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(huffbits);
-      free(huffvalues);
-      free(hufftable);
+   /* Any bitrate gives bin widths the quantization table can hold. */
+   ctx->quant_vals.r = WSQ_MAX_BITRATE;
+   quant_bin_widths(&ctx->quant_vals);
+   len = 0;
+   ret = put_wsq_header(ctx, w, h, d, ppi, m_shift, r_scale, comment_text,
+                        buf, alloc, &len);
+   free(buf);
+   if(ret)
       return(ret);
-   }
-   free(huffbits);
-   free(huffvalues);
 
-   if(debug > 0)
-      fprintf(stderr, "Huffman code Table 2 generated and written\n\n");
+   /* Three block headers and the EOI marker. */
+   *osize = len + (3 * 5) + 2;
+   return(0);
+}
 
-   /* Compress Block 2 data. */
-   ret = compress_block(huff_buf, &hsize2, qdata+qsize1, qsize2,
-		   MAX_HUFFCOEFF, MAX_HUFFZRUN, hufftable);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(hufftable);
-      return(ret);
-   }
+/************************************************************************/
+/* Tells if the quantization table can store the current bin widths.    */
+/************************************************************************/
+static int wsq_bin_widths_fit(QUANT_VALS *quant_vals)
+{
+   int cnt;
 
-   /* Accumulate number of bytes compressed. */
-   hsize += hsize2;
+   for(cnt = 0; cnt < NUM_SUBBANDS; cnt++)
+      if(quant_vals->qbss[cnt] >= 65535.0 || quant_vals->qzbs[cnt] >= 65535.0)
+         return(0);
+   return(1);
+}
 
-   /* Store Block 2's header to WSQ buffer. */
-   ret = putc_block_header(1, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(hufftable);
-      return(ret);
-   }
+/************************************************************************/
+/* Estimates the bytes the three quantized blocks will code to,         */
+/* including their huffman tables, from their symbol counts.  The code  */
+/* lengths are those of the tables the counts give, so only the stuffed */
+/* zero bytes, taken as one in 256, are guessed.  The counts are kept.  */
+/************************************************************************/
+static int estimate_wsq_blocks(WSQ_BLOCKS *blocks, int *oest)
+{
+   int ret, i, j, blk, nvals;
+   int counts[MAX_HUFFCOUNTS_WSQ+1];
+   HUFFCODE *hufftable;
+   unsigned char *huffbits, *huffvalues;
+   double bits;
+   int est;
+
+   est = 0;
+   for(i = 0; i < 2; i++){
+      /* Table generation consumes the counts, so use a copy.  */
+      /* Blocks 2 & 3 share a table, as in huffman_code_blocks_wsq. */
+      memcpy(counts, blocks->counts[i], sizeof(counts));
+      if(i == 1)
+         for(j = 0; j < MAX_HUFFCOUNTS_WSQ; j++)
+            counts[j] += blocks->counts[2][j];
+      ret = gen_hufftable_counts_wsq(&hufftable, &huffbits, &huffvalues,
+                                     counts);
+      if(ret)
+         return(ret);
 
-   /* Store Block 2's compressed data to WSQ buffer. */
-   ret = putc_bytes(huff_buf, hsize2, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
-      free(hufftable);
-      return(ret);
-   }
+      /* DHT marker, length, table id, code counts and values. */
+      nvals = 0;
+      for(j = 0; j < MAX_HUFFBITS; j++)
+         nvals += huffbits[j];
+      est += 2 + 2 + 1 + MAX_HUFFBITS + nvals;
+
+      for(blk = i; blk < (i ? 3 : 1); blk++){
+         bits = 0.0;
+         for(j = 0; j < MAX_HUFFCOUNTS_WSQ; j++){
+            if(blocks->counts[blk][j] == 0)
+               continue;
+            bits += (double)blocks->counts[blk][j] * hufftable[j].size;
+            if(j == 101 || j == 102 || j == 105)
+               bits += 8.0 * blocks->counts[blk][j];
+            else if(j == 103 || j == 104 || j == 106)
+               bits += 16.0 * blocks->counts[blk][j];
+         }
+         bits = ceil(bits / 8.0);
+         est += (int)(bits + (bits / 256.0));
+      }
 
-   if(debug > 0)
-      fprintf(stderr, "Block 2 compressed and written\n\n");
-
-   /******************/
-   /* ENCODE Block 3 */
-   /******************/
-   /* Compress Block 3 data. */
-   ret = compress_block(huff_buf, &hsize3, qdata+qsize1+qsize2, qsize3,
-		   MAX_HUFFCOEFF, MAX_HUFFZRUN, hufftable);
-   if(ret){
-      free(qdata);
-      free(wsq_data);
-      free(huff_buf);
       free(hufftable);
-      return(ret);
+      free(huffbits);
+      free(huffvalues);
    }
-   /* Done with current Huffman table. */
-   free(hufftable);
 
-   /* Done with quantized image buffer. */
-   free(qdata);
+   *oest = est;
+   return(0);
+}
 
-   /* Accumulate number of bytes compressed. */
-   hsize += hsize3;
+/************************************************************************/
+/* Quantizes and counts the huffman symbols of one block.               */
+/************************************************************************/
+static int quantize_block_job(void *arg, const int blk)
+{
+   WSQ_BLOCKS *blocks = (WSQ_BLOCKS *)arg;
 
-   /* Store Block 3's header to WSQ buffer. */
-   ret = putc_block_header(1, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(wsq_data);
-      free(huff_buf);
-      return(ret);
-   }
+   return(quantize_block(&blocks->syms[blk], &blocks->counts[blk],
+                         MAX_HUFFCOUNTS_WSQ, blocks->quant_vals,
+                         blocks->q_tree, wsq_block_subbands[blk],
+                         wsq_block_subbands[blk + 1], blocks->fdata,
+                         blocks->width, MAX_HUFFCOEFF, MAX_HUFFZRUN));
+}
 
-   /* Store Block 3's compressed data to WSQ buffer. */
-   ret = putc_bytes(huff_buf, hsize3, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(wsq_data);
-      free(huff_buf);
-      return(ret);
+/************************************************************************/
+/* Huffman codes one block with its table.                              */
+/************************************************************************/
+static int compress_block_job(void *arg, const int blk)
+{
+   WSQ_BLOCKS *blocks = (WSQ_BLOCKS *)arg;
+
+   return(compress_block_syms(blocks->huff_buf[blk], &blocks->hsize[blk],
+                              &blocks->syms[blk],
+                              blocks->hufftable[blk ? 1 : 0]));
+}
+
+/************************************************************************/
+/* Clears the symbols, counts, tables, and buffers of the blocks.  The  */
+/* memory of block i is later taken from arenas[i], or from the codec   */
+/* allocator when "arenas" is NULL.                                     */
+/************************************************************************/
+static void init_wsq_blocks(WSQ_BLOCKS *blocks, CODEC_ARENA *arenas)
+{
+   int i;
+
+   for(i = 0; i < 3; i++){
+      blocks->syms[i].syms = (unsigned char *)NULL;
+      blocks->syms[i].nsyms = 0;
+      blocks->syms[i].alloc = 0;
+      blocks->syms[i].ncoeffs = 0;
+      blocks->syms[i].arena = (arenas == (CODEC_ARENA *)NULL) ?
+                              (CODEC_ARENA *)NULL : &arenas[i];
+      blocks->counts[i] = (int *)NULL;
+      blocks->huff_buf[i] = (unsigned char *)NULL;
+      blocks->hsize[i] = 0;
+   }
+   for(i = 0; i < 2; i++){
+      blocks->hufftable[i] = (HUFFCODE *)NULL;
+      blocks->huffbits[i] = (unsigned char *)NULL;
+      blocks->huffvalues[i] = (unsigned char *)NULL;
    }
+}
 
-   if(debug > 0)
-      fprintf(stderr, "Block 3 compressed and written\n\n");
+/************************************************************************/
+/* Generates the two huffman tables and codes the three blocks from     */
+/* their symbols and counts.  The blocks are coded in parallel on up    */
+/* to "nthreads" threads, each into its own buffer, and give the same   */
+/* bytes as coding them one after another.  Each buffer is the size of  */
+/* the original image, as the compressed blocks are "assumed" to fit.   */
+/************************************************************************/
+static int huffman_code_blocks_wsq(WSQ_BLOCKS *blocks, const int num_pix,
+                                   const int nthreads)
+{
+   int ret, i, j;
 
-   /* Done with huffman compressing blocks, so done with buffer. */
-   free(huff_buf);
+   /* Blocks 2 & 3 share a table built from their combined counts. */
+   for(j = 0; j < MAX_HUFFCOUNTS_WSQ; j++)
+      blocks->counts[1][j] += blocks->counts[2][j];
 
-   /* Add a End Of Image (EOI) marker to the WSQ buffer. */
-   ret = putc_ushort(EOI_WSQ, wsq_data, wsq_alloc, &wsq_len);
-   if(ret){
-      free(wsq_data);
-      return(ret);
+   for(i = 0; i < 2; i++){
+      ret = gen_hufftable_counts_wsq(&blocks->hufftable[i],
+                     &blocks->huffbits[i], &blocks->huffvalues[i],
+                     blocks->counts[i]);
+      if(ret)
+         return(ret);
    }
 
-   if(debug >= 0) {
-      fprintf(stderr,
-              "hsize1 = %d :: hsize2 = %d :: hsize3 = %d\n", hsize1, hsize2, hsize3);
-      fprintf(stderr,"@ r = %.3f :: complen = %d :: ratio = %.1f\n",
-              r_bitrate, hsize, (float)(num_pix)/(float)hsize);
+   for(i = 0; i < 3; i++){
+      blocks->huff_buf[i] = (unsigned char *)
+                            codec_arena_alloc(blocks->syms[i].arena, num_pix);
+      if(blocks->huff_buf[i] == (unsigned char *)NULL){
+         fprintf(stderr,
+                 "ERROR : huffman_code_blocks_wsq : malloc : huff_buf\n");
+         return(-13);
+      }
    }
 
-   *odata = wsq_data;
-   *olen = wsq_len;
+   return(wsq_run_jobs(nthreads, 3, compress_block_job, blocks));
+}
 
-   /* Return normally. */
-   return(0);
+/************************************************************************/
+/* Deallocates the counts, tables, and buffers of the coded blocks.     */
+/************************************************************************/
+static void free_wsq_blocks(WSQ_BLOCKS *blocks)
+{
+   int i;
+
+   for(i = 0; i < 3; i++){
+      if(blocks->syms[i].syms != (unsigned char *)NULL)
+         codec_arena_free(blocks->syms[i].arena, blocks->syms[i].syms);
+      if(blocks->counts[i] != (int *)NULL)
+         codec_arena_free(blocks->syms[i].arena, blocks->counts[i]);
+      if(blocks->huff_buf[i] != (unsigned char *)NULL)
+         codec_arena_free(blocks->syms[i].arena, blocks->huff_buf[i]);
+   }
+   for(i = 0; i < 2; i++){
+      if(blocks->hufftable[i] != (HUFFCODE *)NULL)
+         free(blocks->hufftable[i]);
+      if(blocks->huffbits[i] != (unsigned char *)NULL)
+         free(blocks->huffbits[i]);
+      if(blocks->huffvalues[i] != (unsigned char *)NULL)
+         free(blocks->huffvalues[i]);
+   }
 }
 
 /*************************************************************/
@@ -400,14 +791,8 @@ int gen_hufftable_wsq(HUFFCODE **ohufftable, unsigned char **ohuffbits,
 {
    int i, j;
    int ret;
-   int adjust;          /* tells if codesize is greater than MAX_HUFFBITS */
-   int *codesize;       /* code sizes to use */
-   int last_size;       /* last huffvalue */
-   unsigned char *huffbits;     /* huffbits values */
-   unsigned char *huffvalues;   /* huffvalues */
    int *huffcounts;     /* counts for each huffman category */
    int *huffcounts2;    /* counts for each huffman category */
-   HUFFCODE *hufftable1, *hufftable2;  /* hufftables */
 
    ret = count_block(&huffcounts, MAX_HUFFCOUNTS_WSQ, sip,
 		   block_sizes[0], MAX_HUFFCOEFF, MAX_HUFFZRUN);
@@ -427,12 +812,30 @@ int gen_hufftable_wsq(HUFFCODE **ohufftable, unsigned char **ohuffbits,
       free(huffcounts2);
    }
 
+   ret = gen_hufftable_counts_wsq(ohufftable, ohuffbits, ohuffvalues,
+                                  huffcounts);
+   free(huffcounts);
+   return(ret);
+}
+
+/*************************************************************/
+/* Generate a Huffman code table from the category counts    */
+/* gathered by count_block.                                  */
+/*************************************************************/
+int gen_hufftable_counts_wsq(HUFFCODE **ohufftable, unsigned char **ohuffbits,
+               unsigned char **ohuffvalues, int *huffcounts)
+{
+   int ret;
+   int adjust;          /* tells if codesize is greater than MAX_HUFFBITS */
+   int *codesize;       /* code sizes to use */
+   int last_size;       /* last huffvalue */
+   unsigned char *huffbits;     /* huffbits values */
+   unsigned char *huffvalues;   /* huffvalues */
+   HUFFCODE *hufftable1, *hufftable2;  /* hufftables */
+
    ret = find_huff_sizes(&codesize, huffcounts, MAX_HUFFCOUNTS_WSQ);
-   if(ret){
-      free(huffcounts);
+   if(ret)
       return(ret);
-   }
-   free(huffcounts);
 
    ret = find_num_huff_sizes(&huffbits, &adjust, codesize, MAX_HUFFCOUNTS_WSQ);
    if(ret){
@@ -806,3 +1209,267 @@ int count_block(
    *ocounts = counts;
    return(0);
 }
+
+/*****************************************************************/
+/* Makes room for at least 3 more bytes of huffman symbols.      */
+/*****************************************************************/
+static int grow_wsq_syms(WSQ_SYMS *syms)
+{
+   unsigned char *nsyms;
+   int nalloc;
+
+   nalloc = (syms->alloc < 4096) ? 4096 : syms->alloc * 2;
+   nsyms = (unsigned char *)codec_arena_realloc(syms->arena, syms->syms,
+                                                syms->alloc, nalloc);
+   if(nsyms == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : grow_wsq_syms : realloc : syms\n");
+      return(-105);
+   }
+   syms->syms = nsyms;
+   syms->alloc = nalloc;
+   return(0);
+}
+
+/*****************************************************************/
+/* Appends the symbol of a zero run to a block, counting it.     */
+/*****************************************************************/
+static int put_zrun_sym(WSQ_SYMS *syms, int *counts, const unsigned int rcnt,
+                        const int MaxZRun)
+{
+   int ret;
+   unsigned char *sptr;
+
+   if(syms->nsyms + 3 > syms->alloc && (ret = grow_wsq_syms(syms)))
+      return(ret);
+   sptr = syms->syms + syms->nsyms;
+
+   if(rcnt <= (unsigned int)MaxZRun){
+      counts[rcnt]++;  /** log zero run length **/
+      *sptr = rcnt;
+      syms->nsyms++;
+   }
+   else if(rcnt <= 0xFF){
+      counts[105]++;   /* 8bit zrun esc */
+      sptr[0] = 105;
+      sptr[1] = rcnt;
+      syms->nsyms += 2;
+   }
+   else{
+      counts[106]++;   /* 16bit zrun esc */
+      sptr[0] = 106;
+      sptr[1] = rcnt >> 8;
+      sptr[2] = rcnt & 0xFF;
+      syms->nsyms += 3;
+   }
+   return(0);
+}
+
+/*****************************************************************/
+/* Appends the symbol of a nonzero coefficient to a block,       */
+/* counting it.                                                  */
+/*****************************************************************/
+static int put_coeff_sym(WSQ_SYMS *syms, int *counts, const int pix,
+                         const int MaxCoeff, const int LoMaxCoeff)
+{
+   int ret;
+   unsigned char *sptr;
+
+   if(syms->nsyms + 3 > syms->alloc && (ret = grow_wsq_syms(syms)))
+      return(ret);
+   sptr = syms->syms + syms->nsyms;
+
+   if(pix > MaxCoeff){
+      if(pix > 255){
+         counts[103]++; /* 16bit pos esc */
+         sptr[0] = 103;
+         sptr[1] = (pix >> 8) & 0xFF;
+         sptr[2] = pix & 0xFF;
+         syms->nsyms += 3;
+      }
+      else{
+         counts[101]++; /* 8bit pos esc */
+         sptr[0] = 101;
+         sptr[1] = pix;
+         syms->nsyms += 2;
+      }
+   }
+   else if(pix < LoMaxCoeff){
+      if(pix < -255){
+         counts[104]++; /* 16bit neg esc */
+         sptr[0] = 104;
+         sptr[1] = (-pix >> 8) & 0xFF;
+         sptr[2] = -pix & 0xFF;
+         syms->nsyms += 3;
+      }
+      else{
+         counts[102]++; /* 8bit neg esc */
+         sptr[0] = 102;
+         sptr[1] = -pix;
+         syms->nsyms += 2;
+      }
+   }
+   else{
+      counts[pix+180]++; /* within table */
+      *sptr = pix + 180;
+      syms->nsyms++;
+   }
+   return(0);
+}
+
+/*****************************************************************/
+/* This routine quantizes the subbands "first" through "last"-1  */
+/* like quantize, but instead of storing the coefficients it     */
+/* appends their huffman symbols to "syms" and counts the        */
+/* categories like count_block.  Subbands with a zero bin width  */
+/* are skipped.  The symbols hold the same zero runs and         */
+/* escapes compress_block would code from the coefficients.      */
+/* The counts and symbols come from the arena of "syms", or from */
+/* the codec allocator when it has none.                         */
+/*****************************************************************/
+int quantize_block(
+   WSQ_SYMS *syms,          /* huffman symbols of the block */
+   int **ocounts,           /* output count for each huffman category */
+   const int max_huffcounts, /* maximum number of counts */
+   QUANT_VALS *quant_vals,  /* quantization parameters */
+   Q_TREE q_tree[],         /* quantization "tree" */
+   const int first,         /* first subband of the block */
+   const int last,          /* subband following the block */
+   float *fip,              /* floating point image pointer */
+   const int width,         /* image width */
+   const int MaxCoeff,      /* maximum values for coefficients */
+   const int MaxZRun)       /* maximum zero runs */
+{
+   int ret;
+   int *counts;           /* count for each huffman category */
+   int LoMaxCoeff;        /* lower (negative) MaxCoeff limit */
+   float *fptr;           /* temp image pointer */
+   int row, col;          /* temp image characteristic parameters */
+   int cnt;               /* subband counter */
+   float zbin;            /* zero bin size */
+   float qbss;            /* bin size */
+   short pix;             /* quantized coefficient */
+   unsigned int rcnt;     /* length of the current zero run, or 0 */
+
+   if (MaxCoeff <0 || MaxCoeff> 0xffff) {
+	   fprintf(stderr, "ERROR : quantize_block : MaxCoeff out of range.\n");
+	   return(-42); }
+   if (MaxZRun <0 || MaxZRun> 0xffff) {
+	   fprintf(stderr, "ERROR : quantize_block : MaxZRun out of range.\n");
+	   return(-43); }
+   counts = (int *)codec_arena_calloc(syms->arena, max_huffcounts+1,
+                                      sizeof(int));
+   if(counts == (int *)NULL){
+      fprintf(stderr, "ERROR : quantize_block : calloc : counts\n");
+      return(-106);
+   }
+   /* Set last count to 1. */
+   counts[max_huffcounts] = 1;
+
+   LoMaxCoeff = 1 - MaxCoeff;
+   syms->nsyms = 0;
+   syms->ncoeffs = 0;
+   rcnt = 0;
+   for(cnt = first; cnt < last; cnt++) {
+      qbss = quant_vals->qbss[cnt];
+      if(qbss == 0.0)
+         continue;
+      zbin = quant_vals->qzbs[cnt] / 2.0;
+      fptr = fip + (q_tree[cnt].y * width) + q_tree[cnt].x;
+
+      for(row = 0;
+         row < q_tree[cnt].leny;
+         row++, fptr += width - q_tree[cnt].lenx){
+         for(col = 0; col < q_tree[cnt].lenx; col++, fptr++) {
+            if(-zbin <= *fptr && *fptr <= zbin)
+               pix = 0;
+            else if(*fptr > 0.0)
+               pix = (short)(((*fptr-zbin)/qbss) + 1.0);
+            else
+               pix = (short)(((*fptr+zbin)/qbss) - 1.0);
+
+            if(pix == 0) {
+               /* Zero runs are cut at 0xFFFF like count_block does. */
+               if(rcnt == 0xFFFF) {
+                  if((ret = put_zrun_sym(syms, counts, rcnt, MaxZRun))) {
+                     codec_arena_free(syms->arena, counts);
+                     return(ret);
+                  }
+                  rcnt = 0;
+               }
+               rcnt++;
+               continue;
+            }
+            if(rcnt) {
+               if((ret = put_zrun_sym(syms, counts, rcnt, MaxZRun))) {
+                  codec_arena_free(syms->arena, counts);
+                  return(ret);
+               }
+               rcnt = 0;
+            }
+            if((ret = put_coeff_sym(syms, counts, pix, MaxCoeff,
+                                    LoMaxCoeff))) {
+               codec_arena_free(syms->arena, counts);
+               return(ret);
+            }
+         }
+      }
+      syms->ncoeffs += q_tree[cnt].lenx * q_tree[cnt].leny;
+   }
+   if(rcnt && (ret = put_zrun_sym(syms, counts, rcnt, MaxZRun))) {
+      codec_arena_free(syms->arena, counts);
+      return(ret);
+   }
+
+   *ocounts = counts;
+   return(0);
+}
+
+/*****************************************************************/
+/* Routine "codes" the huffman symbols of a block, giving the    */
+/* same bytes as compress_block does from its coefficients.      */
+/*****************************************************************/
+int compress_block_syms(
+   unsigned char *outbuf,       /* compressed output buffer            */
+   int   *obytes,       /* number of compressed bytes          */
+   WSQ_SYMS *syms,      /* huffman symbols of the block        */
+   HUFFCODE *codes)     /* huffman code table                  */
+{
+   unsigned char *optr, *sptr, *eptr;
+   int cat;               /* huffman category */
+   int outbit, bytes;     /* parameters used by write_bits to */
+   unsigned char bits;            /* output the "coded" image to the  */
+                          /* output buffer                    */
+
+   optr = outbuf;
+   outbit = 7;
+   bytes = 0;
+   bits = 0;
+   sptr = syms->syms;
+   eptr = sptr + syms->nsyms;
+   while(sptr < eptr) {
+      cat = *sptr++;
+      write_bits( &optr, (unsigned short) codes[cat].code,
+                  codes[cat].size, &outbit, &bits, &bytes );
+      switch(cat) {
+         case 101:  /* 8bit pos esc */
+         case 102:  /* 8bit neg esc */
+         case 105:  /* 8bit zrun esc */
+            write_bits( &optr, (unsigned short) *sptr, 8,
+                        &outbit, &bits, &bytes);
+            sptr++;
+            break;
+         case 103:  /* 16bit pos esc */
+         case 104:  /* 16bit neg esc */
+         case 106:  /* 16bit zrun esc */
+            write_bits( &optr, (unsigned short) ((sptr[0] << 8) | sptr[1]),
+                        16, &outbit, &bits, &bytes);
+            sptr += 2;
+            break;
+      }
+   }
+
+   flush_bits( &optr, &outbit, &bits, &bytes);
+
+   *obytes = bytes;
+   return(0);
+}
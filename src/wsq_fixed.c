@@ -0,0 +1,555 @@
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    WSQ_FIXED.C
+
+      Contains routines responsible for reconstructing a WSQ image in
+      fixed point integer arithmetic.  The subband joins are done with
+      the lifting factorization of the 9/7 biorthogonal filter pair
+      that WSQ encoders transmit, so each output sample costs a few
+      integer multiplies instead of a 7 or 9 tap filter.  No floating
+      point arithmetic touches the image data, so the decoded pixels
+      are the same on every compiler and processor.
+
+      Samples are held as integers scaled by 2^WSQ_FIX_FRAC, and the
+      filter constants as integers scaled by 2^WSQ_FIX_COEF.
+
+      ROUTINES:
+#cat: wsq_fixed_filters - Tells whether a transform table holds the
+#cat:                  9/7 filters the fixed point joins implement.
+#cat: unquantize_fixed - Unquantizes an image's wavelet subbands to
+#cat:                  fixed point values.
+#cat: wsq_reconstruct_fixed - Reconstructs a lossy fixed point pixmap
+#cat:                  from its wavelet subbands.
+#cat: join_lets_fixed - Joins a set of fixed point subband scanlines.
+#cat:
+#cat: conv_img_2_uchar_fixed - Converts an image's fixed point pixels
+#cat:                  to unsigned character pixels.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <wsq.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIX_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* Lifting constants of the inverse 9/7 transform, scaled by         */
+/* 2^WSQ_FIX_COEF.  The input scalings K/sqrt(2) and sqrt(2)/K that  */
+/* bring the lifting to the gain of the WSQ synthesis filters are    */
+/* moved through the steps to the outputs, where they are applied    */
+/* as the samples are interleaved.                                   */
+#define FIX_ALPHA  (-20135528)   /* -1.586134342 * K^2 / 2 */
+#define FIX_BETA    (-1174707)   /* -0.052980119 * 2 / K^2 */
+#define FIX_GAMMA   11208307     /*  0.882911076 * K^2 / 2 */
+#define FIX_DELTA    9833702     /*  0.443506852 * 2 / K^2 */
+#define FIX_LSCALE  14593904     /*  K / sqrt(2) */
+#define FIX_HSCALE  19287161     /*  sqrt(2) / K */
+
+#define FIX_ROUND  (1LL << (WSQ_FIX_COEF - 1))
+
+/* Shorter scanlines are joined with the filter plan, as the lifting */
+/* steps do not reproduce the WSQ boundary handling there.           */
+#define FIX_MIN_LIFT  6
+
+/* Number of rows gathered side by side when joining along rows. */
+#define FIX_ROW_LANES  8
+
+/* Synthesis filters matching the lifting steps, as read from the */
+/* transform table of a WSQ datastream.                           */
+static float fix_lofilt[7] = {
+   -0.064538883, -0.040689418, 0.418092273, 0.788485616,
+    0.418092273, -0.040689418, -0.064538883 };
+static float fix_hifilt[9] = {
+    0.037828455, 0.023849465, -0.110624404, -0.377402856, 0.852698679,
+   -0.377402856, -0.110624404, 0.023849465, 0.037828455 };
+
+/* Lifting kernels.  A step subtracts coef times the sum of two      */
+/* neighbouring samples, x[j] -= (coef * (a[j] + b[j])) >> COEF, and */
+/* a scale sets out[j] = (coef * in[j]) >> COEF, both rounded.  Sums */
+/* and differences wrap at 32 bits and products are formed in 64, so */
+/* every kernel gives the same result for any input.                 */
+typedef void (*FIX_STEP)(int *, const int *, const int *, const int,
+                         const int);
+typedef void (*FIX_SCALE)(int *, const int *, const int, const int);
+
+static int fix_mul(const int coef, const int sample)
+{
+   return((int)(((long long)coef * sample + FIX_ROUND) >> WSQ_FIX_COEF));
+}
+
+static void fix_step_c(int *x, const int *a, const int *b, const int n,
+                       const int coef)
+{
+   int j;
+
+   for(j = 0; j < n; j++)
+      x[j] = (int)((unsigned int)x[j] - (unsigned int)fix_mul(coef,
+                   (int)((unsigned int)a[j] + (unsigned int)b[j])));
+}
+
+static void fix_scale_c(int *out, const int *in, const int n,
+                        const int coef)
+{
+   int j;
+
+   for(j = 0; j < n; j++)
+      out[j] = fix_mul(coef, in[j]);
+}
+
+#ifdef FIX_X86_DISPATCH
+/* The 32 x 32 bit multiplies take the even lanes; the odd lanes are */
+/* shifted down for a second multiply and the halves blended back.   */
+/* Only the low 32 bits of each shifted product are kept, so a       */
+/* logical shift gives the same bits as an arithmetic one.           */
+__attribute__((target("sse4.1")))
+static __m128i fix_mul_sse41(const __m128i c, const __m128i s)
+{
+   __m128i r, e, o;
+
+   r = _mm_set1_epi64x(FIX_ROUND);
+   e = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epi32(s, c), r), WSQ_FIX_COEF);
+   o = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epi32(_mm_srli_epi64(s, 32), c),
+                                    r), WSQ_FIX_COEF);
+   return(_mm_blend_epi16(e, _mm_slli_epi64(o, 32), 0xCC));
+}
+
+__attribute__((target("sse4.1")))
+static void fix_step_sse41(int *x, const int *a, const int *b, const int n,
+                           const int coef)
+{
+   int j;
+   __m128i c, s;
+
+   c = _mm_set1_epi32(coef);
+   for(j = 0; j + 4 <= n; j += 4) {
+      s = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(a + j)),
+                        _mm_loadu_si128((const __m128i *)(b + j)));
+      _mm_storeu_si128((__m128i *)(x + j),
+                       _mm_sub_epi32(_mm_loadu_si128((__m128i *)(x + j)),
+                                     fix_mul_sse41(c, s)));
+   }
+   fix_step_c(x + j, a + j, b + j, n - j, coef);
+}
+
+__attribute__((target("sse4.1")))
+static void fix_scale_sse41(int *out, const int *in, const int n,
+                            const int coef)
+{
+   int j;
+   __m128i c;
+
+   c = _mm_set1_epi32(coef);
+   for(j = 0; j + 4 <= n; j += 4)
+      _mm_storeu_si128((__m128i *)(out + j),
+            fix_mul_sse41(c, _mm_loadu_si128((const __m128i *)(in + j))));
+   fix_scale_c(out + j, in + j, n - j, coef);
+}
+
+__attribute__((target("avx2")))
+static __m256i fix_mul_avx2(const __m256i c, const __m256i s)
+{
+   __m256i r, e, o;
+
+   r = _mm256_set1_epi64x(FIX_ROUND);
+   e = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epi32(s, c), r),
+                         WSQ_FIX_COEF);
+   o = _mm256_srli_epi64(_mm256_add_epi64(
+                  _mm256_mul_epi32(_mm256_srli_epi64(s, 32), c), r),
+                  WSQ_FIX_COEF);
+   return(_mm256_blend_epi32(e, _mm256_slli_epi64(o, 32), 0xAA));
+}
+
+__attribute__((target("avx2")))
+static void fix_step_avx2(int *x, const int *a, const int *b, const int n,
+                          const int coef)
+{
+   int j;
+   __m256i c, s;
+
+   c = _mm256_set1_epi32(coef);
+   for(j = 0; j + 8 <= n; j += 8) {
+      s = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a + j)),
+                           _mm256_loadu_si256((const __m256i *)(b + j)));
+      _mm256_storeu_si256((__m256i *)(x + j),
+                  _mm256_sub_epi32(_mm256_loadu_si256((__m256i *)(x + j)),
+                                   fix_mul_avx2(c, s)));
+   }
+   fix_step_c(x + j, a + j, b + j, n - j, coef);
+}
+
+__attribute__((target("avx2")))
+static void fix_scale_avx2(int *out, const int *in, const int n,
+                           const int coef)
+{
+   int j;
+   __m256i c;
+
+   c = _mm256_set1_epi32(coef);
+   for(j = 0; j + 8 <= n; j += 8)
+      _mm256_storeu_si256((__m256i *)(out + j),
+            fix_mul_avx2(c, _mm256_loadu_si256((const __m256i *)(in + j))));
+   fix_scale_c(out + j, in + j, n - j, coef);
+}
+#endif
+
+/************************************************************************/
+/* Picks the widest kernels the running CPU supports.                   */
+/************************************************************************/
+static void fix_kernels(FIX_STEP *step, FIX_SCALE *scale)
+{
+#ifdef FIX_X86_DISPATCH
+   if(__builtin_cpu_supports("avx2")){
+      *step = fix_step_avx2;
+      *scale = fix_scale_avx2;
+      return;
+   }
+   if(__builtin_cpu_supports("sse4.1")){
+      *step = fix_step_sse41;
+      *scale = fix_scale_sse41;
+      return;
+   }
+#endif
+   *step = fix_step_c;
+   *scale = fix_scale_c;
+}
+
+/************************************************************************/
+/* Returns 1 if the transform table holds the filters implemented by    */
+/* the lifting steps, to within the precision they are transmitted.     */
+/************************************************************************/
+int wsq_fixed_filters(const DTT_TABLE *dtt_table)
+{
+   int i;
+
+   if(dtt_table->lodef != 1 || dtt_table->hidef != 1 ||
+      dtt_table->losz != 7 || dtt_table->hisz != 9)
+      return(0);
+
+   for(i = 0; i < 7; i++)
+      if(fabs(dtt_table->lofilt[i] - fix_lofilt[i]) > 1e-5)
+         return(0);
+   for(i = 0; i < 9; i++)
+      if(fabs(dtt_table->hifilt[i] - fix_hifilt[i]) > 1e-5)
+         return(0);
+
+   return(1);
+}
+
+/************************************************************************/
+/* Unquantizes the subbands like unquantize, to values scaled by        */
+/* 2^WSQ_FIX_FRAC.  Each subband's bin widths are rounded to fixed      */
+/* point once, so the per coefficient work is integer only.             */
+/************************************************************************/
+int unquantize_fixed(
+   int **oip,            /* fixed point image pointer            */
+   const DQT_TABLE *dqt_table, /* quantization table structure   */
+   Q_TREE q_tree[],      /* quantization table structure         */
+   const int q_treelen,  /* size of q_tree                       */
+   short *sip,           /* quantized image pointer              */
+   const int width,      /* image width                          */
+   const int height,     /* image height                         */
+   CODEC_ARENA *arena)   /* arena for "ip", or NULL              */
+{
+   int *ip;           /* fixed point image */
+   int row, col;      /* row/column counters */
+   int *iptr;         /* image pointers */
+   short *sptr;
+   int cnt;           /* subband counter */
+   long long qbin;    /* bin width */
+   long long offset;  /* bin width times bin center, less half the */
+                      /* zero bin width */
+
+   (void)q_treelen;
+   if(dqt_table->dqt_def != 1) {
+      fprintf(stderr,
+      "ERROR: unquantize_fixed : quantization table parameters not defined!\n");
+      return(-92);
+   }
+   if((ip = (int *) codec_arena_calloc(arena, width*height,
+                                       sizeof(int))) == NULL) {
+      fprintf(stderr,"ERROR : unquantize_fixed : calloc : ip\n");
+      return(-91);
+   }
+
+   sptr = sip;
+   for(cnt = 0; cnt < NUM_SUBBANDS; cnt++) {
+      if(dqt_table->q_bin[cnt] == 0.0)
+         continue;
+      qbin = llrint(ldexp(dqt_table->q_bin[cnt], WSQ_FIX_FRAC));
+      offset = llrint(ldexp((double)dqt_table->q_bin[cnt] *
+                            dqt_table->bin_center -
+                            dqt_table->z_bin[cnt] / 2.0, WSQ_FIX_FRAC));
+      iptr = ip + (q_tree[cnt].y * width) + q_tree[cnt].x;
+
+      for(row = 0;
+          row < q_tree[cnt].leny;
+          row++, iptr += width - q_tree[cnt].lenx){
+         for(col = 0; col < q_tree[cnt].lenx; col++) {
+            if(*sptr > 0)
+               *iptr = (int)(qbin * *sptr - offset);
+            else if(*sptr < 0)
+               *iptr = (int)(qbin * *sptr + offset);
+            iptr++;
+            sptr++;
+         }
+      }
+   }
+
+   *oip = ip;
+   return(0);
+}
+
+/************************************************************************/
+/* Runs the inverse lifting steps on the low and high pass halves of    */
+/* "nlanes" adjacent scanlines.  Sample "k" of lane "j" of a half is at */
+/* k*sstride + j.  The halves are interleaved samples of the output,    */
+/* low pass samples at even positions, and are extended symmetrically   */
+/* about its first and last samples.  The output scalings are left to   */
+/* the caller.                                                          */
+/************************************************************************/
+static void lift_lanes_fixed(int *lo, int *hi, const int llen,
+                             const int hlen, const int sstride,
+                             const int nlanes, FIX_STEP step)
+{
+   int k;
+
+   /* Low pass samples from their high pass neighbours. */
+   for(k = 0; k < llen; k++)
+      (*step)(lo + k * sstride, hi + ((k > 0) ? k - 1 : 0) * sstride,
+              hi + ((k < hlen) ? k : hlen - 1) * sstride, nlanes, FIX_DELTA);
+   /* High pass samples from their low pass neighbours. */
+   for(k = 0; k < hlen; k++)
+      (*step)(hi + k * sstride, lo + k * sstride,
+              lo + ((k + 1 < llen) ? k + 1 : llen - 1) * sstride, nlanes,
+              FIX_GAMMA);
+   for(k = 0; k < llen; k++)
+      (*step)(lo + k * sstride, hi + ((k > 0) ? k - 1 : 0) * sstride,
+              hi + ((k < hlen) ? k : hlen - 1) * sstride, nlanes, FIX_BETA);
+   for(k = 0; k < hlen; k++)
+      (*step)(hi + k * sstride, lo + k * sstride,
+              lo + ((k + 1 < llen) ? k + 1 : llen - 1) * sstride, nlanes,
+              FIX_ALPHA);
+}
+
+/************************************************************************/
+/* Joins scanlines too short for the lifting steps with the same plan   */
+/* the floating point joins use, its coefficients rounded to fixed      */
+/* point.                                                               */
+/************************************************************************/
+static int join_lets_plan_fixed(int *new, int *old, const int len1,
+                   const int len2, const int pitch, const int stride,
+                   const DTT_TABLE *dtt_table, const int inv,
+                   CODEC_ARENA *arena)
+{
+   int ret, i, r, j, k, pos, src;
+   long long sum;
+   LETS_PLAN plan;
+   LETS_RUN *run;
+   int *iptr, *optr;
+
+   ret = build_join_lets_plan(&plan, len2, dtt_table->hifilt,
+                   dtt_table->hisz, dtt_table->lofilt, dtt_table->losz, inv,
+                   arena);
+   if(ret)
+      return(ret);
+
+   for(i = 0; i < len1; i++) {
+      iptr = old + i * pitch;
+      optr = new + i * pitch;
+      for(r = 0; r < plan.nruns; r++) {
+         run = plan.runs + r;
+         for(j = 0; j < run->count; j++) {
+            pos = run->pos + j * run->pstep;
+            sum = 0;
+            for(k = 0; k < run->nterms; k++) {
+               src = run->src[k] + j * run->sstep;
+               sum += llrint(ldexp(run->coef[k], WSQ_FIX_COEF)) *
+                      iptr[src * stride];
+            }
+            optr[pos * stride] = (int)((sum + (1LL << (WSQ_FIX_COEF - 1)))
+                                       >> WSQ_FIX_COEF);
+         }
+      }
+   }
+
+   free_LETS_PLAN(&plan);
+   return(0);
+}
+
+/************************************************************************/
+/* Computes the subband join of join_lets in fixed point.  Scanlines    */
+/* start "pitch" samples apart and their samples are "stride" apart.    */
+/* Columns (pitch 1) are lifted in place as lanes; rows are first       */
+/* gathered FIX_ROW_LANES at a time into an interleaved buffer, taken  */
+/* from "arena" if not NULL.                                            */
+/* NOTE: the lifting is done in place, so "old" is overwritten.         */
+/************************************************************************/
+int join_lets_fixed(int *new, int *old, const int len1, const int len2,
+                    const int pitch, const int stride,
+                    const DTT_TABLE *dtt_table, const int inv,
+                    CODEC_ARENA *arena)
+{
+   int ret;
+   int llen, hlen, lo_off, hi_off;
+   int rw, nr, r, k;
+   int *lo, *hi, *ibuf, *optr;
+   FIX_STEP step;
+   FIX_SCALE scale;
+   CODEC_ARENA_MARK mark;
+
+   if(len2 < FIX_MIN_LIFT) {
+      codec_arena_mark(arena, &mark);
+      ret = join_lets_plan_fixed(new, old, len1, len2, pitch, stride,
+                                 dtt_table, inv, arena);
+      codec_arena_release(arena, &mark);
+      return(ret);
+   }
+
+   fix_kernels(&step, &scale);
+
+   llen = (len2 + 1) / 2;
+   hlen = len2 / 2;
+   /* With spectral inversion the high pass half comes first. */
+   lo_off = inv ? hlen : 0;
+   hi_off = inv ? 0 : llen;
+
+   if(pitch == 1) {
+      lo = old + lo_off * stride;
+      hi = old + hi_off * stride;
+      lift_lanes_fixed(lo, hi, llen, hlen, stride, len1, step);
+      for(k = 0; k < llen; k++)
+         (*scale)(new + 2 * k * stride, lo + k * stride, len1, FIX_LSCALE);
+      for(k = 0; k < hlen; k++)
+         (*scale)(new + (2 * k + 1) * stride, hi + k * stride, len1,
+                  FIX_HSCALE);
+      return(0);
+   }
+
+   codec_arena_mark(arena, &mark);
+   ibuf = (int *)codec_arena_calloc(arena, len2 * FIX_ROW_LANES,
+                                    sizeof(int));
+   if(ibuf == (int *)NULL){
+      fprintf(stderr, "ERROR : join_lets_fixed : calloc : ibuf\n");
+      return(-104);
+   }
+   lo = ibuf;
+   hi = ibuf + llen * FIX_ROW_LANES;
+
+   for(rw = 0; rw < len1; rw += FIX_ROW_LANES) {
+      nr = len1 - rw;
+      if(nr > FIX_ROW_LANES)
+         nr = FIX_ROW_LANES;
+      for(r = 0; r < nr; r++) {
+         optr = old + (rw + r) * pitch;
+         for(k = 0; k < llen; k++)
+            lo[k * FIX_ROW_LANES + r] = optr[(lo_off + k) * stride];
+         for(k = 0; k < hlen; k++)
+            hi[k * FIX_ROW_LANES + r] = optr[(hi_off + k) * stride];
+      }
+      lift_lanes_fixed(lo, hi, llen, hlen, FIX_ROW_LANES, FIX_ROW_LANES,
+                       step);
+      (*scale)(lo, lo, llen * FIX_ROW_LANES, FIX_LSCALE);
+      (*scale)(hi, hi, hlen * FIX_ROW_LANES, FIX_HSCALE);
+      for(r = 0; r < nr; r++) {
+         optr = new + (rw + r) * pitch;
+         for(k = 0; k < llen; k++)
+            optr[2 * k * stride] = lo[k * FIX_ROW_LANES + r];
+         for(k = 0; k < hlen; k++)
+            optr[(2 * k + 1) * stride] = hi[k * FIX_ROW_LANES + r];
+      }
+   }
+
+   codec_arena_free(arena, ibuf);
+   codec_arena_release(arena, &mark);
+   return(0);
+}
+
+/************************************************************************/
+/* WSQ reconstructs the part of the image held by node "root" of the    */
+/* wavelet tree like wsq_reconstruct_node, in fixed point.  Node 0      */
+/* gives the whole image, as wsq_reconstruct does.  The temporary rows  */
+/* come from "arena" if not NULL.                                       */
+/* NOTE: this routine modifies and returns the results in "idata".      */
+/************************************************************************/
+int wsq_reconstruct_fixed(int *idata, const int width, const int height,
+                  W_TREE w_tree[], const int w_treelen,
+                  const DTT_TABLE *dtt_table, const int root,
+                  CODEC_ARENA *arena)
+{
+   int ret, node;
+   int *idata1, *idata_bse;
+   W_TREE *rt;
+
+   if(!wsq_fixed_filters(dtt_table)) {
+      fprintf(stderr, "ERROR: wsq_reconstruct_fixed : ");
+      fprintf(stderr, "filters are not the WSQ 9/7 pair\n");
+      return(-102);
+   }
+
+   (void)height;
+   rt = &w_tree[root];
+   if((idata1 = (int *) codec_arena_alloc(arena,
+                                rt->leny*width*sizeof(int))) == NULL) {
+      fprintf(stderr,"ERROR : wsq_reconstruct_fixed : malloc : idata1\n");
+      return(-103);
+   }
+
+   for (node = w_treelen - 1; node >= root; node--) {
+      if(w_tree[node].x < rt->x || w_tree[node].y < rt->y ||
+         w_tree[node].x + w_tree[node].lenx > rt->x + rt->lenx ||
+         w_tree[node].y + w_tree[node].leny > rt->y + rt->leny)
+         continue;
+      idata_bse = idata + (w_tree[node].y * width) + w_tree[node].x;
+      ret = join_lets_fixed(idata1, idata_bse, w_tree[node].lenx,
+                  w_tree[node].leny, 1, width, dtt_table,
+                  w_tree[node].inv_cl, arena);
+      if(!ret)
+         ret = join_lets_fixed(idata_bse, idata1, w_tree[node].leny,
+                  w_tree[node].lenx, width, 1, dtt_table,
+                  w_tree[node].inv_rw, arena);
+      if(ret){
+         codec_arena_free(arena, idata1);
+         return(ret);
+      }
+   }
+   codec_arena_free(arena, idata1);
+
+   return(0);
+}
+
+/************************************************************************/
+/* Converts fixed point pixels to unsigned char pixels like             */
+/* conv_img_2_uchar.                                                    */
+/************************************************************************/
+void conv_img_2_uchar_fixed(
+   unsigned char *data,           /* uchar image pointer    */
+   int *img,                      /* image pointer          */
+   const int width,               /* image width            */
+   const int height,              /* image height           */
+   const float m_shift,           /* shifting parameter     */
+   const float r_scale)           /* scaling parameter      */
+{
+   int i, num_pix;
+   long long scale, shift, pix;
+
+   /* Pixels are formed scaled by 2^30. */
+   scale = llrint(ldexp(r_scale, 30 - WSQ_FIX_FRAC));
+   shift = llrint(ldexp((double)m_shift + 0.5, 30));
+
+   num_pix = width * height;
+   for(i = 0; i < num_pix; i++) {
+      pix = (img[i] * scale + shift) >> 30;
+      if(pix < 0)
+         data[i] = 0;
+      else if(pix > 255)
+         data[i] = 255;
+      else
+         data[i] = (unsigned char)pix;
+   }
+}
@@ -31,6 +31,9 @@ DHT_TABLE dht_table[MAX_DHT_TABLES];
 
 FRM_HEADER_WSQ frm_header_wsq;
 
+/* Context used by the non-reentrant wsq_encode_mem/wsq_decode_mem. */
+WSQ_CTX wsq_default_ctx;
+
 
 #ifdef FILTBANK_EVEN_8X8_1
 float hifilt[MAX_HIFILT] =  {
@@ -0,0 +1,1208 @@
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    WSQ_LETS.C
+
+      Contains routines responsible for the separable wavelet
+      analysis and synthesis filtering used by wsq_decompose and
+      wsq_reconstruct.  The boundary reflection rules of get_lets
+      and join_lets are first worked out once per scanline length
+      as the input samples and coefficients that form each output
+      sample, and outputs with the same terms shifted along the
+      scanline are merged into runs.  The resulting plan is then
+      applied to many rows or columns at once, several lines per
+      vector, with the kernel chosen at run time from the CPU's
+      capabilities.  Columns are filtered a whole image row at a
+      time, so the column pass streams through memory in order.
+      Each output is summed in the same order as get_lets and
+      join_lets, so the results match theirs.
+
+      ROUTINES:
+#cat: build_get_lets_plan - Builds the analysis plan equivalent to
+#cat:                get_lets for one scanline length.
+#cat: build_join_lets_plan - Builds the synthesis plan equivalent to
+#cat:                join_lets for one scanline length.
+#cat: free_LETS_PLAN - Deallocates the tables held by a plan.
+#cat:
+#cat: apply_lets_plan - Filters a set of rows or columns with a plan.
+#cat:
+#cat: apply_lets_plan_mt - Filters a set of rows or columns with a plan,
+#cat:                splitting them into bands across threads.
+#cat: get_lets_vec - Vectorized replacement for get_lets.
+#cat:
+#cat: join_lets_vec - Vectorized replacement for join_lets.
+#cat:
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wsq.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LETS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/* Number of rows gathered side by side when filtering along rows. */
+#define LETS_ROW_LANES  8
+
+/* Fewest samples worth handing to a thread of their own. */
+#define LETS_BAND_SAMPLES  (64 * 1024)
+
+typedef struct lets_bands {
+   float *new;
+   float *old;
+   int len1;
+   int pitch;
+   int stride;
+   int band;       /* scanlines per band */
+   const LETS_PLAN *plan;
+} LETS_BANDS;
+
+/* Terms of every output sample along a scanline, as worked out from */
+/* the reference routines before being merged into runs.             */
+typedef struct lets_terms {
+   int nout;       /* number of output samples */
+   int maxterms;   /* allocated terms per output */
+   int *nterms;    /* number of terms for each output */
+   int *src;       /* nout x maxterms input sample indices */
+   float *coef;    /* nout x maxterms coefficients */
+   CODEC_ARENA *arena;  /* memory for the terms, or NULL */
+} LETS_TERMS;
+
+/************************************************************************/
+/* Deallocates a set of per output terms.                               */
+/************************************************************************/
+static void free_lets_terms(LETS_TERMS *terms)
+{
+   if(terms->nterms != (int *)NULL)
+      codec_arena_free(terms->arena, terms->nterms);
+   if(terms->src != (int *)NULL)
+      codec_arena_free(terms->arena, terms->src);
+   if(terms->coef != (float *)NULL)
+      codec_arena_free(terms->arena, terms->coef);
+}
+
+/************************************************************************/
+/* Allocates empty terms for "nout" outputs of up to "maxterms" terms,  */
+/* from the arena set in "terms".                                       */
+/************************************************************************/
+static int alloc_lets_terms(LETS_TERMS *terms, const int nout,
+                            const int maxterms)
+{
+   terms->nout = nout;
+   terms->maxterms = maxterms;
+   terms->nterms = (int *)codec_arena_calloc(terms->arena, nout,
+                                             sizeof(int));
+   terms->src = (int *)codec_arena_alloc(terms->arena,
+                                         nout * maxterms * sizeof(int));
+   terms->coef = (float *)codec_arena_alloc(terms->arena,
+                                            nout * maxterms * sizeof(float));
+   if(terms->nterms == (int *)NULL || terms->src == (int *)NULL ||
+      terms->coef == (float *)NULL){
+      free_lets_terms(terms);
+      fprintf(stderr, "ERROR : alloc_lets_terms : malloc : terms\n");
+      return(-98);
+   }
+   return(0);
+}
+
+/************************************************************************/
+/* Records "src * coef" as the next term of output "pos".  An "assign"  */
+/* term replaces whatever the output held, as in the reference code.    */
+/* On scanlines of 4 samples or fewer the reflection rules step past    */
+/* the ends; such samples are taken from the nearest end, as get_lets   */
+/* and join_lets now do, and outputs past the end are dropped.          */
+/************************************************************************/
+static int lets_term(LETS_TERMS *terms, const int pos, int src,
+                     const float coef, const int assign)
+{
+   int n;
+
+   if(pos >= terms->nout)
+      return(0);
+   if(src < 0)
+      src = 0;
+   else if(src >= terms->nout)
+      src = terms->nout - 1;
+   if(assign)
+      terms->nterms[pos] = 0;
+   n = terms->nterms[pos];
+   if(n >= terms->maxterms){
+      fprintf(stderr, "ERROR : lets_term : too many terms for output %d\n",
+              pos);
+      return(-99);
+   }
+   terms->src[pos * terms->maxterms + n] = src;
+   terms->coef[pos * terms->maxterms + n] = coef;
+   terms->nterms[pos] = n + 1;
+   return(0);
+}
+
+/************************************************************************/
+/* Returns nonzero if output "b" has the terms of output "a" with every */
+/* input sample moved by "sstep".                                       */
+/************************************************************************/
+static int lets_same_terms(const LETS_TERMS *terms, const int a, const int b,
+                           const int sstep)
+{
+   int k, n, *sa, *sb;
+   float *ca, *cb;
+
+   n = terms->nterms[a];
+   if(terms->nterms[b] != n)
+      return(0);
+   sa = terms->src + a * terms->maxterms;
+   sb = terms->src + b * terms->maxterms;
+   ca = terms->coef + a * terms->maxterms;
+   cb = terms->coef + b * terms->maxterms;
+   for(k = 0; k < n; k++)
+      if(sb[k] != sa[k] + sstep || cb[k] != ca[k])
+         return(0);
+   return(1);
+}
+
+/************************************************************************/
+/* Merges per output terms into a plan of runs.  Starting from the      */
+/* first output not yet covered, a run is grown over every output, or   */
+/* every second output, whose terms repeat those of the previous one    */
+/* shifted along the scanline; the longer of the two is kept.  Away     */
+/* from the scanline ends this leaves one run per subband phase.        */
+/************************************************************************/
+static int compress_lets_terms(LETS_PLAN *plan, const LETS_TERMS *terms)
+{
+   int pos, pstep, bstep, count, bcount, sstep, bsstep, n, j, k;
+   int nruns, ntot;
+   char *done;
+   LETS_RUN *run;
+
+   plan->nout = terms->nout;
+   plan->nruns = 0;
+   plan->arena = terms->arena;
+   plan->runs = (LETS_RUN *)codec_arena_alloc(plan->arena,
+                                      terms->nout * sizeof(LETS_RUN));
+   plan->src = (int *)codec_arena_alloc(plan->arena,
+                          terms->nout * terms->maxterms * sizeof(int));
+   plan->coef = (float *)codec_arena_alloc(plan->arena,
+                          terms->nout * terms->maxterms * sizeof(float));
+   done = (char *)codec_arena_calloc(plan->arena, terms->nout, sizeof(char));
+   if(plan->runs == (LETS_RUN *)NULL || plan->src == (int *)NULL ||
+      plan->coef == (float *)NULL || done == (char *)NULL){
+      if(done != (char *)NULL)
+         codec_arena_free(plan->arena, done);
+      free_LETS_PLAN(plan);
+      fprintf(stderr, "ERROR : compress_lets_terms : malloc : plan\n");
+      return(-98);
+   }
+
+   nruns = 0;
+   ntot = 0;
+   for(pos = 0; pos < terms->nout; pos++) {
+      if(done[pos])
+         continue;
+      n = terms->nterms[pos];
+
+      bstep = 1;
+      bcount = 1;
+      bsstep = 0;
+      for(pstep = 1; pstep <= 2; pstep++) {
+         if(pos + pstep >= terms->nout || done[pos + pstep] ||
+            n == 0 || terms->nterms[pos + pstep] != n)
+            continue;
+         sstep = terms->src[(pos + pstep) * terms->maxterms] -
+                 terms->src[pos * terms->maxterms];
+         count = 1;
+         while(pos + count * pstep < terms->nout &&
+               !done[pos + count * pstep] &&
+               lets_same_terms(terms, pos + (count - 1) * pstep,
+                               pos + count * pstep, sstep))
+            count++;
+         if(count > bcount) {
+            bcount = count;
+            bstep = pstep;
+            bsstep = sstep;
+         }
+      }
+
+      run = plan->runs + nruns;
+      run->pos = pos;
+      run->pstep = bstep;
+      run->count = bcount;
+      run->sstep = bsstep;
+      run->nterms = n;
+      run->src = plan->src + ntot;
+      run->coef = plan->coef + ntot;
+      for(k = 0; k < n; k++) {
+         run->src[k] = terms->src[pos * terms->maxterms + k];
+         run->coef[k] = terms->coef[pos * terms->maxterms + k];
+      }
+      ntot += n;
+      for(j = 0; j < bcount; j++)
+         done[pos + j * bstep] = 1;
+      nruns++;
+   }
+   plan->nruns = nruns;
+   plan->maxcount = 0;
+   for(j = 0; j < nruns; j++)
+      if(plan->runs[j].count > plan->maxcount)
+         plan->maxcount = plan->runs[j].count;
+
+   codec_arena_free(plan->arena, done);
+   return(0);
+}
+
+/************************************************************************/
+/* Deallocates the tables held by a plan.                               */
+/************************************************************************/
+void free_LETS_PLAN(LETS_PLAN *plan)
+{
+   if(plan->runs != (LETS_RUN *)NULL)
+      codec_arena_free(plan->arena, plan->runs);
+   if(plan->src != (int *)NULL)
+      codec_arena_free(plan->arena, plan->src);
+   if(plan->coef != (float *)NULL)
+      codec_arena_free(plan->arena, plan->coef);
+   plan->runs = (LETS_RUN *)NULL;
+   plan->src = (int *)NULL;
+   plan->coef = (float *)NULL;
+   plan->nruns = 0;
+}
+
+/************************************************************************/
+/* Works out the terms of get_lets along a scanline of "len2" samples.  */
+/* Sample indices follow get_lets step for step with a unit stride.     */
+/************************************************************************/
+static int get_lets_terms(
+   LETS_TERMS *plan,
+   const int len2,       /* samples per scanline */
+   float *hi,
+   const int hsz,
+   float *lo,            /* filter coefficients */
+   const int lsz,
+   const int inv)        /* spectral inversion? */
+{
+   int ret;
+   int lopos, hipos;     /* output positions of lopass and hipass */
+   int p0, p1;           /* first and last input samples */
+   int pix, i, da_ev;
+   int fi_ev;
+   int loc, hoc, nstr, pstr;
+   int llen, hlen;
+   int lpxstr, lspxstr;
+   int lpx, lspx;
+   int hpxstr, hspxstr;
+   int hpx, hspx;
+   int olle, ohle;
+   int olre, ohre;
+   int lle, lle2;
+   int lre, lre2;
+   int hle, hle2;
+   int hre, hre2;
+   float hsign;          /* negates hipass for even filters */
+
+   da_ev = len2 % 2;
+   fi_ev = lsz % 2;
+
+   if(fi_ev) {
+      loc = (lsz-1)/2;
+      hoc = (hsz-1)/2 - 1;
+      olle = 0;
+      ohle = 0;
+      olre = 0;
+      ohre = 0;
+      hsign = 1.0;
+   }
+   else {
+      loc = lsz/2 - 2;
+      hoc = hsz/2 - 2;
+      olle = 1;
+      ohle = 1;
+      olre = 1;
+      ohre = 1;
+
+      if(loc == -1) {
+         loc = 0;
+         olle = 0;
+      }
+      if(hoc == -1) {
+         hoc = 0;
+         ohle = 0;
+      }
+      hsign = -1.0;
+   }
+
+   pstr = 1;
+   nstr = -pstr;
+
+   if(da_ev) {
+      llen = (len2+1)/2;
+      hlen = llen - 1;
+   }
+   else {
+      llen = len2/2;
+      hlen = llen;
+   }
+
+   ret = alloc_lets_terms(plan, len2, (lsz > hsz) ? lsz : hsz);
+   if(ret)
+      return(ret);
+
+   if(inv) {
+      hipos = 0;
+      lopos = hlen;
+   }
+   else {
+      lopos = 0;
+      hipos = llen;
+   }
+
+   p0 = 0;
+   p1 = len2 - 1;
+
+   lspx = p0 + loc;
+   lspxstr = nstr;
+   lle2 = olle;
+   lre2 = olre;
+   hspx = p0 + hoc;
+   hspxstr = nstr;
+   hle2 = ohle;
+   hre2 = ohre;
+   for(pix = 0; pix < hlen; pix++) {
+      lpxstr = lspxstr;
+      lpx = lspx;
+      lle = lle2;
+      lre = lre2;
+      if((ret = lets_term(plan, lopos, lpx, lo[0], 1)))
+         break;
+      for(i = 1; i < lsz; i++) {
+         if(lpx == p0) {
+            if(lle) {
+               lpxstr = 0;
+               lle = 0;
+            }
+            else
+               lpxstr = pstr;
+         }
+         if(lpx == p1) {
+            if(lre) {
+               lpxstr = 0;
+               lre = 0;
+            }
+            else
+               lpxstr = nstr;
+         }
+         lpx += lpxstr;
+         if((ret = lets_term(plan, lopos, lpx, lo[i], 0)))
+            break;
+      }
+      if(ret)
+         break;
+      lopos++;
+
+      hpxstr = hspxstr;
+      hpx = hspx;
+      hle = hle2;
+      hre = hre2;
+      if((ret = lets_term(plan, hipos, hpx, hsign * hi[0], 1)))
+         break;
+      for(i = 1; i < hsz; i++) {
+         if(hpx == p0) {
+            if(hle) {
+               hpxstr = 0;
+               hle = 0;
+            }
+            else
+               hpxstr = pstr;
+         }
+         if(hpx == p1) {
+            if(hre) {
+               hpxstr = 0;
+               hre = 0;
+            }
+            else
+               hpxstr = nstr;
+         }
+         hpx += hpxstr;
+         if((ret = lets_term(plan, hipos, hpx, hsign * hi[i], 0)))
+            break;
+      }
+      if(ret)
+         break;
+      hipos++;
+
+      for(i = 0; i < 2; i++) {
+         if(lspx == p0) {
+            if(lle2) {
+               lspxstr = 0;
+               lle2 = 0;
+            }
+            else
+               lspxstr = pstr;
+         }
+         lspx += lspxstr;
+         if(hspx == p0) {
+            if(hle2) {
+               hspxstr = 0;
+               hle2 = 0;
+            }
+            else
+               hspxstr = pstr;
+         }
+         hspx += hspxstr;
+      }
+   }
+   if(!ret && da_ev) {
+      lpxstr = lspxstr;
+      lpx = lspx;
+      lle = lle2;
+      lre = lre2;
+      ret = lets_term(plan, lopos, lpx, lo[0], 1);
+      for(i = 1; !ret && i < lsz; i++) {
+         if(lpx == p0) {
+            if(lle) {
+               lpxstr = 0;
+               lle = 0;
+            }
+            else
+               lpxstr = pstr;
+         }
+         if(lpx == p1) {
+            if(lre) {
+               lpxstr = 0;
+               lre = 0;
+            }
+            else
+               lpxstr = nstr;
+         }
+         lpx += lpxstr;
+         ret = lets_term(plan, lopos, lpx, lo[i], 0);
+      }
+   }
+
+   if(ret){
+      free_lets_terms(plan);
+      return(ret);
+   }
+   return(0);
+}
+
+/************************************************************************/
+/* Works out the terms of join_lets along a scanline of "len2" samples. */
+/* Sample indices follow join_lets step for step with a unit stride.    */
+/************************************************************************/
+static int join_lets_terms(
+   LETS_TERMS *plan,
+   const int len2,       /* samples per scanline */
+   float *hi,
+   const int hsz,
+   float *lo,            /* filter coefficients */
+   const int lsz,
+   const int inv)        /* spectral inversion? */
+{
+   int ret;
+   int lp0, lp1;
+   int hp0, hp1;
+   int lopass, hipass;   /* first lopass and hipass input samples */
+   int limg, himg;       /* output positions */
+   int pix;
+   int i, da_ev;
+   int loc, hoc;
+   int hlen, llen;
+   int nstr, pstr;
+   int tap;
+   int fi_ev;
+   int olle, ohle, olre, ohre;
+   int lle, lle2, lre, lre2;
+   int hle, hle2, hre, hre2;
+   int lpx, lspx;
+   int lpxstr, lspxstr;
+   int lstap, lotap;
+   int hpx, hspx;
+   int hpxstr, hspxstr;
+   int hstap, hotap;
+   int asym, fhre=0, ofhre;
+   float ssfac, osfac, sfac;
+   float hsign;          /* negates hipass for even filters */
+
+   da_ev = len2 % 2;
+   fi_ev = lsz % 2;
+   pstr = 1;
+   nstr = -pstr;
+   if(da_ev) {
+      llen = (len2+1)/2;
+      hlen = llen - 1;
+   }
+   else {
+      llen = len2/2;
+      hlen = llen;
+   }
+
+   if(fi_ev) {
+      asym = 0;
+      ssfac = 1.0;
+      ofhre = 0;
+      loc = (lsz-1)/4;
+      hoc = (hsz+1)/4 - 1;
+      lotap = ((lsz-1)/2) % 2;
+      hotap = ((hsz+1)/2) % 2;
+      if(da_ev) {
+         olle = 0;
+         olre = 0;
+         ohle = 1;
+         ohre = 1;
+      }
+      else {
+         olle = 0;
+         olre = 1;
+         ohle = 1;
+         ohre = 0;
+      }
+      hsign = 1.0;
+   }
+   else {
+      asym = 1;
+      ssfac = -1.0;
+      ofhre = 2;
+      loc = lsz/4 - 1;
+      hoc = hsz/4 - 1;
+      lotap = (lsz/2) % 2;
+      hotap = (hsz/2) % 2;
+      if(da_ev) {
+         olle = 1;
+         olre = 0;
+         ohle = 1;
+         ohre = 1;
+      }
+      else {
+         olle = 1;
+         olre = 1;
+         ohle = 1;
+         ohre = 1;
+      }
+
+      if(loc == -1) {
+         loc = 0;
+         olle = 0;
+      }
+      if(hoc == -1) {
+         hoc = 0;
+         ohle = 0;
+      }
+      hsign = -1.0;
+   }
+
+   /* Each output takes at most every other tap of both filters, */
+   /* plus the repeats made at a reflected edge.                 */
+   ret = alloc_lets_terms(plan, len2, lsz + hsz);
+   if(ret)
+      return(ret);
+
+   limg = 0;
+   himg = limg;
+   if(inv) {
+      hipass = 0;
+      lopass = hipass + hlen;
+   }
+   else {
+      lopass = 0;
+      hipass = lopass + llen;
+   }
+
+   lp0 = lopass;
+   lp1 = lp0 + (llen-1);
+   lspx = lp0 + loc;
+   lspxstr = nstr;
+   lstap = lotap;
+   lle2 = olle;
+   lre2 = olre;
+
+   hp0 = hipass;
+   hp1 = hp0 + (hlen-1);
+   hspx = hp0 + hoc;
+   hspxstr = nstr;
+   hstap = hotap;
+   hle2 = ohle;
+   hre2 = ohre;
+   osfac = ssfac;
+
+   for(pix = 0; pix < hlen; pix++) {
+      for(tap = lstap; tap >=0; tap--) {
+         lle = lle2;
+         lre = lre2;
+         lpx = lspx;
+         lpxstr = lspxstr;
+
+         if((ret = lets_term(plan, limg, lpx, lo[tap], 1)))
+            break;
+         for(i = tap+2; i < lsz; i += 2) {
+            if(lpx == lp0) {
+               if(lle) {
+                  lpxstr = 0;
+                  lle = 0;
+               }
+               else
+                  lpxstr = pstr;
+            }
+            if(lpx == lp1) {
+               if(lre) {
+                  lpxstr = 0;
+                  lre = 0;
+               }
+               else
+                  lpxstr = nstr;
+            }
+            lpx += lpxstr;
+            if((ret = lets_term(plan, limg, lpx, lo[i], 0)))
+               break;
+         }
+         if(ret)
+            break;
+         limg++;
+      }
+      if(ret)
+         break;
+      if(lspx == lp0) {
+         if(lle2) {
+            lspxstr = 0;
+            lle2 = 0;
+         }
+         else
+            lspxstr = pstr;
+      }
+      lspx += lspxstr;
+      lstap = 1;
+
+      for(tap = hstap; tap >=0; tap--) {
+         hle = hle2;
+         hre = hre2;
+         hpx = hspx;
+         hpxstr = hspxstr;
+         fhre = ofhre;
+         sfac = osfac;
+
+         for(i = tap; i < hsz; i += 2) {
+            if(hpx == hp0) {
+               if(hle) {
+                  hpxstr = 0;
+                  hle = 0;
+               }
+               else {
+                  hpxstr = pstr;
+                  sfac = 1.0;
+               }
+            }
+            if(hpx == hp1) {
+               if(hre) {
+                  hpxstr = 0;
+                  hre = 0;
+                  if(asym && da_ev) {
+                     hre = 1;
+                     fhre--;
+                     sfac = (float)fhre;
+                     if(sfac == 0.0)
+                        hre = 0;
+                  }
+               }
+               else {
+                  hpxstr = nstr;
+                  if(asym)
+                     sfac = -1.0;
+               }
+            }
+            if((ret = lets_term(plan, himg, hpx, hsign * hi[i] * sfac, 0)))
+               break;
+            hpx += hpxstr;
+         }
+         if(ret)
+            break;
+         himg++;
+      }
+      if(ret)
+         break;
+      if(hspx == hp0) {
+         if(hle2) {
+            hspxstr = 0;
+            hle2 = 0;
+         }
+         else {
+            hspxstr = pstr;
+            osfac = 1.0;
+         }
+      }
+      hspx += hspxstr;
+      hstap = 1;
+   }
+   if(ret){
+      free_lets_terms(plan);
+      return(ret);
+   }
+
+   if(da_ev)
+      if(lotap)
+         lstap = 1;
+      else
+         lstap = 0;
+   else
+      if(lotap)
+         lstap = 2;
+      else
+         lstap = 1;
+
+   for(tap = 1; !ret && tap >= lstap; tap--) {
+      lle = lle2;
+      lre = lre2;
+      lpx = lspx;
+      lpxstr = lspxstr;
+
+      ret = lets_term(plan, limg, lpx, lo[tap], 1);
+      for(i = tap+2; !ret && i < lsz; i += 2) {
+         if(lpx == lp0) {
+            if(lle) {
+               lpxstr = 0;
+               lle = 0;
+            }
+            else
+               lpxstr = pstr;
+         }
+         if(lpx == lp1) {
+            if(lre) {
+               lpxstr = 0;
+               lre = 0;
+            }
+            else
+               lpxstr = nstr;
+         }
+         lpx += lpxstr;
+         ret = lets_term(plan, limg, lpx, lo[i], 0);
+      }
+      limg++;
+   }
+
+
+   if(da_ev) {
+      if(hotap)
+         hstap = 1;
+      else
+         hstap = 0;
+
+      if(hsz == 2) {
+         hspx -= hspxstr;
+         fhre = 1;
+      }
+   }
+   else
+      if(hotap)
+         hstap = 2;
+      else
+         hstap = 1;
+
+
+   for(tap = 1; !ret && tap >= hstap; tap--) {
+      hle = hle2;
+      hre = hre2;
+      hpx = hspx;
+      hpxstr = hspxstr;
+      sfac = osfac;
+      if(hsz != 2)
+         fhre = ofhre;
+
+      for(i = tap; !ret && i < hsz; i += 2) {
+         if(hpx == hp0) {
+            if(hle) {
+               hpxstr = 0;
+               hle = 0;
+            }
+            else {
+               hpxstr = pstr;
+               sfac = 1.0;
+            }
+         }
+         if(hpx == hp1) {
+            if(hre) {
+               hpxstr = 0;
+               hre = 0;
+               if(asym && da_ev) {
+                  hre = 1;
+                  fhre--;
+                  sfac = (float)fhre;
+                  if(sfac == 0.0)
+                     hre = 0;
+               }
+            }
+            else {
+               hpxstr = nstr;
+               if(asym)
+                  sfac = -1.0;
+            }
+         }
+         ret = lets_term(plan, himg, hpx, hsign * hi[i] * sfac, 0);
+         hpx += hpxstr;
+      }
+      himg++;
+   }
+
+   if(ret){
+      free_lets_terms(plan);
+      return(ret);
+   }
+   return(0);
+}
+
+/************************************************************************/
+/* Plan kernels.  Output "pos" of lane "l" is written to                */
+/* out[pos*ostr + l] from the input samples in[src*istr + l], where the */
+/* lanes are adjacent lines of the image, so each load and store moves  */
+/* several lines at once.  The runs are stepped through together, so   */
+/* the outputs that read neighbouring input samples are formed one      */
+/* after the other and the input is walked through in order.           */
+/************************************************************************/
+static void lets_lanes_c(float *out, const int ostr, float *in,
+                         const int istr, const int nlanes,
+                         const LETS_PLAN *plan)
+{
+   int r, j, k, l, n;
+   LETS_RUN *run;
+   float *optr, *iptr, *ibase;
+
+   for(j = 0; j < plan->maxcount; j++) {
+      for(r = 0; r < plan->nruns; r++) {
+         run = plan->runs + r;
+         if(j >= run->count)
+            continue;
+         n = run->nterms;
+         optr = out + (run->pos + j * run->pstep) * ostr;
+         ibase = in + j * run->sstep * istr;
+         if(n == 0) {
+            for(l = 0; l < nlanes; l++)
+               optr[l] = 0.0;
+            continue;
+         }
+         iptr = ibase + run->src[0] * istr;
+         for(l = 0; l < nlanes; l++)
+            optr[l] = iptr[l] * run->coef[0];
+         for(k = 1; k < n; k++) {
+            iptr = ibase + run->src[k] * istr;
+            for(l = 0; l < nlanes; l++)
+               optr[l] += iptr[l] * run->coef[k];
+         }
+      }
+   }
+}
+
+#ifdef LETS_X86_DISPATCH
+__attribute__((target("sse2")))
+static void lets_lanes_sse2(float *out, const int ostr, float *in,
+                            const int istr, const int nlanes,
+                            const LETS_PLAN *plan)
+{
+   int r, j, k, l, n;
+   LETS_RUN *run;
+   float *optr, *ibase;
+   __m128 acc;
+   float sacc;
+
+   for(j = 0; j < plan->maxcount; j++) {
+      for(r = 0; r < plan->nruns; r++) {
+         run = plan->runs + r;
+         if(j >= run->count)
+            continue;
+         n = run->nterms;
+         optr = out + (run->pos + j * run->pstep) * ostr;
+         ibase = in + j * run->sstep * istr;
+         for(l = 0; l + 4 <= nlanes; l += 4) {
+            acc = _mm_setzero_ps();
+            if(n > 0)
+               acc = _mm_mul_ps(_mm_loadu_ps(ibase + run->src[0] * istr + l),
+                                _mm_set1_ps(run->coef[0]));
+            for(k = 1; k < n; k++)
+               acc = _mm_add_ps(acc,
+                        _mm_mul_ps(_mm_loadu_ps(ibase + run->src[k] * istr + l),
+                                   _mm_set1_ps(run->coef[k])));
+            _mm_storeu_ps(optr + l, acc);
+         }
+         for(; l < nlanes; l++) {
+            sacc = 0.0;
+            if(n > 0)
+               sacc = ibase[run->src[0] * istr + l] * run->coef[0];
+            for(k = 1; k < n; k++)
+               sacc += ibase[run->src[k] * istr + l] * run->coef[k];
+            optr[l] = sacc;
+         }
+      }
+   }
+}
+
+__attribute__((target("avx")))
+static void lets_lanes_avx(float *out, const int ostr, float *in,
+                           const int istr, const int nlanes,
+                           const LETS_PLAN *plan)
+{
+   int r, j, k, l, n;
+   LETS_RUN *run;
+   float *optr, *ibase;
+   __m256 acc;
+   float sacc;
+
+   for(j = 0; j < plan->maxcount; j++) {
+      for(r = 0; r < plan->nruns; r++) {
+         run = plan->runs + r;
+         if(j >= run->count)
+            continue;
+         n = run->nterms;
+         optr = out + (run->pos + j * run->pstep) * ostr;
+         ibase = in + j * run->sstep * istr;
+         for(l = 0; l + 8 <= nlanes; l += 8) {
+            acc = _mm256_setzero_ps();
+            if(n > 0)
+               acc = _mm256_mul_ps(
+                        _mm256_loadu_ps(ibase + run->src[0] * istr + l),
+                        _mm256_set1_ps(run->coef[0]));
+            for(k = 1; k < n; k++)
+               acc = _mm256_add_ps(acc, _mm256_mul_ps(
+                        _mm256_loadu_ps(ibase + run->src[k] * istr + l),
+                        _mm256_set1_ps(run->coef[k])));
+            _mm256_storeu_ps(optr + l, acc);
+         }
+         for(; l < nlanes; l++) {
+            sacc = 0.0;
+            if(n > 0)
+               sacc = ibase[run->src[0] * istr + l] * run->coef[0];
+            for(k = 1; k < n; k++)
+               sacc += ibase[run->src[k] * istr + l] * run->coef[k];
+            optr[l] = sacc;
+         }
+      }
+   }
+}
+#endif
+
+typedef void (*LETS_KERNEL)(float *, const int, float *, const int,
+                            const int, const LETS_PLAN *);
+
+/************************************************************************/
+/* Picks the widest kernel the running CPU supports.                    */
+/************************************************************************/
+static LETS_KERNEL lets_kernel(void)
+{
+#ifdef LETS_X86_DISPATCH
+   if(__builtin_cpu_supports("avx"))
+      return(lets_lanes_avx);
+   if(__builtin_cpu_supports("sse2"))
+      return(lets_lanes_sse2);
+#endif
+   return(lets_lanes_c);
+}
+
+/************************************************************************/
+/* Filters "len1" scanlines with a plan.  Scanlines start "pitch"       */
+/* floats apart and their samples are "stride" floats apart.  Columns   */
+/* (pitch 1) are filtered in place as lanes; rows (stride 1) are first  */
+/* gathered LETS_ROW_LANES at a time into an interleaved buffer, taken */
+/* from "arena" if not NULL.                                            */
+/************************************************************************/
+static int apply_lets_plan_arena(
+   float *new,           /* filtered output */
+   float *old,           /* input */
+   const int len1,       /* number of scanlines */
+   const int pitch,      /* pitch gives next row_col to filter */
+   const int stride,     /* stride gives next pixel to filter */
+   const LETS_PLAN *plan,
+   CODEC_ARENA *arena)
+{
+   LETS_KERNEL kernel;
+   float *ibuf, *obuf;
+   int rw, nr, r, i;
+
+   kernel = lets_kernel();
+
+   if(pitch == 1) {
+      (*kernel)(new, stride, old, stride, len1, plan);
+      return(0);
+   }
+
+   ibuf = (float *)codec_arena_alloc(arena, 2 * plan->nout *
+                                     LETS_ROW_LANES * sizeof(float));
+   if(ibuf == (float *)NULL){
+      fprintf(stderr, "ERROR : apply_lets_plan : malloc : ibuf\n");
+      return(-100);
+   }
+   obuf = ibuf + plan->nout * LETS_ROW_LANES;
+
+   for(rw = 0; rw < len1; rw += LETS_ROW_LANES) {
+      nr = len1 - rw;
+      if(nr > LETS_ROW_LANES)
+         nr = LETS_ROW_LANES;
+      for(i = 0; i < plan->nout; i++)
+         for(r = 0; r < nr; r++)
+            ibuf[i * LETS_ROW_LANES + r] = old[(rw + r) * pitch + i * stride];
+      (*kernel)(obuf, LETS_ROW_LANES, ibuf, LETS_ROW_LANES, nr, plan);
+      for(i = 0; i < plan->nout; i++)
+         for(r = 0; r < nr; r++)
+            new[(rw + r) * pitch + i * stride] = obuf[i * LETS_ROW_LANES + r];
+   }
+
+   codec_arena_free(arena, ibuf);
+   return(0);
+}
+
+/************************************************************************/
+/* Filters "len1" scanlines with a plan, as apply_lets_plan_arena does  */
+/* with no arena.  Safe to call from several threads on one plan.       */
+/************************************************************************/
+int apply_lets_plan(
+   float *new,           /* filtered output */
+   float *old,           /* input */
+   const int len1,       /* number of scanlines */
+   const int pitch,      /* pitch gives next row_col to filter */
+   const int stride,     /* stride gives next pixel to filter */
+   const LETS_PLAN *plan)
+{
+   return(apply_lets_plan_arena(new, old, len1, pitch, stride, plan,
+                                (CODEC_ARENA *)NULL));
+}
+
+/************************************************************************/
+/* Filters one band of scanlines.                                       */
+/************************************************************************/
+static int lets_band_job(void *arg, const int job)
+{
+   LETS_BANDS *bands = (LETS_BANDS *)arg;
+   int first, n;
+
+   first = job * bands->band;
+   n = bands->len1 - first;
+   if(n > bands->band)
+      n = bands->band;
+
+   return(apply_lets_plan(bands->new + first * bands->pitch,
+                          bands->old + first * bands->pitch, n,
+                          bands->pitch, bands->stride, bands->plan));
+}
+
+/************************************************************************/
+/* Filters like apply_lets_plan with the scanlines split into bands of  */
+/* whole vectors, one band per thread.  Small passes run on the calling */
+/* thread alone, with their buffer from the plan's arena.               */
+/************************************************************************/
+int apply_lets_plan_mt(
+   float *new,           /* filtered output */
+   float *old,           /* input */
+   const int len1,       /* number of scanlines */
+   const int pitch,      /* pitch gives next row_col to filter */
+   const int stride,     /* stride gives next pixel to filter */
+   const LETS_PLAN *plan,
+   const int nthreads)
+{
+   LETS_BANDS bands;
+   int nbands;
+
+   nbands = (int)(((double)len1 * plan->nout) / LETS_BAND_SAMPLES);
+   if(nbands > nthreads)
+      nbands = nthreads;
+   if(nbands <= 1)
+      return(apply_lets_plan_arena(new, old, len1, pitch, stride, plan,
+                                   plan->arena));
+
+   bands.new = new;
+   bands.old = old;
+   bands.len1 = len1;
+   bands.pitch = pitch;
+   bands.stride = stride;
+   bands.plan = plan;
+   bands.band = (len1 + nbands - 1) / nbands;
+   bands.band = (bands.band + LETS_ROW_LANES - 1) & ~(LETS_ROW_LANES - 1);
+   nbands = (len1 + bands.band - 1) / bands.band;
+
+   return(wsq_run_jobs(nbands, nbands, lets_band_job, &bands));
+}
+
+/************************************************************************/
+/* Builds the plan that filters like get_lets along "len2" samples.     */
+/* Its tables come from "arena" if not NULL.                            */
+/************************************************************************/
+int build_get_lets_plan(LETS_PLAN *plan, const int len2, float *hi,
+                        const int hsz, float *lo, const int lsz, const int inv,
+                        CODEC_ARENA *arena)
+{
+   int ret;
+   LETS_TERMS terms;
+
+   terms.arena = arena;
+   ret = get_lets_terms(&terms, len2, hi, hsz, lo, lsz, inv);
+   if(ret)
+      return(ret);
+   ret = compress_lets_terms(plan, &terms);
+   free_lets_terms(&terms);
+   return(ret);
+}
+
+/************************************************************************/
+/* Builds the plan that filters like join_lets along "len2" samples.    */
+/* Its tables come from "arena" if not NULL.                            */
+/************************************************************************/
+int build_join_lets_plan(LETS_PLAN *plan, const int len2, float *hi,
+                         const int hsz, float *lo, const int lsz,
+                         const int inv, CODEC_ARENA *arena)
+{
+   int ret;
+   LETS_TERMS terms;
+
+   terms.arena = arena;
+   ret = join_lets_terms(&terms, len2, hi, hsz, lo, lsz, inv);
+   if(ret)
+      return(ret);
+   ret = compress_lets_terms(plan, &terms);
+   free_lets_terms(&terms);
+   return(ret);
+}
+
+/************************************************************************/
+/* Computes the same subband split as get_lets.                         */
+/* Scratch memory comes from "arena" if not NULL and is given back     */
+/* before returning.                                                    */
+/************************************************************************/
+int get_lets_vec(float *new, float *old, const int len1, const int len2,
+                 const int pitch, const int stride, float *hi, const int hsz,
+                 float *lo, const int lsz, const int inv,
+                 const int nthreads, CODEC_ARENA *arena)
+{
+   int ret;
+   LETS_PLAN plan;
+   CODEC_ARENA_MARK mark;
+
+   codec_arena_mark(arena, &mark);
+   ret = build_get_lets_plan(&plan, len2, hi, hsz, lo, lsz, inv, arena);
+   if(!ret){
+      ret = apply_lets_plan_mt(new, old, len1, pitch, stride, &plan,
+                               nthreads);
+      free_LETS_PLAN(&plan);
+   }
+   codec_arena_release(arena, &mark);
+   return(ret);
+}
+
+/************************************************************************/
+/* Computes the same subband join as join_lets.                         */
+/* Scratch memory comes from "arena" if not NULL and is given back     */
+/* before returning.                                                    */
+/************************************************************************/
+int join_lets_vec(float *new, float *old, const int len1, const int len2,
+                  const int pitch, const int stride, float *hi, const int hsz,
+                  float *lo, const int lsz, const int inv,
+                  const int nthreads, CODEC_ARENA *arena)
+{
+   int ret;
+   LETS_PLAN plan;
+   CODEC_ARENA_MARK mark;
+
+   codec_arena_mark(arena, &mark);
+   ret = build_join_lets_plan(&plan, len2, hi, hsz, lo, lsz, inv, arena);
+   if(!ret){
+      ret = apply_lets_plan_mt(new, old, len1, pitch, stride, &plan,
+                               nthreads);
+      free_LETS_PLAN(&plan);
+   }
+   codec_arena_release(arena, &mark);
+   return(ret);
+}
@@ -0,0 +1,291 @@
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    WSQ_STREAM.C
+
+      Contains routines responsible for feeding a WSQ datastream to
+      the decoder from a memory buffer, an open file, or a file
+      descriptor.  Files and descriptors are read a block at a time
+      into a buffer that the memory buffer routines decode from
+      directly.  Marker segments are only read as far as their
+      lengths require, and the huffman coded data only as far as it
+      is consumed, so datastreams may also come from pipes and
+      sockets.
+
+      ROUTINES:
+#cat: init_wsq_stream_mem - Sets up a stream over a memory buffer.
+#cat:
+#cat: open_wsq_stream_file - Sets up a buffered stream reading from an
+#cat:                open file.
+#cat: open_wsq_stream_fd - Sets up a buffered stream reading from a file
+#cat:                descriptor.
+#cat: close_wsq_stream - Releases a stream's buffer, returning unread
+#cat:                bytes to a seekable source.
+#cat: fill_wsq_stream - Reads until a given number of bytes are
+#cat:                buffered or the source is exhausted.
+#cat: fill_wsq_segment - Buffers the whole of the next marker segment.
+#cat:
+#cat: getc_marker_wsq_stream - Reads the next marker from a stream.
+#cat:
+#cat: getc_table_wsq_stream - Reads a table segment from a stream.
+#cat:
+#cat: getc_frame_header_wsq_stream - Reads the frame header from a stream.
+#cat:
+#cat: getc_block_header_stream - Reads a block header from a stream.
+#cat:
+#cat: getc_ppi_wsq_stream - Gets the PPI from the NISTCOM comment found
+#cat:                ahead of the first block of a stream.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <wsq.h>
+
+/************************************************************************/
+/* Sets up a stream that decodes straight from a memory buffer.         */
+/************************************************************************/
+void init_wsq_stream_mem(WSQ_STREAM *stream, unsigned char *idata,
+                         const int ilen)
+{
+   stream->fp = (FILE *)NULL;
+   stream->fd = -1;
+   stream->buf = idata;
+   stream->alloc = 0;
+   stream->cptr = idata;
+   stream->eptr = idata + ilen;
+   stream->keep = (unsigned char *)NULL;
+   stream->eof = 1;
+}
+
+/************************************************************************/
+static int alloc_wsq_stream(WSQ_STREAM *stream)
+{
+   stream->buf = (unsigned char *)malloc(WSQ_STREAM_BLOCK);
+   if(stream->buf == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : alloc_wsq_stream : malloc : buf\n");
+      return(-58);
+   }
+   stream->alloc = WSQ_STREAM_BLOCK;
+   stream->cptr = stream->buf;
+   stream->eptr = stream->buf;
+   stream->keep = (unsigned char *)NULL;
+   stream->eof = 0;
+   return(0);
+}
+
+/************************************************************************/
+/* Sets up a stream reading from "infp" a block at a time.              */
+/************************************************************************/
+int open_wsq_stream_file(WSQ_STREAM *stream, FILE *infp)
+{
+   stream->fp = infp;
+   stream->fd = -1;
+   return(alloc_wsq_stream(stream));
+}
+
+/************************************************************************/
+/* Sets up a stream reading from descriptor "fd".  Reads return as soon */
+/* as any data is available, so "fd" may be a pipe or socket.           */
+/************************************************************************/
+int open_wsq_stream_fd(WSQ_STREAM *stream, const int fd)
+{
+   stream->fp = (FILE *)NULL;
+   stream->fd = fd;
+   return(alloc_wsq_stream(stream));
+}
+
+/************************************************************************/
+/* Releases the stream's buffer.  Bytes read ahead of the decoder are   */
+/* handed back to a seekable file or descriptor, leaving it just past   */
+/* the datastream as an unbuffered decode would.                        */
+/************************************************************************/
+void close_wsq_stream(WSQ_STREAM *stream)
+{
+   long unread;
+
+   if(stream->alloc == 0)
+      return;
+
+   unread = stream->eptr - stream->cptr;
+   if(unread > 0){
+      if(stream->fp != (FILE *)NULL)
+         fseek(stream->fp, -unread, SEEK_CUR);
+      else if(stream->fd >= 0)
+         lseek(stream->fd, (off_t)-unread, SEEK_CUR);
+   }
+
+   free(stream->buf);
+   stream->buf = (unsigned char *)NULL;
+   stream->alloc = 0;
+   stream->cptr = stream->eptr = (unsigned char *)NULL;
+}
+
+/************************************************************************/
+/* Reads from the source until at least "need" bytes are buffered past  */
+/* "cptr" or the source is exhausted.  Bytes from "keep" on, if set, or */
+/* else from "cptr" on are kept; the buffer grows when they and "need"  */
+/* do not fit.  Running out of data is not an error here, as the        */
+/* routines that parse the buffer report it.                            */
+/************************************************************************/
+int fill_wsq_stream(WSQ_STREAM *stream, const int need)
+{
+   unsigned char *base, *nbuf;
+   long nkept, navail, ncur;
+   int nalloc, n;
+
+   while(!stream->eof && stream->eptr - stream->cptr < need){
+      base = (stream->keep != (unsigned char *)NULL) ?
+             stream->keep : stream->cptr;
+
+      /* Make room at the end of the buffer. */
+      if(stream->eptr == stream->buf + stream->alloc ||
+         stream->cptr + need > stream->buf + stream->alloc){
+         nkept = stream->eptr - base;
+         ncur = stream->cptr - base;
+         navail = stream->eptr - stream->cptr;
+         nalloc = stream->alloc;
+         while(nalloc < ncur + need || nalloc <= nkept)
+            nalloc *= 2;
+         if(nalloc != stream->alloc){
+            nbuf = (unsigned char *)malloc(nalloc);
+            if(nbuf == (unsigned char *)NULL){
+               fprintf(stderr, "ERROR : fill_wsq_stream : malloc : buf\n");
+               return(-58);
+            }
+            memcpy(nbuf, base, nkept);
+            free(stream->buf);
+            stream->buf = nbuf;
+            stream->alloc = nalloc;
+         }
+         else if(base != stream->buf)
+            memmove(stream->buf, base, nkept);
+         if(stream->keep != (unsigned char *)NULL)
+            stream->keep = stream->buf;
+         stream->cptr = stream->buf + ncur;
+         stream->eptr = stream->cptr + navail;
+      }
+
+      n = stream->buf + stream->alloc - stream->eptr;
+      if(stream->fp != (FILE *)NULL){
+         n = fread(stream->eptr, 1, n, stream->fp);
+         if(n == 0 && ferror(stream->fp)){
+            fprintf(stderr, "ERROR : fill_wsq_stream : fread\n");
+            return(-57);
+         }
+      }
+      else{
+         do
+            n = read(stream->fd, stream->eptr, n);
+         while(n < 0 && errno == EINTR);
+         if(n < 0){
+            fprintf(stderr, "ERROR : fill_wsq_stream : read\n");
+            return(-57);
+         }
+      }
+      if(n == 0)
+         stream->eof = 1;
+      stream->eptr += n;
+   }
+
+   return(0);
+}
+
+/************************************************************************/
+/* Buffers the marker segment starting at "cptr", given its length in   */
+/* the first two bytes.                                                 */
+/************************************************************************/
+int fill_wsq_segment(WSQ_STREAM *stream)
+{
+   int ret;
+
+   ret = fill_wsq_stream(stream, 2);
+   if(ret || stream->eptr - stream->cptr < 2)
+      return(ret);
+   return(fill_wsq_stream(stream, (stream->cptr[0] << 8) | stream->cptr[1]));
+}
+
+/************************************************************************/
+/* The routines below buffer just the bytes of the next marker or       */
+/* segment and parse them with the memory buffer routines.              */
+/************************************************************************/
+int getc_marker_wsq_stream(unsigned short *omarker, const int type,
+                           WSQ_STREAM *stream)
+{
+   int ret;
+
+   ret = fill_wsq_stream(stream, 2);
+   if(ret)
+      return(ret);
+   return(getc_marker_wsq(omarker, type, &stream->cptr, stream->eptr));
+}
+
+/************************************************************************/
+int getc_table_wsq_stream(unsigned short marker, DTT_TABLE *dtt_table,
+                          DQT_TABLE *dqt_table, DHT_TABLE *dht_table,
+                          WSQ_STREAM *stream)
+{
+   int ret;
+
+   ret = fill_wsq_segment(stream);
+   if(ret)
+      return(ret);
+   return(getc_table_wsq(marker, dtt_table, dqt_table, dht_table,
+                         &stream->cptr, stream->eptr));
+}
+
+/************************************************************************/
+int getc_frame_header_wsq_stream(FRM_HEADER_WSQ *frm_header,
+                                 WSQ_STREAM *stream)
+{
+   int ret;
+
+   ret = fill_wsq_segment(stream);
+   if(ret)
+      return(ret);
+   return(getc_frame_header_wsq(frm_header, &stream->cptr, stream->eptr));
+}
+
+/************************************************************************/
+int getc_block_header_stream(unsigned char *huff_table, WSQ_STREAM *stream)
+{
+   int ret;
+
+   ret = fill_wsq_segment(stream);
+   if(ret)
+      return(ret);
+   return(getc_block_header(huff_table, &stream->cptr, stream->eptr));
+}
+
+/************************************************************************/
+/* Gets the PPI of an image from a stream positioned after its frame    */
+/* header.  The stream must be keeping all bytes from the start of the  */
+/* datastream.  Segments are buffered, without being consumed, up to    */
+/* the first Start Of Block, which ends the search for a NISTCOM.       */
+/************************************************************************/
+int getc_ppi_wsq_stream(int *oppi, WSQ_STREAM *stream)
+{
+   int ret;
+   long pos;               /* offset of the next marker from "cptr" */
+   unsigned char *mptr;
+
+   pos = 0;
+   while(1){
+      ret = fill_wsq_stream(stream, pos + 4);
+      if(ret)
+         return(ret);
+      if(stream->eptr - stream->cptr < pos + 2)
+         break;
+      mptr = stream->cptr + pos;
+      if(((mptr[0] << 8) | mptr[1]) == SOB_WSQ || mptr[0] != 0xFF ||
+         stream->eptr - stream->cptr < pos + 4)
+         break;
+      pos += 2 + ((mptr[2] << 8) | mptr[3]);
+   }
+
+   return(getc_ppi_wsq(oppi, stream->keep,
+                       stream->eptr - stream->keep));
+}
@@ -0,0 +1,110 @@
+/***********************************************************************
+      LIBRARY: WSQ - Grayscale Image Compression
+
+      FILE:    WSQ_THREAD.C
+
+      Contains the routine used to spread the independent pieces of
+      one encoding stage (filter bands, subbands, huffman blocks)
+      across worker threads.  Each job writes only its own outputs,
+      so the results do not depend on how the jobs were scheduled.
+
+      ROUTINES:
+#cat: wsq_run_jobs - Runs a numbered set of jobs on up to a given
+#cat:                number of threads and waits for them to finish.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <pthread.h>
+#include <wsq.h>
+
+typedef struct wsq_jobs {
+   pthread_mutex_t lock;
+   int next;         /* next job to hand out */
+   int njobs;
+   int ret;          /* first error returned by a job */
+   WSQ_JOB job;
+   void *arg;
+} WSQ_JOBS;
+
+/************************************************************************/
+/* Takes jobs from the shared counter until none are left or one of     */
+/* them has failed.                                                     */
+/************************************************************************/
+static void *wsq_job_worker(void *varg)
+{
+   WSQ_JOBS *jobs = (WSQ_JOBS *)varg;
+   int i, ret;
+
+   while(1){
+      pthread_mutex_lock(&jobs->lock);
+      if(jobs->ret == 0 && jobs->next < jobs->njobs)
+         i = jobs->next++;
+      else
+         i = -1;
+      pthread_mutex_unlock(&jobs->lock);
+      if(i < 0)
+         break;
+
+      ret = (*jobs->job)(jobs->arg, i);
+      if(ret){
+         pthread_mutex_lock(&jobs->lock);
+         if(jobs->ret == 0)
+            jobs->ret = ret;
+         pthread_mutex_unlock(&jobs->lock);
+      }
+   }
+
+   return((void *)NULL);
+}
+
+/************************************************************************/
+/* Runs jobs 0 through njobs-1 using the calling thread and up to       */
+/* nthreads-1 additional threads.  If threads cannot be started the     */
+/* remaining work is done by the threads that are running.              */
+/************************************************************************/
+int wsq_run_jobs(const int nthreads, const int njobs, WSQ_JOB job, void *arg)
+{
+   WSQ_JOBS jobs;
+   pthread_t threads[WSQ_MAX_THREADS];
+   int i, nworkers, ret;
+
+   nworkers = nthreads;
+   if(nworkers > njobs)
+      nworkers = njobs;
+   if(nworkers > WSQ_MAX_THREADS)
+      nworkers = WSQ_MAX_THREADS;
+
+   if(nworkers <= 1){
+      for(i = 0; i < njobs; i++){
+         ret = (*job)(arg, i);
+         if(ret)
+            return(ret);
+      }
+      return(0);
+   }
+
+   if(pthread_mutex_init(&jobs.lock, NULL)){
+      fprintf(stderr, "ERROR : wsq_run_jobs : pthread_mutex_init\n");
+      return(-101);
+   }
+   jobs.next = 0;
+   jobs.njobs = njobs;
+   jobs.ret = 0;
+   jobs.job = job;
+   jobs.arg = arg;
+
+   /* The calling thread is the first worker. */
+   for(i = 1; i < nworkers; i++)
+      if(pthread_create(&threads[i], NULL, wsq_job_worker, &jobs))
+         break;
+   nworkers = i;
+
+   wsq_job_worker(&jobs);
+
+   for(i = 1; i < nworkers; i++)
+      pthread_join(threads[i], NULL);
+   pthread_mutex_destroy(&jobs.lock);
+
+   return(jobs.ret);
+}
@@ -12,6 +12,14 @@
       ROUTINES:
 #cat: build_wsq_trees - Builds WSQ decomposition trees.
 #cat:
+#cat: get_wsq_trees - Copies WSQ decomposition trees for an image size
+#cat:                from a cache shared by all codec contexts.
+#cat: preload_wsq_trees - Adds the trees of a list of image sizes to
+#cat:                the cache.
+#cat: get_wsq_tree_cache_stats - Reports the cache hit and miss counts.
+#cat:
+#cat: clear_wsq_tree_cache - Empties the cache and its counters.
+#cat:
 #cat: build_w_tree - Build subband x-y locations for creating wavelets.
 #cat:
 #cat: w_tree4 - Derives location and size of subband splits.
@@ -26,9 +34,33 @@
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include <wsq.h>
 #include <ihead.h>
 
+/* Trees for one image size, kept in the cache until least recently */
+/* used.  Entries are only ever copied out, never handed out.       */
+typedef struct wsq_tree_entry {
+   int width;
+   int height;
+   unsigned long used;       /* cache clock at last use */
+   W_TREE w_tree[W_TREELEN];
+   Q_TREE q_tree[Q_TREELEN];
+} WSQ_TREE_ENTRY;
+
+static pthread_mutex_t tree_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static WSQ_TREE_ENTRY tree_cache[WSQ_TREE_CACHE_SIZE];
+static int tree_cache_len = 0;
+static unsigned long tree_cache_clock = 0;
+static long tree_cache_hits = 0;
+static long tree_cache_misses = 0;
+
+/* Common scan sizes loaded by preload_wsq_trees when given no list. */
+static const int wsq_common_sizes[][2] = {
+   {500, 500}, {800, 750}, {832, 768}, {1600, 1500}
+};
+
 /************************************************************************/
 /*              Routines used to generate the "trees" used              */
 /*              in creating the wavelet subbands (w_tree)               */
@@ -48,6 +80,110 @@ void build_wsq_trees(W_TREE w_tree[], const int w_treelen,
    build_q_tree(w_tree, q_tree);
 }
 
+/************************************************************************/
+/* Finds the cache entry for an image size, building it in the least    */
+/* recently used slot if it is missing.  The cache must be locked.      */
+/************************************************************************/
+static WSQ_TREE_ENTRY *lookup_wsq_trees(const int width, const int height,
+                                        int *hit)
+{
+   WSQ_TREE_ENTRY *entry;
+   int i;
+
+   for(i = 0; i < tree_cache_len; i++){
+      entry = &tree_cache[i];
+      if(entry->width == width && entry->height == height){
+         entry->used = ++tree_cache_clock;
+         *hit = 1;
+         return(entry);
+      }
+   }
+
+   if(tree_cache_len < WSQ_TREE_CACHE_SIZE)
+      entry = &tree_cache[tree_cache_len++];
+   else{
+      entry = &tree_cache[0];
+      for(i = 1; i < WSQ_TREE_CACHE_SIZE; i++)
+         if(tree_cache[i].used < entry->used)
+            entry = &tree_cache[i];
+   }
+
+   entry->width = width;
+   entry->height = height;
+   entry->used = ++tree_cache_clock;
+   build_wsq_trees(entry->w_tree, W_TREELEN, entry->q_tree, Q_TREELEN,
+                   width, height);
+   *hit = 0;
+   return(entry);
+}
+
+/************************************************************************/
+/* Gives the same trees as build_wsq_trees, taken from a cache of the   */
+/* most recently used image sizes.  Safe to call from several threads.  */
+/************************************************************************/
+void get_wsq_trees(W_TREE w_tree[], const int w_treelen,
+                   Q_TREE q_tree[], const int q_treelen,
+                   const int width, const int height)
+{
+   WSQ_TREE_ENTRY *entry;
+   int hit;
+
+   pthread_mutex_lock(&tree_cache_lock);
+   entry = lookup_wsq_trees(width, height, &hit);
+   if(hit)
+      tree_cache_hits++;
+   else
+      tree_cache_misses++;
+   memcpy(w_tree, entry->w_tree, w_treelen * sizeof(W_TREE));
+   memcpy(q_tree, entry->q_tree, q_treelen * sizeof(Q_TREE));
+   pthread_mutex_unlock(&tree_cache_lock);
+}
+
+/************************************************************************/
+/* Loads the trees of "nsizes" width,height pairs into the cache, or of */
+/* the common scan sizes if "sizes" is NULL.  Loads are not counted as  */
+/* hits or misses.                                                      */
+/************************************************************************/
+void preload_wsq_trees(const int *sizes, const int nsizes)
+{
+   int i, n, hit;
+
+   pthread_mutex_lock(&tree_cache_lock);
+   if(sizes == (int *)NULL){
+      n = sizeof(wsq_common_sizes) / sizeof(wsq_common_sizes[0]);
+      for(i = 0; i < n; i++)
+         lookup_wsq_trees(wsq_common_sizes[i][0], wsq_common_sizes[i][1],
+                          &hit);
+   }
+   else
+      for(i = 0; i < nsizes; i++)
+         lookup_wsq_trees(sizes[2*i], sizes[2*i+1], &hit);
+   pthread_mutex_unlock(&tree_cache_lock);
+}
+
+/************************************************************************/
+/* Reports how often get_wsq_trees found its trees in the cache.        */
+/************************************************************************/
+void get_wsq_tree_cache_stats(long *ohits, long *omisses, int *onsizes)
+{
+   pthread_mutex_lock(&tree_cache_lock);
+   *ohits = tree_cache_hits;
+   *omisses = tree_cache_misses;
+   *onsizes = tree_cache_len;
+   pthread_mutex_unlock(&tree_cache_lock);
+}
+
+/************************************************************************/
+void clear_wsq_tree_cache(void)
+{
+   pthread_mutex_lock(&tree_cache_lock);
+   tree_cache_len = 0;
+   tree_cache_clock = 0;
+   tree_cache_hits = 0;
+   tree_cache_misses = 0;
+   pthread_mutex_unlock(&tree_cache_lock);
+}
+
 /********************************************************************/
 /* Routine to obtain subband "x-y locations" for creating wavelets. */
 /********************************************************************/
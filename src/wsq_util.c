@@ -16,18 +16,32 @@
 #cat:                  unsigned character pixels.
 #cat: variance - Calculates the variances within image subbands.
 #cat:
+#cat: variance_mt - Calculates the subband variances on several threads.
+#cat:
+#cat: quant_bin_widths - Computes the quantizer bin widths of the
+#cat:                  image's wavelet subbands from their variances.
 #cat: quantize - Quantizes the image's wavelet subbands.
 #cat:
 #cat: quant_block_sizes - Quantizes an image's subband block.
 #cat:
 #cat: unquantize - Unquantizes an image's wavelet subbands.
 #cat:
+#cat: unquantize_arena - Unquantizes an image's wavelet subbands into
+#cat:                  a plane taken from an arena.
 #cat: wsq_decompose - Computes the wavelet decomposition of an input image.
 #cat:
+#cat: wsq_decompose_mt - Computes the wavelet decomposition splitting each
+#cat:                  filter pass across several threads.
 #cat: get_lets - Compute the wavelet subband decomposition for the image.
 #cat:
 #cat: wsq_reconstruct - Reconstructs a lossy floating point pixmap from
 #cat:                  a WSQ compressed datastream.
+#cat: wsq_reconstruct_arena - Reconstructs a pixmap with its temporary
+#cat:                  pixmap taken from an arena.
+#cat: wsq_reconstruct_levels - Reconstructs all but the final row pass
+#cat:                  of a pixmap.
+#cat: wsq_reconstruct_node - Reconstructs only the low pass image held
+#cat:                  by one node of the wavelet tree.
 #cat: join_lets - Reconstruct the image from the wavelet subbands.
 #cat:
 #cat: int_sign - Get the sign of the sythesis filter coefficients.
@@ -67,7 +81,7 @@ void conv_img_2_flt(
 
 {
    int cnt;                     /* pixel cnt */
-   int sum;                     /* sum of pixel values */
+   long long sum;               /* sum of pixel values */
    float mean;                  /* mean pixel value */
    int low, high;               /* low/high pixel values */
    float low_diff, high_diff;   /* new low/high pixels values shifting */
@@ -133,18 +147,14 @@ void conv_img_2_uchar(
 }
 
 /**********************************************************/
-/* This routine calculates the variances of the subbands. */
+/* This routine calculates the variance of one subband.   */
 /**********************************************************/
-void variance(
-   QUANT_VALS *quant_vals, /* quantization parameters */
-   Q_TREE q_tree[],        /* quantization "tree"     */
-   const int q_treelen,    /* length of q_tree        */
+static float subband_variance(
+   Q_TREE *q_node,         /* subband to measure      */
    float *fip,             /* image pointer           */
-   const int width,        /* image width             */
-   const int height)       /* image height            */
+   const int width)        /* image width             */
 {
    float *fp;              /* temp image pointer */
-   int cvr;                /* subband counter */
    int lenx = 0, leny = 0; /* dimensions of area to calculate variance */
    int skipx, skipy;       /* pixels to skip to get to area for
                               variance calculation */
@@ -152,53 +162,97 @@ void variance(
    float ssq;             /* sum of squares */
    float sum2;            /* variance calculation parameter */
    float sum_pix;         /* sum of pixels */
-   
 
-   (void)q_treelen,(void) height; /* FIXME UNUSED */
-   for(cvr = 0; cvr < NUM_SUBBANDS; cvr++) {
-      fp = fip + (q_tree[cvr].y * width) + q_tree[cvr].x;
-      ssq = 0.0;
-      sum_pix = 0.0;
-
-      skipx = q_tree[cvr].lenx / 8;
-      skipy = (9 * q_tree[cvr].leny)/32;
-
-      lenx = (3 * q_tree[cvr].lenx)/4;
-      leny = (7 * q_tree[cvr].leny)/16;
-
-      fp += (skipy * width) + skipx;
-      for(row = 0; row < leny; row++, fp += (width - lenx)) {
-         for(col = 0; col < lenx; col++) {
-            sum_pix += *fp;
-            ssq += *fp * *fp;
-            fp++;
-         }
+   fp = fip + (q_node->y * width) + q_node->x;
+   ssq = 0.0;
+   sum_pix = 0.0;
+
+   skipx = q_node->lenx / 8;
+   skipy = (9 * q_node->leny)/32;
+
+   lenx = (3 * q_node->lenx)/4;
+   leny = (7 * q_node->leny)/16;
+
+   fp += (skipy * width) + skipx;
+   for(row = 0; row < leny; row++, fp += (width - lenx)) {
+      for(col = 0; col < lenx; col++) {
+         sum_pix += *fp;
+         ssq += *fp * *fp;
+         fp++;
       }
-      sum2 = (sum_pix * sum_pix)/(lenx * leny);
-      quant_vals->var[cvr] = (float)((ssq - sum2)/((lenx * leny)-1.0));
    }
+   sum2 = (sum_pix * sum_pix)/(lenx * leny);
+   return((float)((ssq - sum2)/((lenx * leny)-1.0)));
 }
 
-/************************************************/
-/* This routine quantizes the wavelet subbands. */
-/************************************************/
-int quantize(
-   short **osip,           /* quantized output             */
-   int *ocmp_siz,          /* size of quantized output     */
-   QUANT_VALS *quant_vals, /* quantization parameters      */
-   Q_TREE q_tree[],        /* quantization "tree"          */
-   const int q_treelen,    /* size of q_tree               */
-   float *fip,             /* floating point image pointer */
-   const int width,        /* image width                  */
-   const int height)       /* image height                 */
+/**********************************************************/
+/* This routine calculates the variances of the subbands. */
+/**********************************************************/
+void variance(
+   QUANT_VALS *quant_vals, /* quantization parameters */
+   Q_TREE q_tree[],        /* quantization "tree"     */
+   const int q_treelen,    /* length of q_tree        */
+   float *fip,             /* image pointer           */
+   const int width,        /* image width             */
+   const int height)       /* image height            */
+{
+   variance_mt(quant_vals, q_tree, q_treelen, fip, width, height, 1);
+}
+
+typedef struct variance_jobs {
+   QUANT_VALS *quant_vals;
+   Q_TREE *q_tree;
+   float *fip;
+   int width;
+} VARIANCE_JOBS;
+
+static int variance_job(void *arg, const int cvr)
+{
+   VARIANCE_JOBS *jobs = (VARIANCE_JOBS *)arg;
+
+   jobs->quant_vals->var[cvr] = subband_variance(&jobs->q_tree[cvr],
+                                                 jobs->fip, jobs->width);
+   return(0);
+}
+
+/**********************************************************/
+/* Calculates the subband variances, handing out one      */
+/* subband at a time to each of "nthreads" threads.       */
+/**********************************************************/
+void variance_mt(
+   QUANT_VALS *quant_vals, /* quantization parameters */
+   Q_TREE q_tree[],        /* quantization "tree"     */
+   const int q_treelen,    /* length of q_tree        */
+   float *fip,             /* image pointer           */
+   const int width,        /* image width             */
+   const int height,       /* image height            */
+   const int nthreads)     /* threads to use          */
+{
+   VARIANCE_JOBS jobs;
+   int cvr;                /* subband counter */
+
+   (void)q_treelen,(void) height; /* FIXME UNUSED */
+   jobs.quant_vals = quant_vals;
+   jobs.q_tree = q_tree;
+   jobs.fip = fip;
+   jobs.width = width;
+   /* The jobs cannot fail, so an error means no threads could run. */
+   if(wsq_run_jobs(nthreads, NUM_SUBBANDS, variance_job, &jobs))
+      for(cvr = 0; cvr < NUM_SUBBANDS; cvr++)
+         quant_vals->var[cvr] = subband_variance(&q_tree[cvr], fip, width);
+}
+
+/************************************************************/
+/* This routine computes the bin widths "qbss" and zero bin */
+/* widths "qzbs" of the wavelet subbands for the bitrate    */
+/* "r", given the subband variances.                        */
+/************************************************************/
+void quant_bin_widths(
+   QUANT_VALS *quant_vals) /* quantization parameters      */
 {
    int i;                 /* temp counter */
    int j;                 /* interation index */
-   float *fptr;           /* temp image pointer */
-   short *sip, *sptr;     /* pointers to quantized image */
-   int row, col;          /* temp image characteristic parameters */
    int cnt;               /* subband counter */
-   float zbin;            /* zero bin size */
    float A[NUM_SUBBANDS]; /* subband "weights" for quantization */
    float m[NUM_SUBBANDS]; /* subband size to image size ratios */
                           /* (reciprocal of FBI spec for 'm')  */
@@ -215,7 +269,6 @@ int quantize(
    float q;               /* current proportionality constant */
    float P;               /* product of 'q/Q' ratios */
 
-   (void)q_treelen; /* FIXME UNUSED */
    /* Set up 'A' table. */   
    for(cnt = 0; cnt < STRT_SUBBAND_3; cnt++)
       A[cnt] = 1.0;
@@ -247,14 +300,6 @@ int quantize(
                                     (float)log(quant_vals->var[cnt]));
    }
 
-
-   /* Set up output buffer. */
-   if((sip = (short *) calloc(width*height, sizeof(short))) == NULL) {
-      fprintf(stderr,"ERROR : quantize : calloc : sip\n");
-      return(-90);
-   }
-   sptr = sip;
-
    /* Set up 'm' table (these values are the reciprocal of 'm' in */
    /* the FBI spec).                                              */
    m1 = 1.0/1024.0;
@@ -345,6 +390,36 @@ int quantize(
          quant_vals->qbss[cnt] = 0.0;
       quant_vals->qzbs[cnt] = 1.2 * quant_vals->qbss[cnt];
    }
+}
+
+/************************************************/
+/* This routine quantizes the wavelet subbands. */
+/************************************************/
+int quantize(
+   short **osip,           /* quantized output             */
+   int *ocmp_siz,          /* size of quantized output     */
+   QUANT_VALS *quant_vals, /* quantization parameters      */
+   Q_TREE q_tree[],        /* quantization "tree"          */
+   const int q_treelen,    /* size of q_tree               */
+   float *fip,             /* floating point image pointer */
+   const int width,        /* image width                  */
+   const int height)       /* image height                 */
+{
+   float *fptr;           /* temp image pointer */
+   short *sip, *sptr;     /* pointers to quantized image */
+   int row, col;          /* temp image characteristic parameters */
+   int cnt;               /* subband counter */
+   float zbin;            /* zero bin size */
+
+   (void)q_treelen; /* FIXME UNUSED */
+   quant_bin_widths(quant_vals);
+
+   /* Set up output buffer. */
+   if((sip = (short *) calloc(width*height, sizeof(short))) == NULL) {
+      fprintf(stderr,"ERROR : quantize : calloc : sip\n");
+      return(-90);
+   }
+   sptr = sip;
 
    /* Now ready to compute and store bin widths for subbands. */
    for(cnt = 0; cnt < NUM_SUBBANDS; cnt++) {
@@ -415,36 +490,22 @@ void quant_block_sizes(int *oqsize1, int *oqsize2, int *oqsize3,
    *oqsize3 = qsize3;
 }
 
-/*************************************/
-/* Routine to unquantize image data. */
-/*************************************/
-int unquantize(
-   float **ofip,         /* floating point image pointer         */
+/************************************************************************/
+/* Unquantizes the subbands of "sip" into the zeroed plane "fip".       */
+/************************************************************************/
+static int unquantize_plane(
+   float *fip,           /* floating point image pointer         */
    const DQT_TABLE *dqt_table, /* quantization table structure   */
    Q_TREE q_tree[],      /* quantization table structure         */
-   const int q_treelen,  /* size of q_tree                       */
    short *sip,           /* quantized image pointer              */
-   const int width,      /* image width                          */
-   const int height)     /* image height                         */
+   const int width)      /* image width                          */
 {
-   float *fip;    /* floating point image */
    int row, col;  /* cover counter and row/column counters */
    float C;       /* quantizer bin center */
    float *fptr;   /* image pointers */
    short *sptr;
    int cnt;       /* subband counter */
 
-   (void)q_treelen; /* FIXME UNUSED */
-   if((fip = (float *) calloc(width*height, sizeof(float))) == NULL) {
-      fprintf(stderr,"ERROR : unquantize : calloc : fip\n");
-      return(-91);
-   }
-   if(dqt_table->dqt_def != 1) {
-      fprintf(stderr,
-      "ERROR: unquantize : quantization table parameters not defined!\n");
-      return(-92);
-   }
-
    sptr = sip;
    C = dqt_table->bin_center;
    for(cnt = 0; cnt < NUM_SUBBANDS; cnt++) {
@@ -475,6 +536,78 @@ int unquantize(
       }
    }
 
+   return(0);
+}
+
+/*************************************/
+/* Routine to unquantize image data. */
+/*************************************/
+int unquantize(
+   float **ofip,         /* floating point image pointer         */
+   const DQT_TABLE *dqt_table, /* quantization table structure   */
+   Q_TREE q_tree[],      /* quantization table structure         */
+   const int q_treelen,  /* size of q_tree                       */
+   short *sip,           /* quantized image pointer              */
+   const int width,      /* image width                          */
+   const int height)     /* image height                         */
+{
+   int ret;
+   float *fip;    /* floating point image */
+
+   (void)q_treelen; /* FIXME UNUSED */
+   if(dqt_table->dqt_def != 1) {
+      fprintf(stderr,
+      "ERROR: unquantize : quantization table parameters not defined!\n");
+      return(-92);
+   }
+   if((fip = (float *) calloc(width*height, sizeof(float))) == NULL) {
+      fprintf(stderr,"ERROR : unquantize : calloc : fip\n");
+      return(-91);
+   }
+
+   if((ret = unquantize_plane(fip, dqt_table, q_tree, sip, width))){
+      free(fip);
+      return(ret);
+   }
+
+   *ofip = fip;
+   return(0);
+}
+
+/************************************************************************/
+/* Unquantizes image data as unquantize does, into a plane taken from   */
+/* "arena", or from the codec allocator if NULL.                        */
+/************************************************************************/
+int unquantize_arena(
+   float **ofip,         /* floating point image pointer         */
+   const DQT_TABLE *dqt_table, /* quantization table structure   */
+   Q_TREE q_tree[],      /* quantization table structure         */
+   const int q_treelen,  /* size of q_tree                       */
+   short *sip,           /* quantized image pointer              */
+   const int width,      /* image width                          */
+   const int height,     /* image height                         */
+   CODEC_ARENA *arena)   /* arena for "fip", or NULL             */
+{
+   int ret;
+   float *fip;    /* floating point image */
+
+   (void)q_treelen; /* FIXME UNUSED */
+   if(dqt_table->dqt_def != 1) {
+      fprintf(stderr,
+      "ERROR: unquantize_arena : quantization table parameters not defined!\n");
+      return(-92);
+   }
+   if((fip = (float *) codec_arena_calloc(arena, width*height,
+                                          sizeof(float))) == NULL) {
+      fprintf(stderr,"ERROR : unquantize_arena : calloc : fip\n");
+      return(-91);
+   }
+
+   if((ret = unquantize_plane(fip, dqt_table, q_tree, sip, width))){
+      codec_arena_free(arena, fip);
+      return(ret);
+   }
+
    *ofip = fip;
    return(0);
 }
@@ -488,12 +621,30 @@ int wsq_decompose(float *fdata, const int width, const int height,
                   float *hifilt, const int hisz,
                   float *lofilt, const int losz)
 {
-   int num_pix, node;
+   return(wsq_decompose_mt(fdata, width, height, w_tree, w_treelen,
+                           hifilt, hisz, lofilt, losz, 1,
+                           (CODEC_ARENA *)NULL));
+}
+
+/************************************************************/
+/* Wavelet decomposition with the rows and columns of each  */
+/* filter pass split into bands over "nthreads" threads.    */
+/* Every band is filtered exactly as on a single thread.    */
+/* The temporary pixmap comes from "arena" if not NULL.     */
+/************************************************************/
+int wsq_decompose_mt(float *fdata, const int width, const int height,
+                  W_TREE w_tree[], const int w_treelen,
+                  float *hifilt, const int hisz,
+                  float *lofilt, const int losz, const int nthreads,
+                  CODEC_ARENA *arena)
+{
+   int ret, num_pix, node;
    float *fdata1, *fdata_bse;
 
    num_pix = width * height;
    /* Allocate temporary floating point pixmap. */
-   if((fdata1 = (float *) malloc(num_pix*sizeof(float))) == NULL) {
+   if((fdata1 = (float *) codec_arena_alloc(arena,
+                                     num_pix*sizeof(float))) == NULL) {
       fprintf(stderr,"ERROR : wsq_decompose : malloc : fdata1\n");
       return(-94);
    }
@@ -501,16 +652,37 @@ int wsq_decompose(float *fdata, const int width, const int height,
    /* Compute the Wavelet image decomposition. */
    for(node = 0; node < w_treelen; node++) {
       fdata_bse = fdata + (w_tree[node].y * width) + w_tree[node].x;
-      get_lets(fdata1, fdata_bse, w_tree[node].leny, w_tree[node].lenx,
-               width, 1, hifilt, hisz, lofilt, losz, w_tree[node].inv_rw);
-      get_lets(fdata_bse, fdata1, w_tree[node].lenx, w_tree[node].leny,
-               1, width, hifilt, hisz, lofilt, losz, w_tree[node].inv_cl);
+      ret = get_lets_vec(fdata1, fdata_bse, w_tree[node].leny,
+               w_tree[node].lenx, width, 1, hifilt, hisz, lofilt, losz,
+               w_tree[node].inv_rw, nthreads, arena);
+      if(!ret)
+         ret = get_lets_vec(fdata_bse, fdata1, w_tree[node].lenx,
+               w_tree[node].leny, 1, width, hifilt, hisz, lofilt, losz,
+               w_tree[node].inv_cl, nthreads, arena);
+      if(ret){
+         codec_arena_free(arena, fdata1);
+         return(ret);
+      }
    }
-   free(fdata1);
+   codec_arena_free(arena, fdata1);
 
    return(0);
 }
 
+/************************************************************/
+/* Returns "px", or the nearest end of the scanline "s0" to */
+/* "s1" if the reflection rules have stepped past it, as    */
+/* they do on scanlines of 4 samples or fewer.              */
+/************************************************************/
+static float *scan_sample(float *px, float *s0, float *s1)
+{
+   if(px < s0)
+      return(s0);
+   if(px > s1)
+      return(s1);
+   return(px);
+}
+
 /************************************************************/
 /************************************************************/
 void get_lets(
@@ -544,6 +716,7 @@ void get_lets(
    int lre, lre2;
    int hle, hle2;
    int hre, hre2;
+   float nhi[256];		/* negated hipass filter for even filters */
 
 
    da_ev = len2 % 2;
@@ -575,7 +748,8 @@ void get_lets(
       }
 
       for(i = 0; i < hsz; i++)
-         hi[i] *= -1.0;
+         nhi[i] = -hi[i];
+      hi = nhi;
    }
 
    pstr = stride;
@@ -618,7 +792,7 @@ void get_lets(
          lpx = lspx;
          lle = lle2;
          lre = lre2;
-         *lopass = *lpx * lo[0];
+         *lopass = *scan_sample(lpx, p0, p1) * lo[0];
          for(i = 1; i < lsz; i++) {
             if(lpx == p0) {
                if(lle) {
@@ -637,7 +811,7 @@ void get_lets(
                   lpxstr = nstr;
 	    }
             lpx += lpxstr;
-            *lopass += *lpx * lo[i];
+            *lopass += *scan_sample(lpx, p0, p1) * lo[i];
          }
          lopass += stride;
 
@@ -645,7 +819,7 @@ void get_lets(
          hpx = hspx;
          hle = hle2;
          hre = hre2;
-         *hipass = *hpx * hi[0];
+         *hipass = *scan_sample(hpx, p0, p1) * hi[0];
          for(i = 1; i < hsz; i++) {
             if(hpx == p0) {
                if(hle) {
@@ -664,7 +838,7 @@ void get_lets(
                   hpxstr = nstr;
 	    }
             hpx += hpxstr;
-            *hipass += *hpx * hi[i];
+            *hipass += *scan_sample(hpx, p0, p1) * hi[i];
          }
          hipass += stride;
 
@@ -694,7 +868,7 @@ void get_lets(
          lpx = lspx;
          lle = lle2;
          lre = lre2;
-         *lopass = *lpx * lo[0];
+         *lopass = *scan_sample(lpx, p0, p1) * lo[0];
          for(i = 1; i < lsz; i++) {
             if(lpx == p0) {
                if(lle) {
@@ -713,15 +887,11 @@ void get_lets(
                   lpxstr = nstr;
 	    }
             lpx += lpxstr;
-            *lopass += *lpx * lo[i];
+            *lopass += *scan_sample(lpx, p0, p1) * lo[i];
          }
          lopass += stride;
       }
    }
-   if(!fi_ev) {
-      for(i = 0; i < hsz; i++)
-         hi[i] *= -1.0;
-   }
 }
 
 /************************************************************************/
@@ -732,42 +902,149 @@ int wsq_reconstruct(float *fdata, const int width, const int height,
                   W_TREE w_tree[], const int w_treelen,
                   const DTT_TABLE *dtt_table)
 {
-   int num_pix, node;
+   return(wsq_reconstruct_arena(fdata, width, height, w_tree, w_treelen,
+                  dtt_table, (CODEC_ARENA *)NULL));
+}
+
+/************************************************************************/
+/* WSQ reconstructs the image as wsq_reconstruct does, taking the       */
+/* temporary pixmap from "arena" if not NULL.                           */
+/************************************************************************/
+int wsq_reconstruct_arena(float *fdata, const int width, const int height,
+                  W_TREE w_tree[], const int w_treelen,
+                  const DTT_TABLE *dtt_table, CODEC_ARENA *arena)
+{
+   int ret, num_pix;
+   float *fdata1;
+
+   num_pix = width * height;
+   /* Allocate temporary floating point pixmap. */
+   if((fdata1 = (float *) codec_arena_alloc(arena,
+                                     num_pix*sizeof(float))) == NULL) {
+      fprintf(stderr,"ERROR : wsq_reconstruct_arena : malloc : fdata1\n");
+      return(-97);
+   }
+
+   ret = wsq_reconstruct_levels(fdata, fdata1, width,
+                  w_tree, w_treelen, dtt_table, arena);
+   if(!ret)
+      ret = join_lets_vec(fdata + (w_tree[0].y * width) + w_tree[0].x,
+                  fdata1, w_tree[0].leny,
+                  w_tree[0].lenx, width, 1,
+                  dtt_table->hifilt, dtt_table->hisz,
+                  dtt_table->lofilt, dtt_table->losz,
+                  w_tree[0].inv_rw, 1, arena);
+   codec_arena_free(arena, fdata1);
+
+   return(ret);
+}
+
+/************************************************************************/
+/* Runs all of the reconstruction but the row pass of the final level,  */
+/* which spans the whole image.  The column pass of that level is left  */
+/* in "fdata1" for the caller to join back into "fdata".  Filter plans */
+/* come from "arena" if not NULL.                                       */
+/************************************************************************/
+int wsq_reconstruct_levels(float *fdata, float *fdata1, const int width,
+                  W_TREE w_tree[], const int w_treelen,
+                  const DTT_TABLE *dtt_table, CODEC_ARENA *arena)
+{
+   int ret, node;
+   float *fdata_bse;
+
+   if(dtt_table->lodef != 1) {
+      fprintf(stderr,
+      "ERROR: wsq_reconstruct_levels : Lopass filter coefficients not defined\n");
+      return(-95);
+   }
+   if(dtt_table->hidef != 1) {
+      fprintf(stderr,
+      "ERROR: wsq_reconstruct_levels : Hipass filter coefficients not defined\n");
+      return(-96);
+   }
+
+   /* Reconstruct floating point pixmap from wavelet subband data. */
+   for (node = w_treelen - 1; node >= 0; node--) {
+      fdata_bse = fdata + (w_tree[node].y * width) + w_tree[node].x;
+      ret = join_lets_vec(fdata1, fdata_bse, w_tree[node].lenx,
+                  w_tree[node].leny, 1, width,
+                  dtt_table->hifilt, dtt_table->hisz,
+                  dtt_table->lofilt, dtt_table->losz,
+                  w_tree[node].inv_cl, 1, arena);
+      if(!ret && node > 0)
+         ret = join_lets_vec(fdata_bse, fdata1, w_tree[node].leny,
+                  w_tree[node].lenx, width, 1,
+                  dtt_table->hifilt, dtt_table->hisz,
+                  dtt_table->lofilt, dtt_table->losz,
+                  w_tree[node].inv_rw, 1, arena);
+      if(ret)
+         return(ret);
+   }
+
+   return(0);
+}
+
+/************************************************************************/
+/* Reconstructs only the part of the image held by node "root" of the   */
+/* wavelet tree, joining just the nodes that lie within it.  For node 1 */
+/* or 14 this leaves the low pass image at 1/2 or 1/4 of the image      */
+/* width and height in the top left corner of "fdata", its samples      */
+/* scaled by 2 or 4.  Only subbands within the node need be filled in.  */
+/* NOTE: this routine modifies and returns the results in "fdata".      */
+/* The temporary rows come from "arena" if not NULL.                    */
+/************************************************************************/
+int wsq_reconstruct_node(float *fdata, const int width, const int height,
+                  W_TREE w_tree[], const int w_treelen,
+                  const DTT_TABLE *dtt_table, const int root,
+                  CODEC_ARENA *arena)
+{
+   int ret, node;
    float *fdata1, *fdata_bse;
+   W_TREE *rt;
 
+   (void)height;
    if(dtt_table->lodef != 1) {
       fprintf(stderr,
-      "ERROR: wsq_reconstruct : Lopass filter coefficients not defined\n");
+      "ERROR: wsq_reconstruct_node : Lopass filter coefficients not defined\n");
       return(-95);
    }
    if(dtt_table->hidef != 1) {
       fprintf(stderr,
-      "ERROR: wsq_reconstruct : Hipass filter coefficients not defined\n");
+      "ERROR: wsq_reconstruct_node : Hipass filter coefficients not defined\n");
       return(-96);
    }
 
-   num_pix = width * height;
-   /* Allocate temporary floating point pixmap. */
-   if((fdata1 = (float *) malloc(num_pix*sizeof(float))) == NULL) {
-      fprintf(stderr,"ERROR : wsq_reconstruct : malloc : fdata1\n");
+   rt = &w_tree[root];
+   /* The column passes only span the rows of the root node. */
+   if((fdata1 = (float *) codec_arena_alloc(arena,
+                              rt->leny*width*sizeof(float))) == NULL) {
+      fprintf(stderr,"ERROR : wsq_reconstruct_node : malloc : fdata1\n");
       return(-97);
    }
 
-   /* Reconstruct floating point pixmap from wavelet subband data. */
-   for (node = w_treelen - 1; node >= 0; node--) {
+   for (node = w_treelen - 1; node >= root; node--) {
+      if(w_tree[node].x < rt->x || w_tree[node].y < rt->y ||
+         w_tree[node].x + w_tree[node].lenx > rt->x + rt->lenx ||
+         w_tree[node].y + w_tree[node].leny > rt->y + rt->leny)
+         continue;
       fdata_bse = fdata + (w_tree[node].y * width) + w_tree[node].x;
-      join_lets(fdata1, fdata_bse, w_tree[node].lenx, w_tree[node].leny,
-                  1, width,
+      ret = join_lets_vec(fdata1, fdata_bse, w_tree[node].lenx,
+                  w_tree[node].leny, 1, width,
                   dtt_table->hifilt, dtt_table->hisz,
                   dtt_table->lofilt, dtt_table->losz,
-                  w_tree[node].inv_cl);
-      join_lets(fdata_bse, fdata1, w_tree[node].leny, w_tree[node].lenx,
-                  width, 1,
+                  w_tree[node].inv_cl, 1, arena);
+      if(!ret)
+         ret = join_lets_vec(fdata_bse, fdata1, w_tree[node].leny,
+                  w_tree[node].lenx, width, 1,
                   dtt_table->hifilt, dtt_table->hisz,
                   dtt_table->lofilt, dtt_table->losz,
-                  w_tree[node].inv_rw);
+                  w_tree[node].inv_rw, 1, arena);
+      if(ret){
+         codec_arena_free(arena, fdata1);
+         return(ret);
+      }
    }
-   free(fdata1);
+   codec_arena_free(arena, fdata1);
 
    return(0);
 }
@@ -788,6 +1065,7 @@ void  join_lets(
 {
    float *lp0, *lp1;
    float *hp0, *hp1;
+   float *s0, *s1;		/* first and last samples of the scanline */
    float *lopass, *hipass;	/* lo/hi pass image pointers */
    float *limg, *himg;
    int pix, cl_rw;		/* pixel counter and column/row counter */
@@ -808,6 +1086,7 @@ void  join_lets(
    int hstap, hotap;
    int asym, fhre=0, ofhre;
    float ssfac, osfac, sfac;
+   float nhi[256];		/* negated hipass filter for even filters */
 
    da_ev = len2 % 2;
    fi_ev = lsz % 2;
@@ -874,7 +1153,8 @@ void  join_lets(
       }
 
       for(i = 0; i < hsz; i++)
-         hi[i] *= -1.0;
+         nhi[i] = -hi[i];
+      hi = nhi;
    }
 
 
@@ -891,6 +1171,8 @@ void  join_lets(
          lopass = old + cl_rw * pitch;
          hipass = lopass + stride * llen;
       }
+      s0 = old + cl_rw * pitch;
+      s1 = s0 + (len2-1) * stride;
 
 
       lp0 = lopass;
@@ -917,7 +1199,7 @@ void  join_lets(
             lpx = lspx;
             lpxstr = lspxstr;
 
-            *limg = *lpx * lo[tap];
+            *limg = *scan_sample(lpx, s0, s1) * lo[tap];
             for(i = tap+2; i < lsz; i += 2) {
                if(lpx == lp0) {
                   if(lle) {
@@ -936,7 +1218,7 @@ void  join_lets(
                      lpxstr = nstr;
                }
                lpx += lpxstr;
-               *limg += *lpx * lo[i];
+               *limg += *scan_sample(lpx, s0, s1) * lo[i];
             }
             limg += stride;
          }
@@ -988,7 +1270,7 @@ void  join_lets(
                         sfac = -1.0;
                   }
                }
-               *himg += *hpx * hi[i] * sfac;
+               *himg += *scan_sample(hpx, s0, s1) * hi[i] * sfac;
                hpx += hpxstr;
             }
             himg += stride;
@@ -1025,7 +1307,7 @@ void  join_lets(
          lpx = lspx;
          lpxstr = lspxstr;
 
-         *limg = *lpx * lo[tap];
+         *limg = *scan_sample(lpx, s0, s1) * lo[tap];
          for(i = tap+2; i < lsz; i += 2) {
             if(lpx == lp0) {
                if(lle) {
@@ -1044,7 +1326,7 @@ void  join_lets(
                   lpxstr = nstr;
             }
             lpx += lpxstr;
-            *limg += *lpx * lo[i];
+            *limg += *scan_sample(lpx, s0, s1) * lo[i];
          }
          limg += stride;
       }
@@ -1106,16 +1388,12 @@ void  join_lets(
                      sfac = -1.0;
                }
             }
-            *himg += *hpx * hi[i] * sfac;
+            *himg += *scan_sample(hpx, s0, s1) * hi[i] * sfac;
             hpx += hpxstr;
          }
          himg += stride;
       }
-   }			
-
-   if(!fi_ev)
-      for(i = 0; i < hsz; i++)
-         hi[i] *= -1.0;
+   }
 }
 
 /*****************************************************/